@@ -0,0 +1,139 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_bench.h"
+#include "sln_brigades.h"
+#include "sln_pool.h"
+#include "../lib/parser/parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Counts calls into the connection's parent allocator while receiving
+ * application data records, as they would arrive off a TCP socket in MSS
+ * sized segments.  The unpooled run disables caching in the pool, which
+ * matches the allocation pattern from before it existed.  The reserve/commit
+ * run has the socket read land in Selene's buffers instead of being copied
+ * in by selene_io_in_enc_bytes.
+ */
+
+#define RECORD_SIZE 16384
+#define RECORDS_PER_MB ((1024 * 1024) / RECORD_SIZE)
+#define SEGMENT_SIZE 1460
+#define MB_COUNT 64
+
+static char *build_records(size_t *outlen) {
+  int i;
+  size_t len = RECORDS_PER_MB * (5 + RECORD_SIZE);
+  char *buf = malloc(len);
+  char *p = buf;
+
+  for (i = 0; i < RECORDS_PER_MB; i++) {
+    p[0] = 23;
+    p[1] = 3;
+    p[2] = 1;
+    p[3] = (RECORD_SIZE >> 8) & 0xFF;
+    p[4] = RECORD_SIZE & 0xFF;
+    memset(p + 5, 'a' + (i % 26), RECORD_SIZE);
+    p += 5 + RECORD_SIZE;
+  }
+
+  *outlen = len;
+  return buf;
+}
+
+static void feed_mb(selene_t *s, sln_parser_baton_t *baton, int reserve,
+                    const char *buf, size_t len) {
+  size_t off;
+  size_t n;
+  size_t rlen;
+  char *rbuf;
+
+  for (off = 0; off < len; off += n) {
+    n = len - off < SEGMENT_SIZE ? len - off : SEGMENT_SIZE;
+    if (reserve) {
+      /* stands in for the read() into the reserved space */
+      SLN_BENCH_ERR(selene_io_in_enc_reserve(s, SEGMENT_SIZE, &rbuf, &rlen));
+      memcpy(rbuf, buf + off, n);
+      SLN_BENCH_ERR(selene_io_in_enc_commit(s, n));
+    } else {
+      SLN_BENCH_ERR(selene_io_in_enc_bytes(s, buf + off, n));
+    }
+    SLN_BENCH_ERR(sln_io_tls_read(s, baton));
+    sln_brigade_clear(baton->in_application);
+  }
+}
+
+static void run(const char *name, int pooled, int reserve, const char *buf,
+                size_t len) {
+  int i;
+  double start;
+  double elapsed;
+  size_t pool_requests;
+  sln_bench_alloc_t ba;
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  sln_parser_baton_t *baton;
+
+  sln_bench_alloc_init(&ba);
+  SLN_BENCH_ERR(selene_conf_create_with_alloc(&conf, &ba.alloc));
+  SLN_BENCH_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_BENCH_ERR(selene_server_create(conf, &s));
+  baton = (sln_parser_baton_t *)s->backend_baton;
+
+  if (!pooled) {
+    for (i = 0; i < SLN_POOL_CLASSES; i++) {
+      s->pool->classes[i].max_free = 0;
+    }
+  }
+
+  /* warm up, so that the pool reaches its steady state */
+  feed_mb(s, baton, reserve, buf, len);
+
+  sln_bench_alloc_reset(&ba);
+  pool_requests = s->pool->hits + s->pool->misses;
+  start = sln_bench_now();
+  for (i = 0; i < MB_COUNT; i++) {
+    feed_mb(s, baton, reserve, buf, len);
+  }
+  elapsed = sln_bench_now() - start;
+  pool_requests = s->pool->hits + s->pool->misses - pool_requests;
+
+  printf("%s:\n", name);
+  sln_bench_report("  parent allocations", "per MB",
+                   (double)ba.mallocs / MB_COUNT);
+  sln_bench_report("  parent bytes", "per MB", (double)ba.bytes / MB_COUNT);
+  sln_bench_report("  pool requests", "per MB",
+                   (double)pool_requests / MB_COUNT);
+  sln_bench_report("  throughput", "MB/s", MB_COUNT / elapsed);
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+int main(int argc, char *argv[]) {
+  size_t len;
+  char *buf = build_records(&len);
+
+  run("unpooled", 0, 0, buf, len);
+  run("pooled", 1, 0, buf, len);
+  run("pooled, reserve/commit", 1, 1, buf, len);
+
+  free(buf);
+
+  return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_bench.h"
+#include "sln_brigades.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Brigade traversal and queue operations, on the shapes the record layer
+ * produces: many small buckets from MSS sized reads and record headers,
+ * with their headers spread over the heap by unrelated allocations.
+ */
+
+#define BUCKET_SIZE 64
+#define BUCKET_COUNT 256
+#define ITERATIONS 20000
+
+static void *junk[BUCKET_COUNT];
+
+static sln_brigade_t *build(selene_alloc_t *alloc) {
+  int i;
+  char data[BUCKET_SIZE];
+  sln_brigade_t *bb;
+  sln_bucket_t *e;
+
+  memset(data, 'x', sizeof(data));
+  SLN_BENCH_ERR(sln_brigade_create(alloc, &bb));
+
+  for (i = 0; i < BUCKET_COUNT; i++) {
+    SLN_BENCH_ERR(sln_bucket_create_copy_bytes(alloc, &e, data, sizeof(data)));
+    SLN_BRIGADE_INSERT_TAIL(bb, e);
+    /* keeps neighbouring bucket headers apart, like a busy heap would */
+    junk[i] = malloc(64 + (rand() % 1024));
+  }
+
+  return bb;
+}
+
+static void free_junk(void) {
+  int i;
+
+  for (i = 0; i < BUCKET_COUNT; i++) {
+    free(junk[i]);
+  }
+}
+
+static void bench_pread(selene_alloc_t *alloc) {
+  int i;
+  size_t len;
+  double start;
+  char *buf = malloc(BUCKET_SIZE * BUCKET_COUNT);
+  sln_brigade_t *bb = build(alloc);
+
+  start = sln_bench_now();
+  for (i = 0; i < ITERATIONS; i++) {
+    SLN_BENCH_ERR(
+        sln_brigade_pread_bytes(bb, 0, BUCKET_SIZE * BUCKET_COUNT, buf, &len));
+  }
+  sln_bench_report("pread whole brigade", "ns/op",
+                   (sln_bench_now() - start) * 1e9 / ITERATIONS);
+
+  /* a 5 byte header read at the end, the worst case for the search */
+  start = sln_bench_now();
+  for (i = 0; i < ITERATIONS; i++) {
+    SLN_BENCH_ERR(sln_brigade_pread_bytes(
+        bb, BUCKET_SIZE * BUCKET_COUNT - 5, 5, buf, &len));
+  }
+  sln_bench_report("pread 5 bytes at the tail", "ns/op",
+                   (sln_bench_now() - start) * 1e9 / ITERATIONS);
+
+  sln_brigade_destroy(bb);
+  free_junk();
+  free(buf);
+}
+
+static void bench_fifo(selene_alloc_t *alloc) {
+  int i;
+  double start;
+  char data[BUCKET_SIZE];
+  sln_brigade_t *bb = build(alloc);
+  sln_bucket_t *e;
+
+  memset(data, 'y', sizeof(data));
+
+  /* appending at the tail while consuming from the head */
+  start = sln_bench_now();
+  for (i = 0; i < ITERATIONS * 10; i++) {
+    SLN_BENCH_ERR(sln_bucket_create_copy_bytes(alloc, &e, data, sizeof(data)));
+    SLN_BRIGADE_INSERT_TAIL(bb, e);
+    SLN_BENCH_ERR(sln_brigade_chomp(bb, BUCKET_SIZE));
+  }
+  sln_bench_report("append and chomp", "ns/op",
+                   (sln_bench_now() - start) * 1e9 / (ITERATIONS * 10));
+
+  sln_brigade_destroy(bb);
+  free_junk();
+}
+
+static void bench_copy_into(selene_alloc_t *alloc) {
+  int i;
+  double start;
+  sln_brigade_t *bb = build(alloc);
+  sln_brigade_t *dest;
+
+  SLN_BENCH_ERR(sln_brigade_create(alloc, &dest));
+
+  /* slicing a record out of the middle, as the record layer does */
+  start = sln_bench_now();
+  for (i = 0; i < ITERATIONS; i++) {
+    SLN_BENCH_ERR(sln_brigade_copy_into(bb, BUCKET_SIZE * BUCKET_COUNT / 2,
+                                        BUCKET_SIZE * 8, dest));
+    sln_brigade_clear(dest);
+  }
+  sln_bench_report("copy_into 8 buckets from the middle", "ns/op",
+                   (sln_bench_now() - start) * 1e9 / ITERATIONS);
+
+  sln_brigade_destroy(dest);
+  sln_brigade_destroy(bb);
+  free_junk();
+}
+
+int main(int argc, char *argv[]) {
+  sln_bench_alloc_t ba;
+
+  sln_bench_alloc_init(&ba);
+
+  printf("%d buckets of %d bytes:\n", BUCKET_COUNT, BUCKET_SIZE);
+  bench_pread(&ba.alloc);
+  bench_fifo(&ba.alloc);
+  bench_copy_into(&ba.alloc);
+
+  return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_bench.h"
+#include "sln_digest.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Compares the OpenSSL digests with the built-in ones: a handshake
+ * transcript, hashed as the handshake messages arrive, and bulk throughput.
+ * Then 8 transcripts at once through sln_digest_builtin_update_many, against
+ * updating them one after the other, which is where the multi-buffer
+ * kernels come in on CPUs without SHA instructions.
+ */
+
+#define TRANSCRIPTS 20000
+#define BULK_BYTES (64 * 1024 * 1024)
+#define LANES 8
+
+typedef struct backend_t {
+  const char *name;
+  selene_error_t *(*create)(selene_t *s, sln_digest_e type,
+                            sln_digest_t **p_digest);
+  void (*update)(sln_digest_t *digest, const void *data, size_t len);
+  void (*final)(sln_digest_t *digest, unsigned char *md);
+  void (*destroy)(sln_digest_t *d);
+} backend_t;
+
+static const backend_t backends[] = {
+    {"openssl", sln_digest_openssl_create, sln_digest_openssl_update,
+     sln_digest_openssl_final, sln_digest_openssl_destroy},
+    {"builtin", sln_digest_builtin_create, sln_digest_builtin_update,
+     sln_digest_builtin_final, sln_digest_builtin_destroy}};
+
+static const struct {
+  const char *name;
+  sln_digest_e type;
+} types[] = {{"MD5", SLN_DIGEST_MD5},
+             {"SHA1", SLN_DIGEST_SHA1},
+             {"SHA256", SLN_DIGEST_SHA256},
+             {"SHA384", SLN_DIGEST_SHA384}};
+
+/* Sizes of the messages of a full RSA handshake with a 2 certificate chain */
+static const size_t messages[] = {200, 90, 2800, 4, 134, 1, 16, 1, 16};
+
+static unsigned char buf[16384];
+
+static void transcript(selene_t *s, const backend_t *b, sln_digest_e type) {
+  unsigned char md[SLN_BIG_DIGEST_LENGTH];
+  sln_digest_t *d;
+  size_t i;
+
+  SLN_BENCH_ERR(b->create(s, type, &d));
+  for (i = 0; i < sizeof(messages) / sizeof(messages[0]); i++) {
+    b->update(d, buf, messages[i]);
+  }
+  b->final(d, md);
+  b->destroy(d);
+}
+
+static void run(selene_t *s, const backend_t *b, size_t t) {
+  unsigned char md[SLN_BIG_DIGEST_LENGTH];
+  sln_digest_t *d;
+  double start;
+  double elapsed;
+  size_t done;
+  int i;
+
+  start = sln_bench_now();
+  for (i = 0; i < TRANSCRIPTS; i++) {
+    transcript(s, b, types[t].type);
+  }
+  elapsed = sln_bench_now() - start;
+
+  printf("%s %s:\n", types[t].name, b->name);
+  sln_bench_report("  transcript", "handshakes/s", TRANSCRIPTS / elapsed);
+
+  SLN_BENCH_ERR(b->create(s, types[t].type, &d));
+  start = sln_bench_now();
+  for (done = 0; done < BULK_BYTES; done += sizeof(buf)) {
+    b->update(d, buf, sizeof(buf));
+  }
+  b->final(d, md);
+  elapsed = sln_bench_now() - start;
+  b->destroy(d);
+
+  sln_bench_report("  bulk", "MB/s", BULK_BYTES / elapsed / (1024 * 1024));
+}
+
+static void run_many(selene_t *s, size_t t) {
+  unsigned char md[SLN_BIG_DIGEST_LENGTH];
+  sln_digest_t *d[LANES];
+  const void *data[LANES];
+  size_t len[LANES];
+  double start;
+  double serial;
+  double many;
+  size_t i;
+  size_t m;
+  int n;
+
+  for (i = 0; i < LANES; i++) {
+    data[i] = buf + (i * 64);
+  }
+
+  start = sln_bench_now();
+  for (n = 0; n < TRANSCRIPTS / LANES; n++) {
+    for (i = 0; i < LANES; i++) {
+      SLN_BENCH_ERR(sln_digest_builtin_create(s, types[t].type, &d[i]));
+    }
+    for (m = 0; m < sizeof(messages) / sizeof(messages[0]); m++) {
+      for (i = 0; i < LANES; i++) {
+        sln_digest_builtin_update(d[i], data[i], messages[m]);
+      }
+    }
+    for (i = 0; i < LANES; i++) {
+      sln_digest_builtin_final(d[i], md);
+      sln_digest_builtin_destroy(d[i]);
+    }
+  }
+  serial = sln_bench_now() - start;
+
+  start = sln_bench_now();
+  for (n = 0; n < TRANSCRIPTS / LANES; n++) {
+    for (i = 0; i < LANES; i++) {
+      SLN_BENCH_ERR(sln_digest_builtin_create(s, types[t].type, &d[i]));
+    }
+    for (m = 0; m < sizeof(messages) / sizeof(messages[0]); m++) {
+      for (i = 0; i < LANES; i++) {
+        len[i] = messages[m];
+      }
+      sln_digest_builtin_update_many(d, data, len, LANES);
+    }
+    for (i = 0; i < LANES; i++) {
+      sln_digest_builtin_final(d[i], md);
+      sln_digest_builtin_destroy(d[i]);
+    }
+  }
+  many = sln_bench_now() - start;
+
+  printf("%s builtin, %d transcripts at once:\n", types[t].name, LANES);
+  sln_bench_report("  one by one", "handshakes/s", TRANSCRIPTS / serial);
+  sln_bench_report("  update_many", "handshakes/s", TRANSCRIPTS / many);
+}
+
+int main(int argc, char *argv[]) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  size_t t;
+  size_t b;
+
+  memset(buf, 'h', sizeof(buf));
+
+  SLN_BENCH_ERR(selene_conf_create(&conf));
+  SLN_BENCH_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_BENCH_ERR(selene_client_create(conf, &s));
+
+  for (t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+    for (b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+      run(s, &backends[b], t);
+    }
+  }
+
+  for (t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+    run_many(s, t);
+  }
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+
+  return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_bench.h"
+#include "sln_brigades.h"
+#include "../lib/parser/parser.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Bulk application data throughput through a client and a server wired
+ * together in memory, like tests/test_loopback.c, for each cipher suite.
+ * Every byte is encrypted and MACed by the client, moved over, and decrypted
+ * and verified by the server, in parallel in the runs with workers.  The
+ * handshake cannot derive keys yet, so it is skipped, and both ends are keyed
+ * from the same made up master secret.
+ */
+
+#define WRITE_SIZE (256 * 1024)
+#define MB_COUNT 256
+
+typedef struct pipe_baton_t {
+  selene_t *sendto;
+  size_t received;
+} pipe_baton_t;
+
+/* stands in for a send() on one end and a read() on the other */
+static selene_error_t *want_pull(selene_t *s, selene_event_e event,
+                                 void *baton) {
+  pipe_baton_t *p = (pipe_baton_t *)baton;
+  struct iovec vec[16];
+  int count;
+  int i;
+  char *buf;
+  size_t len;
+  size_t moved;
+
+  for (;;) {
+    SELENE_ERR(selene_io_out_enc_peek_iovec(s, vec, 16, &count));
+    if (count == 0) {
+      break;
+    }
+    moved = 0;
+    for (i = 0; i < count; i++) {
+      SELENE_ERR(selene_io_in_enc_reserve(p->sendto, vec[i].iov_len, &buf,
+                                          &len));
+      memcpy(buf, vec[i].iov_base, vec[i].iov_len);
+      SELENE_ERR(selene_io_in_enc_commit(p->sendto, vec[i].iov_len));
+      moved += vec[i].iov_len;
+    }
+    SELENE_ERR(selene_io_out_enc_consume(s, moved));
+  }
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *have_cleartext(selene_t *s, selene_event_e event,
+                                      void *baton) {
+  pipe_baton_t *p = (pipe_baton_t *)baton;
+  char buf[16384];
+  size_t blen = 0;
+  size_t remaining = 0;
+
+  do {
+    SELENE_ERR(
+        selene_io_out_clear_bytes(s, &buf[0], sizeof(buf), &blen, &remaining));
+    p->received += blen;
+  } while (remaining > 0);
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *use_suite(selene_t *s, selene_cipher_suite_e suite) {
+  sln_parser_baton_t *baton = s->backend_baton;
+
+  /* selene_start left a client with the random of its ClientHello */
+  memset(baton->master_secret, 'm', sizeof(baton->master_secret));
+  baton->client_utc_unix_time = 0;
+  memset(baton->client_random_bytes, 'c', sizeof(baton->client_random_bytes));
+  baton->server_utc_unix_time = 0;
+  memset(baton->server_random_bytes, 's', sizeof(baton->server_random_bytes));
+  SELENE_ERR(sln_tls_params_init(s, suite));
+  sln_tls_params_activate_send(s);
+  sln_tls_params_activate_recv(s);
+  baton->ready_for_appdata = 1;
+
+  return SELENE_SUCCESS;
+}
+
+static void run(const char *name, selene_cipher_suite_e suite, int workers,
+                const char *data) {
+  int i;
+  double start;
+  double elapsed;
+  selene_error_t *err;
+  selene_conf_t *sconf = NULL;
+  selene_conf_t *cconf = NULL;
+  selene_t *server = NULL;
+  selene_t *client = NULL;
+  pipe_baton_t serverp;
+  pipe_baton_t clientp;
+
+  SLN_BENCH_ERR(selene_conf_create(&sconf));
+  SLN_BENCH_ERR(selene_conf_use_reasonable_defaults(sconf));
+  SLN_BENCH_ERR(selene_conf_record_workers(sconf, workers));
+  SLN_BENCH_ERR(selene_server_create(sconf, &server));
+  SLN_BENCH_ERR(selene_conf_create(&cconf));
+  SLN_BENCH_ERR(selene_conf_use_reasonable_defaults(cconf));
+  SLN_BENCH_ERR(selene_client_create(cconf, &client));
+
+  memset(&serverp, 0, sizeof(serverp));
+  memset(&clientp, 0, sizeof(clientp));
+  serverp.sendto = client;
+  clientp.sendto = server;
+
+  /* starting hooks up the input events, the ClientHello is thrown away */
+  SLN_BENCH_ERR(selene_start(server));
+  SLN_BENCH_ERR(selene_start(client));
+  sln_brigade_clear(client->bb.out_enc);
+
+  SLN_BENCH_ERR(
+      selene_subscribe(server, SELENE_EVENT_IO_OUT_ENC, want_pull, &serverp));
+  SLN_BENCH_ERR(selene_subscribe(server, SELENE_EVENT_IO_OUT_CLEAR,
+                                 have_cleartext, &serverp));
+  SLN_BENCH_ERR(
+      selene_subscribe(client, SELENE_EVENT_IO_OUT_ENC, want_pull, &clientp));
+  SLN_BENCH_ERR(selene_subscribe(client, SELENE_EVENT_IO_OUT_CLEAR,
+                                 have_cleartext, &clientp));
+
+  err = use_suite(client, suite);
+  if (err == SELENE_SUCCESS) {
+    err = use_suite(server, suite);
+  }
+  if (err != SELENE_SUCCESS && err->err == SELENE_ENOTIMPL) {
+    printf("%s: %s\n", name, err->msg);
+    selene_error_clear(err);
+    goto cleanup;
+  }
+  SLN_BENCH_ERR(err);
+
+  start = sln_bench_now();
+  for (i = 0; i < MB_COUNT * (1024 * 1024 / WRITE_SIZE); i++) {
+    SLN_BENCH_ERR(selene_io_in_clear_bytes(client, data, WRITE_SIZE));
+  }
+  elapsed = sln_bench_now() - start;
+
+  if (serverp.received != (size_t)MB_COUNT * 1024 * 1024) {
+    fprintf(stderr, "%s: only %lu bytes arrived\n", name,
+            (unsigned long)serverp.received);
+    exit(1);
+  }
+
+  sln_bench_report(name, "MB/s", MB_COUNT / elapsed);
+
+cleanup:
+  selene_destroy(server);
+  selene_destroy(client);
+  selene_conf_destroy(sconf);
+  selene_conf_destroy(cconf);
+}
+
+int main(int argc, char *argv[]) {
+  char *data = malloc(WRITE_SIZE);
+
+  memset(data, 'x', WRITE_SIZE);
+
+  run("RC4-SHA", SELENE_CS_RSA_WITH_RC4_128_SHA, 0, data);
+  run("AES128-SHA", SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 0, data);
+  run("AES256-SHA", SELENE_CS_RSA_WITH_AES_256_CBC_SHA, 0, data);
+  run("AES256-SHA, 3 workers", SELENE_CS_RSA_WITH_AES_256_CBC_SHA, 3, data);
+  run("AES128-GCM-SHA256", SELENE_CS_RSA_WITH_AES_128_GCM_SHA256, 0, data);
+  run("AES256-GCM-SHA384", SELENE_CS_RSA_WITH_AES_256_GCM_SHA384, 0, data);
+  run("AES256-GCM-SHA384, 3 workers", SELENE_CS_RSA_WITH_AES_256_GCM_SHA384,
+      3, data);
+
+  free(data);
+
+  return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_bench.h"
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Handshakes per second between a client and a server wired together in
+ * memory, full RSA handshakes against abbreviated ones that resume a session
+ * from the server's session ID cache, or from a session ticket.  Takes the
+ * directory holding the test certificates, tests/fixtures from the top of the
+ * tree by default.
+ */
+
+#define HANDSHAKE_COUNT 2000
+
+typedef struct pipe_baton_t {
+  selene_t *sendto;
+} pipe_baton_t;
+
+static selene_error_t *want_pull(selene_t *s, selene_event_e event,
+                                 void *baton) {
+  pipe_baton_t *p = (pipe_baton_t *)baton;
+  char buf[8192];
+  size_t blen = 0;
+  size_t remaining = 0;
+
+  do {
+    SELENE_ERR(
+        selene_io_out_enc_bytes(s, &buf[0], sizeof(buf), &blen, &remaining));
+    if (blen > 0) {
+      SELENE_ERR(selene_io_in_enc_bytes(p->sendto, buf, blen));
+    }
+  } while (remaining > 0);
+
+  return SELENE_SUCCESS;
+}
+
+static char *load_file(const char *dir, const char *fname) {
+  char path[1024];
+  FILE *fp;
+  long len;
+  char *buf;
+
+  snprintf(path, sizeof(path), "%s/%s", dir, fname);
+
+  fp = fopen(path, "r");
+  if (fp == NULL) {
+    fprintf(stderr, "fatal error: unable to open %s\n", path);
+    exit(1);
+  }
+
+  fseek(fp, 0, SEEK_END);
+  len = ftell(fp);
+  fseek(fp, 0, SEEK_SET);
+
+  buf = malloc(len + 1);
+  if (fread(buf, 1, len, fp) != (size_t)len) {
+    fprintf(stderr, "fatal error: short read from %s\n", path);
+    exit(1);
+  }
+  buf[len] = '\0';
+
+  fclose(fp);
+
+  return buf;
+}
+
+/* One handshake, offering session when it is not NULL */
+static void handshake(selene_conf_t *sconf, selene_conf_t *cconf,
+                      selene_session_t *session, selene_session_t **p_session) {
+  selene_t *server;
+  selene_t *client;
+  pipe_baton_t serverp;
+  pipe_baton_t clientp;
+
+  SLN_BENCH_ERR(selene_server_create(sconf, &server));
+  SLN_BENCH_ERR(selene_client_create(cconf, &client));
+
+  serverp.sendto = client;
+  clientp.sendto = server;
+
+  SLN_BENCH_ERR(selene_client_name_indication(client, "localhost"));
+  if (session != NULL) {
+    SLN_BENCH_ERR(selene_client_session_set(client, session));
+  }
+
+  SLN_BENCH_ERR(
+      selene_subscribe(server, SELENE_EVENT_IO_OUT_ENC, want_pull, &serverp));
+  SLN_BENCH_ERR(
+      selene_subscribe(client, SELENE_EVENT_IO_OUT_ENC, want_pull, &clientp));
+
+  SLN_BENCH_ERR(selene_start(server));
+  SLN_BENCH_ERR(selene_start(client));
+
+  if (session != NULL && !selene_session_resumed(client)) {
+    fprintf(stderr, "fatal error: session was not resumed\n");
+    exit(1);
+  }
+
+  if (p_session != NULL) {
+    SLN_BENCH_ERR(selene_session_get(client, p_session));
+  }
+
+  selene_destroy(client);
+  selene_destroy(server);
+}
+
+int main(int argc, char *argv[]) {
+  const char *dir = argc > 1 ? argv[1] : "tests/fixtures";
+  char *ca = load_file(dir, "test_ca.pem");
+  char *cert = load_file(dir, "test_cert.pem");
+  char *pkey = load_file(dir, "test_key.pem");
+  selene_conf_t *sconf = NULL;
+  selene_conf_t *tconf = NULL;
+  selene_conf_t *cconf = NULL;
+  selene_session_t *session = NULL;
+  double start;
+  double elapsed;
+  int i;
+
+  SLN_BENCH_ERR(selene_conf_create(&sconf));
+  SLN_BENCH_ERR(selene_conf_use_reasonable_defaults(sconf));
+  SLN_BENCH_ERR(selene_conf_cert_chain_add(sconf, cert, pkey));
+  SLN_BENCH_ERR(selene_conf_session_cache(sconf, 1024, 300));
+
+  SLN_BENCH_ERR(selene_conf_create(&tconf));
+  SLN_BENCH_ERR(selene_conf_use_reasonable_defaults(tconf));
+  SLN_BENCH_ERR(selene_conf_cert_chain_add(tconf, cert, pkey));
+  SLN_BENCH_ERR(selene_conf_session_tickets(tconf, 300));
+
+  SLN_BENCH_ERR(selene_conf_create(&cconf));
+  SLN_BENCH_ERR(selene_conf_use_reasonable_defaults(cconf));
+  SLN_BENCH_ERR(selene_conf_ca_trusted_cert_add(cconf, ca));
+
+  start = sln_bench_now();
+  for (i = 0; i < HANDSHAKE_COUNT; i++) {
+    handshake(sconf, cconf, NULL, NULL);
+  }
+  elapsed = sln_bench_now() - start;
+  sln_bench_report("handshake full", "handshakes/s",
+                   HANDSHAKE_COUNT / elapsed);
+
+  handshake(sconf, cconf, NULL, &session);
+
+  start = sln_bench_now();
+  for (i = 0; i < HANDSHAKE_COUNT; i++) {
+    handshake(sconf, cconf, session, NULL);
+  }
+  elapsed = sln_bench_now() - start;
+  sln_bench_report("handshake resumed", "handshakes/s",
+                   HANDSHAKE_COUNT / elapsed);
+
+  selene_session_destroy(session);
+  session = NULL;
+
+  handshake(tconf, cconf, NULL, &session);
+
+  start = sln_bench_now();
+  for (i = 0; i < HANDSHAKE_COUNT; i++) {
+    handshake(tconf, cconf, session, NULL);
+  }
+  elapsed = sln_bench_now() - start;
+  sln_bench_report("handshake resumed ticket", "handshakes/s",
+                   HANDSHAKE_COUNT / elapsed);
+
+  selene_session_destroy(session);
+  session = NULL;
+
+  /* the same, out of memory forked workers would share */
+  SLN_BENCH_ERR(selene_conf_session_cache_shared(sconf, 1024, 300, NULL));
+  handshake(sconf, cconf, NULL, &session);
+
+  start = sln_bench_now();
+  for (i = 0; i < HANDSHAKE_COUNT; i++) {
+    handshake(sconf, cconf, session, NULL);
+  }
+  elapsed = sln_bench_now() - start;
+  sln_bench_report("handshake resumed shared cache", "handshakes/s",
+                   HANDSHAKE_COUNT / elapsed);
+
+  selene_session_destroy(session);
+  selene_conf_destroy(sconf);
+  selene_conf_destroy(tconf);
+  selene_conf_destroy(cconf);
+  free(ca);
+  free(cert);
+  free(pkey);
+
+  return 0;
+}
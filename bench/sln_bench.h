@@ -0,0 +1,60 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_bench_h_
+#define _sln_bench_h_
+
+#include "selene.h"
+#include "sln_types.h"
+#include <stdio.h>
+
+/**
+ * Shared helpers for the micro benchmarks in this directory.  These programs
+ * poke at library internals the same way the unit tests do, and print one
+ * line per measurement.
+ */
+
+/* A selene_alloc_t on top of malloc(3) that counts calls into it */
+typedef struct sln_bench_alloc_t {
+  selene_alloc_t alloc;
+  size_t mallocs;
+  size_t frees;
+  size_t bytes;
+} sln_bench_alloc_t;
+
+void sln_bench_alloc_init(sln_bench_alloc_t *ba);
+
+void sln_bench_alloc_reset(sln_bench_alloc_t *ba);
+
+/* Monotonic wall clock, in seconds */
+double sln_bench_now(void);
+
+/* Prints a result line: name, value and unit */
+void sln_bench_report(const char *name, const char *metric, double value);
+
+#define SLN_BENCH_ERR(expression)                                    \
+  do {                                                               \
+    selene_error_t *sln__b__err = (expression);                      \
+    if (sln__b__err != SELENE_SUCCESS) {                             \
+      fprintf(stderr, "fatal error: (%d) %s from %s:%d\n",           \
+              sln__b__err->err, sln__b__err->msg, sln__b__err->file, \
+              sln__b__err->line);                                    \
+      exit(1);                                                       \
+    }                                                                \
+  } while (0)
+
+#endif
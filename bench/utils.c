@@ -0,0 +1,65 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_bench.h"
+#include <stdlib.h>
+#include <time.h>
+#include <sys/time.h>
+
+static void *bench_malloc(void *baton, size_t len) {
+  sln_bench_alloc_t *ba = (sln_bench_alloc_t *)baton;
+  ba->mallocs++;
+  ba->bytes += len;
+  return malloc(len);
+}
+
+static void *bench_calloc(void *baton, size_t len) {
+  sln_bench_alloc_t *ba = (sln_bench_alloc_t *)baton;
+  ba->mallocs++;
+  ba->bytes += len;
+  return calloc(1, len);
+}
+
+static void bench_free(void *baton, void *ptr) {
+  sln_bench_alloc_t *ba = (sln_bench_alloc_t *)baton;
+  ba->frees++;
+  free(ptr);
+}
+
+void sln_bench_alloc_init(sln_bench_alloc_t *ba) {
+  ba->alloc.baton = ba;
+  ba->alloc.malloc = bench_malloc;
+  ba->alloc.calloc = bench_calloc;
+  ba->alloc.free = bench_free;
+  sln_bench_alloc_reset(ba);
+}
+
+void sln_bench_alloc_reset(sln_bench_alloc_t *ba) {
+  ba->mallocs = 0;
+  ba->frees = 0;
+  ba->bytes = 0;
+}
+
+double sln_bench_now(void) {
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return (double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0);
+}
+
+void sln_bench_report(const char *name, const char *metric, double value) {
+  printf("%-40s %12.2f %s\n", name, value, metric);
+}
@@ -0,0 +1,55 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_aead_h_
+#define _sln_aead_h_
+
+/**
+ * Authenticated encryption with associated data, as used by the TLS 1.2
+ * AEAD record format.  A context is keyed once, and then seals or opens any
+ * number of messages, each under its own SLN_AEAD_NONCE_LENGTH byte nonce.
+ * Both work in place.
+ */
+
+/* Key length for type, in bytes */
+size_t sln_aead_key_length(sln_aead_e type);
+
+selene_error_t *sln_aead_openssl_create(selene_t *s, sln_aead_e type,
+                                        const char *key, sln_aead_t **p_aead);
+
+/* Encrypts len bytes of data in place, and writes the
+ * SLN_AEAD_TAG_LENGTH byte tag over aad and the ciphertext to tag */
+selene_error_t *sln_aead_openssl_seal(sln_aead_t *aead, const char *nonce,
+                                      const char *aad, size_t aadlen,
+                                      char *data, size_t len, char *tag);
+
+/* Decrypts len bytes of data in place.  Fails with SELENE_EINVAL if tag does
+ * not match, data is then garbage. */
+selene_error_t *sln_aead_openssl_open(sln_aead_t *aead, const char *nonce,
+                                      const char *aad, size_t aadlen,
+                                      char *data, size_t len,
+                                      const char *tag);
+
+void sln_aead_openssl_destroy(sln_aead_t *aead);
+
+/* CommonCrypto has no public AEAD interface, OpenSSL is used everywhere */
+#define sln_aead_create sln_aead_openssl_create
+#define sln_aead_seal sln_aead_openssl_seal
+#define sln_aead_open sln_aead_openssl_open
+#define sln_aead_destroy sln_aead_openssl_destroy
+
+#endif
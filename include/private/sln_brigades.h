@@ -35,10 +35,18 @@ void sln_brigade_destroy(sln_brigade_t *bb);
 void sln_brigade_clear(sln_brigade_t *bb);
 
 /* Length of the entire brigade */
-size_t sln_brigade_size(sln_brigade_t *bb);
+#define sln_brigade_size(bb) ((bb)->size)
 
 /* Number of buckets inside this brigade */
-int sln_brigade_bucket_count(sln_brigade_t *bb);
+#define sln_brigade_bucket_count(bb) ((bb)->count)
+
+/**
+ * Make sure the first length bytes of a brigade are in memory, reading file
+ * and mmap buckets up to that point with sln_bucket_read.  Everything that
+ * looks at bucket data works on memory buckets only, so this must be called
+ * first on brigades that may hold files.
+ */
+selene_error_t *sln_brigade_read(sln_brigade_t *bb, size_t length);
 
 /**
  * Flatten a section of a brigade into an existing buffer.
@@ -61,6 +69,21 @@ selene_error_t *sln_brigade_flatten(sln_brigade_t *bb, char *c, size_t *len);
  */
 selene_error_t *sln_brigade_chomp(sln_brigade_t *bb, size_t len);
 
+/**
+ * Make sure a bucket boundary falls at offset, splitting the bucket that
+ * spans it in two.  This is the only case where a bucket is created.
+ */
+selene_error_t *sln_brigade_split(sln_brigade_t *bb, size_t offset);
+
+/**
+ * Move the first length bytes of a brigade to the tail of another one.
+ *
+ * Unlike sln_brigade_copy_into, whole buckets change owner, so besides a
+ * split at the end of the range no bucket is created or referenced.
+ */
+selene_error_t *sln_brigade_splice_into(sln_brigade_t *source_bb,
+                                        size_t length, sln_brigade_t *into_bb);
+
 /**
  * Duplicate a section of a brigade, into the tail of another brigade.
  *
@@ -70,39 +93,75 @@ selene_error_t *sln_brigade_chomp(sln_brigade_t *bb, size_t len);
 selene_error_t *sln_brigade_copy_into(sln_brigade_t *source_bb, size_t offset,
                                       size_t point, sln_brigade_t *into_bb);
 
-#define SLN_BRIGADE_SENTINEL(b) \
-  SLN_RING_SENTINEL(&(b)->list, sln_bucket_t, link)
-#define SLN_BRIGADE_EMPTY(b) SLN_RING_EMPTY(&(b)->list, sln_bucket_t, link)
-#define SLN_BRIGADE_FIRST(b) SLN_RING_FIRST(&(b)->list)
-#define SLN_BRIGADE_LAST(b) SLN_RING_LAST(&(b)->list)
-
-#define SLN_BRIGADE_INSERT_TAIL(b, e)                             \
-  do {                                                            \
-    sln_bucket_t *sln__b = (e);                                   \
-    SLN_RING_INSERT_TAIL(&(b)->list, sln__b, sln_bucket_t, link); \
-    SLN_BRIGADE_CHECK_CONSISTENCY((b));                           \
-  } while (0)
+/**
+ * Cursors remember the bucket the last read started in, so that reading a
+ * brigade front to back only walks each bucket once, instead of walking
+ * from the head for every read.  Appending to the brigade keeps cursors
+ * valid, any other change makes the next read seek from the head again.
+ */
+void sln_brigade_cursor_init(sln_brigade_t *bb, sln_brigade_cursor_t *cur);
 
-#define SLN_BRIGADE_INSERT_HEAD(b, e)                             \
-  do {                                                            \
-    sln_bucket_t *sln__b = (e);                                   \
-    SLN_RING_INSERT_HEAD(&(b)->list, sln__b, sln_bucket_t, link); \
-    SLN_BRIGADE_CHECK_CONSISTENCY((b));                           \
-  } while (0)
+/* Same as sln_brigade_pread_bytes, starting the search at the cursor */
+selene_error_t *sln_brigade_cursor_pread_bytes(sln_brigade_cursor_t *cur,
+                                               size_t offset, size_t length,
+                                               char *buffer, size_t *len);
+
+/* Same as sln_brigade_copy_into, starting the search at the cursor */
+selene_error_t *sln_brigade_cursor_copy_into(sln_brigade_cursor_t *cur,
+                                             size_t offset, size_t length,
+                                             sln_brigade_t *into_bb);
+
+#define SLN_BRIGADE_EMPTY(b) ((b)->count == 0)
+
+/* Slot and bucket at index i, counting from the front of the brigade */
+#define SLN_BRIGADE_SLOT(b, i) \
+  (&(b)->slots[((b)->head + (i)) & ((b)->capacity - 1)])
+#define SLN_BRIGADE_BUCKET(b, i) (SLN_BRIGADE_SLOT((b), (i))->bucket)
 
-#define SLN_BRIGADE_CONCAT(a, b)                                 \
-  do {                                                           \
-    SLN_RING_CONCAT(&(a)->list, &(b)->list, sln_bucket_t, link); \
-    SLN_BRIGADE_CHECK_CONSISTENCY((a));                          \
+/* The brigade must not be empty */
+#define SLN_BRIGADE_FIRST(b) SLN_BRIGADE_BUCKET((b), 0)
+#define SLN_BRIGADE_LAST(b) SLN_BRIGADE_BUCKET((b), (b)->count - 1)
+
+/**
+ * Put bucket e at index i of the brigade, 0 being the front and
+ * sln_brigade_bucket_count the back.  Inserting at either end is O(1), in
+ * the middle the buckets after it are moved up.
+ */
+void sln_brigade_insert(sln_brigade_t *bb, int i, sln_bucket_t *e);
+
+/* Take bucket e out of its brigade */
+void sln_brigade_remove(sln_brigade_t *bb, sln_bucket_t *e);
+
+/* Index of bucket e in bb, searching from both ends */
+int sln_brigade_index(sln_brigade_t *bb, sln_bucket_t *e);
+
+/* Refresh the slot of bucket e at index i, after its data or size moved */
+#define SLN_BRIGADE_SLOT_UPDATE(b, i, e)                     \
+  do {                                                       \
+    sln_brigade_slot_t *sln__s = SLN_BRIGADE_SLOT((b), (i)); \
+    (b)->size += (e)->size;                                  \
+    (b)->size -= sln__s->size;                               \
+    sln__s->data = (e)->data;                                \
+    sln__s->size = (e)->size;                                \
   } while (0)
 
+#define SLN_BRIGADE_INSERT_TAIL(b, e) sln_brigade_insert((b), (b)->count, (e))
+
+#define SLN_BRIGADE_INSERT_HEAD(b, e) sln_brigade_insert((b), 0, (e))
+
+/* Moves all of b's buckets to the end of a */
+#define SLN_BRIGADE_CONCAT(a, b) sln_brigade_concat((a), (b))
+
+void sln_brigade_concat(sln_brigade_t *a, sln_brigade_t *b);
+
+#ifdef DEBUG
 #define SLN_BRIGADE_DEBUG
+#endif
 
 #ifdef SLN_BRIGADE_DEBUG
-#define SLN_BRIGADE_CHECK_CONSISTENCY(b)                        \
-  do {                                                          \
-    SLN_RING_CHECK_CONSISTENCY(&(b)->list, sln_bucket_t, link); \
-  } while (0)
+/* Walks every slot, so only in debug builds */
+void sln_brigade_check_consistency(sln_brigade_t *bb);
+#define SLN_BRIGADE_CHECK_CONSISTENCY(b) sln_brigade_check_consistency((b))
 #else
 #define SLN_BRIGADE_CHECK_CONSISTENCY(b)
 #endif
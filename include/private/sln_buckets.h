@@ -25,21 +25,79 @@
 selene_error_t *sln_bucket_create_empty(selene_alloc_t *alloc, sln_bucket_t **b,
                                         size_t size);
 
+/**
+ * Create an empty memory bucket of size bytes, with headroom spare bytes in
+ * front of it and tailroom behind it, all in one allocation.  The bucket can
+ * later be widened over them with sln_bucket_grow, so that a header or
+ * trailer is written next to the data instead of into buckets of their own.
+ */
+selene_error_t *sln_bucket_create_with_room(selene_alloc_t *alloc,
+                                            sln_bucket_t **b, size_t headroom,
+                                            size_t size, size_t tailroom);
+
+/* Spare bytes in front of and behind b that sln_bucket_grow may take.  Always
+ * 0 for memory that is borrowed, or shared with another bucket. */
+size_t sln_bucket_headroom(sln_bucket_t *b);
+
+size_t sln_bucket_tailroom(sln_bucket_t *b);
+
+/* Widen b by head bytes at the front and tail bytes at the end, within its
+ * headroom and tailroom.  b must not be in a brigade. */
+void sln_bucket_grow(sln_bucket_t *b, size_t head, size_t tail);
+
 /* Create a memory buffer, copying the bytes */
 selene_error_t *sln_bucket_create_copy_bytes(selene_alloc_t *alloc,
                                              sln_bucket_t **b,
                                              const char *bytes, size_t size);
 
-/* Create a memory buffer, taking ownership of the bytes (including calling
- * free()) */
+/* Create a memory buffer over existing bytes, without copying them.  The
+ * caller keeps ownership, and must keep them around until every bucket
+ * sliced from this one is destroyed. */
 selene_error_t *sln_bucket_create_with_bytes(selene_alloc_t *alloc,
                                              sln_bucket_t **b, char *bytes,
                                              size_t size);
 
+/**
+ * Append one bucket for each buffer of vec to bb, without copying.  They all
+ * share one backing, so cb is called once, when the last bucket referencing
+ * any of the buffers is destroyed.  If all the buffers are empty, cb is
+ * called right away.
+ */
+selene_error_t *sln_bucket_create_borrowed_iovec(selene_alloc_t *alloc,
+                                                 sln_brigade_t *bb,
+                                                 const struct iovec *vec,
+                                                 int iovcnt,
+                                                 selene_io_release_cb *cb,
+                                                 void *baton);
+
+/**
+ * Create a bucket for length bytes of fd starting at offset, of type
+ * SLN_BUCKET_FILE or SLN_BUCKET_MMAP.  Nothing is read until sln_bucket_read
+ * is called on it.  cb is called once no bucket references the file anymore,
+ * it is up to the caller to close fd.
+ */
+selene_error_t *sln_bucket_create_file(selene_alloc_t *alloc, sln_bucket_t **b,
+                                       sln_bucket_type_e type, int fd,
+                                       off_t offset, size_t length,
+                                       selene_io_release_cb *cb, void *baton);
+
+#define SLN_BUCKET_TYPE(b) ((b)->backing->type)
+
+/* How much of a file is read or mapped at once, a full TLS record */
+#define SLN_BUCKET_READ_SIZE 16384
+
+/**
+ * Bring the front of a file or mmap bucket into memory, as a memory bucket
+ * of up to SLN_BUCKET_READ_SIZE bytes inserted in front of it.  b shrinks by
+ * as much, and is destroyed once it is used up.  b must be in a brigade.
+ * Memory buckets are left alone.
+ */
+selene_error_t *sln_bucket_read(sln_bucket_t *b);
+
 /* Create a new bucket, which references a slice from an existing bucket.  This
- * increments
- * the reference count of the parent.  This method is not re-entrant safe across
- * single parent buckets.
+ * increments the reference count of the parent's backing memory, which is
+ * shared by all slices, so it costs the same however deep the slicing goes.
+ * This method is not re-entrant safe across buckets sharing a backing.
  */
 selene_error_t *sln_bucket_create_from_bucket(selene_alloc_t *alloc,
                                               sln_bucket_t **out_b,
@@ -51,6 +109,12 @@ selene_error_t *sln_bucket_create_from_bucket(selene_alloc_t *alloc,
  * memory. */
 void sln_bucket_destroy(sln_bucket_t *b);
 
-#define SLN_BUCKET_REMOVE(e) SLN_RING_REMOVE((e), link)
+#define SLN_BUCKET_REMOVE(e)                       \
+  do {                                             \
+    sln_bucket_t *sln__e = (e);                    \
+    if (sln__e->brigade != NULL) {                 \
+      sln_brigade_remove(sln__e->brigade, sln__e); \
+    }                                              \
+  } while (0)
 
 #endif
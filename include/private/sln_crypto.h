@@ -0,0 +1,55 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_crypto_h_
+#define _sln_crypto_h_
+
+#include "sln_types.h"
+#include <openssl/evp.h>
+
+/**
+ * The digest and cipher methods behind the crypto backends, looked up once
+ * per process from sln_initialize, rather than by name every time a context
+ * is created.  The lookups return NULL for methods the OpenSSL we run
+ * against does not have.
+ *
+ * With SLN_HAVE_OPENSSL3, they are fetched explicitly from the providers,
+ * and released again by sln_crypto_terminate.
+ */
+selene_error_t *sln_crypto_openssl_initialize(void);
+void sln_crypto_openssl_terminate(void);
+
+const EVP_MD *sln_crypto_openssl_digest(sln_digest_e type);
+const EVP_MD *sln_crypto_openssl_hmac(sln_hmac_e type);
+const EVP_CIPHER *sln_crypto_openssl_cipher(sln_cipher_e type);
+const EVP_CIPHER *sln_crypto_openssl_stitched(sln_cipher_e type);
+const EVP_CIPHER *sln_crypto_openssl_aead(sln_aead_e type);
+
+#ifdef SLN_HAVE_OPENSSL3
+/* An unkeyed HMAC context with its digest set, to be copied, or NULL */
+const EVP_MAC_CTX *sln_crypto_openssl_hmac_template(sln_hmac_e type);
+#endif
+
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_new EVP_MD_CTX_create
+#define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#endif
+
+#define sln_crypto_initialize sln_crypto_openssl_initialize
+#define sln_crypto_terminate sln_crypto_openssl_terminate
+
+#endif
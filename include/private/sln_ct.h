@@ -0,0 +1,44 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_ct_h_
+#define _sln_ct_h_
+
+#include <stddef.h>
+
+/**
+ * Comparisons of secret size_t values without branches, for code whose
+ * timing must not depend on them.  Each yields a mask, all ones for true and
+ * 0 for false, to select values with instead of an if.  The arguments are
+ * evaluated more than once.
+ */
+
+/* All ones if the top bit of a is set */
+#define SLN_CT_MSB(a) ((size_t)0 - ((size_t)(a) >> (sizeof(size_t) * 8 - 1)))
+
+#define SLN_CT_LT(a, b)                                               \
+  SLN_CT_MSB((size_t)(a) ^                                            \
+             (((size_t)(a) ^ (size_t)(b)) |                           \
+              (((size_t)(a) - (size_t)(b)) ^ (size_t)(b))))
+
+#define SLN_CT_GE(a, b) (~SLN_CT_LT((a), (b)))
+
+#define SLN_CT_EQ(a, b)                           \
+  SLN_CT_MSB(~((size_t)(a) ^ (size_t)(b)) &       \
+             (((size_t)(a) ^ (size_t)(b)) - 1))
+
+#endif
@@ -24,6 +24,8 @@ selene_error_t *sln_digest_osx_cc_create(selene_t *s, sln_digest_e type,
 void sln_digest_osx_cc_update(sln_digest_t *digest, const void *data,
                               size_t len);
 void sln_digest_osx_cc_final(sln_digest_t *digest, unsigned char *md);
+selene_error_t *sln_digest_osx_cc_copy(sln_digest_t *digest,
+                                       sln_digest_t **p_copy);
 void sln_digest_osx_cc_destroy(sln_digest_t *d);
 #endif
 
@@ -32,21 +34,61 @@ selene_error_t *sln_digest_openssl_create(selene_t *s, sln_digest_e type,
 void sln_digest_openssl_update(sln_digest_t *digest, const void *data,
                                size_t len);
 void sln_digest_openssl_final(sln_digest_t *digest, unsigned char *md);
+/* A new digest in the same state as digest, to finish a hash of the data so
+ * far while digest goes on */
+selene_error_t *sln_digest_openssl_copy(sln_digest_t *digest,
+                                        sln_digest_t **p_copy);
 void sln_digest_openssl_destroy(sln_digest_t *d);
 
+/* Plain C, with SHA-NI and AVX2 kernels where the CPU has them */
+void sln_digest_builtin_initialize(void);
+selene_error_t *sln_digest_builtin_create(selene_t *s, sln_digest_e type,
+                                          sln_digest_t **p_digest);
+void sln_digest_builtin_update(sln_digest_t *digest, const void *data,
+                               size_t len);
+void sln_digest_builtin_final(sln_digest_t *digest, unsigned char *md);
+selene_error_t *sln_digest_builtin_copy(sln_digest_t *digest,
+                                        sln_digest_t **p_copy);
+void sln_digest_builtin_destroy(sln_digest_t *d);
+
+/**
+ * Feeds data[i] to digests[i], for count digests of the same type.  With the
+ * built-in backend, up to 8 of them are hashed at once by the multi-buffer
+ * kernels, which suits an event loop finishing several handshakes per
+ * wakeup; other backends just update them one at a time.
+ */
+void sln_digest_builtin_update_many(sln_digest_t **digests,
+                                    const void *const *data,
+                                    const size_t *len, size_t count);
+
 /* TODO: windows */
-#ifdef SLN_HAVE_OSX_COMMONCRYPTO
+#if defined(SLN_HAVE_BUILTIN_DIGEST)
+/* Built-in hash functions, asked for at build time */
+#define sln_digest_create sln_digest_builtin_create
+#define sln_digest_update sln_digest_builtin_update
+#define sln_digest_update_many sln_digest_builtin_update_many
+#define sln_digest_final sln_digest_builtin_final
+#define sln_digest_copy sln_digest_builtin_copy
+#define sln_digest_destroy sln_digest_builtin_destroy
+#elif defined(SLN_HAVE_OSX_COMMONCRYPTO)
 /* Use OSX native methods if available */
 #define sln_digest_create sln_digest_osx_cc_create
 #define sln_digest_update sln_digest_osx_cc_update
 #define sln_digest_final sln_digest_osx_cc_final
+#define sln_digest_copy sln_digest_osx_cc_copy
 #define sln_digest_destroy sln_digest_osx_cc_destroy
 #else
 /* OpenSSL Fallbacks */
 #define sln_digest_create sln_digest_openssl_create
 #define sln_digest_update sln_digest_openssl_update
 #define sln_digest_final sln_digest_openssl_final
+#define sln_digest_copy sln_digest_openssl_copy
 #define sln_digest_destroy sln_digest_openssl_destroy
 #endif
 
+#ifndef sln_digest_update_many
+void sln_digest_update_many(sln_digest_t **digests, const void *const *data,
+                            const size_t *len, size_t count);
+#endif
+
 #endif
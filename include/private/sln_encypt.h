@@ -27,6 +27,7 @@ selene_error_t *sln_cryptor_osx_cc_create(selene_t *s, int encrypt,
                                           sln_cryptor_t **p_enc);
 void sln_cryptor_osx_cc_encrypt(sln_cryptor_t *enc, const void *data,
                                 size_t len, char *buf, size_t *blen);
+void sln_cryptor_osx_cc_set_iv(sln_cryptor_t *enc, const char *iv);
 void sln_cryptor_osx_cc_destroy(sln_cryptor_t *enc);
 #endif
 
@@ -36,6 +37,8 @@ selene_error_t *sln_cryptor_openssl_create(selene_t *s, int encrypt,
                                            sln_cryptor_t **p_enc);
 void sln_cryptor_openssl_encrypt(sln_cryptor_t *enc, const void *data,
                                  size_t len, char *buf, size_t *blen);
+/* Restarts the CBC chain of a block cipher from iv, keeping the key */
+void sln_cryptor_openssl_set_iv(sln_cryptor_t *enc, const char *iv);
 void sln_cryptor_openssl_destroy(sln_cryptor_t *enc);
 
 /* TODO: windows */
@@ -43,11 +46,13 @@ void sln_cryptor_openssl_destroy(sln_cryptor_t *enc);
 /* Use OSX native methods if available */
 #define sln_cryptor_create sln_cryptor_osx_cc_create
 #define sln_cryptor_encrypt sln_cryptor_osx_cc_encrypt
+#define sln_cryptor_set_iv sln_cryptor_osx_cc_set_iv
 #define sln_cryptor_destroy sln_cryptor_osx_cc_destroy
 #else
 /* OpenSSL Fallbacks */
 #define sln_cryptor_create sln_cryptor_openssl_create
 #define sln_cryptor_encrypt sln_cryptor_openssl_encrypt
+#define sln_cryptor_set_iv sln_cryptor_openssl_set_iv
 #define sln_cryptor_destroy sln_cryptor_openssl_destroy
 #endif
 
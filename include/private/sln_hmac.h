@@ -24,6 +24,7 @@ selene_error_t *sln_hmac_osx_cc_create(selene_t *s, sln_hmac_e type,
                                        sln_hmac_t **p_hmac);
 void sln_hmac_osx_cc_update(sln_hmac_t *digest, const void *data, size_t len);
 void sln_hmac_osx_cc_final(sln_hmac_t *digest, unsigned char *md);
+void sln_hmac_osx_cc_reset(sln_hmac_t *digest);
 void sln_hmac_osx_cc_destroy(sln_hmac_t *d);
 #endif
 
@@ -32,20 +33,62 @@ selene_error_t *sln_hmac_openssl_create(selene_t *s, sln_hmac_e type,
                                         sln_hmac_t **p_hmac);
 void sln_hmac_openssl_update(sln_hmac_t *digest, const void *data, size_t len);
 void sln_hmac_openssl_final(sln_hmac_t *digest, unsigned char *md);
+void sln_hmac_openssl_reset(sln_hmac_t *digest);
 void sln_hmac_openssl_destroy(sln_hmac_t *d);
 
+#ifdef SLN_HAVE_OPENSSL3
+selene_error_t *sln_hmac_openssl3_create(selene_t *s, sln_hmac_e type,
+                                         const char *key, size_t klen,
+                                         sln_hmac_t **p_hmac);
+void sln_hmac_openssl3_update(sln_hmac_t *digest, const void *data,
+                              size_t len);
+void sln_hmac_openssl3_final(sln_hmac_t *digest, unsigned char *md);
+void sln_hmac_openssl3_reset(sln_hmac_t *digest);
+void sln_hmac_openssl3_destroy(sln_hmac_t *d);
+#endif
+
+selene_error_t *sln_hmac_builtin_create(selene_t *s, sln_hmac_e type,
+                                        const char *key, size_t klen,
+                                        sln_hmac_t **p_hmac);
+void sln_hmac_builtin_update(sln_hmac_t *digest, const void *data, size_t len);
+void sln_hmac_builtin_final(sln_hmac_t *digest, unsigned char *md);
+/* Updates with the first len of the maxlen bytes at data and finishes, in
+ * constant time whatever len is, see sln_md_final_ct.  The receiving side
+ * of CBC suites checks MACs with this, on the built-in backend whichever
+ * one is in use otherwise. */
+void sln_hmac_builtin_final_ct(sln_hmac_t *digest, const void *data,
+                               size_t len, size_t maxlen, unsigned char *md);
+void sln_hmac_builtin_reset(sln_hmac_t *digest);
+void sln_hmac_builtin_destroy(sln_hmac_t *d);
+
 /* TODO: windows */
-#ifdef SLN_HAVE_OSX_COMMONCRYPTO
+#if defined(SLN_HAVE_BUILTIN_DIGEST)
+/* Built-in hash functions, with the keyed pads kept for resets */
+#define sln_hmac_create sln_hmac_builtin_create
+#define sln_hmac_update sln_hmac_builtin_update
+#define sln_hmac_final sln_hmac_builtin_final
+#define sln_hmac_reset sln_hmac_builtin_reset
+#define sln_hmac_destroy sln_hmac_builtin_destroy
+#elif defined(SLN_HAVE_OSX_COMMONCRYPTO)
 /* Use OSX native methods if available */
 #define sln_hmac_create sln_hmac_osx_cc_create
 #define sln_hmac_update sln_hmac_osx_cc_update
 #define sln_hmac_final sln_hmac_osx_cc_final
+#define sln_hmac_reset sln_hmac_osx_cc_reset
 #define sln_hmac_destroy sln_hmac_osx_cc_destroy
+#elif defined(SLN_HAVE_OPENSSL3)
+/* EVP_MAC, copied from a pre-fetched template */
+#define sln_hmac_create sln_hmac_openssl3_create
+#define sln_hmac_update sln_hmac_openssl3_update
+#define sln_hmac_final sln_hmac_openssl3_final
+#define sln_hmac_reset sln_hmac_openssl3_reset
+#define sln_hmac_destroy sln_hmac_openssl3_destroy
 #else
 /* OpenSSL Fallbacks */
 #define sln_hmac_create sln_hmac_openssl_create
 #define sln_hmac_update sln_hmac_openssl_update
 #define sln_hmac_final sln_hmac_openssl_final
+#define sln_hmac_reset sln_hmac_openssl_reset
 #define sln_hmac_destroy sln_hmac_openssl_destroy
 #endif
 
@@ -0,0 +1,50 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_pool_h_
+#define _sln_pool_h_
+
+#include "selene.h"
+#include "sln_types.h"
+
+/**
+ * A size-class slab allocator, sitting in front of a parent selene_alloc_t.
+ *
+ * Requests that fit one of the size classes are served from a free list, and
+ * returned to it on free, so that the steady state of the record layer (TLS
+ * headers, bucket headers, handshake messages, full records) never touches
+ * the parent allocator.  Anything larger is passed through.
+ *
+ * A pool is not thread safe; each selene_t owns its own.
+ */
+selene_error_t *sln_pool_create(selene_alloc_t *parent, sln_pool_t **pool);
+
+/* Returns every cached chunk to the parent allocator, and frees the pool.
+ * All memory handed out by the pool must have been freed first. */
+void sln_pool_destroy(sln_pool_t *pool);
+
+/* The selene_alloc_t to hand to buckets and brigades */
+#define sln_pool_alloc(pool) (&(pool)->alloc)
+
+/* Size class for a request of len bytes, or -1 if it is passed through */
+int sln_pool_size_class(size_t len);
+
+/* Bytes actually available to a request of len bytes: the size of its class,
+ * or len itself if it is passed through */
+size_t sln_pool_usable_size(size_t len);
+
+#endif
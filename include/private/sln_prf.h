@@ -19,8 +19,16 @@
 #define _sln_prf_h_
 
 /* TODO: think about interface more */
+/* The TLS 1.0 and 1.1 PRF, P_MD5 XOR P_SHA1 over the two halves of secret */
 selene_error_t *sln_prf(selene_t *s, const char *label, size_t labellen,
                         const char *secret, size_t secretlen, const char *seed,
                         size_t seedlen, char *output, size_t outlen);
 
+/* The TLS 1.2 PRF, a single P_hash with the HMAC the cipher suite names,
+ * SLN_HMAC_SHA256 unless it says otherwise */
+selene_error_t *sln_prf_tls12(selene_t *s, sln_hmac_e type, const char *label,
+                              size_t labellen, const char *secret,
+                              size_t secretlen, const char *seed,
+                              size_t seedlen, char *output, size_t outlen);
+
 #endif
@@ -29,6 +29,14 @@ selene_error_t *sln_rsa_openssl_public_encrypt(selene_t *s, sln_pubkey_t *key,
                                                const char *input,
                                                size_t inputlen, char *output);
 size_t sln_rsa_openssl_size(sln_pubkey_t *key);
+/* PKCS #1 v1.5 decryption into output, of sln_rsa_openssl_private_size()
+ * bytes, sets outputlen to the length of the plaintext */
+selene_error_t *sln_rsa_openssl_private_decrypt(selene_t *s,
+                                                sln_privkey_t *key,
+                                                const char *input,
+                                                size_t inputlen, char *output,
+                                                size_t *outputlen);
+size_t sln_rsa_openssl_private_size(sln_privkey_t *key);
 
 #if defined(SLN_HAVE_OSX_COMMONCRYPTO) && defined(__never__)
 #define sln_rsa_public_encrypt sln_rsa_osx_cc_public_encrypt
@@ -38,4 +46,7 @@ size_t sln_rsa_openssl_size(sln_pubkey_t *key);
 #define sln_rsa_size sln_rsa_openssl_size
 #endif
 
+#define sln_rsa_private_decrypt sln_rsa_openssl_private_decrypt
+#define sln_rsa_private_size sln_rsa_openssl_private_size
+
 #endif
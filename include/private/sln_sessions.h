@@ -0,0 +1,131 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_sessions_h_
+#define _sln_sessions_h_
+
+#include "selene.h"
+#include "sln_types.h"
+
+/**
+ * Sessions kept for resumption, by a key of up to SLN_SESSION_KEY_MAX_LENGTH
+ * bytes: their ID on servers, and the server they were set up with on
+ * clients.  A fixed number of slots is allocated up front.  Once they are all
+ * taken, a CLOCK hand picks the slot to reuse: expired sessions go first,
+ * then the first one that was not looked up since the hand last passed it.
+ * In the cache sln_session_cache_create makes every call takes the cache's
+ * lock, so one cache serves any number of threads.
+ */
+#define SLN_SESSION_KEY_MAX_LENGTH SLN_SESSION_ID_MAX_LENGTH
+
+/**
+ * Where a cache keeps its sessions.  Every call gets the store's baton, keys
+ * are never longer than SLN_SESSION_KEY_MAX_LENGTH, and sessions go in and
+ * come out by value.
+ */
+typedef struct sln_session_store_t {
+  const char *name;
+  void (*destroy)(void *baton);
+  void (*put)(void *baton, const char *key, size_t keylen,
+              const selene_session_t *session);
+  int (*get)(void *baton, const char *key, size_t keylen, int64_t now,
+             selene_session_t *session);
+  void (*remove)(void *baton, const char *key, size_t keylen);
+  void (*stats)(void *baton, size_t *hits, size_t *misses, size_t *evictions);
+} sln_session_store_t;
+
+struct sln_session_cache_t {
+  selene_alloc_t *alloc;
+  const sln_session_store_t *store;
+  void *baton;
+};
+
+/* Spreads keys over buckets and shards, FNV-1a */
+uint32_t sln_session_key_hash(const char *key, size_t keylen);
+
+/* A cache on top of store, which owns baton from here on */
+selene_error_t *sln_session_cache_create_store(
+    selene_alloc_t *alloc, const sln_session_store_t *store, void *baton,
+    sln_session_cache_t **cache);
+
+selene_error_t *sln_session_cache_create(selene_alloc_t *alloc,
+                                         int max_sessions, int timeout,
+                                         sln_session_cache_t **cache);
+
+/**
+ * A cache in memory shared between processes: the file at path, mapped, or
+ * with path NULL an anonymous mapping that processes forked after this call
+ * share.  Slots are spread over shards with a lock each, lookups take no
+ * lock.  A file laid out for another number of sessions, or by another
+ * version, is refused.  The chains of sessions are not kept.
+ */
+selene_error_t *sln_session_cache_create_shared(selene_alloc_t *alloc,
+                                                int max_sessions, int timeout,
+                                                const char *path,
+                                                sln_session_cache_t **cache);
+
+/* Wipes the secrets of every cached session */
+void sln_session_cache_destroy(sln_session_cache_t *cache);
+
+/* Copies session in under key, replacing whatever was there.  Its created
+ * time starts its timeout. */
+void sln_session_cache_put(sln_session_cache_t *cache, const char *key,
+                           size_t keylen, const selene_session_t *session);
+
+/* Copies the session under key to session and returns 1 if it is cached and
+ * has not timed out at now, returns 0 otherwise */
+int sln_session_cache_get(sln_session_cache_t *cache, const char *key,
+                          size_t keylen, int64_t now,
+                          selene_session_t *session);
+
+void sln_session_cache_remove(sln_session_cache_t *cache, const char *key,
+                              size_t keylen);
+
+void sln_session_cache_stats(sln_session_cache_t *cache, size_t *hits,
+                             size_t *misses, size_t *evictions);
+
+/**
+ * What it takes to resume a session, in a fixed layout for keeping it out of
+ * process: the protocol version, suite, creation time and master secret.
+ */
+#define SLN_SESSION_STATE_LENGTH (2 + 2 + 8 + SLN_SESSION_SECRET_LENGTH)
+
+/* Leads selene_session_export output, followed by the ID length, the ID
+ * padded to SLN_SESSION_ID_MAX_LENGTH and the state */
+#define SLN_SESSION_EXPORT_VERSION (1)
+
+void sln_session_state_write(const selene_session_t *session,
+                             unsigned char *out);
+
+void sln_session_state_read(const unsigned char *in, selene_session_t *session);
+
+/**
+ * Client session cache, see selene_conf_client_session_cache.  Sessions are
+ * kept under a hash of the server name and tag of the client.
+ */
+
+/* Offers the session cached for the server s connects to, unless the
+ * application offered one itself */
+selene_error_t *sln_client_session_lookup(selene_t *s);
+
+/* Caches the session s just established */
+selene_error_t *sln_client_session_store(selene_t *s);
+
+/* Drops the session cached for the server s connects to, after s failed */
+void sln_client_session_forget(selene_t *s);
+
+#endif
@@ -0,0 +1,66 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_stitched_h_
+#define _sln_stitched_h_
+
+/**
+ * AES-CBC and HMAC-SHA1 of a TLS record computed in one pass over it, as
+ * OpenSSL does with AES-NI.  The context takes the whole record framing
+ * over: it appends the MAC and the padding on the way out, and checks and
+ * keeps them on the way in.  aad is the 13 bytes of seq_num and record
+ * header the MAC starts with; its version decides whether the record starts
+ * with an explicit IV block (TLS 1.1+), or chains on from the previous one.
+ */
+
+/* Largest number of bytes sln_stitched_seal appends to a record */
+#define SLN_STITCHED_MAX_OVERHEAD (20 + 16)
+
+/* Fails with SELENE_ENOTIMPL where no stitched implementation exists, like
+ * on CPUs without AES-NI, use sln_hmac_t and sln_cryptor_t then */
+selene_error_t *sln_stitched_openssl_create(selene_t *s, int encrypt,
+                                            sln_cipher_e type, const char *key,
+                                            const char *iv,
+                                            const char *mac_secret,
+                                            sln_stitched_t **p_st);
+
+/* data holds len bytes of record, with the length in aad, and room for
+ * SLN_STITCHED_MAX_OVERHEAD more bytes.  Appends the MAC and the padding,
+ * and encrypts all of it in place; *outlen is set to the new length. */
+selene_error_t *sln_stitched_openssl_seal(sln_stitched_t *st, const char *aad,
+                                          char *data, size_t len,
+                                          size_t *outlen);
+
+/* Decrypts the len byte record in data in place, and checks its padding and
+ * MAC.  Fails with SELENE_EINVAL if either is bad.  data is left holding
+ * the plaintext followed by the MAC and the padding. */
+selene_error_t *sln_stitched_openssl_open(sln_stitched_t *st, const char *aad,
+                                          char *data, size_t len);
+
+/* Restarts the CBC chain from iv, for TLS 1.0 records that were decrypted
+ * somewhere else in the meantime */
+void sln_stitched_openssl_set_iv(sln_stitched_t *st, const char *iv);
+
+void sln_stitched_openssl_destroy(sln_stitched_t *st);
+
+#define sln_stitched_create sln_stitched_openssl_create
+#define sln_stitched_seal sln_stitched_openssl_seal
+#define sln_stitched_open sln_stitched_openssl_open
+#define sln_stitched_set_iv sln_stitched_openssl_set_iv
+#define sln_stitched_destroy sln_stitched_openssl_destroy
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_tickets_h_
+#define _sln_tickets_h_
+
+#include "selene.h"
+#include "selene_conf.h"
+#include "sln_types.h"
+#include "sln_sessions.h"
+
+/**
+ * RFC 5077 session tickets.  The server seals the state of a session under a
+ * key of its own and hands it to the client, which brings it back in a later
+ * ClientHello.  Our tickets are
+ *
+ *   key_name[16] nonce[12] state[60] tag[16]
+ *
+ * with state sealed by AES-256-GCM under the key named, and the name as
+ * additional data.  state is the protocol version, suite, creation time and
+ * master secret of the session.
+ */
+
+#define SLN_TICKET_KEY_NAME_LENGTH (16)
+#define SLN_TICKET_KEY_LENGTH (32)
+#define SLN_TICKET_STATE_LENGTH SLN_SESSION_STATE_LENGTH
+#define SLN_TICKET_LENGTH                                  \
+  (SLN_TICKET_KEY_NAME_LENGTH + SLN_AEAD_NONCE_LENGTH + \
+   SLN_TICKET_STATE_LENGTH + SLN_AEAD_TAG_LENGTH)
+
+typedef struct sln_ticket_key_t {
+  char name[SLN_TICKET_KEY_NAME_LENGTH];
+  char key[SLN_TICKET_KEY_LENGTH];
+} sln_ticket_key_t;
+
+/* One generation of keys, never changed once published in the conf.  The
+ * generations it replaced stay around while readers may still use them, and
+ * are wiped and freed by the first rotation that finds no readers left. */
+struct sln_ticket_keys_t {
+  sln_ticket_key_t current;
+  sln_ticket_key_t previous;
+  int have_previous;
+  sln_ticket_keys_t *older;
+};
+
+/* Publishes a new generation with key, SELENE_SESSION_TICKET_KEY_LENGTH
+ * bytes, or a random one, as current, and the current key as previous */
+selene_error_t *sln_ticket_keys_rotate(selene_conf_t *conf, const char *key);
+
+/* Frees every generation, nothing may use conf any more */
+void sln_ticket_keys_destroy(selene_conf_t *conf);
+
+/* Seals session into ticket, SLN_TICKET_LENGTH bytes, with the current key */
+selene_error_t *sln_ticket_seal(selene_t *s, const selene_session_t *session,
+                                char *ticket);
+
+/**
+ * Opens a ticket the client offered into session.  Sets valid to 0, and
+ * fails no further, for tickets that are not ours, do not authenticate or
+ * are more than the ticket lifetime old at now.  Sets renew if it was sealed
+ * with the previous key.
+ */
+selene_error_t *sln_ticket_open(selene_t *s, const char *ticket, size_t len,
+                                int64_t now, selene_session_t *session,
+                                int *valid, int *renew);
+
+#endif
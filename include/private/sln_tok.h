@@ -50,6 +50,37 @@ typedef struct sln_tok_value_t {
 
 typedef selene_error_t *(sln_tok_cb)(sln_tok_value_t *v, void *baton);
 
+/**
+ * Tokenizer state that survives between calls, so that a message arriving
+ * in several pieces is only walked once.  When the brigade does not hold
+ * enough data for the token asked for, sln_tok_parser_resume returns
+ * without calling back, and the next call picks up at the same token and
+ * offset.
+ */
+typedef struct sln_tok_parser_t {
+  sln_tok_value_t value;
+  /* Offset in the brigade of the first byte after the last token */
+  size_t offset;
+  /* Number of times the callback was invoked */
+  size_t steps;
+  sln_brigade_cursor_t cursor;
+  sln_brigade_t *tmpbb;
+} sln_tok_parser_t;
+
+void sln_tok_parser_init(sln_tok_parser_t *tok);
+
+/* Resets the tokenizer to the start of a new message, keeping its buffers */
+void sln_tok_parser_reset(sln_tok_parser_t *tok);
+
+void sln_tok_parser_destroy(sln_tok_parser_t *tok);
+
+/* Has the callback asked for TOK_DONE */
+#define sln_tok_parser_done(tok) ((tok)->value.next == TOK_DONE)
+
+selene_error_t *sln_tok_parser_resume(sln_tok_parser_t *tok, sln_brigade_t *bb,
+                                      sln_tok_cb cb, void *baton);
+
+/* Runs a one shot tokenizer from the start of the brigade */
 selene_error_t *sln_tok_parser(sln_brigade_t *bb, sln_tok_cb cb, void *baton);
 
 #endif
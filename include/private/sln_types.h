@@ -47,28 +47,126 @@ typedef enum {
   SLN_BACKEND__MAX = 2
 } sln_backend_e;
 
+typedef enum {
+  SLN_BUCKET__UNUSED0 = 0,
+  /* data points at the bytes */
+  SLN_BUCKET_MEMORY = 1,
+  /* Bytes still in a file, read into memory on demand with pread() */
+  SLN_BUCKET_FILE = 2,
+  /* Bytes still in a file, mapped on demand with mmap() */
+  SLN_BUCKET_MMAP = 3,
+  SLN_BUCKET__MAX = 4
+} sln_bucket_type_e;
+
+typedef struct sln_backing_t sln_backing_t;
 typedef struct sln_bucket_t sln_bucket_t;
 typedef struct sln_brigade_t sln_brigade_t;
+typedef struct sln_pool_t sln_pool_t;
+typedef struct sln_pool_chunk_t sln_pool_chunk_t;
+/* Server side session cache, see sln_sessions.h */
+typedef struct sln_session_cache_t sln_session_cache_t;
 
-/* A chunk of memory */
-struct sln_bucket_t {
-  SLN_RING_ENTRY(sln_bucket_t) link;
+/* Session ticket keys, see sln_tickets.h */
+typedef struct sln_ticket_keys_t sln_ticket_keys_t;
+/* Thread pool, see sln_workers.h */
+typedef struct sln_workers_t sln_workers_t;
+
+/* Number of size classes kept by a sln_pool_t */
+#define SLN_POOL_CLASSES 5
+
+/* Free list of one sln_pool_t size class */
+typedef struct {
+  size_t size;
+  /* Upper bound on cached chunks, the rest go back to the parent */
+  size_t max_free;
+  size_t nfree;
+  sln_pool_chunk_t *free;
+} sln_pool_class_t;
+
+/* Slab allocator in front of a parent allocator, see sln_pool.h */
+struct sln_pool_t {
+  /* Allocator handed out to users of the pool, its baton is the pool */
+  selene_alloc_t alloc;
+  selene_alloc_t *parent;
+  sln_pool_class_t classes[SLN_POOL_CLASSES];
+  /* Requests served from a free list */
+  size_t hits;
+  /* Requests that went through to the parent allocator */
+  size_t misses;
+};
+
+/* Memory shared by every bucket sliced out of it */
+struct sln_backing_t {
   selene_alloc_t *alloc;
-  /* When destroying this bucket, can we also destroy memory */
-  int memory_is_mine;
+  /* Number of buckets referencing this memory */
   int refcount;
   size_t size;
-  /* TODO: non-memory buckets */
+  /* Either follows this structure in the same allocation, or is memory
+   * owned by someone else, NULL if that is spread over several buffers */
+  char *data;
+  /* Tells the owner of borrowed memory that it is no longer referenced */
+  selene_io_release_cb *release;
+  void *release_baton;
+  /* Every bucket sharing a backing is of the same type, kept here to keep
+   * bucket headers in the pool's 64 byte class */
+  sln_bucket_type_e type;
+  /* File the bytes of file and mmap buckets are in */
+  int fd;
+};
+
+/* A chunk of memory, a view into a backing store */
+struct sln_bucket_t {
+  selene_alloc_t *alloc;
+  size_t size;
+  /* NULL for file and mmap buckets, until read with sln_bucket_read */
   char *data;
-  sln_bucket_t *parent;
+  /* Where the bytes of file and mmap buckets start in the file */
+  off_t offset;
+  sln_backing_t *backing;
+  /* Brigade this bucket is linked into, if any */
+  sln_brigade_t *brigade;
 };
 
-/* A list of chunks (aka, a bucket brigade) */
+/* Where a brigade keeps a bucket.  Data and size are copies of the
+ * bucket's, so that walking a brigade stays inside its slot array. */
+typedef struct {
+  sln_bucket_t *bucket;
+  char *data;
+  size_t size;
+} sln_brigade_slot_t;
+
+/* Slots that fit in the brigade itself, enough for most brigades */
+#define SLN_BRIGADE_INLINE_SLOTS 4
+
+/* A list of chunks (aka, a bucket brigade), kept in a circular array */
 struct sln_brigade_t {
-  SLN_RING_HEAD(sln_bucket_list, sln_bucket_t) list;
   selene_alloc_t *alloc;
+  /* Either inline_slots, or allocated once there are more buckets */
+  sln_brigade_slot_t *slots;
+  /* Always a power of two */
+  int capacity;
+  /* Slot of the first bucket */
+  int head;
+  /* Number of buckets */
+  int count;
+  /* Cached total length */
+  size_t size;
+  /* Bumped whenever offsets of existing buckets may have changed, which
+   * invalidates any sln_brigade_cursor_t */
+  size_t generation;
+  sln_brigade_slot_t inline_slots[SLN_BRIGADE_INLINE_SLOTS];
 };
 
+/* A position inside a brigade, for sequential reads */
+typedef struct sln_brigade_cursor_t {
+  sln_brigade_t *bb;
+  /* Index of the bucket the cursor is in, -1 if not positioned yet */
+  int index;
+  /* Offset in the brigade of the first byte of that bucket */
+  size_t bucket_offset;
+  size_t generation;
+} sln_brigade_cursor_t;
+
 typedef struct sln_eventcb_t sln_eventcb_t;
 typedef struct sln_events_t sln_events_t;
 
@@ -105,14 +203,18 @@ typedef enum {
 
 #define SLN_MD5_DIGEST_LENGTH (16)
 #define SLN_SHA1_DIGEST_LENGTH (20)
+#define SLN_SHA256_DIGEST_LENGTH (32)
+#define SLN_SHA384_DIGEST_LENGTH (48)
 
 /* TODO: better naming, more thought, this is kinda lame */
-#define SLN_BIG_DIGEST_LENGTH SLN_SHA1_DIGEST_LENGTH
+#define SLN_BIG_DIGEST_LENGTH SLN_SHA384_DIGEST_LENGTH
 
 typedef enum {
   /* TODO: more digest algos */
   SLN_DIGEST_MD5,
-  SLN_DIGEST_SHA1
+  SLN_DIGEST_SHA1,
+  SLN_DIGEST_SHA256,
+  SLN_DIGEST_SHA384
 } sln_digest_e;
 
 typedef struct {
@@ -124,7 +226,10 @@ typedef struct {
 typedef enum {
   /* TODO: more digest algos */
   SLN_HMAC_MD5,
-  SLN_HMAC_SHA1
+  SLN_HMAC_SHA1,
+  /* for the TLS 1.2 PRF */
+  SLN_HMAC_SHA256,
+  SLN_HMAC_SHA384
 } sln_hmac_e;
 
 typedef struct {
@@ -147,6 +252,28 @@ typedef struct {
   void *baton;
 } sln_cryptor_t;
 
+/* One pass CBC encryption and HMAC-SHA1 of a whole TLS record */
+typedef struct {
+  selene_t *s;
+  sln_cipher_e type;
+  void *baton;
+} sln_stitched_t;
+
+typedef enum {
+  SLN_AEAD_AES_128_GCM,
+  SLN_AEAD_AES_256_GCM,
+  SLN_AEAD_CHACHA20_POLY1305
+} sln_aead_e;
+
+#define SLN_AEAD_NONCE_LENGTH (12)
+#define SLN_AEAD_TAG_LENGTH (16)
+
+typedef struct {
+  selene_t *s;
+  sln_aead_e type;
+  void *baton;
+} sln_aead_t;
+
 /* Repersents our parsed version of the TLS record,
  * not really what we send out on the wire */
 typedef struct {
@@ -191,6 +318,18 @@ struct selene_conf_t {
   selene_cipher_suite_list_t ciphers;
   sln_array_header_t *certs;
   X509_STORE *trusted_cert_store;
+  /* NULL unless records are decrypted in parallel */
+  sln_workers_t *workers;
+  /* NULL unless servers keep sessions for resumption */
+  sln_session_cache_t *session_cache;
+  /* NULL unless clients keep sessions, by the server they connect to */
+  sln_session_cache_t *client_session_cache;
+  /* NULL unless servers issue session tickets, swapped for a new generation
+   * on rotation without locking */
+  sln_ticket_keys_t *ticket_keys;
+  /* Threads looking at ticket_keys right now, rotations included */
+  int ticket_readers;
+  int ticket_lifetime;
 };
 
 struct selene_cert_t {
@@ -210,24 +349,65 @@ struct selene_cert_t {
   sln_array_header_t *cache_subjectAltNames;
 };
 
+typedef struct {
+  EVP_PKEY *key;
+} sln_pubkey_t;
+
+typedef struct {
+  EVP_PKEY *key;
+} sln_privkey_t;
+
 struct selene_cert_chain_t {
   SLN_RING_HEAD(selene_cert_list, selene_cert_t) list;
   selene_t *s;
+  /* Key of the first certificate, for our own chains, NULL otherwise */
+  sln_privkey_t *privkey;
 };
 
-typedef struct {
-  EVP_PKEY *key;
-} sln_pubkey_t;
+#define SLN_SESSION_ID_MAX_LENGTH (32)
+#define SLN_SESSION_SECRET_LENGTH (48)
+#define SLN_SESSION_TICKET_MAX_LENGTH (256)
+
+/* What it takes to resume a session with an abbreviated handshake */
+struct selene_session_t {
+  selene_alloc_t *alloc;
+  uint8_t id_len;
+  char id[SLN_SESSION_ID_MAX_LENGTH];
+  char master_secret[SLN_SESSION_SECRET_LENGTH];
+  selene_cipher_suite_e suite;
+  uint8_t version_major;
+  uint8_t version_minor;
+  /* time() of the full handshake */
+  int64_t created;
+  /* Server only, the chain it authenticated with, owned by its conf.  The
+   * peer's chain is not kept: client certificates are not supported yet, and
+   * a resuming client gets no server chain either. */
+  selene_cert_chain_t *chain;
+  /* Client only, the ticket the server handed out for the session, offered
+   * along with the ID.  Longer tickets are not kept. */
+  uint32_t ticket_lifetime_hint;
+  uint16_t ticket_len;
+  char ticket[SLN_SESSION_TICKET_MAX_LENGTH];
+};
 
 typedef struct {
   sln_brigade_t *in_enc;
   sln_brigade_t *out_enc;
   sln_brigade_t *in_cleartext;
   sln_brigade_t *out_cleartext;
+  /* Writable space handed out by selene_io_in_enc_reserve, not yet part of
+   * in_enc, and how much of it the caller may commit */
+  sln_brigade_t *in_enc_spare;
+  size_t in_enc_reserved;
+  /* Sent with selene_io_out_enc_consume_deferred, kept alive until
+   * selene_io_out_enc_release */
+  sln_brigade_t *out_enc_inflight;
 } sln_iobb_t;
 
 struct selene_t {
+  /* Allocator for buckets and brigades, backed by pool */
   selene_alloc_t *alloc;
+  sln_pool_t *pool;
   sln_mode_e mode;
   sln_state_e state;
   selene_conf_t *conf;
@@ -244,9 +424,18 @@ struct selene_t {
   void *backend_baton;
 
   const char *client_sni;
+  /* (client only) Tells apart servers with the same name in the client
+   * session cache, NULL for none */
+  const char *client_session_tag;
   selene_cert_chain_t *peer_certs;
   sln_pubkey_t *peer_pubkey;
   selene_cert_chain_t *my_certs;
+
+  /* (client only) Session offered in the ClientHello, NULL for none */
+  selene_session_t *offered_session;
+  /* Session of the completed handshake, NULL until then */
+  selene_session_t *session;
+  int session_resumed;
 };
 
 void *sln_alloc(selene_t *s, size_t len);
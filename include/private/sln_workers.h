@@ -0,0 +1,47 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_workers_h_
+#define _sln_workers_h_
+
+#include "selene.h"
+#include "sln_types.h"
+
+/**
+ * A fixed set of threads that run batches of independent jobs.  Any number
+ * of threads may submit batches at once.  The submitting thread works on its
+ * own batch as well, and returns once every job of it is done.
+ *
+ * Every thread running jobs has a lane number, below sln_workers_lanes(),
+ * and runs one job at a time: per lane state needs no locking.  Submitters
+ * all share the last lane, so state behind it must belong to the submitter.
+ */
+typedef void(sln_workers_job_cb)(void *baton, size_t job, int lane);
+
+selene_error_t *sln_workers_create(selene_alloc_t *alloc, int threads,
+                                   sln_workers_t **workers);
+
+/* Stops and joins the threads, no batch may be running */
+void sln_workers_destroy(sln_workers_t *workers);
+
+int sln_workers_lanes(sln_workers_t *workers);
+
+/* Calls cb once for each job in [0, njobs), and waits for all of them */
+void sln_workers_run(sln_workers_t *workers, sln_workers_job_cb *cb,
+                     void *baton, size_t njobs);
+
+#endif
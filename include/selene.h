@@ -21,6 +21,7 @@
 
 #include <stdlib.h>     /* for size_t */
 #include <sys/socket.h> /* for iovec */
+#include <sys/types.h>  /* for off_t */
 
 #include "selene_visibility.h"
 #include "selene_version.h"
@@ -37,6 +38,9 @@ extern "C" {
 /** Opaque context of an SSL/TLS Session */
 typedef struct selene_t selene_t;
 
+/** Opaque state of an established session, to resume it later */
+typedef struct selene_session_t selene_session_t;
+
 #include "selene_cert.h"
 
 /**
@@ -73,6 +77,52 @@ selene_client_name_indication(selene_t *ctxt, const char *sni);
 SELENE_API(selene_error_t *)
 selene_client_next_protocol_add(selene_t *ctxt, const char *protocol);
 
+/* (client only) Offer session to the server, which may resume it with an
+ * abbreviated handshake instead of a full one.  Must be called before
+ * selene_start, session is copied. */
+SELENE_API(selene_error_t *)
+selene_client_session_set(selene_t *ctxt, const selene_session_t *session);
+
+/* (client only) Set what, along with the server name indication, picks the
+ * session offered from the client session cache of the conf, like the port
+ * of the server.  Must be called before selene_start. */
+SELENE_API(selene_error_t *)
+selene_client_session_tag(selene_t *ctxt, const char *tag);
+
+/* Copies the session ctxt established, for selene_client_session_set on a
+ * later connection to the same server.  Sets session to NULL until the
+ * handshake has completed.  Free it with selene_session_destroy. */
+SELENE_API(selene_error_t *)
+selene_session_get(selene_t *ctxt, selene_session_t **session);
+
+SELENE_API(void) selene_session_destroy(selene_session_t *session);
+
+/* The ID session is resumed by, in a session cache outside of Selene */
+SELENE_API(void)
+selene_session_id(const selene_session_t *session, const char **id,
+                  size_t *len);
+
+#define SELENE_SESSION_EXPORT_LENGTH (94)
+
+/**
+ * Writes session into buf, SELENE_SESSION_EXPORT_LENGTH bytes, for keeping it
+ * outside of Selene, and sets len to the bytes written.  It carries the
+ * master secret of the session in the clear: anyone holding it can decrypt
+ * the connections of the session, keep it as safe as the private key.
+ */
+SELENE_API(selene_error_t *)
+selene_session_export(const selene_session_t *session, char *buf,
+                      size_t *len);
+
+/* Reads back a session selene_session_export wrote, allocated from conf.
+ * Free it with selene_session_destroy. */
+SELENE_API(selene_error_t *)
+selene_session_import(selene_conf_t *conf, const char *buf, size_t len,
+                      selene_session_t **session);
+
+/* 1 if the handshake of ctxt resumed an earlier session, 0 otherwise */
+SELENE_API(int) selene_session_resumed(selene_t *ctxt);
+
 /* Possible Event Types */
 typedef enum {
   SELENE_EVENT__UNUSED0 = 0,
@@ -94,7 +144,15 @@ typedef enum {
   SELENE__EVENT_HS_GOT_CERTIFICATE = 12,
   SELENE__EVENT_HS_GOT_SERVER_HELLO_DONE = 13,
   SELENE__EVENT_HS_GOT_CLIENT_KEY_EXCHANGE = 14,
-  SELENE_EVENT__MAX = 15
+  SELENE__EVENT_HS_GOT_FINISHED = 15,
+  SELENE__EVENT_HS_GOT_NEW_SESSION_TICKET = 16,
+  /* (server only) A client asked to resume a session by ID, see
+   * selene_complete_session_lookup */
+  SELENE_EVENT_SESSION_LOOKUP = 17,
+  /* (server only) A full handshake set up a session resumable by ID, see
+   * selene_session_get */
+  SELENE_EVENT_SESSION_STORE = 18,
+  SELENE_EVENT__MAX = 19
 } selene_event_e;
 
 typedef enum {
@@ -152,10 +210,74 @@ selene_io_in_clear_bytes(selene_t *ctxt, const char *bytes, size_t length);
 SELENE_API(selene_error_t *)
 selene_io_in_clear_iovec(selene_t *s, const struct iovec *vec, int iovcnt);
 
+/* Called once Selene no longer references memory lent to it */
+typedef void(selene_io_release_cb)(void *baton);
+
+/**
+ * Hand cleartext bytes to Selene without copying them.  Selene only reads
+ * the memory, and calls cb with baton once the records built from it no
+ * longer need it, which may be as late as selene_destroy.  Until then the
+ * bytes must not be modified or freed.
+ */
+SELENE_API(selene_error_t *)
+selene_io_in_clear_borrow(selene_t *ctxt, const char *bytes, size_t length,
+                          selene_io_release_cb *cb, void *baton);
+
+/* Same as selene_io_in_clear_borrow, cb is called once for all of the
+ * buffers */
+SELENE_API(selene_error_t *)
+selene_io_in_clear_borrow_iovec(selene_t *ctxt, const struct iovec *vec,
+                                int iovcnt, selene_io_release_cb *cb,
+                                void *baton);
+
+/**
+ * Hand length bytes of a file, starting at offset, to Selene as cleartext.
+ * Nothing is read up front: the record layer reads a record's worth at a
+ * time as it needs it, so sending a large file only ever keeps a few records
+ * of it in memory.  cb is called once Selene is done with fd, which the
+ * caller still owns and has to close.
+ */
+SELENE_API(selene_error_t *)
+selene_io_in_clear_file(selene_t *ctxt, int fd, off_t offset, size_t length,
+                        selene_io_release_cb *cb, void *baton);
+
+/* Same as selene_io_in_clear_file, but maps a record's worth of the file at
+ * a time with mmap() instead of reading it */
+SELENE_API(selene_error_t *)
+selene_io_in_clear_mmap(selene_t *ctxt, int fd, off_t offset, size_t length,
+                        selene_io_release_cb *cb, void *baton);
+
 /* Hand encrypted input bytes to Selene */
 SELENE_API(selene_error_t *)
 selene_io_in_enc_bytes(selene_t *ctxt, const char *bytes, size_t length);
 
+/**
+ * Borrow writable space for encrypted input, so that read() can place bytes
+ * directly into Selene's buffers instead of having them copied by
+ * selene_io_in_enc_bytes.  At least hint bytes are handed out.  With a hint
+ * of 0, that is whatever is left over from the previous reservation, or else
+ * room for a full TLS record.  Call selene_io_in_enc_commit afterwards with
+ * the number of bytes actually written to the front of the buffer.
+ *
+ * The space stays valid until the next commit or reservation.
+ */
+SELENE_API(selene_error_t *)
+selene_io_in_enc_reserve(selene_t *ctxt, size_t hint, char **buf,
+                         size_t *len);
+
+/**
+ * Same as selene_io_in_enc_reserve, but for readv(): hands out up to
+ * *iovcnt buffers adding up to at least hint bytes, and sets *iovcnt to the
+ * number of entries filled in.  Committed bytes fill the buffers in order.
+ */
+SELENE_API(selene_error_t *)
+selene_io_in_enc_reserve_iovec(selene_t *ctxt, size_t hint, struct iovec *vec,
+                               int *iovcnt);
+
+/* Hand the first length bytes of the last reservation to Selene */
+SELENE_API(selene_error_t *)
+selene_io_in_enc_commit(selene_t *ctxt, size_t length);
+
 /* Read cleartext bytes out of Selene and parse by your application */
 SELENE_API(selene_error_t *)
 selene_io_out_clear_bytes(selene_t *ctxt, char *buffer, size_t blen,
@@ -166,6 +288,37 @@ SELENE_API(selene_error_t *)
 selene_io_out_enc_bytes(selene_t *ctxt, char *buffer, size_t blen,
                         size_t *length, size_t *remaining);
 
+/**
+ * Point up to max iovecs at the encrypted bytes waiting to be sent, without
+ * copying them, for use with writev() or sendmsg().  *count is set to the
+ * number of entries filled in, 0 if there is nothing to send.
+ *
+ * The buffers stay valid until the bytes in them are consumed; consuming the
+ * front of a buffer leaves the rest of it where it was.
+ */
+SELENE_API(selene_error_t *)
+selene_io_out_enc_peek_iovec(selene_t *ctxt, struct iovec *vec, int max,
+                             int *count);
+
+/* Drop the first length bytes handed out by selene_io_out_enc_peek_iovec,
+ * once the kernel accepted them */
+SELENE_API(selene_error_t *)
+selene_io_out_enc_consume(selene_t *ctxt, size_t length);
+
+/**
+ * Same as selene_io_out_enc_consume, but for MSG_ZEROCOPY style sends, where
+ * the kernel keeps reading the buffers after accepting them.  The bytes are
+ * taken off the output, but kept valid until selene_io_out_enc_release is
+ * called for them.
+ */
+SELENE_API(selene_error_t *)
+selene_io_out_enc_consume_deferred(selene_t *ctxt, size_t length);
+
+/* Free the oldest length bytes passed to selene_io_out_enc_consume_deferred,
+ * once the kernel reported their send as complete */
+SELENE_API(selene_error_t *)
+selene_io_out_enc_release(selene_t *ctxt, size_t length);
+
 SELENE_API(void)
 selene_log_msg_get(selene_t *ctxt, const char **log_msg, size_t *log_msg_len);
 
@@ -187,6 +340,25 @@ selene_complete_validate_certificate(selene_t *ctxt, int valid);
 SELENE_API(void)
 selene_complete_select_certificates(selene_t *s, selene_cert_chain_t *chain);
 
+/* The session ID the client asked to resume, for the
+ * SELENE_EVENT_SESSION_LOOKUP event */
+SELENE_API(void)
+selene_session_lookup_id(selene_t *ctxt, const char **id, size_t *len);
+
+/**
+ * Answers SELENE_EVENT_SESSION_LOOKUP with the session stored under the ID,
+ * or NULL if there is none.  Must be called for the handshake to go on, from
+ * the handler or any time later: the handshake waits, and the connection may
+ * be fed more data meanwhile.  session is copied, and only resumed if the
+ * client can still use it.  The default handler looks in the session cache
+ * of the conf, and the default SELENE_EVENT_SESSION_STORE handler fills it.
+ * Setting a handler for SELENE_EVENT_SESSION_STORE names new sessions even
+ * without a session cache.
+ */
+SELENE_API(void)
+selene_complete_session_lookup(selene_t *ctxt,
+                               const selene_session_t *session);
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -78,7 +78,11 @@ typedef enum {
   SELENE_CS_RSA_WITH_RC4_128_SHA = 1,
   SELENE_CS_RSA_WITH_AES_128_CBC_SHA = 2,
   SELENE_CS_RSA_WITH_AES_256_CBC_SHA = 3,
-  SELENE_CS__MAX = 4
+  /* The AEAD suites are TLS 1.2 only, and Selene only speaks TLS 1.0 so far:
+   * they are never negotiated yet, adding them to a list does nothing */
+  SELENE_CS_RSA_WITH_AES_128_GCM_SHA256 = 4,
+  SELENE_CS_RSA_WITH_AES_256_GCM_SHA384 = 5,
+  SELENE_CS__MAX = 6
 } selene_cipher_suite_e;
 
 typedef struct selene_cipher_suite_list_t selene_cipher_suite_list_t;
@@ -123,6 +127,86 @@ typedef enum {
 SELENE_API(selene_error_t *)
 selene_conf_protocols(selene_conf_t *conf, int protocols);
 
+/**
+ * Decrypt and verify runs of application data records that arrived together
+ * on a pool of threads, threads of them, shared by every session using conf.
+ * Worth it for a few sessions moving a lot of data each, like replication
+ * links.  Plaintext still comes out in order.  AES-CBC and AEAD cipher
+ * suites are decrypted in parallel, RC4 is not.  AES-CBC records then take
+ * two passes instead of OpenSSL's stitched one, their padding and MAC are
+ * still checked in constant time.  0, the default, decrypts every record on
+ * the thread handing it to Selene.  Must be called before creating
+ * sessions.
+ */
+SELENE_API(selene_error_t *)
+selene_conf_record_workers(selene_conf_t *conf, int threads);
+
+/**
+ * Keep up to max_sessions sessions for timeout seconds after their full
+ * handshake, so that clients coming back in that time resume them with an
+ * abbreviated handshake, skipping the RSA operation.  The slots are
+ * allocated here, once they are all taken the sessions not resumed lately
+ * are evicted first.  Shared by every server using conf, from any thread.
+ * 0, the default, disables the cache.  Must be called before creating
+ * sessions.
+ */
+SELENE_API(selene_error_t *)
+selene_conf_session_cache(selene_conf_t *conf, int max_sessions, int timeout);
+
+/**
+ * Like selene_conf_session_cache, in memory shared between processes, so
+ * that workers forked after this call, or any process passing the same path,
+ * resume each other's sessions.  With path NULL the memory is anonymous and
+ * goes away with the last process.  Otherwise it is the file at path, which
+ * keeps the master secrets of the sessions it holds: it is created readable
+ * by its owner only, and must be in a place nobody else can get to, ideally
+ * in memory like /dev/shm.  Every process must pass the same max_sessions.
+ * Replaces any cache set before.
+ */
+SELENE_API(selene_error_t *)
+selene_conf_session_cache_shared(selene_conf_t *conf, int max_sessions,
+                                 int timeout, const char *path);
+
+/**
+ * Keep up to max_sessions sessions clients using conf established, for
+ * timeout seconds after their full handshake.  A client with a server name
+ * indication offers the session cached for that name and its
+ * selene_client_session_tag, unless selene_client_session_set gave it one,
+ * and caches the session it ends up with.  Shared by every client using
+ * conf, from any thread.  0, the default, disables the cache.  Must be
+ * called before creating sessions.
+ */
+SELENE_API(selene_error_t *)
+selene_conf_client_session_cache(selene_conf_t *conf, int max_sessions,
+                                 int timeout);
+
+/* How many client session cache lookups found a session, and how many did
+ * not, since the cache was created */
+SELENE_API(void)
+selene_conf_client_session_cache_stats(selene_conf_t *conf, size_t *hits,
+                                       size_t *misses);
+
+/**
+ * Hand clients RFC 5077 session tickets good for lifetime seconds: the
+ * session sealed under a key only the servers know, so that any server
+ * holding the key resumes it without keeping any state.  Starts out with a
+ * random key unless selene_conf_session_ticket_key set one.  0, the
+ * default, disables tickets.  Must be called before creating sessions.
+ */
+SELENE_API(selene_error_t *)
+selene_conf_session_tickets(selene_conf_t *conf, int lifetime);
+
+#define SELENE_SESSION_TICKET_KEY_LENGTH (48)
+
+/**
+ * Seal new tickets with key, SELENE_SESSION_TICKET_KEY_LENGTH random bytes,
+ * or with a random key if key is NULL.  The key it replaces still opens
+ * tickets until the next call, and those get a new ticket when resumed.
+ * May be called at any time, from any thread, while servers use conf.
+ */
+SELENE_API(selene_error_t *)
+selene_conf_session_ticket_key(selene_conf_t *conf, const char *key);
+
 /* TODO: this is a OpenSSL specific interface*/
 #if 0
 SELENE_API(selene_error_t*)
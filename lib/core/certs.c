@@ -459,6 +459,10 @@ int selene_cert_chain_count(selene_cert_chain_t *cc) {
 
 void sln_cert_chain_destroy(selene_conf_t *conf, selene_cert_chain_t *chain) {
   sln_cert_chain_clear(conf, chain);
+  if (chain->privkey != NULL) {
+    EVP_PKEY_free(chain->privkey->key);
+    sln_conf_free(conf, chain->privkey);
+  }
   sln_conf_free(conf, chain);
 }
 
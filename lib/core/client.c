@@ -17,6 +17,10 @@
 
 #include "selene.h"
 #include "sln_types.h"
+#include "sln_digest.h"
+#include "sln_sessions.h"
+#include <string.h>
+#include <time.h>
 
 selene_error_t *selene_client_name_indication(selene_t *s,
                                               const char *hostname) {
@@ -40,3 +44,104 @@ selene_error_t *selene_client_next_protocol_add(selene_t *s,
   /* TODO: NPN */
   return SELENE_SUCCESS;
 }
+
+selene_error_t *selene_client_session_set(selene_t *s,
+                                          const selene_session_t *session) {
+  if (s->offered_session != NULL) {
+    memset(s->offered_session, 0, sizeof(selene_session_t));
+    sln_free(s, s->offered_session);
+    s->offered_session = NULL;
+  }
+
+  if (session != NULL) {
+    s->offered_session = sln_alloc(s, sizeof(selene_session_t));
+    memcpy(s->offered_session, session, sizeof(selene_session_t));
+  }
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *selene_client_session_tag(selene_t *s, const char *tag) {
+  if (s->client_session_tag != NULL) {
+    sln_free(s, (void *)s->client_session_tag);
+  }
+
+  if (tag) {
+    s->client_session_tag = sln_strdup(s, tag);
+  } else {
+    s->client_session_tag = NULL;
+  }
+
+  return SELENE_SUCCESS;
+}
+
+/* SHA-256 over the server name and the tag, both with their terminating
+ * NUL, so no two pairs share a key */
+static selene_error_t *client_session_key(selene_t *s, char *key) {
+  const char *tag = s->client_session_tag != NULL ? s->client_session_tag : "";
+  sln_digest_t *d = NULL;
+
+  SELENE_ERR(sln_digest_create(s, SLN_DIGEST_SHA256, &d));
+  sln_digest_update(d, s->client_sni, strlen(s->client_sni) + 1);
+  sln_digest_update(d, tag, strlen(tag) + 1);
+  sln_digest_final(d, (unsigned char *)key);
+  sln_digest_destroy(d);
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_client_session_lookup(selene_t *s) {
+  sln_session_cache_t *cache = s->conf->client_session_cache;
+  char key[SLN_SESSION_KEY_MAX_LENGTH];
+  selene_session_t cached;
+
+  if (cache == NULL || s->client_sni == NULL || s->offered_session != NULL) {
+    return SELENE_SUCCESS;
+  }
+
+  SELENE_ERR(client_session_key(s, key));
+
+  if (sln_session_cache_get(cache, key, sizeof(key), time(NULL), &cached)) {
+    s->offered_session = sln_alloc(s, sizeof(selene_session_t));
+    memcpy(s->offered_session, &cached, sizeof(selene_session_t));
+    s->offered_session->alloc = s->conf->alloc;
+    memset(&cached, 0, sizeof(cached));
+  }
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_client_session_store(selene_t *s) {
+  sln_session_cache_t *cache = s->conf->client_session_cache;
+  char key[SLN_SESSION_KEY_MAX_LENGTH];
+
+  /* nothing to offer without an ID */
+  if (cache == NULL || s->client_sni == NULL || s->session == NULL ||
+      s->session->id_len == 0) {
+    return SELENE_SUCCESS;
+  }
+
+  SELENE_ERR(client_session_key(s, key));
+
+  sln_session_cache_put(cache, key, sizeof(key), s->session);
+
+  return SELENE_SUCCESS;
+}
+
+void sln_client_session_forget(selene_t *s) {
+  sln_session_cache_t *cache = s->conf->client_session_cache;
+  char key[SLN_SESSION_KEY_MAX_LENGTH];
+  selene_error_t *err;
+
+  if (cache == NULL || s->client_sni == NULL) {
+    return;
+  }
+
+  err = client_session_key(s, key);
+  if (err) {
+    selene_error_clear(err);
+    return;
+  }
+
+  sln_session_cache_remove(cache, key, sizeof(key));
+}
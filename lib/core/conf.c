@@ -19,6 +19,9 @@
 #include "sln_types.h"
 #include "sln_arrays.h"
 #include "sln_certs.h"
+#include "sln_workers.h"
+#include "sln_sessions.h"
+#include "sln_tickets.h"
 #include <string.h>
 
 static void *malloc_cb(void *baton, size_t len) { return malloc(len); }
@@ -29,7 +32,7 @@ static void free_cb(void *baton, void *ptr) { free(ptr); }
 
 static selene_alloc_t default_alloc = {NULL, malloc_cb, calloc_cb, free_cb};
 
-selene_error_t *selene_conf_create_with_allloc(selene_conf_t **p_conf,
+selene_error_t *selene_conf_create_with_alloc(selene_conf_t **p_conf,
                                                selene_alloc_t *alloc) {
   selene_conf_t *conf;
 
@@ -51,7 +54,7 @@ selene_error_t *selene_conf_create_with_allloc(selene_conf_t **p_conf,
 }
 
 selene_error_t *selene_conf_create(selene_conf_t **p_conf) {
-  return selene_conf_create_with_allloc(p_conf, NULL);
+  return selene_conf_create_with_alloc(p_conf, NULL);
 }
 
 void selene_conf_destroy(selene_conf_t *conf) {
@@ -67,6 +70,21 @@ void selene_conf_destroy(selene_conf_t *conf) {
   sln_array_destroy(conf->certs);
 
   X509_STORE_free(conf->trusted_cert_store);
+
+  if (conf->workers != NULL) {
+    sln_workers_destroy(conf->workers);
+  }
+
+  if (conf->session_cache != NULL) {
+    sln_session_cache_destroy(conf->session_cache);
+  }
+
+  if (conf->client_session_cache != NULL) {
+    sln_session_cache_destroy(conf->client_session_cache);
+  }
+
+  sln_ticket_keys_destroy(conf);
+
   alloc->free(alloc->baton, conf);
 }
 
@@ -132,6 +150,107 @@ void selene_cipher_suite_list_destroy(selene_cipher_suite_list_t *ciphers) {
   alloc->free(alloc->baton, ciphers);
 }
 
+selene_error_t *selene_conf_record_workers(selene_conf_t *conf, int threads) {
+  if (threads < 0) {
+    return selene_error_createf(SELENE_EINVAL, "Invalid thread count: %d",
+                                threads);
+  }
+
+  if (conf->workers != NULL) {
+    sln_workers_destroy(conf->workers);
+    conf->workers = NULL;
+  }
+
+  if (threads == 0) {
+    return SELENE_SUCCESS;
+  }
+
+  return sln_workers_create(conf->alloc, threads, &conf->workers);
+}
+
+selene_error_t *selene_conf_session_cache(selene_conf_t *conf,
+                                          int max_sessions, int timeout) {
+  if (conf->session_cache != NULL) {
+    sln_session_cache_destroy(conf->session_cache);
+    conf->session_cache = NULL;
+  }
+
+  if (max_sessions == 0) {
+    return SELENE_SUCCESS;
+  }
+
+  return sln_session_cache_create(conf->alloc, max_sessions, timeout,
+                                  &conf->session_cache);
+}
+
+selene_error_t *selene_conf_session_cache_shared(selene_conf_t *conf,
+                                                 int max_sessions, int timeout,
+                                                 const char *path) {
+  if (conf->session_cache != NULL) {
+    sln_session_cache_destroy(conf->session_cache);
+    conf->session_cache = NULL;
+  }
+
+  if (max_sessions == 0) {
+    return SELENE_SUCCESS;
+  }
+
+  return sln_session_cache_create_shared(conf->alloc, max_sessions, timeout,
+                                         path, &conf->session_cache);
+}
+
+selene_error_t *selene_conf_client_session_cache(selene_conf_t *conf,
+                                                 int max_sessions,
+                                                 int timeout) {
+  if (conf->client_session_cache != NULL) {
+    sln_session_cache_destroy(conf->client_session_cache);
+    conf->client_session_cache = NULL;
+  }
+
+  if (max_sessions == 0) {
+    return SELENE_SUCCESS;
+  }
+
+  return sln_session_cache_create(conf->alloc, max_sessions, timeout,
+                                  &conf->client_session_cache);
+}
+
+void selene_conf_client_session_cache_stats(selene_conf_t *conf, size_t *hits,
+                                            size_t *misses) {
+  size_t evictions;
+
+  if (conf->client_session_cache == NULL) {
+    *hits = 0;
+    *misses = 0;
+    return;
+  }
+
+  sln_session_cache_stats(conf->client_session_cache, hits, misses,
+                          &evictions);
+}
+
+selene_error_t *selene_conf_session_tickets(selene_conf_t *conf,
+                                            int lifetime) {
+  if (lifetime < 0) {
+    return selene_error_createf(SELENE_EINVAL,
+                                "Invalid session ticket lifetime: %d",
+                                lifetime);
+  }
+
+  conf->ticket_lifetime = lifetime;
+
+  if (lifetime > 0 && conf->ticket_keys == NULL) {
+    return sln_ticket_keys_rotate(conf, NULL);
+  }
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *selene_conf_session_ticket_key(selene_conf_t *conf,
+                                               const char *key) {
+  return sln_ticket_keys_rotate(conf, key);
+}
+
 selene_error_t *selene_conf_protocols(selene_conf_t *conf, int protocols) {
   /* TODO: assert on inalid protocols */
   conf->protocols = protocols;
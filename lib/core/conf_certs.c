@@ -74,6 +74,36 @@ selene_error_t *read_certificate_chain(selene_conf_t *conf, BIO *in,
   return SELENE_SUCCESS;
 }
 
+/* The key has to be the one of the first certificate in chain */
+static selene_error_t *read_private_key(selene_conf_t *conf,
+                                        selene_cert_chain_t *chain,
+                                        const char *pkey) {
+  selene_cert_t *cert = SLN_CERT_CHAIN_FIRST(chain);
+  EVP_PKEY *key;
+  BIO *bio = BIO_new_mem_buf((void *)pkey, strlen(pkey));
+
+  key = PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL);
+
+  BIO_free(bio);
+
+  if (key == NULL) {
+    ERR_clear_error();
+    return selene_error_create(SELENE_EINVAL, "Failed to parse private key");
+  }
+
+  if (!X509_check_private_key(cert->cert, key)) {
+    ERR_clear_error();
+    EVP_PKEY_free(key);
+    return selene_error_create(SELENE_EINVAL,
+                               "Private key does not match the certificate");
+  }
+
+  chain->privkey = sln_conf_alloc(conf, sizeof(sln_privkey_t));
+  chain->privkey->key = key;
+
+  return SELENE_SUCCESS;
+}
+
 selene_error_t *selene_conf_cert_chain_add(selene_conf_t *conf,
                                            const char *certificate,
                                            const char *pkey) {
@@ -89,9 +119,18 @@ selene_error_t *selene_conf_cert_chain_add(selene_conf_t *conf,
         r);
   }
 
-  /* TODO: private key */
   SELENE_ERR(read_certificate_chain(conf, bio, &certs));
 
+  BIO_free(bio);
+
+  if (pkey != NULL) {
+    selene_error_t *err = read_private_key(conf, certs, pkey);
+    if (err) {
+      sln_cert_chain_destroy(conf, certs);
+      return err;
+    }
+  }
+
   SLN_ARRAY_PUSH(conf->certs, selene_cert_chain_t *) = certs;
 
   return SELENE_SUCCESS;
@@ -22,6 +22,10 @@
 #include "sln_backends.h"
 #include "sln_assert.h"
 #include "sln_certs.h"
+#include "sln_pool.h"
+#include "sln_crypto.h"
+#include "sln_digest.h"
+#include <string.h>
 
 static int initialized = 0;
 
@@ -31,6 +35,10 @@ static selene_error_t *sln_initialize(void) {
     return SELENE_SUCCESS;
   }
 
+  SELENE_ERR(sln_crypto_initialize());
+
+  sln_digest_builtin_initialize();
+
   /* TODO: Backend initilization */
   SELENE_ERR(sln_backend_initialize());
 
@@ -45,6 +53,8 @@ static void sln_terminate(void) {
 
   sln_backend_terminate();
 
+  sln_crypto_terminate();
+
   return;
 }
 
@@ -55,7 +65,6 @@ static selene_error_t *sln_create(selene_conf_t *conf, sln_mode_e mode,
   SELENE_ERR(sln_initialize());
 
   s = conf->alloc->calloc(conf->alloc->baton, sizeof(selene_t));
-  s->alloc = conf->alloc;
   s->conf = conf;
   s->mode = mode;
   s->state = SLN_STATE_INIT;
@@ -66,6 +75,9 @@ static selene_error_t *sln_create(selene_conf_t *conf, sln_mode_e mode,
   s->log_msg_level = SLN_LOG_NOTHING;
 
   /* TODO: leaks on errors here */
+  SELENE_ERR(sln_pool_create(conf->alloc, &s->pool));
+  s->alloc = sln_pool_alloc(s->pool);
+
   SELENE_ERR(sln_iobb_create(s->alloc, &s->bb));
 
   SELENE_ERR(sln_events_create(s));
@@ -95,15 +107,21 @@ void selene_destroy(selene_t *s) {
 
   sln_iobb_destroy(&s->bb);
 
-  sln_events_destroy(s);
-
+  /* The backend may still log while tearing down, so events go last */
   s->backend.destroy(s);
 
+  sln_events_destroy(s);
+
   if (s->client_sni != NULL) {
     sln_free(s, (void *)s->client_sni);
     s->client_sni = NULL;
   }
 
+  if (s->client_session_tag != NULL) {
+    sln_free(s, (void *)s->client_session_tag);
+    s->client_session_tag = NULL;
+  }
+
   if (s->peer_certs != NULL) {
     sln_cert_chain_destroy(s->conf, s->peer_certs);
     s->peer_certs = NULL;
@@ -113,6 +131,19 @@ void selene_destroy(selene_t *s) {
     sln_free(s, s->peer_pubkey);
   }
 
+  if (s->offered_session != NULL) {
+    memset(s->offered_session, 0, sizeof(selene_session_t));
+    sln_free(s, s->offered_session);
+  }
+
+  if (s->session != NULL) {
+    memset(s->session, 0, sizeof(selene_session_t));
+    sln_free(s, s->session);
+  }
+
+  sln_pool_destroy(s->pool);
+  s->pool = NULL;
+
   sln_free(s, s);
 
   sln_terminate();
@@ -0,0 +1,192 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_pool.h"
+#include "sln_assert.h"
+#include <string.h>
+
+/* Every chunk is prefixed by this header, which records the size class the
+ * chunk belongs to, and links it into the free list while it is cached. */
+struct sln_pool_chunk_t {
+  sln_pool_chunk_t *next;
+  int size_class;
+};
+
+/* Keep the memory after the header aligned like malloc() would */
+#define SLN_POOL_HEADER_SIZE 16
+
+/* Size class marker for requests passed through to the parent */
+#define SLN_POOL_CLASS_HUGE -1
+
+#define CHUNK_TO_MEM(c) ((void *)(((char *)(c)) + SLN_POOL_HEADER_SIZE))
+#define MEM_TO_CHUNK(p) \
+  ((sln_pool_chunk_t *)(((char *)(p)) - SLN_POOL_HEADER_SIZE))
+
+/* Sizes are picked for what the record layer allocates the most: TLS
+ * record headers, bucket headers, handshake messages, socket reads, and full
+ * TLS records (2^14 bytes of plaintext plus expansion). */
+static const size_t class_sizes[SLN_POOL_CLASSES] = {16, 64, 512, 4096,
+                                                     16384 + 2048};
+
+/* Enough 4K chunks to buffer a full record arriving in MSS sized reads */
+static const size_t class_max_free[SLN_POOL_CLASSES] = {256, 256, 64, 16, 4};
+
+int sln_pool_size_class(size_t len) {
+  int i;
+
+  for (i = 0; i < SLN_POOL_CLASSES; i++) {
+    if (len <= class_sizes[i]) {
+      return i;
+    }
+  }
+
+  return SLN_POOL_CLASS_HUGE;
+}
+
+size_t sln_pool_usable_size(size_t len) {
+  int cls = sln_pool_size_class(len);
+
+  if (cls == SLN_POOL_CLASS_HUGE) {
+    return len;
+  }
+
+  return class_sizes[cls];
+}
+
+static void *pool_malloc(void *baton, size_t len) {
+  sln_pool_t *pool = (sln_pool_t *)baton;
+  sln_pool_class_t *pc;
+  sln_pool_chunk_t *c;
+  int cls = sln_pool_size_class(len);
+
+  if (cls == SLN_POOL_CLASS_HUGE) {
+    pool->misses++;
+    c = pool->parent->malloc(pool->parent->baton, SLN_POOL_HEADER_SIZE + len);
+    if (c == NULL) {
+      return NULL;
+    }
+    c->next = NULL;
+    c->size_class = SLN_POOL_CLASS_HUGE;
+    return CHUNK_TO_MEM(c);
+  }
+
+  pc = &pool->classes[cls];
+
+  if (sln_likely(pc->free != NULL)) {
+    pool->hits++;
+    c = pc->free;
+    pc->free = c->next;
+    pc->nfree--;
+  } else {
+    pool->misses++;
+    c = pool->parent->malloc(pool->parent->baton,
+                             SLN_POOL_HEADER_SIZE + pc->size);
+    if (c == NULL) {
+      return NULL;
+    }
+    c->size_class = cls;
+  }
+
+  c->next = NULL;
+
+  return CHUNK_TO_MEM(c);
+}
+
+static void *pool_calloc(void *baton, size_t len) {
+  void *p = pool_malloc(baton, len);
+
+  if (p != NULL) {
+    memset(p, 0, len);
+  }
+
+  return p;
+}
+
+static void pool_free(void *baton, void *ptr) {
+  sln_pool_t *pool = (sln_pool_t *)baton;
+  sln_pool_class_t *pc;
+  sln_pool_chunk_t *c;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  c = MEM_TO_CHUNK(ptr);
+
+  if (c->size_class == SLN_POOL_CLASS_HUGE) {
+    pool->parent->free(pool->parent->baton, c);
+    return;
+  }
+
+  SLN_ASSERT(c->size_class >= 0 && c->size_class < SLN_POOL_CLASSES);
+
+  pc = &pool->classes[c->size_class];
+
+  if (pc->nfree >= pc->max_free) {
+    pool->parent->free(pool->parent->baton, c);
+    return;
+  }
+
+  c->next = pc->free;
+  pc->free = c;
+  pc->nfree++;
+}
+
+selene_error_t *sln_pool_create(selene_alloc_t *parent, sln_pool_t **p_pool) {
+  int i;
+  sln_pool_t *pool;
+
+  SLN_ASSERT(sizeof(sln_pool_chunk_t) <= SLN_POOL_HEADER_SIZE);
+
+  pool = parent->calloc(parent->baton, sizeof(sln_pool_t));
+
+  if (pool == NULL) {
+    return selene_error_create(SELENE_ENOMEM, "Unable to allocate pool");
+  }
+
+  pool->parent = parent;
+  pool->alloc.baton = pool;
+  pool->alloc.malloc = pool_malloc;
+  pool->alloc.calloc = pool_calloc;
+  pool->alloc.free = pool_free;
+
+  for (i = 0; i < SLN_POOL_CLASSES; i++) {
+    pool->classes[i].size = class_sizes[i];
+    pool->classes[i].max_free = class_max_free[i];
+  }
+
+  *p_pool = pool;
+
+  return SELENE_SUCCESS;
+}
+
+void sln_pool_destroy(sln_pool_t *pool) {
+  int i;
+  sln_pool_chunk_t *c;
+  selene_alloc_t *parent = pool->parent;
+
+  for (i = 0; i < SLN_POOL_CLASSES; i++) {
+    while (pool->classes[i].free != NULL) {
+      c = pool->classes[i].free;
+      pool->classes[i].free = c->next;
+      parent->free(parent->baton, c);
+    }
+    pool->classes[i].nfree = 0;
+  }
+
+  parent->free(parent->baton, pool);
+}
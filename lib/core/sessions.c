@@ -0,0 +1,432 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "sln_types.h"
+#include "sln_sessions.h"
+#include <pthread.h>
+#include <string.h>
+
+typedef struct {
+  selene_session_t session;
+  uint8_t key_len;
+  char key[SLN_SESSION_KEY_MAX_LENGTH];
+  uint32_t hash;
+  /* Next slot in the same hash bucket, -1 at the end */
+  int next;
+  int used;
+  /* Looked up since the CLOCK hand last passed */
+  int referenced;
+} cache_slot_t;
+
+/* The in-process store, slots in a chained hash under a mutex */
+typedef struct local_cache_t {
+  selene_alloc_t *alloc;
+  pthread_mutex_t lock;
+  int timeout;
+  int capacity;
+  /* Slots handed out so far, every slot is in use once this is capacity */
+  int filled;
+  int hand;
+  /* Heads of the hash chains, one less than a power of two */
+  uint32_t mask;
+  int *buckets;
+  cache_slot_t *slots;
+  size_t hits;
+  size_t misses;
+  size_t evictions;
+} local_cache_t;
+
+/* FNV-1a, keys are random or hashes already */
+uint32_t sln_session_key_hash(const char *key, size_t keylen) {
+  uint32_t h = 2166136261U;
+  size_t i;
+
+  for (i = 0; i < keylen; i++) {
+    h ^= (unsigned char)key[i];
+    h *= 16777619U;
+  }
+
+  return h;
+}
+
+static void local_destroy(void *baton) {
+  local_cache_t *cache = baton;
+  selene_alloc_t *alloc = cache->alloc;
+
+  pthread_mutex_destroy(&cache->lock);
+
+  memset(cache->slots, 0, sizeof(cache_slot_t) * cache->capacity);
+
+  alloc->free(alloc->baton, cache->slots);
+  alloc->free(alloc->baton, cache->buckets);
+  alloc->free(alloc->baton, cache);
+}
+
+static int slot_find(local_cache_t *cache, uint32_t hash,
+                     const char *key, size_t keylen) {
+  int i = cache->buckets[hash & cache->mask];
+
+  while (i != -1) {
+    cache_slot_t *slot = &cache->slots[i];
+    if (slot->hash == hash && slot->key_len == keylen &&
+        memcmp(slot->key, key, keylen) == 0) {
+      return i;
+    }
+    i = slot->next;
+  }
+
+  return -1;
+}
+
+/* Takes slot i out of its hash chain, and wipes it */
+static void slot_release(local_cache_t *cache, int i) {
+  cache_slot_t *slot = &cache->slots[i];
+  int *link = &cache->buckets[slot->hash & cache->mask];
+
+  while (*link != i) {
+    link = &cache->slots[*link].next;
+  }
+  *link = slot->next;
+
+  memset(slot, 0, sizeof(*slot));
+}
+
+static int slot_expired(local_cache_t *cache, cache_slot_t *slot,
+                        int64_t now) {
+  return now - slot->session.created >= cache->timeout;
+}
+
+/* Picks the slot for a new session, on the second pass at the latest */
+static int slot_victim(local_cache_t *cache, int64_t now) {
+  cache_slot_t *slot;
+  int i;
+
+  if (cache->filled < cache->capacity) {
+    return cache->filled++;
+  }
+
+  while (1) {
+    i = cache->hand;
+    slot = &cache->slots[i];
+    cache->hand = (cache->hand + 1) % cache->capacity;
+
+    if (!slot->used) {
+      return i;
+    }
+
+    if (slot_expired(cache, slot, now)) {
+      break;
+    }
+
+    if (!slot->referenced) {
+      cache->evictions++;
+      break;
+    }
+
+    slot->referenced = 0;
+  }
+
+  slot_release(cache, i);
+
+  return i;
+}
+
+static void local_put(void *baton, const char *key, size_t keylen,
+                      const selene_session_t *session) {
+  local_cache_t *cache = baton;
+  uint32_t hash;
+  cache_slot_t *slot;
+  int i;
+
+  hash = sln_session_key_hash(key, keylen);
+
+  pthread_mutex_lock(&cache->lock);
+
+  i = slot_find(cache, hash, key, keylen);
+
+  if (i == -1) {
+    i = slot_victim(cache, session->created);
+    slot = &cache->slots[i];
+    slot->hash = hash;
+    slot->key_len = keylen;
+    memcpy(slot->key, key, keylen);
+    slot->used = 1;
+    slot->next = cache->buckets[hash & cache->mask];
+    cache->buckets[hash & cache->mask] = i;
+  } else {
+    slot = &cache->slots[i];
+  }
+
+  memcpy(&slot->session, session, sizeof(selene_session_t));
+  slot->session.alloc = NULL;
+  slot->referenced = 0;
+
+  pthread_mutex_unlock(&cache->lock);
+}
+
+static int local_get(void *baton, const char *key, size_t keylen,
+                     int64_t now, selene_session_t *session) {
+  local_cache_t *cache = baton;
+  uint32_t hash = sln_session_key_hash(key, keylen);
+  int found = 0;
+  int i;
+
+  pthread_mutex_lock(&cache->lock);
+
+  i = slot_find(cache, hash, key, keylen);
+
+  if (i != -1 && slot_expired(cache, &cache->slots[i], now)) {
+    slot_release(cache, i);
+    i = -1;
+  }
+
+  if (i != -1) {
+    cache->slots[i].referenced = 1;
+    memcpy(session, &cache->slots[i].session, sizeof(selene_session_t));
+    cache->hits++;
+    found = 1;
+  } else {
+    cache->misses++;
+  }
+
+  pthread_mutex_unlock(&cache->lock);
+
+  return found;
+}
+
+static void local_remove(void *baton, const char *key, size_t keylen) {
+  local_cache_t *cache = baton;
+  int i;
+
+  pthread_mutex_lock(&cache->lock);
+
+  i = slot_find(cache, sln_session_key_hash(key, keylen), key, keylen);
+  if (i != -1) {
+    slot_release(cache, i);
+  }
+
+  pthread_mutex_unlock(&cache->lock);
+}
+
+static void local_stats(void *baton, size_t *hits, size_t *misses,
+                        size_t *evictions) {
+  local_cache_t *cache = baton;
+
+  pthread_mutex_lock(&cache->lock);
+  *hits = cache->hits;
+  *misses = cache->misses;
+  *evictions = cache->evictions;
+  pthread_mutex_unlock(&cache->lock);
+}
+
+static const sln_session_store_t local_store = {
+    "local", local_destroy, local_put, local_get, local_remove, local_stats};
+
+selene_error_t *sln_session_cache_create(selene_alloc_t *alloc,
+                                         int max_sessions, int timeout,
+                                         sln_session_cache_t **p_cache) {
+  local_cache_t *local;
+  uint32_t nbuckets = 1;
+  uint32_t i;
+
+  if (max_sessions <= 0 || timeout <= 0) {
+    return selene_error_createf(SELENE_EINVAL,
+                                "Invalid session cache: %d sessions for %d "
+                                "seconds",
+                                max_sessions, timeout);
+  }
+
+  while (nbuckets < (uint32_t)max_sessions) {
+    nbuckets <<= 1;
+  }
+
+  local = alloc->calloc(alloc->baton, sizeof(local_cache_t));
+  local->alloc = alloc;
+  local->timeout = timeout;
+  local->capacity = max_sessions;
+  local->mask = nbuckets - 1;
+  local->buckets = alloc->malloc(alloc->baton, sizeof(int) * nbuckets);
+  local->slots =
+      alloc->calloc(alloc->baton, sizeof(cache_slot_t) * max_sessions);
+
+  for (i = 0; i < nbuckets; i++) {
+    local->buckets[i] = -1;
+  }
+
+  pthread_mutex_init(&local->lock, NULL);
+
+  return sln_session_cache_create_store(alloc, &local_store, local, p_cache);
+}
+
+selene_error_t *sln_session_cache_create_store(
+    selene_alloc_t *alloc, const sln_session_store_t *store, void *baton,
+    sln_session_cache_t **p_cache) {
+  sln_session_cache_t *cache;
+
+  cache = alloc->calloc(alloc->baton, sizeof(sln_session_cache_t));
+  cache->alloc = alloc;
+  cache->store = store;
+  cache->baton = baton;
+
+  *p_cache = cache;
+
+  return SELENE_SUCCESS;
+}
+
+void sln_session_cache_destroy(sln_session_cache_t *cache) {
+  selene_alloc_t *alloc = cache->alloc;
+
+  cache->store->destroy(cache->baton);
+
+  alloc->free(alloc->baton, cache);
+}
+
+void sln_session_cache_put(sln_session_cache_t *cache, const char *key,
+                           size_t keylen, const selene_session_t *session) {
+  if (keylen > SLN_SESSION_KEY_MAX_LENGTH) {
+    return;
+  }
+
+  cache->store->put(cache->baton, key, keylen, session);
+}
+
+int sln_session_cache_get(sln_session_cache_t *cache, const char *key,
+                          size_t keylen, int64_t now,
+                          selene_session_t *session) {
+  if (keylen > SLN_SESSION_KEY_MAX_LENGTH) {
+    return 0;
+  }
+
+  return cache->store->get(cache->baton, key, keylen, now, session);
+}
+
+void sln_session_cache_remove(sln_session_cache_t *cache, const char *key,
+                              size_t keylen) {
+  if (keylen > SLN_SESSION_KEY_MAX_LENGTH) {
+    return;
+  }
+
+  cache->store->remove(cache->baton, key, keylen);
+}
+
+void sln_session_cache_stats(sln_session_cache_t *cache, size_t *hits,
+                             size_t *misses, size_t *evictions) {
+  cache->store->stats(cache->baton, hits, misses, evictions);
+}
+
+void sln_session_state_write(const selene_session_t *session,
+                             unsigned char *out) {
+  uint64_t created = (uint64_t)session->created;
+  int i;
+
+  out[0] = session->version_major;
+  out[1] = session->version_minor;
+  out[2] = (unsigned int)session->suite >> 8;
+  out[3] = (unsigned int)session->suite;
+  for (i = 0; i < 8; i++) {
+    out[4 + i] = created >> (56 - 8 * i);
+  }
+  memcpy(out + 12, session->master_secret, SLN_SESSION_SECRET_LENGTH);
+}
+
+void sln_session_state_read(const unsigned char *in,
+                            selene_session_t *session) {
+  uint64_t created = 0;
+  int i;
+
+  session->version_major = in[0];
+  session->version_minor = in[1];
+  session->suite = (selene_cipher_suite_e)(in[2] << 8 | in[3]);
+  for (i = 0; i < 8; i++) {
+    created = created << 8 | in[4 + i];
+  }
+  session->created = (int64_t)created;
+  memcpy(session->master_secret, in + 12, SLN_SESSION_SECRET_LENGTH);
+}
+
+selene_error_t *selene_session_get(selene_t *s, selene_session_t **p_session) {
+  selene_alloc_t *alloc = s->conf->alloc;
+  selene_session_t *session;
+
+  if (s->session == NULL) {
+    *p_session = NULL;
+    return SELENE_SUCCESS;
+  }
+
+  session = alloc->malloc(alloc->baton, sizeof(selene_session_t));
+  memcpy(session, s->session, sizeof(selene_session_t));
+  session->alloc = alloc;
+  session->chain = NULL;
+
+  *p_session = session;
+
+  return SELENE_SUCCESS;
+}
+
+void selene_session_id(const selene_session_t *session, const char **id,
+                       size_t *len) {
+  *id = session->id;
+  *len = session->id_len;
+}
+
+selene_error_t *selene_session_export(const selene_session_t *session,
+                                      char *buf, size_t *len) {
+  unsigned char *out = (unsigned char *)buf;
+
+  out[0] = SLN_SESSION_EXPORT_VERSION;
+  out[1] = session->id_len;
+  memcpy(out + 2, session->id, SLN_SESSION_ID_MAX_LENGTH);
+  sln_session_state_write(session, out + 2 + SLN_SESSION_ID_MAX_LENGTH);
+
+  *len = SELENE_SESSION_EXPORT_LENGTH;
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *selene_session_import(selene_conf_t *conf, const char *buf,
+                                      size_t len,
+                                      selene_session_t **p_session) {
+  const unsigned char *in = (const unsigned char *)buf;
+  selene_alloc_t *alloc = conf->alloc;
+  selene_session_t *session;
+
+  if (len != SELENE_SESSION_EXPORT_LENGTH ||
+      in[0] != SLN_SESSION_EXPORT_VERSION ||
+      in[1] > SLN_SESSION_ID_MAX_LENGTH) {
+    return selene_error_create(SELENE_EINVAL, "Not an exported session");
+  }
+
+  session = alloc->calloc(alloc->baton, sizeof(selene_session_t));
+  session->alloc = alloc;
+  session->id_len = in[1];
+  memcpy(session->id, in + 2, session->id_len);
+  sln_session_state_read(in + 2 + SLN_SESSION_ID_MAX_LENGTH, session);
+
+  *p_session = session;
+
+  return SELENE_SUCCESS;
+}
+
+void selene_session_destroy(selene_session_t *session) {
+  selene_alloc_t *alloc = session->alloc;
+
+  memset(session, 0, sizeof(selene_session_t));
+  alloc->free(alloc->baton, session);
+}
+
+int selene_session_resumed(selene_t *s) { return s->session_resumed; }
@@ -0,0 +1,405 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "sln_types.h"
+#include "sln_sessions.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+#define SHM_MAGIC (0x534c4e53U)
+/* Bumped whenever the layout of the region or of selene_session_t changes */
+#define SHM_VERSION (1)
+/* Slots per shard, a key lives in one of the slots of its shard */
+#define SHM_WAYS (8)
+
+/**
+ * Slots are written under the lock of their shard, and read without it: seq
+ * is odd while a writer is in the slot, and moves on once it is done, so a
+ * reader that saw the same even seq before and after copying the slot out
+ * copied a whole one.
+ */
+typedef struct {
+  uint32_t seq;
+  uint32_t hash;
+  uint8_t key_len;
+  uint8_t used;
+  /* Looked up since the CLOCK hand last passed, set by readers too */
+  uint8_t referenced;
+  char key[SLN_SESSION_KEY_MAX_LENGTH];
+  selene_session_t session;
+} shm_slot_t;
+
+typedef struct {
+  uint32_t lock;
+  uint32_t hand;
+  uint64_t hits;
+  uint64_t misses;
+  uint64_t evictions;
+  shm_slot_t slots[SHM_WAYS];
+} shm_shard_t;
+
+/* Starts the region, so that processes mapping a file agree on its layout */
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t nshards;
+  uint32_t slot_size;
+} shm_header_t;
+
+#define SHM_HEADER_SIZE (64)
+
+typedef struct {
+  selene_alloc_t *alloc;
+  int timeout;
+  uint32_t mask;
+  void *region;
+  size_t region_len;
+  shm_shard_t *shards;
+} shm_cache_t;
+
+/* Another process may hold it, so it spins, yielding now and then rather
+ * than sleeping in the kernel */
+static void shard_lock(shm_shard_t *shard) {
+  int spins = 0;
+
+  while (__atomic_exchange_n(&shard->lock, 1, __ATOMIC_ACQUIRE) != 0) {
+    while (__atomic_load_n(&shard->lock, __ATOMIC_RELAXED) != 0) {
+      if (++spins == 64) {
+        spins = 0;
+        sched_yield();
+      }
+    }
+  }
+}
+
+static void shard_unlock(shm_shard_t *shard) {
+  __atomic_store_n(&shard->lock, 0, __ATOMIC_RELEASE);
+}
+
+static void slot_write_begin(shm_slot_t *slot) {
+  __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void slot_write_end(shm_slot_t *slot) {
+  __atomic_store_n(&slot->seq, slot->seq + 1, __ATOMIC_RELEASE);
+}
+
+static shm_shard_t *shard_of(shm_cache_t *cache, uint32_t hash) {
+  return &cache->shards[hash & cache->mask];
+}
+
+static int slot_matches(shm_slot_t *slot, uint32_t hash, const char *key,
+                        size_t keylen) {
+  return slot->used && slot->hash == hash && slot->key_len == keylen &&
+         memcmp(slot->key, key, keylen) == 0;
+}
+
+static int slot_expired(shm_cache_t *cache, shm_slot_t *slot, int64_t now) {
+  return now - slot->session.created >= cache->timeout;
+}
+
+/* Picks the slot of shard for a new session, on the second pass at the
+ * latest.  Called with the shard locked. */
+static shm_slot_t *slot_victim(shm_cache_t *cache, shm_shard_t *shard,
+                               int64_t now) {
+  shm_slot_t *slot;
+  int i;
+
+  for (i = 0; i < SHM_WAYS; i++) {
+    if (!shard->slots[i].used) {
+      return &shard->slots[i];
+    }
+  }
+
+  while (1) {
+    slot = &shard->slots[shard->hand];
+    shard->hand = (shard->hand + 1) % SHM_WAYS;
+
+    if (slot_expired(cache, slot, now)) {
+      return slot;
+    }
+
+    if (!__atomic_load_n(&slot->referenced, __ATOMIC_RELAXED)) {
+      shard->evictions++;
+      return slot;
+    }
+
+    __atomic_store_n(&slot->referenced, 0, __ATOMIC_RELAXED);
+  }
+}
+
+static void shm_put(void *baton, const char *key, size_t keylen,
+                    const selene_session_t *session) {
+  shm_cache_t *cache = baton;
+  uint32_t hash = sln_session_key_hash(key, keylen);
+  shm_shard_t *shard = shard_of(cache, hash);
+  shm_slot_t *slot = NULL;
+  int i;
+
+  shard_lock(shard);
+
+  for (i = 0; i < SHM_WAYS; i++) {
+    if (slot_matches(&shard->slots[i], hash, key, keylen)) {
+      slot = &shard->slots[i];
+      break;
+    }
+  }
+
+  if (slot == NULL) {
+    slot = slot_victim(cache, shard, session->created);
+  }
+
+  slot_write_begin(slot);
+  slot->hash = hash;
+  slot->key_len = keylen;
+  memcpy(slot->key, key, keylen);
+  slot->used = 1;
+  __atomic_store_n(&slot->referenced, 0, __ATOMIC_RELAXED);
+  memcpy(&slot->session, session, sizeof(selene_session_t));
+  /* pointers mean nothing in the other processes */
+  slot->session.alloc = NULL;
+  slot->session.chain = NULL;
+  slot_write_end(slot);
+
+  shard_unlock(shard);
+}
+
+static int shm_get(void *baton, const char *key, size_t keylen, int64_t now,
+                   selene_session_t *session) {
+  shm_cache_t *cache = baton;
+  uint32_t hash = sln_session_key_hash(key, keylen);
+  shm_shard_t *shard = shard_of(cache, hash);
+  shm_slot_t *slot;
+  uint32_t seq;
+  int found = 0;
+  int i;
+
+  for (i = 0; i < SHM_WAYS && !found; i++) {
+    slot = &shard->slots[i];
+
+    do {
+      seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      if (seq & 1) {
+        continue;
+      }
+      found = slot_matches(slot, hash, key, keylen);
+      if (found) {
+        memcpy(session, &slot->session, sizeof(selene_session_t));
+      }
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq);
+  }
+
+  /* expired sessions wait for a writer to take their slot */
+  if (found && now - session->created >= cache->timeout) {
+    memset(session, 0, sizeof(*session));
+    found = 0;
+  }
+
+  if (found) {
+    __atomic_store_n(&slot->referenced, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&shard->hits, 1, __ATOMIC_RELAXED);
+  } else {
+    __atomic_fetch_add(&shard->misses, 1, __ATOMIC_RELAXED);
+  }
+
+  return found;
+}
+
+static void shm_remove(void *baton, const char *key, size_t keylen) {
+  shm_cache_t *cache = baton;
+  uint32_t hash = sln_session_key_hash(key, keylen);
+  shm_shard_t *shard = shard_of(cache, hash);
+  shm_slot_t *slot;
+  int i;
+
+  shard_lock(shard);
+
+  for (i = 0; i < SHM_WAYS; i++) {
+    slot = &shard->slots[i];
+    if (slot_matches(slot, hash, key, keylen)) {
+      slot_write_begin(slot);
+      slot->used = 0;
+      slot->key_len = 0;
+      memset(slot->key, 0, sizeof(slot->key));
+      memset(&slot->session, 0, sizeof(slot->session));
+      slot_write_end(slot);
+    }
+  }
+
+  shard_unlock(shard);
+}
+
+static void shm_stats(void *baton, size_t *hits, size_t *misses,
+                      size_t *evictions) {
+  shm_cache_t *cache = baton;
+  uint32_t i;
+
+  *hits = 0;
+  *misses = 0;
+  *evictions = 0;
+
+  for (i = 0; i <= cache->mask; i++) {
+    shm_shard_t *shard = &cache->shards[i];
+    *hits += __atomic_load_n(&shard->hits, __ATOMIC_RELAXED);
+    *misses += __atomic_load_n(&shard->misses, __ATOMIC_RELAXED);
+    *evictions += __atomic_load_n(&shard->evictions, __ATOMIC_RELAXED);
+  }
+}
+
+/* Only unmaps, the sessions stay for the other processes */
+static void shm_destroy(void *baton) {
+  shm_cache_t *cache = baton;
+  selene_alloc_t *alloc = cache->alloc;
+
+  munmap(cache->region, cache->region_len);
+
+  alloc->free(alloc->baton, cache);
+}
+
+static const sln_session_store_t shm_store = {
+    "shared", shm_destroy, shm_put, shm_get, shm_remove, shm_stats};
+
+/* Maps the file at path, laying out an empty one.  Takes an exclusive flock
+ * meanwhile, so that only one process lays it out. */
+static selene_error_t *map_file(const char *path, shm_header_t *want,
+                                size_t len, void **p_region) {
+  selene_error_t *err = SELENE_SUCCESS;
+  shm_header_t *header;
+  struct stat st;
+  void *region;
+  int fd;
+
+  fd = open(path, O_RDWR | O_CREAT, 0600);
+  if (fd == -1) {
+    return selene_error_createf(SELENE_EIO, "Unable to open %s: %s", path,
+                                strerror(errno));
+  }
+
+  if (flock(fd, LOCK_EX) == -1 || fstat(fd, &st) == -1) {
+    err = selene_error_createf(SELENE_EIO, "Unable to lock %s: %s", path,
+                               strerror(errno));
+    goto out;
+  }
+
+  if (st.st_size == 0 && ftruncate(fd, len) == -1) {
+    err = selene_error_createf(SELENE_EIO, "Unable to size %s: %s", path,
+                               strerror(errno));
+    goto out;
+  }
+
+  if (st.st_size != 0 && (size_t)st.st_size != len) {
+    err = selene_error_createf(SELENE_EINVAL,
+                               "Session cache %s was made for another "
+                               "number of sessions",
+                               path);
+    goto out;
+  }
+
+  region = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (region == MAP_FAILED) {
+    err = selene_error_createf(SELENE_EIO, "Unable to map %s: %s", path,
+                               strerror(errno));
+    goto out;
+  }
+
+  header = region;
+  if (st.st_size == 0) {
+    memcpy(header, want, sizeof(*want));
+  } else if (memcmp(header, want, sizeof(*want)) != 0) {
+    munmap(region, len);
+    err = selene_error_createf(SELENE_EINVAL,
+                               "Session cache %s was made by another "
+                               "version of Selene",
+                               path);
+    goto out;
+  }
+
+  *p_region = region;
+
+out:
+  /* the mapping holds on to the file, so closing would not drop the lock */
+  flock(fd, LOCK_UN);
+  close(fd);
+  return err;
+}
+
+selene_error_t *sln_session_cache_create_shared(selene_alloc_t *alloc,
+                                                int max_sessions, int timeout,
+                                                const char *path,
+                                                sln_session_cache_t **p_cache) {
+  shm_cache_t *cache;
+  shm_header_t header;
+  uint32_t nshards = 1;
+  size_t len;
+  void *region = NULL;
+
+  if (max_sessions <= 0 || timeout <= 0) {
+    return selene_error_createf(SELENE_EINVAL,
+                                "Invalid session cache: %d sessions for %d "
+                                "seconds",
+                                max_sessions, timeout);
+  }
+
+  while (nshards * SHM_WAYS < (uint32_t)max_sessions) {
+    nshards <<= 1;
+  }
+
+  memset(&header, 0, sizeof(header));
+  header.magic = SHM_MAGIC;
+  header.version = SHM_VERSION;
+  header.nshards = nshards;
+  header.slot_size = sizeof(shm_slot_t);
+
+  len = SHM_HEADER_SIZE + sizeof(shm_shard_t) * nshards;
+
+  if (path != NULL) {
+    SELENE_ERR(map_file(path, &header, len, &region));
+  } else {
+    /* zeroed, which is every shard unlocked and every slot free */
+    region = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (region == MAP_FAILED) {
+      return selene_error_createf(SELENE_ENOMEM,
+                                  "Unable to map %d sessions: %s",
+                                  max_sessions, strerror(errno));
+    }
+    memcpy(region, &header, sizeof(header));
+  }
+
+  cache = alloc->calloc(alloc->baton, sizeof(shm_cache_t));
+  cache->alloc = alloc;
+  cache->timeout = timeout;
+  cache->mask = nshards - 1;
+  cache->region = region;
+  cache->region_len = len;
+  cache->shards = (shm_shard_t *)((char *)region + SHM_HEADER_SIZE);
+
+  return sln_session_cache_create_store(alloc, &shm_store, cache, p_cache);
+}
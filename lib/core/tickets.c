@@ -0,0 +1,212 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "sln_types.h"
+#include "sln_aead.h"
+#include "sln_sessions.h"
+#include "sln_tickets.h"
+#include <openssl/rand.h>
+#include <string.h>
+
+/**
+ * Readers only ever load the pointer, rotation swaps it in one go.  They
+ * count themselves in ticket_readers around the load and the copy of the key
+ * they need, so a rotation that finds itself alone knows nobody holds a
+ * generation older than the one it published.  Sequentially consistent, so
+ * that either the rotation sees the reader, or the reader the rotation.
+ */
+static sln_ticket_keys_t *keys_enter(selene_conf_t *conf) {
+  __atomic_add_fetch(&conf->ticket_readers, 1, __ATOMIC_SEQ_CST);
+  return __atomic_load_n(&conf->ticket_keys, __ATOMIC_SEQ_CST);
+}
+
+static void keys_leave(selene_conf_t *conf) {
+  __atomic_sub_fetch(&conf->ticket_readers, 1, __ATOMIC_SEQ_CST);
+}
+
+static void keys_free(selene_alloc_t *alloc, sln_ticket_keys_t *keys) {
+  sln_ticket_keys_t *older;
+
+  while (keys != NULL) {
+    older = keys->older;
+    memset(keys, 0, sizeof(*keys));
+    alloc->free(alloc->baton, keys);
+    keys = older;
+  }
+}
+
+selene_error_t *sln_ticket_keys_rotate(selene_conf_t *conf, const char *key) {
+  selene_alloc_t *alloc = conf->alloc;
+  sln_ticket_keys_t *keys;
+  sln_ticket_keys_t *old;
+  sln_ticket_key_t fresh;
+
+  if (key != NULL) {
+    memcpy(&fresh, key, sizeof(fresh));
+  } else if (RAND_bytes((unsigned char *)&fresh, sizeof(fresh)) != 1) {
+    return selene_error_create(SELENE_EIO,
+                               "Unable to generate a session ticket key");
+  }
+
+  keys = alloc->calloc(alloc->baton, sizeof(sln_ticket_keys_t));
+  memcpy(&keys->current, &fresh, sizeof(fresh));
+  memset(&fresh, 0, sizeof(fresh));
+
+  old = keys_enter(conf);
+  do {
+    /* retried with whatever another rotation published meanwhile */
+    if (old != NULL) {
+      memcpy(&keys->previous, &old->current, sizeof(keys->previous));
+      keys->have_previous = 1;
+    }
+    keys->older = old;
+  } while (!__atomic_compare_exchange_n(&conf->ticket_keys, &old, keys, 0,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+
+  /* Alone, every reader from now on finds keys or a newer generation, which
+   * carries the key they need as previous.  Otherwise a later rotation
+   * frees these. */
+  if (__atomic_load_n(&conf->ticket_readers, __ATOMIC_SEQ_CST) == 1) {
+    keys_free(alloc, __atomic_exchange_n(&keys->older, NULL,
+                                         __ATOMIC_SEQ_CST));
+  }
+
+  keys_leave(conf);
+
+  return SELENE_SUCCESS;
+}
+
+void sln_ticket_keys_destroy(selene_conf_t *conf) {
+  keys_free(conf->alloc, conf->ticket_keys);
+
+  conf->ticket_keys = NULL;
+}
+
+selene_error_t *sln_ticket_seal(selene_t *s, const selene_session_t *session,
+                                char *ticket) {
+  sln_ticket_keys_t *keys;
+  sln_ticket_key_t key;
+  char *nonce = ticket + SLN_TICKET_KEY_NAME_LENGTH;
+  char *state = nonce + SLN_AEAD_NONCE_LENGTH;
+  sln_aead_t *aead = NULL;
+  selene_error_t *err;
+
+  keys = keys_enter(s->conf);
+  if (keys != NULL) {
+    memcpy(&key, &keys->current, sizeof(key));
+  }
+  keys_leave(s->conf);
+
+  if (keys == NULL) {
+    return selene_error_create(SELENE_EINVAL, "No session ticket key set");
+  }
+
+  if (RAND_bytes((unsigned char *)nonce, SLN_AEAD_NONCE_LENGTH) != 1) {
+    memset(&key, 0, sizeof(key));
+    return selene_error_create(SELENE_EIO,
+                               "Unable to generate a session ticket nonce");
+  }
+
+  memcpy(ticket, key.name, SLN_TICKET_KEY_NAME_LENGTH);
+  sln_session_state_write(session, (unsigned char *)state);
+
+  err = sln_aead_create(s, SLN_AEAD_AES_256_GCM, key.key, &aead);
+  memset(&key, 0, sizeof(key));
+  if (err) {
+    return err;
+  }
+
+  err = sln_aead_seal(aead, nonce, ticket, SLN_TICKET_KEY_NAME_LENGTH, state,
+                      SLN_TICKET_STATE_LENGTH, state + SLN_TICKET_STATE_LENGTH);
+
+  sln_aead_destroy(aead);
+
+  return err;
+}
+
+selene_error_t *sln_ticket_open(selene_t *s, const char *ticket, size_t len,
+                                int64_t now, selene_session_t *session,
+                                int *valid, int *renew) {
+  sln_ticket_keys_t *keys;
+  const char *nonce = ticket + SLN_TICKET_KEY_NAME_LENGTH;
+  char key[SLN_TICKET_KEY_LENGTH];
+  char state[SLN_TICKET_STATE_LENGTH];
+  sln_aead_t *aead = NULL;
+  selene_error_t *err;
+  int found = 0;
+
+  *valid = 0;
+  *renew = 0;
+
+  if (len != SLN_TICKET_LENGTH) {
+    return SELENE_SUCCESS;
+  }
+
+  keys = keys_enter(s->conf);
+  if (keys != NULL &&
+      memcmp(ticket, keys->current.name, SLN_TICKET_KEY_NAME_LENGTH) == 0) {
+    memcpy(key, keys->current.key, sizeof(key));
+    found = 1;
+  } else if (keys != NULL && keys->have_previous &&
+             memcmp(ticket, keys->previous.name,
+                    SLN_TICKET_KEY_NAME_LENGTH) == 0) {
+    memcpy(key, keys->previous.key, sizeof(key));
+    found = 1;
+    *renew = 1;
+  }
+  keys_leave(s->conf);
+
+  if (!found) {
+    return SELENE_SUCCESS;
+  }
+
+  memcpy(state, nonce + SLN_AEAD_NONCE_LENGTH, sizeof(state));
+
+  err = sln_aead_create(s, SLN_AEAD_AES_256_GCM, key, &aead);
+  memset(key, 0, sizeof(key));
+  if (err) {
+    return err;
+  }
+
+  err = sln_aead_open(aead, nonce, ticket, SLN_TICKET_KEY_NAME_LENGTH, state,
+                      sizeof(state), nonce + SLN_AEAD_NONCE_LENGTH +
+                                         SLN_TICKET_STATE_LENGTH);
+
+  sln_aead_destroy(aead);
+
+  if (err) {
+    /* forged, or sealed by someone else */
+    selene_error_clear(err);
+    memset(state, 0, sizeof(state));
+    return SELENE_SUCCESS;
+  }
+
+  memset(session, 0, sizeof(*session));
+  sln_session_state_read((unsigned char *)state, session);
+  memset(state, 0, sizeof(state));
+
+  if (now < session->created ||
+      now - session->created >= s->conf->ticket_lifetime) {
+    memset(session, 0, sizeof(*session));
+    return SELENE_SUCCESS;
+  }
+
+  *valid = 1;
+
+  return SELENE_SUCCESS;
+}
@@ -0,0 +1,217 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_workers.h"
+#include "sln_assert.h"
+#include <pthread.h>
+
+typedef struct sln_workers_batch_t sln_workers_batch_t;
+
+struct sln_workers_batch_t {
+  sln_workers_batch_t *next;
+  sln_workers_job_cb *cb;
+  void *baton;
+  size_t njobs;
+  /* next job to hand out */
+  size_t next_job;
+  size_t finished;
+};
+
+struct sln_workers_t {
+  selene_alloc_t *alloc;
+  pthread_mutex_t lock;
+  /* signalled when a batch is queued, or on shutdown */
+  pthread_cond_t work;
+  /* signalled when the last job of a batch finishes */
+  pthread_cond_t done;
+  /* batches with jobs left to hand out, oldest first */
+  sln_workers_batch_t *head;
+  sln_workers_batch_t *tail;
+  int stopping;
+  int nthreads;
+  pthread_t *threads;
+};
+
+typedef struct {
+  sln_workers_t *workers;
+  int lane;
+} worker_start_t;
+
+/* Called with the lock held, hands out the next job of batch, and takes
+ * batch off the queue once it has none left */
+static size_t take_job(sln_workers_t *w, sln_workers_batch_t *batch) {
+  sln_workers_batch_t *prev = NULL;
+  sln_workers_batch_t *b;
+  size_t job = batch->next_job++;
+
+  if (batch->next_job < batch->njobs) {
+    return job;
+  }
+
+  for (b = w->head; b != batch; b = b->next) {
+    prev = b;
+  }
+
+  if (prev == NULL) {
+    w->head = batch->next;
+  } else {
+    prev->next = batch->next;
+  }
+  if (w->tail == batch) {
+    w->tail = prev;
+  }
+
+  return job;
+}
+
+/* Called with the lock held, drops it while the job runs */
+static void run_job(sln_workers_t *w, sln_workers_batch_t *batch, size_t job,
+                    int lane) {
+  pthread_mutex_unlock(&w->lock);
+  batch->cb(batch->baton, job, lane);
+  pthread_mutex_lock(&w->lock);
+
+  batch->finished++;
+  if (batch->finished == batch->njobs) {
+    pthread_cond_broadcast(&w->done);
+  }
+}
+
+static void *worker_main(void *arg) {
+  worker_start_t *start = arg;
+  sln_workers_t *w = start->workers;
+  int lane = start->lane;
+  sln_workers_batch_t *batch;
+  size_t job;
+
+  w->alloc->free(w->alloc->baton, start);
+
+  pthread_mutex_lock(&w->lock);
+  while (!w->stopping) {
+    batch = w->head;
+    if (batch == NULL) {
+      pthread_cond_wait(&w->work, &w->lock);
+      continue;
+    }
+    job = take_job(w, batch);
+    run_job(w, batch, job, lane);
+  }
+  pthread_mutex_unlock(&w->lock);
+
+  return NULL;
+}
+
+selene_error_t *sln_workers_create(selene_alloc_t *alloc, int threads,
+                                   sln_workers_t **p_workers) {
+  sln_workers_t *w;
+  worker_start_t *start;
+  int i;
+
+  SLN_ASSERT(threads > 0);
+
+  w = alloc->calloc(alloc->baton, sizeof(sln_workers_t));
+  w->alloc = alloc;
+  w->threads = alloc->calloc(alloc->baton, sizeof(pthread_t) * threads);
+  pthread_mutex_init(&w->lock, NULL);
+  pthread_cond_init(&w->work, NULL);
+  pthread_cond_init(&w->done, NULL);
+
+  for (i = 0; i < threads; i++) {
+    start = alloc->malloc(alloc->baton, sizeof(worker_start_t));
+    start->workers = w;
+    start->lane = i;
+    if (pthread_create(&w->threads[i], NULL, worker_main, start) != 0) {
+      alloc->free(alloc->baton, start);
+      sln_workers_destroy(w);
+      return selene_error_createf(SELENE_EIO,
+                                  "Unable to start worker thread %d", i);
+    }
+    w->nthreads++;
+  }
+
+  *p_workers = w;
+
+  return SELENE_SUCCESS;
+}
+
+void sln_workers_destroy(sln_workers_t *w) {
+  selene_alloc_t *alloc = w->alloc;
+  int i;
+
+  pthread_mutex_lock(&w->lock);
+  SLN_ASSERT(w->head == NULL);
+  w->stopping = 1;
+  pthread_cond_broadcast(&w->work);
+  pthread_mutex_unlock(&w->lock);
+
+  for (i = 0; i < w->nthreads; i++) {
+    pthread_join(w->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&w->done);
+  pthread_cond_destroy(&w->work);
+  pthread_mutex_destroy(&w->lock);
+
+  alloc->free(alloc->baton, w->threads);
+  alloc->free(alloc->baton, w);
+}
+
+int sln_workers_lanes(sln_workers_t *w) { return w->nthreads + 1; }
+
+void sln_workers_run(sln_workers_t *w, sln_workers_job_cb *cb, void *baton,
+                     size_t njobs) {
+  sln_workers_batch_t batch;
+  size_t job;
+
+  if (njobs == 0) {
+    return;
+  }
+
+  batch.next = NULL;
+  batch.cb = cb;
+  batch.baton = baton;
+  batch.njobs = njobs;
+  batch.next_job = 0;
+  batch.finished = 0;
+
+  pthread_mutex_lock(&w->lock);
+
+  if (w->tail == NULL) {
+    w->head = &batch;
+  } else {
+    w->tail->next = &batch;
+  }
+  w->tail = &batch;
+
+  if (njobs > 1) {
+    pthread_cond_broadcast(&w->work);
+  }
+
+  /* work on our own batch until all of it is handed out, then wait for the
+   * workers to finish the rest.  Only our own: the submitters' lane is
+   * shared, its state belongs to whoever submitted. */
+  while (batch.finished < batch.njobs) {
+    if (batch.next_job < batch.njobs) {
+      job = take_job(w, &batch);
+      run_job(w, &batch, job, w->nthreads);
+    } else {
+      pthread_cond_wait(&w->done, &w->lock);
+    }
+  }
+
+  pthread_mutex_unlock(&w->lock);
+}
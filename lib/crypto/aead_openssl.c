@@ -0,0 +1,131 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_types.h"
+#include "sln_aead.h"
+#include "sln_crypto.h"
+#include <openssl/evp.h>
+
+size_t sln_aead_key_length(sln_aead_e type) {
+  switch (type) {
+    case SLN_AEAD_AES_128_GCM:
+      return 16;
+    case SLN_AEAD_AES_256_GCM:
+    case SLN_AEAD_CHACHA20_POLY1305:
+      return 32;
+  }
+
+  /* unreached */
+  return 0;
+}
+
+selene_error_t *sln_aead_openssl_create(selene_t *s, sln_aead_e type,
+                                        const char *key, sln_aead_t **p_aead) {
+  sln_aead_t *aead;
+  const EVP_CIPHER *cipherType = NULL;
+  EVP_CIPHER_CTX *ctx;
+
+  cipherType = sln_crypto_openssl_aead(type);
+
+  if (cipherType == NULL) {
+    return selene_error_createf(SELENE_ENOTIMPL,
+                                "Unsupported AEAD type: %d", type);
+  }
+
+  ctx = EVP_CIPHER_CTX_new();
+
+  /* the key is set up once here, every message only sets its nonce */
+  if (ctx == NULL ||
+      EVP_CipherInit_ex(ctx, cipherType, NULL, NULL, NULL, 1) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_IVLEN, SLN_AEAD_NONCE_LENGTH,
+                          NULL) != 1 ||
+      EVP_CipherInit_ex(ctx, NULL, NULL, (const unsigned char *)key, NULL,
+                        -1) != 1) {
+    EVP_CIPHER_CTX_free(ctx);
+    return selene_error_createf(
+        SELENE_ENOTIMPL, "AEAD type %d is disabled in this OpenSSL", type);
+  }
+
+  aead = sln_alloc(s, sizeof(sln_aead_t));
+  aead->s = s;
+  aead->baton = ctx;
+  aead->type = type;
+  *p_aead = aead;
+
+  return SELENE_SUCCESS;
+}
+
+static int aead_start(EVP_CIPHER_CTX *ctx, const char *nonce, const char *aad,
+                      size_t aadlen, int enc) {
+  int outl;
+
+  if (EVP_CipherInit_ex(ctx, NULL, NULL, NULL, (const unsigned char *)nonce,
+                        enc) != 1) {
+    return 0;
+  }
+
+  return EVP_CipherUpdate(ctx, NULL, &outl, (const unsigned char *)aad,
+                          aadlen) == 1;
+}
+
+selene_error_t *sln_aead_openssl_seal(sln_aead_t *aead, const char *nonce,
+                                      const char *aad, size_t aadlen,
+                                      char *data, size_t len, char *tag) {
+  EVP_CIPHER_CTX *ctx = aead->baton;
+  unsigned char *p = (unsigned char *)data;
+  int outl;
+
+  if (!aead_start(ctx, nonce, aad, aadlen, 1) ||
+      EVP_CipherUpdate(ctx, p, &outl, p, len) != 1 ||
+      EVP_CipherFinal_ex(ctx, p + outl, &outl) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_GET_TAG, SLN_AEAD_TAG_LENGTH,
+                          tag) != 1) {
+    return selene_error_create(SELENE_EIO, "AEAD seal failed");
+  }
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_aead_openssl_open(sln_aead_t *aead, const char *nonce,
+                                      const char *aad, size_t aadlen,
+                                      char *data, size_t len,
+                                      const char *tag) {
+  EVP_CIPHER_CTX *ctx = aead->baton;
+  unsigned char *p = (unsigned char *)data;
+  int outl;
+
+  if (!aead_start(ctx, nonce, aad, aadlen, 0) ||
+      EVP_CipherUpdate(ctx, p, &outl, p, len) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_TAG, SLN_AEAD_TAG_LENGTH,
+                          (void *)tag) != 1) {
+    return selene_error_create(SELENE_EIO, "AEAD open failed");
+  }
+
+  if (EVP_CipherFinal_ex(ctx, p + outl, &outl) != 1) {
+    return selene_error_create(SELENE_EINVAL, "AEAD tag mismatch");
+  }
+
+  return SELENE_SUCCESS;
+}
+
+void sln_aead_openssl_destroy(sln_aead_t *aead) {
+  selene_t *s = aead->s;
+
+  EVP_CIPHER_CTX_free(aead->baton);
+
+  sln_free(s, aead);
+}
@@ -0,0 +1,31 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_types.h"
+#include "sln_digest.h"
+
+#ifndef sln_digest_update_many
+/* Backends without a multi-buffer path update one digest at a time */
+void sln_digest_update_many(sln_digest_t **digests, const void *const *data,
+                            const size_t *len, size_t count) {
+  size_t i;
+
+  for (i = 0; i < count; i++) {
+    sln_digest_update(digests[i], data[i], len[i]);
+  }
+}
+#endif
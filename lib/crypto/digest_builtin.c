@@ -0,0 +1,814 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_types.h"
+#include "sln_digest.h"
+#include "sln_assert.h"
+#include "digest_builtin.h"
+#include "sln_ct.h"
+#include <string.h>
+
+#define ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define ROTR64(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+/* 64 bit constants from two halves, gnu89 has no long long literals */
+#define U64(hi, lo) (((uint64_t)(hi##U) << 32) | (lo##U))
+
+#define LOAD32_LE(p)                                          \
+  ((uint32_t)(p)[0] | ((uint32_t)(p)[1] << 8) |                \
+   ((uint32_t)(p)[2] << 16) | ((uint32_t)(p)[3] << 24))
+#define LOAD32_BE(p)                                          \
+  (((uint32_t)(p)[0] << 24) | ((uint32_t)(p)[1] << 16) |       \
+   ((uint32_t)(p)[2] << 8) | (uint32_t)(p)[3])
+#define LOAD64_BE(p) \
+  (((uint64_t)LOAD32_BE(p) << 32) | (uint64_t)LOAD32_BE((p) + 4))
+
+static void store32_le(unsigned char *p, uint32_t v) {
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static void store32_be(unsigned char *p, uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static void store64_be(unsigned char *p, uint64_t v) {
+  store32_be(p, (uint32_t)(v >> 32));
+  store32_be(p + 4, (uint32_t)v);
+}
+
+/* RFC 1321 */
+#define F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define H(x, y, z) ((x) ^ (y) ^ (z))
+#define I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+#define MD5_STEP(f, a, b, c, d, x, t, s) \
+  do {                                   \
+    (a) += f((b), (c), (d)) + (x) + (t); \
+    (a) = ROTL32((a), (s));              \
+    (a) += (b);                          \
+  } while (0)
+
+void sln_md5_blocks_c(uint32_t *state, const unsigned char *data,
+                      size_t nblocks) {
+  uint32_t a, b, c, d;
+  uint32_t x[16];
+  int i;
+
+  while (nblocks--) {
+    for (i = 0; i < 16; i++) {
+      x[i] = LOAD32_LE(data + (i * 4));
+    }
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+
+    /* Round 1 */
+    MD5_STEP(F, a, b, c, d, x[0], 0xd76aa478, 7);
+    MD5_STEP(F, d, a, b, c, x[1], 0xe8c7b756, 12);
+    MD5_STEP(F, c, d, a, b, x[2], 0x242070db, 17);
+    MD5_STEP(F, b, c, d, a, x[3], 0xc1bdceee, 22);
+    MD5_STEP(F, a, b, c, d, x[4], 0xf57c0faf, 7);
+    MD5_STEP(F, d, a, b, c, x[5], 0x4787c62a, 12);
+    MD5_STEP(F, c, d, a, b, x[6], 0xa8304613, 17);
+    MD5_STEP(F, b, c, d, a, x[7], 0xfd469501, 22);
+    MD5_STEP(F, a, b, c, d, x[8], 0x698098d8, 7);
+    MD5_STEP(F, d, a, b, c, x[9], 0x8b44f7af, 12);
+    MD5_STEP(F, c, d, a, b, x[10], 0xffff5bb1, 17);
+    MD5_STEP(F, b, c, d, a, x[11], 0x895cd7be, 22);
+    MD5_STEP(F, a, b, c, d, x[12], 0x6b901122, 7);
+    MD5_STEP(F, d, a, b, c, x[13], 0xfd987193, 12);
+    MD5_STEP(F, c, d, a, b, x[14], 0xa679438e, 17);
+    MD5_STEP(F, b, c, d, a, x[15], 0x49b40821, 22);
+    /* Round 2 */
+    MD5_STEP(G, a, b, c, d, x[1], 0xf61e2562, 5);
+    MD5_STEP(G, d, a, b, c, x[6], 0xc040b340, 9);
+    MD5_STEP(G, c, d, a, b, x[11], 0x265e5a51, 14);
+    MD5_STEP(G, b, c, d, a, x[0], 0xe9b6c7aa, 20);
+    MD5_STEP(G, a, b, c, d, x[5], 0xd62f105d, 5);
+    MD5_STEP(G, d, a, b, c, x[10], 0x02441453, 9);
+    MD5_STEP(G, c, d, a, b, x[15], 0xd8a1e681, 14);
+    MD5_STEP(G, b, c, d, a, x[4], 0xe7d3fbc8, 20);
+    MD5_STEP(G, a, b, c, d, x[9], 0x21e1cde6, 5);
+    MD5_STEP(G, d, a, b, c, x[14], 0xc33707d6, 9);
+    MD5_STEP(G, c, d, a, b, x[3], 0xf4d50d87, 14);
+    MD5_STEP(G, b, c, d, a, x[8], 0x455a14ed, 20);
+    MD5_STEP(G, a, b, c, d, x[13], 0xa9e3e905, 5);
+    MD5_STEP(G, d, a, b, c, x[2], 0xfcefa3f8, 9);
+    MD5_STEP(G, c, d, a, b, x[7], 0x676f02d9, 14);
+    MD5_STEP(G, b, c, d, a, x[12], 0x8d2a4c8a, 20);
+    /* Round 3 */
+    MD5_STEP(H, a, b, c, d, x[5], 0xfffa3942, 4);
+    MD5_STEP(H, d, a, b, c, x[8], 0x8771f681, 11);
+    MD5_STEP(H, c, d, a, b, x[11], 0x6d9d6122, 16);
+    MD5_STEP(H, b, c, d, a, x[14], 0xfde5380c, 23);
+    MD5_STEP(H, a, b, c, d, x[1], 0xa4beea44, 4);
+    MD5_STEP(H, d, a, b, c, x[4], 0x4bdecfa9, 11);
+    MD5_STEP(H, c, d, a, b, x[7], 0xf6bb4b60, 16);
+    MD5_STEP(H, b, c, d, a, x[10], 0xbebfbc70, 23);
+    MD5_STEP(H, a, b, c, d, x[13], 0x289b7ec6, 4);
+    MD5_STEP(H, d, a, b, c, x[0], 0xeaa127fa, 11);
+    MD5_STEP(H, c, d, a, b, x[3], 0xd4ef3085, 16);
+    MD5_STEP(H, b, c, d, a, x[6], 0x04881d05, 23);
+    MD5_STEP(H, a, b, c, d, x[9], 0xd9d4d039, 4);
+    MD5_STEP(H, d, a, b, c, x[12], 0xe6db99e5, 11);
+    MD5_STEP(H, c, d, a, b, x[15], 0x1fa27cf8, 16);
+    MD5_STEP(H, b, c, d, a, x[2], 0xc4ac5665, 23);
+    /* Round 4 */
+    MD5_STEP(I, a, b, c, d, x[0], 0xf4292244, 6);
+    MD5_STEP(I, d, a, b, c, x[7], 0x432aff97, 10);
+    MD5_STEP(I, c, d, a, b, x[14], 0xab9423a7, 15);
+    MD5_STEP(I, b, c, d, a, x[5], 0xfc93a039, 21);
+    MD5_STEP(I, a, b, c, d, x[12], 0x655b59c3, 6);
+    MD5_STEP(I, d, a, b, c, x[3], 0x8f0ccc92, 10);
+    MD5_STEP(I, c, d, a, b, x[10], 0xffeff47d, 15);
+    MD5_STEP(I, b, c, d, a, x[1], 0x85845dd1, 21);
+    MD5_STEP(I, a, b, c, d, x[8], 0x6fa87e4f, 6);
+    MD5_STEP(I, d, a, b, c, x[15], 0xfe2ce6e0, 10);
+    MD5_STEP(I, c, d, a, b, x[6], 0xa3014314, 15);
+    MD5_STEP(I, b, c, d, a, x[13], 0x4e0811a1, 21);
+    MD5_STEP(I, a, b, c, d, x[4], 0xf7537e82, 6);
+    MD5_STEP(I, d, a, b, c, x[11], 0xbd3af235, 10);
+    MD5_STEP(I, c, d, a, b, x[2], 0x2ad7d2bb, 15);
+    MD5_STEP(I, b, c, d, a, x[9], 0xeb86d391, 21);
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+
+    data += 64;
+  }
+}
+
+/* FIPS 180-4 */
+void sln_sha1_blocks_c(uint32_t *state, const unsigned char *data,
+                       size_t nblocks) {
+  uint32_t a, b, c, d, e, t;
+  uint32_t w[16];
+  int i;
+
+  while (nblocks--) {
+    for (i = 0; i < 16; i++) {
+      w[i] = LOAD32_BE(data + (i * 4));
+    }
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+
+    for (i = 0; i < 80; i++) {
+      if (i >= 16) {
+        t = w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15];
+        w[i & 15] = ROTL32(t, 1);
+      }
+
+      if (i < 20) {
+        t = (d ^ (b & (c ^ d))) + 0x5a827999;
+      } else if (i < 40) {
+        t = (b ^ c ^ d) + 0x6ed9eba1;
+      } else if (i < 60) {
+        t = ((b & c) | (d & (b | c))) + 0x8f1bbcdc;
+      } else {
+        t = (b ^ c ^ d) + 0xca62c1d6;
+      }
+
+      t += ROTL32(a, 5) + e + w[i & 15];
+      e = d;
+      d = c;
+      c = ROTL32(b, 30);
+      b = a;
+      a = t;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+
+    data += 64;
+  }
+}
+
+const uint32_t sln_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+void sln_sha256_blocks_c(uint32_t *state, const unsigned char *data,
+                         size_t nblocks) {
+  uint32_t a, b, c, d, e, f, g, h, t1, t2;
+  uint32_t w[16];
+  int i;
+
+  while (nblocks--) {
+    for (i = 0; i < 16; i++) {
+      w[i] = LOAD32_BE(data + (i * 4));
+    }
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+
+    for (i = 0; i < 64; i++) {
+      if (i >= 16) {
+        t1 = w[(i + 14) & 15];
+        t2 = w[(i + 1) & 15];
+        w[i & 15] += (ROTR32(t1, 17) ^ ROTR32(t1, 19) ^ (t1 >> 10)) +
+                     w[(i + 9) & 15] +
+                     (ROTR32(t2, 7) ^ ROTR32(t2, 18) ^ (t2 >> 3));
+      }
+
+      t1 = h + (ROTR32(e, 6) ^ ROTR32(e, 11) ^ ROTR32(e, 25)) +
+           (g ^ (e & (f ^ g))) + sln_sha256_k[i] + w[i & 15];
+      t2 = (ROTR32(a, 2) ^ ROTR32(a, 13) ^ ROTR32(a, 22)) +
+           ((a & b) | (c & (a | b)));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+
+    data += 64;
+  }
+}
+
+static const uint64_t sha512_k[80] = {
+    U64(0x428a2f98, 0xd728ae22), U64(0x71374491, 0x23ef65cd),
+    U64(0xb5c0fbcf, 0xec4d3b2f), U64(0xe9b5dba5, 0x8189dbbc),
+    U64(0x3956c25b, 0xf348b538), U64(0x59f111f1, 0xb605d019),
+    U64(0x923f82a4, 0xaf194f9b), U64(0xab1c5ed5, 0xda6d8118),
+    U64(0xd807aa98, 0xa3030242), U64(0x12835b01, 0x45706fbe),
+    U64(0x243185be, 0x4ee4b28c), U64(0x550c7dc3, 0xd5ffb4e2),
+    U64(0x72be5d74, 0xf27b896f), U64(0x80deb1fe, 0x3b1696b1),
+    U64(0x9bdc06a7, 0x25c71235), U64(0xc19bf174, 0xcf692694),
+    U64(0xe49b69c1, 0x9ef14ad2), U64(0xefbe4786, 0x384f25e3),
+    U64(0x0fc19dc6, 0x8b8cd5b5), U64(0x240ca1cc, 0x77ac9c65),
+    U64(0x2de92c6f, 0x592b0275), U64(0x4a7484aa, 0x6ea6e483),
+    U64(0x5cb0a9dc, 0xbd41fbd4), U64(0x76f988da, 0x831153b5),
+    U64(0x983e5152, 0xee66dfab), U64(0xa831c66d, 0x2db43210),
+    U64(0xb00327c8, 0x98fb213f), U64(0xbf597fc7, 0xbeef0ee4),
+    U64(0xc6e00bf3, 0x3da88fc2), U64(0xd5a79147, 0x930aa725),
+    U64(0x06ca6351, 0xe003826f), U64(0x14292967, 0x0a0e6e70),
+    U64(0x27b70a85, 0x46d22ffc), U64(0x2e1b2138, 0x5c26c926),
+    U64(0x4d2c6dfc, 0x5ac42aed), U64(0x53380d13, 0x9d95b3df),
+    U64(0x650a7354, 0x8baf63de), U64(0x766a0abb, 0x3c77b2a8),
+    U64(0x81c2c92e, 0x47edaee6), U64(0x92722c85, 0x1482353b),
+    U64(0xa2bfe8a1, 0x4cf10364), U64(0xa81a664b, 0xbc423001),
+    U64(0xc24b8b70, 0xd0f89791), U64(0xc76c51a3, 0x0654be30),
+    U64(0xd192e819, 0xd6ef5218), U64(0xd6990624, 0x5565a910),
+    U64(0xf40e3585, 0x5771202a), U64(0x106aa070, 0x32bbd1b8),
+    U64(0x19a4c116, 0xb8d2d0c8), U64(0x1e376c08, 0x5141ab53),
+    U64(0x2748774c, 0xdf8eeb99), U64(0x34b0bcb5, 0xe19b48a8),
+    U64(0x391c0cb3, 0xc5c95a63), U64(0x4ed8aa4a, 0xe3418acb),
+    U64(0x5b9cca4f, 0x7763e373), U64(0x682e6ff3, 0xd6b2b8a3),
+    U64(0x748f82ee, 0x5defb2fc), U64(0x78a5636f, 0x43172f60),
+    U64(0x84c87814, 0xa1f0ab72), U64(0x8cc70208, 0x1a6439ec),
+    U64(0x90befffa, 0x23631e28), U64(0xa4506ceb, 0xde82bde9),
+    U64(0xbef9a3f7, 0xb2c67915), U64(0xc67178f2, 0xe372532b),
+    U64(0xca273ece, 0xea26619c), U64(0xd186b8c7, 0x21c0c207),
+    U64(0xeada7dd6, 0xcde0eb1e), U64(0xf57d4f7f, 0xee6ed178),
+    U64(0x06f067aa, 0x72176fba), U64(0x0a637dc5, 0xa2c898a6),
+    U64(0x113f9804, 0xbef90dae), U64(0x1b710b35, 0x131c471b),
+    U64(0x28db77f5, 0x23047d84), U64(0x32caab7b, 0x40c72493),
+    U64(0x3c9ebe0a, 0x15c9bebc), U64(0x431d67c4, 0x9c100d4c),
+    U64(0x4cc5d4be, 0xcb3e42b6), U64(0x597f299c, 0xfc657e2a),
+    U64(0x5fcb6fab, 0x3ad6faec), U64(0x6c44198c, 0x4a475817)};
+
+void sln_sha512_blocks_c(uint64_t *state, const unsigned char *data,
+                         size_t nblocks) {
+  uint64_t a, b, c, d, e, f, g, h, t1, t2;
+  uint64_t w[16];
+  int i;
+
+  while (nblocks--) {
+    for (i = 0; i < 16; i++) {
+      w[i] = LOAD64_BE(data + (i * 8));
+    }
+
+    a = state[0];
+    b = state[1];
+    c = state[2];
+    d = state[3];
+    e = state[4];
+    f = state[5];
+    g = state[6];
+    h = state[7];
+
+    for (i = 0; i < 80; i++) {
+      if (i >= 16) {
+        t1 = w[(i + 14) & 15];
+        t2 = w[(i + 1) & 15];
+        w[i & 15] += (ROTR64(t1, 19) ^ ROTR64(t1, 61) ^ (t1 >> 6)) +
+                     w[(i + 9) & 15] +
+                     (ROTR64(t2, 1) ^ ROTR64(t2, 8) ^ (t2 >> 7));
+      }
+
+      t1 = h + (ROTR64(e, 14) ^ ROTR64(e, 18) ^ ROTR64(e, 41)) +
+           (g ^ (e & (f ^ g))) + sha512_k[i] + w[i & 15];
+      t2 = (ROTR64(a, 28) ^ ROTR64(a, 34) ^ ROTR64(a, 39)) +
+           ((a & b) | (c & (a | b)));
+      h = g;
+      g = f;
+      f = e;
+      e = d + t1;
+      d = c;
+      c = b;
+      b = a;
+      a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+
+    data += 128;
+  }
+}
+
+typedef void(sln_md_blocks_fn)(uint32_t *state, const unsigned char *data,
+                               size_t nblocks);
+typedef void(sln_md_x8_fn)(uint32_t **state, const unsigned char **data,
+                           size_t nblocks);
+
+/* Picked by sln_digest_builtin_initialize, before any selene_t exists */
+static sln_md_blocks_fn *sha1_blocks = sln_sha1_blocks_c;
+static sln_md_blocks_fn *sha256_blocks = sln_sha256_blocks_c;
+static sln_md_x8_fn *x8_blocks[SLN_DIGEST_SHA384 + 1];
+
+void sln_digest_builtin_initialize(void) {
+#ifdef SLN_DIGEST_X86
+  int shani = sln_cpu_has_shani();
+
+  if (shani) {
+    sha1_blocks = sln_sha1_blocks_shani;
+    sha256_blocks = sln_sha256_blocks_shani;
+  }
+
+  /* a single SHA-NI stream keeps up with 8 AVX2 lanes, so the multi-buffer
+   * kernels only pay off where there are no SHA instructions, and for MD5 */
+  if (sln_cpu_has_avx2()) {
+    x8_blocks[SLN_DIGEST_MD5] = sln_md5_x8_avx2;
+    if (!shani) {
+      x8_blocks[SLN_DIGEST_SHA1] = sln_sha1_x8_avx2;
+      x8_blocks[SLN_DIGEST_SHA256] = sln_sha256_x8_avx2;
+    }
+  }
+#endif
+}
+
+size_t sln_md_length(sln_digest_e type) {
+  switch (type) {
+    case SLN_DIGEST_MD5:
+      return SLN_MD5_DIGEST_LENGTH;
+    case SLN_DIGEST_SHA1:
+      return SLN_SHA1_DIGEST_LENGTH;
+    case SLN_DIGEST_SHA256:
+      return SLN_SHA256_DIGEST_LENGTH;
+    case SLN_DIGEST_SHA384:
+      return SLN_SHA384_DIGEST_LENGTH;
+  }
+
+  /* unreached */
+  return 0;
+}
+
+size_t sln_md_block_size(sln_digest_e type) {
+  return type == SLN_DIGEST_SHA384 ? 128 : 64;
+}
+
+static void md_blocks(sln_md_t *md, const unsigned char *data,
+                      size_t nblocks) {
+  switch (md->type) {
+    case SLN_DIGEST_MD5:
+      sln_md5_blocks_c(md->h.w, data, nblocks);
+      break;
+    case SLN_DIGEST_SHA1:
+      sha1_blocks(md->h.w, data, nblocks);
+      break;
+    case SLN_DIGEST_SHA256:
+      sha256_blocks(md->h.w, data, nblocks);
+      break;
+    case SLN_DIGEST_SHA384:
+      sln_sha512_blocks_c(md->h.d, data, nblocks);
+      break;
+  }
+}
+
+void sln_md_init(sln_md_t *md, sln_digest_e type) {
+  md->type = type;
+  md->total = 0;
+  md->used = 0;
+
+  switch (type) {
+    case SLN_DIGEST_MD5:
+      md->h.w[0] = 0x67452301;
+      md->h.w[1] = 0xefcdab89;
+      md->h.w[2] = 0x98badcfe;
+      md->h.w[3] = 0x10325476;
+      break;
+    case SLN_DIGEST_SHA1:
+      md->h.w[0] = 0x67452301;
+      md->h.w[1] = 0xefcdab89;
+      md->h.w[2] = 0x98badcfe;
+      md->h.w[3] = 0x10325476;
+      md->h.w[4] = 0xc3d2e1f0;
+      break;
+    case SLN_DIGEST_SHA256:
+      md->h.w[0] = 0x6a09e667;
+      md->h.w[1] = 0xbb67ae85;
+      md->h.w[2] = 0x3c6ef372;
+      md->h.w[3] = 0xa54ff53a;
+      md->h.w[4] = 0x510e527f;
+      md->h.w[5] = 0x9b05688c;
+      md->h.w[6] = 0x1f83d9ab;
+      md->h.w[7] = 0x5be0cd19;
+      break;
+    case SLN_DIGEST_SHA384:
+      md->h.d[0] = U64(0xcbbb9d5d, 0xc1059ed8);
+      md->h.d[1] = U64(0x629a292a, 0x367cd507);
+      md->h.d[2] = U64(0x9159015a, 0x3070dd17);
+      md->h.d[3] = U64(0x152fecd8, 0xf70e5939);
+      md->h.d[4] = U64(0x67332667, 0xffc00b31);
+      md->h.d[5] = U64(0x8eb44a87, 0x68581511);
+      md->h.d[6] = U64(0xdb0c2e0d, 0x64f98fa7);
+      md->h.d[7] = U64(0x47b5481d, 0xbefa4fa4);
+      break;
+  }
+}
+
+void sln_md_update(sln_md_t *md, const void *data, size_t len) {
+  const unsigned char *p = data;
+  size_t bs = sln_md_block_size(md->type);
+  size_t n;
+
+  md->total += len;
+
+  if (md->used != 0) {
+    n = bs - md->used < len ? bs - md->used : len;
+    memcpy(md->buf + md->used, p, n);
+    md->used += n;
+    p += n;
+    len -= n;
+
+    if (md->used < bs) {
+      return;
+    }
+
+    md_blocks(md, md->buf, 1);
+    md->used = 0;
+  }
+
+  if (len >= bs) {
+    n = len / bs;
+    md_blocks(md, p, n);
+    p += n * bs;
+    len -= n * bs;
+  }
+
+  if (len != 0) {
+    memcpy(md->buf, p, len);
+    md->used = len;
+  }
+}
+
+static void md_output(sln_md_t *md, unsigned char *out) {
+  int i;
+
+  switch (md->type) {
+    case SLN_DIGEST_MD5:
+      for (i = 0; i < 4; i++) {
+        store32_le(out + (i * 4), md->h.w[i]);
+      }
+      break;
+    case SLN_DIGEST_SHA1:
+    case SLN_DIGEST_SHA256:
+      for (i = 0; i < (int)sln_md_length(md->type) / 4; i++) {
+        store32_be(out + (i * 4), md->h.w[i]);
+      }
+      break;
+    case SLN_DIGEST_SHA384:
+      for (i = 0; i < 6; i++) {
+        store64_be(out + (i * 8), md->h.d[i]);
+      }
+      break;
+  }
+}
+
+/* The length block of a message of total bytes, as the tail of a block */
+static void md_length(sln_md_t *md, uint64_t total, unsigned char *out) {
+  size_t lenbytes = sln_md_block_size(md->type) == 128 ? 16 : 8;
+  uint64_t bits = total * 8;
+
+  memset(out, 0, lenbytes);
+
+  if (md->type == SLN_DIGEST_MD5) {
+    store32_le(out, (uint32_t)bits);
+    store32_le(out + 4, (uint32_t)(bits >> 32));
+  } else {
+    store64_be(out + lenbytes - 8, bits);
+  }
+}
+
+void sln_md_final(sln_md_t *md, unsigned char *out) {
+  size_t bs = sln_md_block_size(md->type);
+  /* SHA-384 ends in a 128 bit length, of which the top half stays 0 */
+  size_t lenbytes = bs == 128 ? 16 : 8;
+
+  md->buf[md->used++] = 0x80;
+
+  if (md->used > bs - lenbytes) {
+    memset(md->buf + md->used, 0, bs - md->used);
+    md_blocks(md, md->buf, 1);
+    md->used = 0;
+  }
+
+  memset(md->buf + md->used, 0, bs - md->used);
+  md_length(md, md->total, md->buf + bs - lenbytes);
+
+  md_blocks(md, md->buf, 1);
+
+  md_output(md, out);
+}
+
+void sln_md_final_ct(sln_md_t *md, const void *data, size_t len,
+                     size_t maxlen, unsigned char *out) {
+  const unsigned char *p = data;
+  size_t bs = sln_md_block_size(md->type);
+  size_t lenbytes = bs == 128 ? 16 : 8;
+  size_t used = md->used;
+  /* where the message ends and the block its length goes in, counting from
+   * the start of buf; both secret */
+  size_t end = used + len;
+  size_t last = (end + lenbytes) / bs;
+  /* the blocks a message of maxlen needs, and the first one whose bytes
+   * depend on len; both public */
+  size_t nblocks = (used + maxlen + lenbytes) / bs + 1;
+  size_t start = (used + (maxlen > 255 ? maxlen - 255 : 0)) / bs;
+  unsigned char block[SLN_MD_MAX_BLOCK_SIZE];
+  unsigned char lenblock[16];
+  uint64_t h[8];
+  size_t k;
+  size_t j;
+  size_t i;
+  size_t past;
+  size_t mask;
+  int w;
+
+  md_length(md, md->total + len, lenblock);
+
+  /* blocks that are all message whatever len is go through as usual */
+  if (start > 0) {
+    memcpy(block, md->buf, used);
+    memcpy(block + used, p, bs - used);
+    md_blocks(md, block, 1);
+    md_blocks(md, p + bs - used, start - 1);
+  }
+
+  memset(h, 0, sizeof(h));
+
+  for (k = start; k < nblocks; k++) {
+    for (j = 0; j < bs; j++) {
+      i = (k * bs) + j;
+      if (i < used) {
+        block[j] = md->buf[i];
+      } else if (i - used < maxlen) {
+        block[j] = p[i - used];
+      } else {
+        block[j] = 0;
+      }
+
+      /* past the end, 0x80 and zeros, and the length at the end of the last
+       * block */
+      past = SLN_CT_GE(i, end);
+      block[j] = (block[j] & ~past) | (0x80 & SLN_CT_EQ(i, end));
+      if (j >= bs - lenbytes) {
+        mask = SLN_CT_EQ(k, last);
+        block[j] = (block[j] & ~mask) | (lenblock[j - (bs - lenbytes)] & mask);
+      }
+    }
+
+    md_blocks(md, block, 1);
+
+    /* keep the state after the last block, the later ones are for show */
+    mask = SLN_CT_EQ(k, last);
+    for (w = 0; w < 8; w++) {
+      h[w] |= md->h.d[w] & ((uint64_t)0 - (mask & 1));
+    }
+  }
+
+  memcpy(md->h.d, h, sizeof(h));
+  memset(block, 0, sizeof(block));
+
+  md_output(md, out);
+}
+
+void sln_md_update_many(sln_md_t **mds, const void *const *data,
+                        const size_t *len, size_t count) {
+  sln_md_x8_fn *x8;
+  uint32_t *state[8];
+  uint32_t dummy[8];
+  const unsigned char *lanep[8];
+  const unsigned char *p[8];
+  size_t left[8];
+  size_t bs;
+  size_t base;
+  size_t nblocks;
+  size_t take;
+  size_t n;
+  size_t i;
+  int active[8];
+  int nactive;
+
+  if (count == 0) {
+    return;
+  }
+
+  x8 = x8_blocks[mds[0]->type];
+  bs = sln_md_block_size(mds[0]->type);
+  memset(dummy, 0, sizeof(dummy));
+
+  for (base = 0; base < count; base += 8) {
+    n = count - base < 8 ? count - base : 8;
+
+    /* top up the partial blocks first, so the lanes start block aligned */
+    for (i = 0; i < n; i++) {
+      sln_md_t *md = mds[base + i];
+
+      SLN_ASSERT(md->type == mds[0]->type);
+
+      p[i] = data[base + i];
+      left[i] = len[base + i];
+
+      if (md->used != 0) {
+        take = bs - md->used < left[i] ? bs - md->used : left[i];
+        sln_md_update(md, p[i], take);
+        p[i] += take;
+        left[i] -= take;
+      }
+    }
+
+    while (x8 != NULL) {
+      nactive = 0;
+      nblocks = 0;
+      for (i = 0; i < n; i++) {
+        if (left[i] >= bs) {
+          if (nactive == 0 || left[i] / bs < nblocks) {
+            nblocks = left[i] / bs;
+          }
+          active[nactive++] = i;
+        }
+      }
+
+      if (nactive < 2) {
+        break;
+      }
+
+      /* idle lanes hash the first active lane's data into a scratch state */
+      for (i = 0; i < 8; i++) {
+        state[i] = dummy;
+        lanep[i] = p[active[0]];
+      }
+      for (i = 0; i < (size_t)nactive; i++) {
+        state[i] = mds[base + active[i]]->h.w;
+        lanep[i] = p[active[i]];
+      }
+
+      x8(state, lanep, nblocks);
+
+      for (i = 0; i < (size_t)nactive; i++) {
+        mds[base + active[i]]->total += nblocks * bs;
+        p[active[i]] += nblocks * bs;
+        left[active[i]] -= nblocks * bs;
+      }
+    }
+
+    for (i = 0; i < n; i++) {
+      sln_md_update(mds[base + i], p[i], left[i]);
+    }
+  }
+}
+
+typedef struct sln_digest_builtin_t {
+  sln_digest_t d;
+  sln_md_t md;
+} sln_digest_builtin_t;
+
+selene_error_t *sln_digest_builtin_create(selene_t *s, sln_digest_e type,
+                                          sln_digest_t **p_digest) {
+  sln_digest_builtin_t *db = sln_alloc(s, sizeof(sln_digest_builtin_t));
+
+  db->d.s = s;
+  db->d.type = type;
+  db->d.baton = &db->md;
+  sln_md_init(&db->md, type);
+
+  *p_digest = &db->d;
+
+  return SELENE_SUCCESS;
+}
+
+void sln_digest_builtin_update(sln_digest_t *d, const void *data,
+                               size_t len) {
+  sln_md_update(d->baton, data, len);
+}
+
+void sln_digest_builtin_update_many(sln_digest_t **digests,
+                                    const void *const *data,
+                                    const size_t *len, size_t count) {
+  sln_md_t *mds[8];
+  size_t base;
+  size_t n;
+  size_t i;
+
+  for (base = 0; base < count; base += 8) {
+    n = count - base < 8 ? count - base : 8;
+    for (i = 0; i < n; i++) {
+      mds[i] = digests[base + i]->baton;
+    }
+    sln_md_update_many(mds, data + base, len + base, n);
+  }
+}
+
+void sln_digest_builtin_final(sln_digest_t *d, unsigned char *md) {
+  sln_md_final(d->baton, md);
+}
+
+selene_error_t *sln_digest_builtin_copy(sln_digest_t *d,
+                                        sln_digest_t **p_copy) {
+  sln_digest_builtin_t *db = sln_alloc(d->s, sizeof(sln_digest_builtin_t));
+
+  db->d.s = d->s;
+  db->d.type = d->type;
+  db->d.baton = &db->md;
+  memcpy(&db->md, d->baton, sizeof(sln_md_t));
+
+  *p_copy = &db->d;
+
+  return SELENE_SUCCESS;
+}
+
+void sln_digest_builtin_destroy(sln_digest_t *d) {
+  sln_free(d->s, d);
+}
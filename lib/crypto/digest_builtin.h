@@ -0,0 +1,100 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _sln_digest_builtin_h_
+#define _sln_digest_builtin_h_
+
+#include "sln_types.h"
+#include <stdint.h>
+
+/**
+ * The hash functions behind the built-in digest and HMAC backends.  The
+ * block functions are plain C, with SHA-NI and AVX2 versions picked at
+ * runtime by sln_digest_builtin_initialize where the CPU has them.
+ */
+
+#define SLN_MD_MAX_BLOCK_SIZE (128)
+
+typedef struct sln_md_t {
+  sln_digest_e type;
+  union {
+    uint32_t w[8];
+    uint64_t d[8];
+  } h;
+  /* bytes hashed so far, including the ones waiting in buf */
+  uint64_t total;
+  size_t used;
+  unsigned char buf[SLN_MD_MAX_BLOCK_SIZE];
+} sln_md_t;
+
+size_t sln_md_length(sln_digest_e type);
+size_t sln_md_block_size(sln_digest_e type);
+
+void sln_md_init(sln_md_t *md, sln_digest_e type);
+void sln_md_update(sln_md_t *md, const void *data, size_t len);
+void sln_md_final(sln_md_t *md, unsigned char *out);
+
+/**
+ * Hashes the first len of the maxlen bytes at data and finishes, without len
+ * showing in the time taken or the memory read: every block a message of up
+ * to maxlen bytes needs is hashed, and the state after the one that really
+ * ends it is picked out with masks.  For MACs of CBC records, whose length
+ * depends on the padding (Lucky 13).  len is at least maxlen - 255.
+ */
+void sln_md_final_ct(sln_md_t *md, const void *data, size_t len,
+                     size_t maxlen, unsigned char *out);
+
+/* Feeds data[i] to mds[i], all of the same type, running up to 8 of them
+ * through the SIMD lanes at once where a multi-buffer kernel is in use */
+void sln_md_update_many(sln_md_t **mds, const void *const *data,
+                        const size_t *len, size_t count);
+
+/* Block functions, hashing nblocks whole blocks into state */
+void sln_md5_blocks_c(uint32_t *state, const unsigned char *data,
+                      size_t nblocks);
+void sln_sha1_blocks_c(uint32_t *state, const unsigned char *data,
+                       size_t nblocks);
+void sln_sha256_blocks_c(uint32_t *state, const unsigned char *data,
+                         size_t nblocks);
+void sln_sha512_blocks_c(uint64_t *state, const unsigned char *data,
+                         size_t nblocks);
+
+extern const uint32_t sln_sha256_k[64];
+
+#if defined(__x86_64__) && \
+    ((defined(__GNUC__) && __GNUC__ >= 5) || defined(__clang__))
+#define SLN_DIGEST_X86
+
+int sln_cpu_has_shani(void);
+int sln_cpu_has_avx2(void);
+
+void sln_sha1_blocks_shani(uint32_t *state, const unsigned char *data,
+                           size_t nblocks);
+void sln_sha256_blocks_shani(uint32_t *state, const unsigned char *data,
+                             size_t nblocks);
+
+/* Multi-buffer versions: nblocks blocks of each of 8 independent messages,
+ * data[i] going into state[i] */
+void sln_md5_x8_avx2(uint32_t **state, const unsigned char **data,
+                     size_t nblocks);
+void sln_sha1_x8_avx2(uint32_t **state, const unsigned char **data,
+                      size_t nblocks);
+void sln_sha256_x8_avx2(uint32_t **state, const unsigned char **data,
+                        size_t nblocks);
+#endif
+
+#endif
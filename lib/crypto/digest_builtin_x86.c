@@ -0,0 +1,759 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "digest_builtin.h"
+
+#ifdef SLN_DIGEST_X86
+
+#include <cpuid.h>
+#include <immintrin.h>
+
+/**
+ * The kernels are compiled for the instructions they use through target
+ * attributes, so the rest of the library keeps building for the baseline
+ * CPU, and they are only called once sln_cpu_has_* said they can be.
+ */
+
+#define SHANI __attribute__((target("sha,sse4.1,ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+int sln_cpu_has_shani(void) {
+  unsigned int a, b, c, d;
+
+  if (__get_cpuid_max(0, NULL) < 7) {
+    return 0;
+  }
+
+  __cpuid(1, a, b, c, d);
+  if (!(c & bit_SSSE3) || !(c & bit_SSE4_1)) {
+    return 0;
+  }
+
+  __cpuid_count(7, 0, a, b, c, d);
+  return (b >> 29) & 1;
+}
+
+int sln_cpu_has_avx2(void) {
+  unsigned int a, b, c, d;
+  unsigned int xcr0;
+  unsigned int xcr0_hi;
+
+  if (__get_cpuid_max(0, NULL) < 7) {
+    return 0;
+  }
+
+  /* the OS has to save the YMM registers too */
+  __cpuid(1, a, b, c, d);
+  if (!(c & bit_OSXSAVE) || !(c & bit_AVX)) {
+    return 0;
+  }
+  __asm__ __volatile__("xgetbv" : "=a"(xcr0), "=d"(xcr0_hi) : "c"(0));
+  if ((xcr0 & 6) != 6) {
+    return 0;
+  }
+
+  __cpuid_count(7, 0, a, b, c, d);
+  return (b >> 5) & 1;
+}
+
+#define LOAD_BE(p) _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(p)), mask)
+
+SHANI void sln_sha1_blocks_shani(uint32_t *state, const unsigned char *data,
+                                 size_t nblocks) {
+  const __m128i mask =
+      _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  __m128i abcd, abcd_save, e0, e0_save, e1;
+  __m128i msg0, msg1, msg2, msg3;
+
+  abcd = _mm_loadu_si128((const __m128i *)state);
+  abcd = _mm_shuffle_epi32(abcd, 0x1b);
+  e0 = _mm_set_epi32((int)state[4], 0, 0, 0);
+
+  while (nblocks--) {
+    abcd_save = abcd;
+    e0_save = e0;
+
+    /* Rounds 0-3 */
+    msg0 = LOAD_BE(data + 0);
+    e0 = _mm_add_epi32(e0, msg0);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+
+    /* Rounds 4-7 */
+    msg1 = LOAD_BE(data + 16);
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+
+    /* Rounds 8-11 */
+    msg2 = LOAD_BE(data + 32);
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    /* Rounds 12-15 */
+    msg3 = LOAD_BE(data + 48);
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 0);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    /* Rounds 16-19 */
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 0);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    /* Rounds 20-23 */
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    /* Rounds 24-27 */
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    /* Rounds 28-31 */
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    /* Rounds 32-35 */
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 1);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    /* Rounds 36-39 */
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 1);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    /* Rounds 40-43 */
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    /* Rounds 44-47 */
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    /* Rounds 48-51 */
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    /* Rounds 52-55 */
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 2);
+    msg0 = _mm_sha1msg1_epu32(msg0, msg1);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    /* Rounds 56-59 */
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 2);
+    msg1 = _mm_sha1msg1_epu32(msg1, msg2);
+    msg0 = _mm_xor_si128(msg0, msg2);
+
+    /* Rounds 60-63 */
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    msg0 = _mm_sha1msg2_epu32(msg0, msg3);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+    msg2 = _mm_sha1msg1_epu32(msg2, msg3);
+    msg1 = _mm_xor_si128(msg1, msg3);
+
+    /* Rounds 64-67 */
+    e0 = _mm_sha1nexte_epu32(e0, msg0);
+    e1 = abcd;
+    msg1 = _mm_sha1msg2_epu32(msg1, msg0);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+    msg3 = _mm_sha1msg1_epu32(msg3, msg0);
+    msg2 = _mm_xor_si128(msg2, msg0);
+
+    /* Rounds 68-71 */
+    e1 = _mm_sha1nexte_epu32(e1, msg1);
+    e0 = abcd;
+    msg2 = _mm_sha1msg2_epu32(msg2, msg1);
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+    msg3 = _mm_xor_si128(msg3, msg1);
+
+    /* Rounds 72-75 */
+    e0 = _mm_sha1nexte_epu32(e0, msg2);
+    e1 = abcd;
+    msg3 = _mm_sha1msg2_epu32(msg3, msg2);
+    abcd = _mm_sha1rnds4_epu32(abcd, e0, 3);
+
+    /* Rounds 76-79 */
+    e1 = _mm_sha1nexte_epu32(e1, msg3);
+    e0 = abcd;
+    abcd = _mm_sha1rnds4_epu32(abcd, e1, 3);
+
+    e0 = _mm_sha1nexte_epu32(e0, e0_save);
+    abcd = _mm_add_epi32(abcd, abcd_save);
+
+    data += 64;
+  }
+
+  abcd = _mm_shuffle_epi32(abcd, 0x1b);
+  _mm_storeu_si128((__m128i *)state, abcd);
+  state[4] = (uint32_t)_mm_extract_epi32(e0, 3);
+}
+
+#define K4(i) _mm_loadu_si128((const __m128i *)&sln_sha256_k[i])
+
+SHANI void sln_sha256_blocks_shani(uint32_t *state, const unsigned char *data,
+                                   size_t nblocks) {
+  const __m128i mask =
+      _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  __m128i state0, state1, abef_save, cdgh_save;
+  __m128i msg, tmp;
+  __m128i msg0, msg1, msg2, msg3;
+
+  /* the SHA instructions want the state as ABEF and CDGH */
+  tmp = _mm_loadu_si128((const __m128i *)&state[0]);
+  state1 = _mm_loadu_si128((const __m128i *)&state[4]);
+  tmp = _mm_shuffle_epi32(tmp, 0xb1);
+  state1 = _mm_shuffle_epi32(state1, 0x1b);
+  state0 = _mm_alignr_epi8(tmp, state1, 8);
+  state1 = _mm_blend_epi16(state1, tmp, 0xf0);
+
+  while (nblocks--) {
+    abef_save = state0;
+    cdgh_save = state1;
+
+    /* Rounds 0-3 */
+    msg0 = LOAD_BE(data + 0);
+    msg = _mm_add_epi32(msg0, K4(0));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    /* Rounds 4-7 */
+    msg1 = LOAD_BE(data + 16);
+    msg = _mm_add_epi32(msg1, K4(4));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+    /* Rounds 8-11 */
+    msg2 = LOAD_BE(data + 32);
+    msg = _mm_add_epi32(msg2, K4(8));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+    /* Rounds 12-15 */
+    msg3 = LOAD_BE(data + 48);
+    msg = _mm_add_epi32(msg3, K4(12));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg3, msg2, 4);
+    msg0 = _mm_add_epi32(msg0, tmp);
+    msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+    /* Rounds 16-19 */
+    msg = _mm_add_epi32(msg0, K4(16));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg0, msg3, 4);
+    msg1 = _mm_add_epi32(msg1, tmp);
+    msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+    /* Rounds 20-23 */
+    msg = _mm_add_epi32(msg1, K4(20));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg1, msg0, 4);
+    msg2 = _mm_add_epi32(msg2, tmp);
+    msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+    /* Rounds 24-27 */
+    msg = _mm_add_epi32(msg2, K4(24));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg2, msg1, 4);
+    msg3 = _mm_add_epi32(msg3, tmp);
+    msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+    /* Rounds 28-31 */
+    msg = _mm_add_epi32(msg3, K4(28));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg3, msg2, 4);
+    msg0 = _mm_add_epi32(msg0, tmp);
+    msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+    /* Rounds 32-35 */
+    msg = _mm_add_epi32(msg0, K4(32));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg0, msg3, 4);
+    msg1 = _mm_add_epi32(msg1, tmp);
+    msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+    /* Rounds 36-39 */
+    msg = _mm_add_epi32(msg1, K4(36));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg1, msg0, 4);
+    msg2 = _mm_add_epi32(msg2, tmp);
+    msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg0 = _mm_sha256msg1_epu32(msg0, msg1);
+
+    /* Rounds 40-43 */
+    msg = _mm_add_epi32(msg2, K4(40));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg2, msg1, 4);
+    msg3 = _mm_add_epi32(msg3, tmp);
+    msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg1 = _mm_sha256msg1_epu32(msg1, msg2);
+
+    /* Rounds 44-47 */
+    msg = _mm_add_epi32(msg3, K4(44));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg3, msg2, 4);
+    msg0 = _mm_add_epi32(msg0, tmp);
+    msg0 = _mm_sha256msg2_epu32(msg0, msg3);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg2 = _mm_sha256msg1_epu32(msg2, msg3);
+
+    /* Rounds 48-51 */
+    msg = _mm_add_epi32(msg0, K4(48));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg0, msg3, 4);
+    msg1 = _mm_add_epi32(msg1, tmp);
+    msg1 = _mm_sha256msg2_epu32(msg1, msg0);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    msg3 = _mm_sha256msg1_epu32(msg3, msg0);
+
+    /* Rounds 52-55 */
+    msg = _mm_add_epi32(msg1, K4(52));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg1, msg0, 4);
+    msg2 = _mm_add_epi32(msg2, tmp);
+    msg2 = _mm_sha256msg2_epu32(msg2, msg1);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    /* Rounds 56-59 */
+    msg = _mm_add_epi32(msg2, K4(56));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    tmp = _mm_alignr_epi8(msg2, msg1, 4);
+    msg3 = _mm_add_epi32(msg3, tmp);
+    msg3 = _mm_sha256msg2_epu32(msg3, msg2);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    /* Rounds 60-63 */
+    msg = _mm_add_epi32(msg3, K4(60));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    msg = _mm_shuffle_epi32(msg, 0x0e);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+
+    state0 = _mm_add_epi32(state0, abef_save);
+    state1 = _mm_add_epi32(state1, cdgh_save);
+
+    data += 64;
+  }
+
+  tmp = _mm_shuffle_epi32(state0, 0x1b);
+  state1 = _mm_shuffle_epi32(state1, 0xb1);
+  state0 = _mm_blend_epi16(tmp, state1, 0xf0);
+  state1 = _mm_alignr_epi8(state1, tmp, 8);
+  _mm_storeu_si128((__m128i *)&state[0], state0);
+  _mm_storeu_si128((__m128i *)&state[4], state1);
+}
+
+/* Multi-buffer kernels: every 32 bit lane of a YMM register belongs to a
+ * different message, so one instruction advances all 8 of them. */
+
+#define VADD(a, b) _mm256_add_epi32((a), (b))
+#define VXOR(a, b) _mm256_xor_si256((a), (b))
+#define VAND(a, b) _mm256_and_si256((a), (b))
+#define VOR(a, b) _mm256_or_si256((a), (b))
+#define VROTL(x, n) \
+  VOR(_mm256_slli_epi32((x), (n)), _mm256_srli_epi32((x), 32 - (n)))
+#define VROTR(x, n) VROTL((x), 32 - (n))
+#define VSET(k) _mm256_set1_epi32((int)(k))
+
+/* Turns 8 rows of 8 words into 8 columns */
+static AVX2 void transpose8(__m256i *r) {
+  __m256i t0, t1, t2, t3, t4, t5, t6, t7;
+  __m256i u0, u1, u2, u3, u4, u5, u6, u7;
+
+  t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+  t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+  t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+  t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+  t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+  t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+  t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+  t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+  u0 = _mm256_unpacklo_epi64(t0, t2);
+  u1 = _mm256_unpackhi_epi64(t0, t2);
+  u2 = _mm256_unpacklo_epi64(t1, t3);
+  u3 = _mm256_unpackhi_epi64(t1, t3);
+  u4 = _mm256_unpacklo_epi64(t4, t6);
+  u5 = _mm256_unpackhi_epi64(t4, t6);
+  u6 = _mm256_unpacklo_epi64(t5, t7);
+  u7 = _mm256_unpackhi_epi64(t5, t7);
+
+  r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+  r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+  r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+  r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+  r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+  r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+  r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+  r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+/* w[j] gets word j of the 64 byte block at data[lane] + off, for every lane,
+ * byte swapped for the big endian hashes */
+static AVX2 void load_block_x8(__m256i *w, const unsigned char **data,
+                               size_t off, int big_endian) {
+  const __m256i bswap = _mm256_set_epi8(
+      12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3, 12, 13, 14, 15, 8,
+      9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+  int half;
+  int i;
+
+  for (half = 0; half < 2; half++) {
+    for (i = 0; i < 8; i++) {
+      w[(half * 8) + i] =
+          _mm256_loadu_si256((const __m256i *)(data[i] + off + (half * 32)));
+    }
+    transpose8(w + (half * 8));
+  }
+
+  if (big_endian) {
+    for (i = 0; i < 16; i++) {
+      w[i] = _mm256_shuffle_epi8(w[i], bswap);
+    }
+  }
+}
+
+static AVX2 __m256i load_state_x8(uint32_t **state, int k) {
+  return _mm256_set_epi32((int)state[7][k], (int)state[6][k],
+                          (int)state[5][k], (int)state[4][k],
+                          (int)state[3][k], (int)state[2][k],
+                          (int)state[1][k], (int)state[0][k]);
+}
+
+static AVX2 void store_state_x8(uint32_t **state, int k, __m256i v) {
+  uint32_t t[8];
+  int i;
+
+  _mm256_storeu_si256((__m256i *)t, v);
+  for (i = 0; i < 8; i++) {
+    state[i][k] = t[i];
+  }
+}
+
+#define VF(x, y, z) VXOR((z), VAND((x), VXOR((y), (z))))
+#define VG(x, y, z) VXOR((y), VAND((z), VXOR((x), (y))))
+#define VH(x, y, z) VXOR(VXOR((x), (y)), (z))
+#define VI(x, y, z) VXOR((y), VOR((x), VXOR((z), ones)))
+
+#define MD5_VSTEP(f, a, b, c, d, x, t, s)          \
+  do {                                             \
+    (a) = VADD((a), VADD(VADD(f((b), (c), (d)), (x)), VSET(t))); \
+    (a) = VROTL((a), (s));                         \
+    (a) = VADD((a), (b));                          \
+  } while (0)
+
+AVX2 void sln_md5_x8_avx2(uint32_t **state, const unsigned char **data,
+                          size_t nblocks) {
+  const __m256i ones = _mm256_set1_epi32(-1);
+  __m256i a, b, c, d, sa, sb, sc, sd;
+  __m256i x[16];
+  size_t off;
+
+  a = load_state_x8(state, 0);
+  b = load_state_x8(state, 1);
+  c = load_state_x8(state, 2);
+  d = load_state_x8(state, 3);
+
+  for (off = 0; off < nblocks * 64; off += 64) {
+    load_block_x8(x, data, off, 0);
+
+    sa = a;
+    sb = b;
+    sc = c;
+    sd = d;
+
+      /* Round 1 */
+      MD5_VSTEP(VF, a, b, c, d, x[0], 0xd76aa478, 7);
+      MD5_VSTEP(VF, d, a, b, c, x[1], 0xe8c7b756, 12);
+      MD5_VSTEP(VF, c, d, a, b, x[2], 0x242070db, 17);
+      MD5_VSTEP(VF, b, c, d, a, x[3], 0xc1bdceee, 22);
+      MD5_VSTEP(VF, a, b, c, d, x[4], 0xf57c0faf, 7);
+      MD5_VSTEP(VF, d, a, b, c, x[5], 0x4787c62a, 12);
+      MD5_VSTEP(VF, c, d, a, b, x[6], 0xa8304613, 17);
+      MD5_VSTEP(VF, b, c, d, a, x[7], 0xfd469501, 22);
+      MD5_VSTEP(VF, a, b, c, d, x[8], 0x698098d8, 7);
+      MD5_VSTEP(VF, d, a, b, c, x[9], 0x8b44f7af, 12);
+      MD5_VSTEP(VF, c, d, a, b, x[10], 0xffff5bb1, 17);
+      MD5_VSTEP(VF, b, c, d, a, x[11], 0x895cd7be, 22);
+      MD5_VSTEP(VF, a, b, c, d, x[12], 0x6b901122, 7);
+      MD5_VSTEP(VF, d, a, b, c, x[13], 0xfd987193, 12);
+      MD5_VSTEP(VF, c, d, a, b, x[14], 0xa679438e, 17);
+      MD5_VSTEP(VF, b, c, d, a, x[15], 0x49b40821, 22);
+      /* Round 2 */
+      MD5_VSTEP(VG, a, b, c, d, x[1], 0xf61e2562, 5);
+      MD5_VSTEP(VG, d, a, b, c, x[6], 0xc040b340, 9);
+      MD5_VSTEP(VG, c, d, a, b, x[11], 0x265e5a51, 14);
+      MD5_VSTEP(VG, b, c, d, a, x[0], 0xe9b6c7aa, 20);
+      MD5_VSTEP(VG, a, b, c, d, x[5], 0xd62f105d, 5);
+      MD5_VSTEP(VG, d, a, b, c, x[10], 0x02441453, 9);
+      MD5_VSTEP(VG, c, d, a, b, x[15], 0xd8a1e681, 14);
+      MD5_VSTEP(VG, b, c, d, a, x[4], 0xe7d3fbc8, 20);
+      MD5_VSTEP(VG, a, b, c, d, x[9], 0x21e1cde6, 5);
+      MD5_VSTEP(VG, d, a, b, c, x[14], 0xc33707d6, 9);
+      MD5_VSTEP(VG, c, d, a, b, x[3], 0xf4d50d87, 14);
+      MD5_VSTEP(VG, b, c, d, a, x[8], 0x455a14ed, 20);
+      MD5_VSTEP(VG, a, b, c, d, x[13], 0xa9e3e905, 5);
+      MD5_VSTEP(VG, d, a, b, c, x[2], 0xfcefa3f8, 9);
+      MD5_VSTEP(VG, c, d, a, b, x[7], 0x676f02d9, 14);
+      MD5_VSTEP(VG, b, c, d, a, x[12], 0x8d2a4c8a, 20);
+      /* Round 3 */
+      MD5_VSTEP(VH, a, b, c, d, x[5], 0xfffa3942, 4);
+      MD5_VSTEP(VH, d, a, b, c, x[8], 0x8771f681, 11);
+      MD5_VSTEP(VH, c, d, a, b, x[11], 0x6d9d6122, 16);
+      MD5_VSTEP(VH, b, c, d, a, x[14], 0xfde5380c, 23);
+      MD5_VSTEP(VH, a, b, c, d, x[1], 0xa4beea44, 4);
+      MD5_VSTEP(VH, d, a, b, c, x[4], 0x4bdecfa9, 11);
+      MD5_VSTEP(VH, c, d, a, b, x[7], 0xf6bb4b60, 16);
+      MD5_VSTEP(VH, b, c, d, a, x[10], 0xbebfbc70, 23);
+      MD5_VSTEP(VH, a, b, c, d, x[13], 0x289b7ec6, 4);
+      MD5_VSTEP(VH, d, a, b, c, x[0], 0xeaa127fa, 11);
+      MD5_VSTEP(VH, c, d, a, b, x[3], 0xd4ef3085, 16);
+      MD5_VSTEP(VH, b, c, d, a, x[6], 0x04881d05, 23);
+      MD5_VSTEP(VH, a, b, c, d, x[9], 0xd9d4d039, 4);
+      MD5_VSTEP(VH, d, a, b, c, x[12], 0xe6db99e5, 11);
+      MD5_VSTEP(VH, c, d, a, b, x[15], 0x1fa27cf8, 16);
+      MD5_VSTEP(VH, b, c, d, a, x[2], 0xc4ac5665, 23);
+      /* Round 4 */
+      MD5_VSTEP(VI, a, b, c, d, x[0], 0xf4292244, 6);
+      MD5_VSTEP(VI, d, a, b, c, x[7], 0x432aff97, 10);
+      MD5_VSTEP(VI, c, d, a, b, x[14], 0xab9423a7, 15);
+      MD5_VSTEP(VI, b, c, d, a, x[5], 0xfc93a039, 21);
+      MD5_VSTEP(VI, a, b, c, d, x[12], 0x655b59c3, 6);
+      MD5_VSTEP(VI, d, a, b, c, x[3], 0x8f0ccc92, 10);
+      MD5_VSTEP(VI, c, d, a, b, x[10], 0xffeff47d, 15);
+      MD5_VSTEP(VI, b, c, d, a, x[1], 0x85845dd1, 21);
+      MD5_VSTEP(VI, a, b, c, d, x[8], 0x6fa87e4f, 6);
+      MD5_VSTEP(VI, d, a, b, c, x[15], 0xfe2ce6e0, 10);
+      MD5_VSTEP(VI, c, d, a, b, x[6], 0xa3014314, 15);
+      MD5_VSTEP(VI, b, c, d, a, x[13], 0x4e0811a1, 21);
+      MD5_VSTEP(VI, a, b, c, d, x[4], 0xf7537e82, 6);
+      MD5_VSTEP(VI, d, a, b, c, x[11], 0xbd3af235, 10);
+      MD5_VSTEP(VI, c, d, a, b, x[2], 0x2ad7d2bb, 15);
+      MD5_VSTEP(VI, b, c, d, a, x[9], 0xeb86d391, 21);
+
+    a = VADD(a, sa);
+    b = VADD(b, sb);
+    c = VADD(c, sc);
+    d = VADD(d, sd);
+  }
+
+  store_state_x8(state, 0, a);
+  store_state_x8(state, 1, b);
+  store_state_x8(state, 2, c);
+  store_state_x8(state, 3, d);
+}
+
+AVX2 void sln_sha1_x8_avx2(uint32_t **state, const unsigned char **data,
+                           size_t nblocks) {
+  __m256i v[5];
+  __m256i a, b, c, d, e, t;
+  __m256i w[16];
+  size_t off;
+  int i;
+
+  for (i = 0; i < 5; i++) {
+    v[i] = load_state_x8(state, i);
+  }
+
+  for (off = 0; off < nblocks * 64; off += 64) {
+    load_block_x8(w, data, off, 1);
+
+    a = v[0];
+    b = v[1];
+    c = v[2];
+    d = v[3];
+    e = v[4];
+
+    for (i = 0; i < 80; i++) {
+      if (i >= 16) {
+        t = VXOR(VXOR(w[(i + 13) & 15], w[(i + 8) & 15]),
+                 VXOR(w[(i + 2) & 15], w[i & 15]));
+        w[i & 15] = VROTL(t, 1);
+      }
+
+      if (i < 20) {
+        t = VADD(VXOR(d, VAND(b, VXOR(c, d))), VSET(0x5a827999));
+      } else if (i < 40) {
+        t = VADD(VXOR(VXOR(b, c), d), VSET(0x6ed9eba1));
+      } else if (i < 60) {
+        t = VADD(VOR(VAND(b, c), VAND(d, VOR(b, c))), VSET(0x8f1bbcdc));
+      } else {
+        t = VADD(VXOR(VXOR(b, c), d), VSET(0xca62c1d6));
+      }
+
+      t = VADD(VADD(t, VROTL(a, 5)), VADD(e, w[i & 15]));
+      e = d;
+      d = c;
+      c = VROTL(b, 30);
+      b = a;
+      a = t;
+    }
+
+    v[0] = VADD(v[0], a);
+    v[1] = VADD(v[1], b);
+    v[2] = VADD(v[2], c);
+    v[3] = VADD(v[3], d);
+    v[4] = VADD(v[4], e);
+  }
+
+  for (i = 0; i < 5; i++) {
+    store_state_x8(state, i, v[i]);
+  }
+}
+
+AVX2 void sln_sha256_x8_avx2(uint32_t **state, const unsigned char **data,
+                             size_t nblocks) {
+  __m256i v[8];
+  __m256i a, b, c, d, e, f, g, h, t1, t2;
+  __m256i w[16];
+  size_t off;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    v[i] = load_state_x8(state, i);
+  }
+
+  for (off = 0; off < nblocks * 64; off += 64) {
+    load_block_x8(w, data, off, 1);
+
+    a = v[0];
+    b = v[1];
+    c = v[2];
+    d = v[3];
+    e = v[4];
+    f = v[5];
+    g = v[6];
+    h = v[7];
+
+    for (i = 0; i < 64; i++) {
+      if (i >= 16) {
+        t1 = w[(i + 14) & 15];
+        t2 = w[(i + 1) & 15];
+        t1 = VXOR(VXOR(VROTR(t1, 17), VROTR(t1, 19)),
+                  _mm256_srli_epi32(t1, 10));
+        t2 = VXOR(VXOR(VROTR(t2, 7), VROTR(t2, 18)), _mm256_srli_epi32(t2, 3));
+        w[i & 15] = VADD(VADD(w[i & 15], t1), VADD(w[(i + 9) & 15], t2));
+      }
+
+      t1 = VADD(VADD(h, VXOR(VXOR(VROTR(e, 6), VROTR(e, 11)), VROTR(e, 25))),
+                VADD(VXOR(g, VAND(e, VXOR(f, g))),
+                     VADD(VSET(sln_sha256_k[i]), w[i & 15])));
+      t2 = VADD(VXOR(VXOR(VROTR(a, 2), VROTR(a, 13)), VROTR(a, 22)),
+                VOR(VAND(a, b), VAND(c, VOR(a, b))));
+      h = g;
+      g = f;
+      f = e;
+      e = VADD(d, t1);
+      d = c;
+      c = b;
+      b = a;
+      a = VADD(t1, t2);
+    }
+
+    v[0] = VADD(v[0], a);
+    v[1] = VADD(v[1], b);
+    v[2] = VADD(v[2], c);
+    v[3] = VADD(v[3], d);
+    v[4] = VADD(v[4], e);
+    v[5] = VADD(v[5], f);
+    v[6] = VADD(v[6], g);
+    v[7] = VADD(v[7], h);
+  }
+
+  for (i = 0; i < 8; i++) {
+    store_state_x8(state, i, v[i]);
+  }
+}
+
+#endif
@@ -17,30 +17,18 @@
 
 #include "sln_types.h"
 #include "sln_digest.h"
+#include "sln_crypto.h"
 
 selene_error_t *sln_digest_openssl_create(selene_t *s, sln_digest_e type,
                                           sln_digest_t **p_digest) {
   sln_digest_t *d = sln_alloc(s, sizeof(sln_digest_t));
-  EVP_MD_CTX *mdctx = EVP_MD_CTX_create();
-  const EVP_MD *mt = NULL;
+  EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
 
   d->s = s;
   d->type = type;
   d->baton = mdctx;
 
-  switch (d->type) {
-    case SLN_DIGEST_MD5: {
-      mt = EVP_md5();
-      break;
-    }
-    case SLN_DIGEST_SHA1: {
-      mt = EVP_sha1();
-      break;
-    }
-  }
-
-  EVP_MD_CTX_init(mdctx);
-  EVP_DigestInit_ex(mdctx, mt, NULL);
+  EVP_DigestInit_ex(mdctx, sln_crypto_openssl_digest(type), NULL);
 
   *p_digest = d;
 
@@ -57,11 +45,31 @@ void sln_digest_openssl_final(sln_digest_t *d, unsigned char *md) {
   EVP_DigestFinal_ex(mdctx, md, NULL);
 }
 
+selene_error_t *sln_digest_openssl_copy(sln_digest_t *d,
+                                        sln_digest_t **p_copy) {
+  sln_digest_t *c = sln_alloc(d->s, sizeof(sln_digest_t));
+  EVP_MD_CTX *mdctx = EVP_MD_CTX_new();
+
+  c->s = d->s;
+  c->type = d->type;
+  c->baton = mdctx;
+
+  if (mdctx == NULL || !EVP_MD_CTX_copy_ex(mdctx, d->baton)) {
+    EVP_MD_CTX_free(mdctx);
+    sln_free(d->s, c);
+    return selene_error_create(SELENE_ENOMEM, "EVP_MD_CTX_copy_ex failed");
+  }
+
+  *p_copy = c;
+
+  return SELENE_SUCCESS;
+}
+
 void sln_digest_openssl_destroy(sln_digest_t *d) {
   selene_t *s = d->s;
   EVP_MD_CTX *mdctx = d->baton;
 
-  EVP_MD_CTX_destroy(mdctx);
+  EVP_MD_CTX_free(mdctx);
 
   sln_free(s, d);
 }
@@ -20,6 +20,7 @@
 #include "sln_types.h"
 #include "sln_digest.h"
 #include <CommonCrypto/CommonDigest.h>
+#include <string.h>
 
 selene_error_t *sln_digest_osx_cc_create(selene_t *s, sln_digest_e type,
                                          sln_digest_t **p_digest) {
@@ -40,6 +41,18 @@ selene_error_t *sln_digest_osx_cc_create(selene_t *s, sln_digest_e type,
       d->baton = c;
       break;
     }
+    case SLN_DIGEST_SHA256: {
+      CC_SHA256_CTX *c = sln_alloc(s, sizeof(CC_SHA256_CTX));
+      CC_SHA256_Init(c);
+      d->baton = c;
+      break;
+    }
+    case SLN_DIGEST_SHA384: {
+      CC_SHA512_CTX *c = sln_alloc(s, sizeof(CC_SHA512_CTX));
+      CC_SHA384_Init(c);
+      d->baton = c;
+      break;
+    }
   }
 
   *p_digest = d;
@@ -56,6 +69,14 @@ void sln_digest_osx_cc_update(sln_digest_t *d, const void *data, size_t len) {
       CC_SHA1_Update((CC_SHA1_CTX *)d->baton, data, len);
       break;
     }
+    case SLN_DIGEST_SHA256: {
+      CC_SHA256_Update((CC_SHA256_CTX *)d->baton, data, len);
+      break;
+    }
+    case SLN_DIGEST_SHA384: {
+      CC_SHA384_Update((CC_SHA512_CTX *)d->baton, data, len);
+      break;
+    }
   }
 }
 
@@ -69,9 +90,47 @@ void sln_digest_osx_cc_final(sln_digest_t *d, unsigned char *md) {
       CC_SHA1_Final(md, (CC_SHA1_CTX *)d->baton);
       break;
     }
+    case SLN_DIGEST_SHA256: {
+      CC_SHA256_Final(md, (CC_SHA256_CTX *)d->baton);
+      break;
+    }
+    case SLN_DIGEST_SHA384: {
+      CC_SHA384_Final(md, (CC_SHA512_CTX *)d->baton);
+      break;
+    }
   }
 }
 
+selene_error_t *sln_digest_osx_cc_copy(sln_digest_t *d,
+                                       sln_digest_t **p_copy) {
+  size_t len = 0;
+  sln_digest_t *c = sln_alloc(d->s, sizeof(sln_digest_t));
+
+  switch (d->type) {
+    case SLN_DIGEST_MD5:
+      len = sizeof(CC_MD5_CTX);
+      break;
+    case SLN_DIGEST_SHA1:
+      len = sizeof(CC_SHA1_CTX);
+      break;
+    case SLN_DIGEST_SHA256:
+      len = sizeof(CC_SHA256_CTX);
+      break;
+    case SLN_DIGEST_SHA384:
+      len = sizeof(CC_SHA512_CTX);
+      break;
+  }
+
+  c->s = d->s;
+  c->type = d->type;
+  c->baton = sln_alloc(d->s, len);
+  memcpy(c->baton, d->baton, len);
+
+  *p_copy = c;
+
+  return SELENE_SUCCESS;
+}
+
 void sln_digest_osx_cc_destroy(sln_digest_t *d) {
   selene_t *s = d->s;
   sln_free(s, d->baton);
@@ -17,8 +17,7 @@
 
 #include "sln_types.h"
 #include "sln_hmac.h"
-#include <openssl/aes.h>
-#include <openssl/obj_mac.h>
+#include "sln_crypto.h"
 
 selene_error_t *sln_cryptor_openssl_create(selene_t *s, int encypt,
                                            sln_cipher_e type, const char *key,
@@ -28,33 +27,27 @@ selene_error_t *sln_cryptor_openssl_create(selene_t *s, int encypt,
   const EVP_CIPHER *cipherType = NULL;
   EVP_CIPHER_CTX *ctx;
 
-  switch (type) {
-    case SLN_CIPHER_AES_128_CBC:
-      cipherType = EVP_get_cipherbyname(SN_aes_128_cbc);
-      break;
-    case SLN_CIPHER_AES_256_CBC:
-      cipherType = EVP_get_cipherbyname(SN_aes_256_cbc);
-      break;
-    case SLN_CIPHER_RC4:
-      cipherType = EVP_get_cipherbyname(SN_rc4);
-      break;
-    default:
-      return selene_error_createf(SELENE_ENOTIMPL,
-                                  "Unsupported cipher type: %d", type);
-  }
+  cipherType = sln_crypto_openssl_cipher(type);
 
   if (cipherType == NULL) {
-    return selene_error_createf(
-        SELENE_ENOTIMPL,
-        "Unsupported cipher type (even though it should be): %d", type);
+    return selene_error_createf(SELENE_ENOTIMPL,
+                                "Unsupported cipher type: %d", type);
   }
 
-  ctx = sln_alloc(s, sizeof(EVP_CIPHER_CTX));
+  ctx = EVP_CIPHER_CTX_new();
 
   /* TODO: engine support (?) */
   /* TODO: encrypt/decrypt mode */
-  EVP_CipherInit_ex(ctx, cipherType, NULL, (const unsigned char *)key,
-                    (const unsigned char *)iv, encypt);
+  if (ctx == NULL ||
+      EVP_CipherInit_ex(ctx, cipherType, NULL, (const unsigned char *)key,
+                        (const unsigned char *)iv, encypt) != 1) {
+    EVP_CIPHER_CTX_free(ctx);
+    return selene_error_createf(
+        SELENE_ENOTIMPL, "Cipher type %d is disabled in this OpenSSL", type);
+  }
+  /* records are padded by the TLS layer, and a decrypting context must not
+   * hold back the last block waiting for padding */
+  EVP_CIPHER_CTX_set_padding(ctx, 0);
 
   enc = sln_alloc(s, sizeof(sln_cryptor_t));
   enc->s = s;
@@ -75,11 +68,16 @@ void sln_cryptor_openssl_encrypt(sln_cryptor_t *enc, const void *data,
   *blen = outl;
 }
 
+void sln_cryptor_openssl_set_iv(sln_cryptor_t *enc, const char *iv) {
+  EVP_CipherInit_ex(enc->baton, NULL, NULL, NULL, (const unsigned char *)iv,
+                    -1);
+}
+
 void sln_cryptor_openssl_destroy(sln_cryptor_t *enc) {
   selene_t *s = enc->s;
   EVP_CIPHER_CTX *ctx = enc->baton;
 
-  EVP_CIPHER_CTX_cleanup(ctx);
+  EVP_CIPHER_CTX_free(ctx);
 
   sln_free(s, enc);
 }
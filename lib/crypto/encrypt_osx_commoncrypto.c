@@ -84,6 +84,10 @@ void sln_cryptor_osx_cc_encrypt(sln_cryptor_t *enc, const void *data,
   CCCryptorUpdate(cryptor, data, len, buf, *blen, blen);
 }
 
+void sln_cryptor_osx_cc_set_iv(sln_cryptor_t *enc, const char *iv) {
+  CCCryptorReset(enc->baton, iv);
+}
+
 void sln_cryptor_osx_cc_destroy(sln_cryptor_t *enc) {
   selene_t *s = enc->s;
   CCCryptorRef cryptor = enc->baton;
@@ -22,6 +22,8 @@ size_t sln_hmac_length(sln_hmac_t *h) {
   switch (h->type) {
     case SLN_HMAC_MD5: { return SLN_MD5_DIGEST_LENGTH; }
     case SLN_HMAC_SHA1: { return SLN_SHA1_DIGEST_LENGTH; }
+    case SLN_HMAC_SHA256: { return SLN_SHA256_DIGEST_LENGTH; }
+    case SLN_HMAC_SHA384: { return SLN_SHA384_DIGEST_LENGTH; }
   }
 
   /* unreached */
@@ -0,0 +1,146 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_types.h"
+#include "sln_hmac.h"
+#include "digest_builtin.h"
+#include <string.h>
+
+/* RFC 2104, on top of the built-in hash functions.  The states after
+ * hashing the inner and outer pads are kept, so that a reset, which the PRF
+ * does for every block, is a copy instead of two extra compressions. */
+typedef struct sln_hmac_builtin_t {
+  sln_hmac_t h;
+  sln_md_t inner;
+  sln_md_t outer;
+  sln_md_t keyed_inner;
+  sln_md_t keyed_outer;
+} sln_hmac_builtin_t;
+
+static int hmac_digest_type(sln_hmac_e type, sln_digest_e *dtype) {
+  switch (type) {
+    case SLN_HMAC_MD5:
+      *dtype = SLN_DIGEST_MD5;
+      return 1;
+    case SLN_HMAC_SHA1:
+      *dtype = SLN_DIGEST_SHA1;
+      return 1;
+    case SLN_HMAC_SHA256:
+      *dtype = SLN_DIGEST_SHA256;
+      return 1;
+    case SLN_HMAC_SHA384:
+      *dtype = SLN_DIGEST_SHA384;
+      return 1;
+  }
+
+  return 0;
+}
+
+selene_error_t *sln_hmac_builtin_create(selene_t *s, sln_hmac_e type,
+                                        const char *key, size_t klen,
+                                        sln_hmac_t **p_hmac) {
+  sln_hmac_builtin_t *hb;
+  sln_digest_e dtype;
+  unsigned char pad[SLN_MD_MAX_BLOCK_SIZE];
+  size_t bs;
+  size_t i;
+
+  if (!hmac_digest_type(type, &dtype)) {
+    return selene_error_createf(SELENE_ENOTIMPL, "Unsupported HMAC type: %d",
+                                type);
+  }
+
+  hb = sln_alloc(s, sizeof(sln_hmac_builtin_t));
+  hb->h.s = s;
+  hb->h.type = type;
+  hb->h.baton = hb;
+
+  bs = sln_md_block_size(dtype);
+  memset(pad, 0, sizeof(pad));
+
+  /* keys longer than a block are hashed down first */
+  if (klen > bs) {
+    sln_md_init(&hb->inner, dtype);
+    sln_md_update(&hb->inner, key, klen);
+    sln_md_final(&hb->inner, pad);
+  } else {
+    memcpy(pad, key, klen);
+  }
+
+  for (i = 0; i < bs; i++) {
+    pad[i] ^= 0x36;
+  }
+  sln_md_init(&hb->keyed_inner, dtype);
+  sln_md_update(&hb->keyed_inner, pad, bs);
+
+  for (i = 0; i < bs; i++) {
+    pad[i] ^= 0x36 ^ 0x5c;
+  }
+  sln_md_init(&hb->keyed_outer, dtype);
+  sln_md_update(&hb->keyed_outer, pad, bs);
+
+  memset(pad, 0, sizeof(pad));
+
+  sln_hmac_builtin_reset(&hb->h);
+
+  *p_hmac = &hb->h;
+
+  return SELENE_SUCCESS;
+}
+
+void sln_hmac_builtin_update(sln_hmac_t *h, const void *data, size_t len) {
+  sln_hmac_builtin_t *hb = h->baton;
+
+  sln_md_update(&hb->inner, data, len);
+}
+
+void sln_hmac_builtin_final(sln_hmac_t *h, unsigned char *md) {
+  sln_hmac_builtin_t *hb = h->baton;
+  unsigned char ihash[SLN_BIG_DIGEST_LENGTH];
+
+  sln_md_final(&hb->inner, ihash);
+  memcpy(&hb->outer, &hb->keyed_outer, sizeof(sln_md_t));
+  sln_md_update(&hb->outer, ihash, sln_md_length(hb->inner.type));
+  sln_md_final(&hb->outer, md);
+}
+
+void sln_hmac_builtin_final_ct(sln_hmac_t *h, const void *data, size_t len,
+                               size_t maxlen, unsigned char *md) {
+  sln_hmac_builtin_t *hb = h->baton;
+  unsigned char ihash[SLN_BIG_DIGEST_LENGTH];
+
+  sln_md_final_ct(&hb->inner, data, len, maxlen, ihash);
+  memcpy(&hb->outer, &hb->keyed_outer, sizeof(sln_md_t));
+  sln_md_update(&hb->outer, ihash, sln_md_length(hb->inner.type));
+  sln_md_final(&hb->outer, md);
+}
+
+void sln_hmac_builtin_reset(sln_hmac_t *h) {
+  sln_hmac_builtin_t *hb = h->baton;
+
+  memcpy(&hb->inner, &hb->keyed_inner, sizeof(sln_md_t));
+}
+
+void sln_hmac_builtin_destroy(sln_hmac_t *h) {
+  sln_hmac_builtin_t *hb = h->baton;
+  selene_t *s = h->s;
+
+  /* the keyed states are as good as the key */
+  memset(hb, 0, sizeof(sln_hmac_builtin_t));
+
+  sln_free(s, hb);
+}
@@ -17,32 +17,45 @@
 
 #include "sln_types.h"
 #include "sln_hmac.h"
+#include "sln_crypto.h"
 #include <openssl/hmac.h>
 
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+static HMAC_CTX *HMAC_CTX_new(void) {
+  HMAC_CTX *hctx = OPENSSL_malloc(sizeof(HMAC_CTX));
+
+  if (hctx != NULL) {
+    HMAC_CTX_init(hctx);
+  }
+
+  return hctx;
+}
+
+static void HMAC_CTX_free(HMAC_CTX *hctx) {
+  HMAC_CTX_cleanup(hctx);
+  OPENSSL_free(hctx);
+}
+#endif
+
 selene_error_t *sln_hmac_openssl_create(selene_t *s, sln_hmac_e type,
                                         const char *key, size_t klen,
                                         sln_hmac_t **p_hmac) {
-  sln_hmac_t *h = sln_alloc(s, sizeof(sln_hmac_t));
-  HMAC_CTX *hctx = sln_alloc(s, sizeof(HMAC_CTX));
-  const EVP_MD *mt = NULL;
-
-  h->s = s;
-  h->type = type;
-  h->baton = hctx;
+  sln_hmac_t *h;
+  HMAC_CTX *hctx = HMAC_CTX_new();
 
-  switch (h->type) {
-    case SLN_HMAC_MD5: {
-      mt = EVP_md5();
-      break;
-    }
-    case SLN_HMAC_SHA1: {
-      mt = EVP_sha1();
-      break;
+  if (hctx == NULL ||
+      HMAC_Init_ex(hctx, key, klen, sln_crypto_openssl_hmac(type), NULL) != 1) {
+    if (hctx != NULL) {
+      HMAC_CTX_free(hctx);
     }
+    return selene_error_createf(SELENE_ENOTIMPL, "Unsupported HMAC type: %d",
+                                type);
   }
 
-  HMAC_CTX_init(hctx);
-  HMAC_Init_ex(hctx, key, klen, mt, NULL);
+  h = sln_alloc(s, sizeof(sln_hmac_t));
+  h->s = s;
+  h->type = type;
+  h->baton = hctx;
 
   *p_hmac = h;
 
@@ -59,12 +72,19 @@ void sln_hmac_openssl_final(sln_hmac_t *h, unsigned char *md) {
   HMAC_Final(hctx, md, NULL);
 }
 
+void sln_hmac_openssl_reset(sln_hmac_t *h) {
+  HMAC_CTX *hctx = h->baton;
+  /* A NULL key restores the inner and outer pad states HMAC_Init_ex hashed
+   * the key into when h was created, so a MAC per record costs no key setup
+   * and no allocation. */
+  HMAC_Init_ex(hctx, NULL, 0, NULL, NULL);
+}
+
 void sln_hmac_openssl_destroy(sln_hmac_t *h) {
   selene_t *s = h->s;
   HMAC_CTX *hctx = h->baton;
 
-  HMAC_CTX_cleanup(hctx);
+  HMAC_CTX_free(hctx);
 
-  sln_free(s, hctx);
   sln_free(s, h);
 }
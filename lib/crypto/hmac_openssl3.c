@@ -0,0 +1,74 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifdef SLN_HAVE_OPENSSL3
+
+#include "sln_types.h"
+#include "sln_hmac.h"
+#include "sln_crypto.h"
+
+selene_error_t *sln_hmac_openssl3_create(selene_t *s, sln_hmac_e type,
+                                         const char *key, size_t klen,
+                                         sln_hmac_t **p_hmac) {
+  sln_hmac_t *h;
+  const EVP_MAC_CTX *tmpl = sln_crypto_openssl_hmac_template(type);
+  EVP_MAC_CTX *ctx = NULL;
+
+  if (tmpl != NULL) {
+    ctx = EVP_MAC_CTX_dup(tmpl);
+  }
+
+  if (ctx == NULL ||
+      EVP_MAC_init(ctx, (const unsigned char *)key, klen, NULL) != 1) {
+    EVP_MAC_CTX_free(ctx);
+    return selene_error_createf(SELENE_ENOTIMPL, "Unsupported HMAC type: %d",
+                                type);
+  }
+
+  h = sln_alloc(s, sizeof(sln_hmac_t));
+  h->s = s;
+  h->type = type;
+  h->baton = ctx;
+
+  *p_hmac = h;
+
+  return SELENE_SUCCESS;
+}
+
+void sln_hmac_openssl3_update(sln_hmac_t *h, const void *data, size_t len) {
+  EVP_MAC_update(h->baton, data, len);
+}
+
+void sln_hmac_openssl3_final(sln_hmac_t *h, unsigned char *md) {
+  size_t outlen;
+  EVP_MAC_final(h->baton, md, &outlen, sln_hmac_length(h));
+}
+
+void sln_hmac_openssl3_reset(sln_hmac_t *h) {
+  /* like HMAC_Init_ex, no key restores the keyed inner and outer pads */
+  EVP_MAC_init(h->baton, NULL, 0, NULL);
+}
+
+void sln_hmac_openssl3_destroy(sln_hmac_t *h) {
+  selene_t *s = h->s;
+
+  EVP_MAC_CTX_free(h->baton);
+
+  sln_free(s, h);
+}
+
+#endif
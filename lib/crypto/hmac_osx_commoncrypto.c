@@ -20,6 +20,7 @@
 #include "sln_types.h"
 #include "sln_hmac.h"
 #include <CommonCrypto/CommonHMAC.h>
+#include <string.h>
 
 selene_error_t *sln_hmac_osx_cc_create(selene_t *s, sln_hmac_e type,
                                        const char *key, size_t klen,
@@ -39,11 +40,21 @@ selene_error_t *sln_hmac_osx_cc_create(selene_t *s, sln_hmac_e type,
       alg = kCCHmacAlgSHA1;
       break;
     }
+    case SLN_HMAC_SHA256: {
+      alg = kCCHmacAlgSHA256;
+      break;
+    }
+    case SLN_HMAC_SHA384: {
+      alg = kCCHmacAlgSHA384;
+      break;
+    }
   }
 
-  c = sln_alloc(s, sizeof(CCHmacContext));
+  /* the second context keeps the keyed state, for sln_hmac_osx_cc_reset */
+  c = sln_alloc(s, sizeof(CCHmacContext) * 2);
 
   CCHmacInit(c, alg, key, klen);
+  memcpy(c + 1, c, sizeof(CCHmacContext));
   h->baton = c;
 
   *p_hmac = h;
@@ -58,6 +69,11 @@ void sln_hmac_osx_cc_final(sln_hmac_t *h, unsigned char *md) {
   CCHmacFinal((CCHmacContext *)h->baton, md);
 }
 
+void sln_hmac_osx_cc_reset(sln_hmac_t *h) {
+  CCHmacContext *c = h->baton;
+  memcpy(c, c + 1, sizeof(CCHmacContext));
+}
+
 void sln_hmac_osx_cc_destroy(sln_hmac_t *h) {
   selene_t *s = h->s;
   sln_free(s, h->baton);
@@ -0,0 +1,189 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_crypto.h"
+#include <openssl/obj_mac.h>
+
+/* Indexed by sln_digest_e, sln_hmac_e, sln_cipher_e and sln_aead_e.  Filled
+ * in before the first selene_t exists, and only read afterwards, from any
+ * thread. */
+static const EVP_MD *digests[SLN_DIGEST_SHA384 + 1];
+static const EVP_MD *hmacs[SLN_HMAC_SHA384 + 1];
+static const EVP_CIPHER *ciphers[SLN_CIPHER_RC4 + 1];
+static const EVP_CIPHER *stitched[SLN_CIPHER_RC4 + 1];
+static const EVP_CIPHER *aeads[SLN_AEAD_CHACHA20_POLY1305 + 1];
+
+#ifdef SLN_HAVE_OPENSSL3
+
+#include <openssl/core_names.h>
+
+/* Unkeyed HMAC contexts with their digest set, for sln_hmac_openssl3_create
+ * to copy, which takes the digest along without fetching it again */
+static EVP_MAC_CTX *hmac_templates[SLN_HMAC_SHA384 + 1];
+
+static const char *hmac_names[SLN_HMAC_SHA384 + 1] = {"MD5", "SHA1", "SHA256",
+                                                      "SHA384"};
+
+/* Every algorithm is fetched from the default library context up front, so
+ * that creating a context never goes through a provider lookup, and the
+ * global locks that come with it.  Missing algorithms, like RC4 without the
+ * legacy provider loaded, are left NULL. */
+selene_error_t *sln_crypto_openssl_initialize(void) {
+  size_t i;
+  EVP_MAC *mac;
+  OSSL_PARAM params[2];
+
+  digests[SLN_DIGEST_MD5] = EVP_MD_fetch(NULL, "MD5", NULL);
+  digests[SLN_DIGEST_SHA1] = EVP_MD_fetch(NULL, "SHA1", NULL);
+  digests[SLN_DIGEST_SHA256] = EVP_MD_fetch(NULL, "SHA256", NULL);
+  digests[SLN_DIGEST_SHA384] = EVP_MD_fetch(NULL, "SHA384", NULL);
+
+  for (i = 0; i < sizeof(hmacs) / sizeof(hmacs[0]); i++) {
+    hmacs[i] = EVP_MD_fetch(NULL, hmac_names[i], NULL);
+  }
+
+  ciphers[SLN_CIPHER_AES_128_CBC] = EVP_CIPHER_fetch(NULL, "AES-128-CBC", NULL);
+  ciphers[SLN_CIPHER_AES_256_CBC] = EVP_CIPHER_fetch(NULL, "AES-256-CBC", NULL);
+  ciphers[SLN_CIPHER_RC4] = EVP_CIPHER_fetch(NULL, "RC4", NULL);
+
+  stitched[SLN_CIPHER_AES_128_CBC] =
+      EVP_CIPHER_fetch(NULL, "AES-128-CBC-HMAC-SHA1", NULL);
+  stitched[SLN_CIPHER_AES_256_CBC] =
+      EVP_CIPHER_fetch(NULL, "AES-256-CBC-HMAC-SHA1", NULL);
+
+  aeads[SLN_AEAD_AES_128_GCM] = EVP_CIPHER_fetch(NULL, "AES-128-GCM", NULL);
+  aeads[SLN_AEAD_AES_256_GCM] = EVP_CIPHER_fetch(NULL, "AES-256-GCM", NULL);
+  aeads[SLN_AEAD_CHACHA20_POLY1305] =
+      EVP_CIPHER_fetch(NULL, "ChaCha20-Poly1305", NULL);
+
+  mac = EVP_MAC_fetch(NULL, "HMAC", NULL);
+  if (mac == NULL) {
+    sln_crypto_openssl_terminate();
+    return selene_error_create(SELENE_ENOTIMPL,
+                               "OpenSSL provides no HMAC implementation");
+  }
+
+  for (i = 0; i < sizeof(hmac_templates) / sizeof(hmac_templates[0]); i++) {
+    if (hmacs[i] == NULL) {
+      continue;
+    }
+    params[0] = OSSL_PARAM_construct_utf8_string(
+        OSSL_MAC_PARAM_DIGEST, (char *)EVP_MD_get0_name(hmacs[i]), 0);
+    params[1] = OSSL_PARAM_construct_end();
+    hmac_templates[i] = EVP_MAC_CTX_new(mac);
+    if (hmac_templates[i] != NULL &&
+        EVP_MAC_CTX_set_params(hmac_templates[i], params) != 1) {
+      EVP_MAC_CTX_free(hmac_templates[i]);
+      hmac_templates[i] = NULL;
+    }
+  }
+
+  /* the templates keep their own reference */
+  EVP_MAC_free(mac);
+
+  return SELENE_SUCCESS;
+}
+
+void sln_crypto_openssl_terminate(void) {
+  size_t i;
+
+  for (i = 0; i < sizeof(digests) / sizeof(digests[0]); i++) {
+    EVP_MD_free((EVP_MD *)digests[i]);
+    digests[i] = NULL;
+  }
+
+  for (i = 0; i < sizeof(hmacs) / sizeof(hmacs[0]); i++) {
+    EVP_MD_free((EVP_MD *)hmacs[i]);
+    hmacs[i] = NULL;
+    EVP_MAC_CTX_free(hmac_templates[i]);
+    hmac_templates[i] = NULL;
+  }
+
+  for (i = 0; i < sizeof(ciphers) / sizeof(ciphers[0]); i++) {
+    EVP_CIPHER_free((EVP_CIPHER *)ciphers[i]);
+    ciphers[i] = NULL;
+    EVP_CIPHER_free((EVP_CIPHER *)stitched[i]);
+    stitched[i] = NULL;
+  }
+
+  for (i = 0; i < sizeof(aeads) / sizeof(aeads[0]); i++) {
+    EVP_CIPHER_free((EVP_CIPHER *)aeads[i]);
+    aeads[i] = NULL;
+  }
+}
+
+const EVP_MAC_CTX *sln_crypto_openssl_hmac_template(sln_hmac_e type) {
+  return hmac_templates[type];
+}
+
+#else
+
+selene_error_t *sln_crypto_openssl_initialize(void) {
+  digests[SLN_DIGEST_MD5] = EVP_md5();
+  digests[SLN_DIGEST_SHA1] = EVP_sha1();
+  digests[SLN_DIGEST_SHA256] = EVP_sha256();
+  digests[SLN_DIGEST_SHA384] = EVP_sha384();
+
+  hmacs[SLN_HMAC_MD5] = EVP_md5();
+  hmacs[SLN_HMAC_SHA1] = EVP_sha1();
+  hmacs[SLN_HMAC_SHA256] = EVP_sha256();
+  hmacs[SLN_HMAC_SHA384] = EVP_sha384();
+
+  ciphers[SLN_CIPHER_AES_128_CBC] = EVP_get_cipherbyname(SN_aes_128_cbc);
+  ciphers[SLN_CIPHER_AES_256_CBC] = EVP_get_cipherbyname(SN_aes_256_cbc);
+  ciphers[SLN_CIPHER_RC4] = EVP_get_cipherbyname(SN_rc4);
+
+#ifdef NID_aes_128_cbc_hmac_sha1
+  stitched[SLN_CIPHER_AES_128_CBC] =
+      EVP_get_cipherbyname(SN_aes_128_cbc_hmac_sha1);
+  stitched[SLN_CIPHER_AES_256_CBC] =
+      EVP_get_cipherbyname(SN_aes_256_cbc_hmac_sha1);
+#endif
+
+  aeads[SLN_AEAD_AES_128_GCM] = EVP_aes_128_gcm();
+  aeads[SLN_AEAD_AES_256_GCM] = EVP_aes_256_gcm();
+#ifdef NID_chacha20_poly1305
+  aeads[SLN_AEAD_CHACHA20_POLY1305] = EVP_chacha20_poly1305();
+#endif
+
+  return SELENE_SUCCESS;
+}
+
+/* the methods are static objects owned by OpenSSL */
+void sln_crypto_openssl_terminate(void) {}
+
+#endif
+
+const EVP_MD *sln_crypto_openssl_digest(sln_digest_e type) {
+  return digests[type];
+}
+
+const EVP_MD *sln_crypto_openssl_hmac(sln_hmac_e type) {
+  return hmacs[type];
+}
+
+const EVP_CIPHER *sln_crypto_openssl_cipher(sln_cipher_e type) {
+  return ciphers[type];
+}
+
+const EVP_CIPHER *sln_crypto_openssl_stitched(sln_cipher_e type) {
+  return stitched[type];
+}
+
+const EVP_CIPHER *sln_crypto_openssl_aead(sln_aead_e type) {
+  return aeads[type];
+}
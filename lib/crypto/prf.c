@@ -21,49 +21,34 @@
 
 #include <string.h>
 
-static selene_error_t *prf_hash(selene_t *s, sln_hmac_e htype,
-                                const char *secret, size_t secretlen,
-                                const char *seed, size_t seedlen, char *output,
-                                size_t outlen) {
-  sln_hmac_t *a_hmac;
-  unsigned char a_hmac_buf[SLN_BIG_DIGEST_LENGTH];
-  char *a_buf = NULL;
-  size_t a_buf_len;
-  selene_error_t *err = SELENE_SUCCESS;
-  size_t hashlen;
-
-  SELENE_ERR(sln_hmac_create(s, htype, secret, secretlen, &a_hmac));
-
-  hashlen = sln_hmac_length(a_hmac);
-
-  sln_hmac_update(a_hmac, seed, seedlen);
-
-  sln_hmac_final(a_hmac, a_hmac_buf);
-
-  sln_hmac_destroy(a_hmac);
+/**
+ * P_hash from RFC 5246, Section 5, with h already keyed with the secret.
+ * Every HMAC starts from the keyed state sln_hmac_reset restores, so the key
+ * is set up once per call rather than once per block.  The seed is label
+ * followed by seed, which are fed to the HMAC one after the other instead of
+ * being copied together.  With mix set, the output is XORed into output,
+ * like the TLS 1.0 PRF combines its two halves, instead of overwriting it.
+ */
+static void p_hash(sln_hmac_t *h, const char *label, size_t labellen,
+                   const char *seed, size_t seedlen, char *output,
+                   size_t outlen, int mix) {
+  unsigned char a[SLN_BIG_DIGEST_LENGTH];
+  unsigned char buf[SLN_BIG_DIGEST_LENGTH];
+  size_t hashlen = sln_hmac_length(h);
+  size_t adv;
+  size_t i;
 
-  /* TODO: efficiency */
-  a_buf_len = seedlen + hashlen;
-  a_buf = sln_alloc(s, a_buf_len);
-  memcpy(a_buf, a_hmac_buf, hashlen);
-  memcpy(a_buf + hashlen, seed, seedlen);
+  /* A(1) */
+  sln_hmac_update(h, label, labellen);
+  sln_hmac_update(h, seed, seedlen);
+  sln_hmac_final(h, a);
 
   while (outlen > 0) {
-    sln_hmac_t *hmac;
-    size_t adv;
-    unsigned char buf[SLN_BIG_DIGEST_LENGTH];
-
-    err = sln_hmac_create(s, htype, secret, secretlen, &hmac);
-
-    if (err) {
-      break;
-    }
-
-    sln_hmac_update(hmac, a_buf, a_buf_len);
-
-    sln_hmac_final(hmac, buf);
-
-    sln_hmac_destroy(hmac);
+    sln_hmac_reset(h);
+    sln_hmac_update(h, a, hashlen);
+    sln_hmac_update(h, label, labellen);
+    sln_hmac_update(h, seed, seedlen);
+    sln_hmac_final(h, buf);
 
     if (hashlen < outlen) {
       adv = hashlen;
@@ -71,69 +56,57 @@ static selene_error_t *prf_hash(selene_t *s, sln_hmac_e htype,
       adv = outlen;
     }
 
-    memcpy(output, buf, adv);
+    if (mix) {
+      for (i = 0; i < adv; i++) {
+        output[i] ^= buf[i];
+      }
+    } else {
+      memcpy(output, buf, adv);
+    }
 
     outlen -= adv;
     output += adv;
 
     if (outlen != 0) {
-      err = sln_hmac_create(s, htype, secret, secretlen, &a_hmac);
-
-      if (err) {
-        break;
-      }
-      sln_hmac_update(a_hmac, a_buf, hashlen);
-      sln_hmac_final(a_hmac, a_hmac_buf);
-      sln_hmac_destroy(a_hmac);
+      /* A(i + 1) */
+      sln_hmac_reset(h);
+      sln_hmac_update(h, a, hashlen);
+      sln_hmac_final(h, a);
     }
   }
-
-  if (a_buf) {
-    sln_free(s, a_buf);
-  }
-
-  return err;
 }
 
 selene_error_t *sln_prf(selene_t *s, const char *label, size_t labellen,
                         const char *secret, size_t secretlen, const char *seed,
                         size_t seedlen, char *output, size_t outlen) {
-  selene_error_t *err = SELENE_SUCCESS;
-  size_t i;
   size_t half_secretlen;
-  size_t concatlen = labellen + seedlen;
-  char *concat = sln_alloc(s, labellen + seedlen);
-  char *tmpout = sln_alloc(s, outlen);
-
-  memcpy(concat, label, labellen);
-  memcpy(concat + labellen, seed, seedlen);
+  sln_hmac_t *h;
 
   half_secretlen = (secretlen / 2) + (secretlen % 2);
 
-  /* We store the MD5 HMAC in the initial output, and need to allocate
-   * a temp area for the SHA1 HMAC, to then XOR them together.
-   */
+  /* The MD5 half goes straight into output, and the SHA1 half is XORed in
+   * as it is computed, a block at a time. */
+  SELENE_ERR(sln_hmac_create(s, SLN_HMAC_MD5, secret, half_secretlen, &h));
+  p_hash(h, label, labellen, seed, seedlen, output, outlen, 0);
+  sln_hmac_destroy(h);
 
-  err = prf_hash(s, SLN_HMAC_MD5, secret, half_secretlen, concat, concatlen,
-                 output, outlen);
-
-  if (err) {
-    goto out;
-  }
+  SELENE_ERR(sln_hmac_create(s, SLN_HMAC_SHA1, secret + (secretlen / 2),
+                             half_secretlen, &h));
+  p_hash(h, label, labellen, seed, seedlen, output, outlen, 1);
+  sln_hmac_destroy(h);
 
-  err = prf_hash(s, SLN_HMAC_SHA1, secret + (secretlen / 2), half_secretlen,
-                 concat, concatlen, tmpout, outlen);
-  if (err) {
-    goto out;
-  }
+  return SELENE_SUCCESS;
+}
 
-  for (i = 0; i < outlen; i++) {
-    output[i] ^= tmpout[i];
-  }
+selene_error_t *sln_prf_tls12(selene_t *s, sln_hmac_e type, const char *label,
+                              size_t labellen, const char *secret,
+                              size_t secretlen, const char *seed,
+                              size_t seedlen, char *output, size_t outlen) {
+  sln_hmac_t *h;
 
-out:
-  sln_free(s, tmpout);
-  sln_free(s, concat);
+  SELENE_ERR(sln_hmac_create(s, type, secret, secretlen, &h));
+  p_hash(h, label, labellen, seed, seedlen, output, outlen, 0);
+  sln_hmac_destroy(h);
 
-  return err;
+  return SELENE_SUCCESS;
 }
@@ -18,34 +18,77 @@
 #include "sln_types.h"
 #include "sln_rsa.h"
 #include "sln_assert.h"
+#include <openssl/evp.h>
 #include <openssl/rsa.h>
 #include <openssl/err.h>
 
+/* Goes through EVP_PKEY rather than the RSA struct inside it, which is
+ * opaque since OpenSSL 1.1, and deprecated in 3.0 */
 selene_error_t *sln_rsa_openssl_public_encrypt(selene_t *s, sln_pubkey_t *key,
                                                const char *input,
                                                size_t inputlen, char *output) {
-  int err;
-  RSA *rsa = key->key->pkey.rsa;
+  EVP_PKEY_CTX *ctx;
+  size_t outlen = EVP_PKEY_size(key->key);
 
-  SLN_ASSERT(key->key->type == EVP_PKEY_RSA);
+  SLN_ASSERT(EVP_PKEY_id(key->key) == EVP_PKEY_RSA);
 
-  err = RSA_public_encrypt(inputlen, (const unsigned char *)input,
-                           (unsigned char *)output, rsa, RSA_PKCS1_PADDING);
+  ctx = EVP_PKEY_CTX_new(key->key, NULL);
 
-  if (err == -1) {
+  if (ctx == NULL || EVP_PKEY_encrypt_init(ctx) <= 0 ||
+      EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0 ||
+      EVP_PKEY_encrypt(ctx, (unsigned char *)output, &outlen,
+                       (const unsigned char *)input, inputlen) <= 0) {
     char buf[121];
     unsigned long e = ERR_get_error();
-    return selene_error_createf(SELENE_EINVAL, "RSA_public_encrypt error: %s",
+    EVP_PKEY_CTX_free(ctx);
+    return selene_error_createf(SELENE_EINVAL, "EVP_PKEY_encrypt error: %s",
                                 ERR_error_string(e, buf));
   }
 
+  EVP_PKEY_CTX_free(ctx);
+
   return SELENE_SUCCESS;
 }
 
 size_t sln_rsa_openssl_size(sln_pubkey_t *key) {
-  RSA *rsa = key->key->pkey.rsa;
+  SLN_ASSERT(EVP_PKEY_id(key->key) == EVP_PKEY_RSA);
+
+  return EVP_PKEY_size(key->key);
+}
+
+selene_error_t *sln_rsa_openssl_private_decrypt(selene_t *s,
+                                                sln_privkey_t *key,
+                                                const char *input,
+                                                size_t inputlen, char *output,
+                                                size_t *outputlen) {
+  EVP_PKEY_CTX *ctx;
+  size_t outlen = EVP_PKEY_size(key->key);
+
+  SLN_ASSERT(EVP_PKEY_id(key->key) == EVP_PKEY_RSA);
+
+  ctx = EVP_PKEY_CTX_new(key->key, NULL);
+
+  if (ctx == NULL || EVP_PKEY_decrypt_init(ctx) <= 0 ||
+      EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0 ||
+      EVP_PKEY_decrypt(ctx, (unsigned char *)output, &outlen,
+                       (const unsigned char *)input, inputlen) <= 0) {
+    char buf[121];
+    unsigned long e = ERR_get_error();
+    EVP_PKEY_CTX_free(ctx);
+    ERR_clear_error();
+    return selene_error_createf(SELENE_EINVAL, "EVP_PKEY_decrypt error: %s",
+                                ERR_error_string(e, buf));
+  }
+
+  EVP_PKEY_CTX_free(ctx);
+
+  *outputlen = outlen;
+
+  return SELENE_SUCCESS;
+}
 
-  SLN_ASSERT(key->key->type == EVP_PKEY_RSA);
+size_t sln_rsa_openssl_private_size(sln_privkey_t *key) {
+  SLN_ASSERT(EVP_PKEY_id(key->key) == EVP_PKEY_RSA);
 
-  return RSA_size(rsa);
+  return EVP_PKEY_size(key->key);
 }
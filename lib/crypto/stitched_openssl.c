@@ -0,0 +1,118 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "sln_types.h"
+#include "sln_stitched.h"
+#include "sln_crypto.h"
+#include <openssl/evp.h>
+#include <string.h>
+
+#define AAD_LENGTH (13)
+
+selene_error_t *sln_stitched_openssl_create(selene_t *s, int encrypt,
+                                            sln_cipher_e type, const char *key,
+                                            const char *iv,
+                                            const char *mac_secret,
+                                            sln_stitched_t **p_st) {
+  sln_stitched_t *st;
+  const EVP_CIPHER *cipherType = NULL;
+  EVP_CIPHER_CTX *ctx;
+
+  cipherType = sln_crypto_openssl_stitched(type);
+
+  if (cipherType == NULL) {
+    return selene_error_createf(SELENE_ENOTIMPL,
+                                "No stitched implementation of cipher %d",
+                                type);
+  }
+
+  ctx = EVP_CIPHER_CTX_new();
+
+  /* only offered by OpenSSL when the CPU has AES-NI */
+  if (ctx == NULL ||
+      EVP_CipherInit_ex(ctx, cipherType, NULL, (const unsigned char *)key,
+                        (const unsigned char *)iv, encrypt) != 1 ||
+      EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_SET_MAC_KEY, 20,
+                          (void *)mac_secret) != 1) {
+    EVP_CIPHER_CTX_free(ctx);
+    return selene_error_createf(SELENE_ENOTIMPL,
+                                "No stitched implementation of cipher %d",
+                                type);
+  }
+
+  st = sln_alloc(s, sizeof(sln_stitched_t));
+  st->s = s;
+  st->baton = ctx;
+  st->type = type;
+  *p_st = st;
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_stitched_openssl_seal(sln_stitched_t *st, const char *aad,
+                                          char *data, size_t len,
+                                          size_t *outlen) {
+  EVP_CIPHER_CTX *ctx = st->baton;
+  unsigned char buf[AAD_LENGTH];
+  int extra;
+
+  /* OpenSSL rewrites the length in it */
+  memcpy(buf, aad, AAD_LENGTH);
+
+  extra = EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD, AAD_LENGTH, buf);
+  if (extra <= 0 || extra > SLN_STITCHED_MAX_OVERHEAD ||
+      EVP_Cipher(ctx, (unsigned char *)data, (unsigned char *)data,
+                 len + extra) <= 0) {
+    return selene_error_create(SELENE_EIO, "Stitched seal failed");
+  }
+
+  *outlen = len + extra;
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_stitched_openssl_open(sln_stitched_t *st, const char *aad,
+                                          char *data, size_t len) {
+  EVP_CIPHER_CTX *ctx = st->baton;
+  unsigned char buf[AAD_LENGTH];
+
+  memcpy(buf, aad, AAD_LENGTH);
+
+  if (EVP_CIPHER_CTX_ctrl(ctx, EVP_CTRL_AEAD_TLS1_AAD, AAD_LENGTH, buf) <= 0) {
+    return selene_error_create(SELENE_EIO, "Stitched open failed");
+  }
+
+  /* padding and MAC are checked in constant time */
+  if (EVP_Cipher(ctx, (unsigned char *)data, (unsigned char *)data, len) <= 0) {
+    return selene_error_create(SELENE_EINVAL, "Bad record MAC");
+  }
+
+  return SELENE_SUCCESS;
+}
+
+void sln_stitched_openssl_set_iv(sln_stitched_t *st, const char *iv) {
+  EVP_CipherInit_ex(st->baton, NULL, NULL, NULL, (const unsigned char *)iv,
+                    -1);
+}
+
+void sln_stitched_openssl_destroy(sln_stitched_t *st) {
+  selene_t *s = st->s;
+
+  EVP_CIPHER_CTX_free(st->baton);
+
+  sln_free(s, st);
+}
@@ -25,9 +25,9 @@ selene_error_t *sln_brigade_create(selene_alloc_t *alloc,
                                    sln_brigade_t **out_bb) {
   sln_brigade_t *bb = alloc->calloc(alloc->baton, sizeof(sln_brigade_t));
 
-  SLN_RING_INIT(&bb->list, sln_bucket_t, link);
-
   bb->alloc = alloc;
+  bb->slots = &bb->inline_slots[0];
+  bb->capacity = SLN_BRIGADE_INLINE_SLOTS;
 
   *out_bb = bb;
 
@@ -37,38 +37,147 @@ selene_error_t *sln_brigade_create(selene_alloc_t *alloc,
 void sln_brigade_destroy(sln_brigade_t *bb) {
   sln_brigade_clear(bb);
 
+  if (bb->slots != &bb->inline_slots[0]) {
+    bb->alloc->free(bb->alloc->baton, bb->slots);
+  }
+
   bb->alloc->free(bb->alloc->baton, bb);
 }
 
 void sln_brigade_clear(sln_brigade_t *bb) {
-  sln_bucket_t *e;
-
   while (!SLN_BRIGADE_EMPTY(bb)) {
-    e = SLN_BRIGADE_FIRST(bb);
-    sln_bucket_destroy(e);
+    sln_bucket_destroy(SLN_BRIGADE_FIRST(bb));
   }
 }
 
-size_t sln_brigade_size(sln_brigade_t *bb) {
-  /* TODO: cache current value inside the sln_brigade_t structure */
-  size_t total = 0;
-  sln_bucket_t *b = NULL;
+/* Doubles the slot array, unwrapping it so the front is at slot 0 again */
+static void brigade_grow(sln_brigade_t *bb) {
+  int i;
+  sln_brigade_slot_t *slots;
+
+  slots = bb->alloc->malloc(bb->alloc->baton,
+                            sizeof(sln_brigade_slot_t) * bb->capacity * 2);
+
+  for (i = 0; i < bb->count; i++) {
+    slots[i] = *SLN_BRIGADE_SLOT(bb, i);
+  }
+
+  if (bb->slots != &bb->inline_slots[0]) {
+    bb->alloc->free(bb->alloc->baton, bb->slots);
+  }
+
+  bb->slots = slots;
+  bb->capacity *= 2;
+  bb->head = 0;
+}
+
+void sln_brigade_insert(sln_brigade_t *bb, int i, sln_bucket_t *e) {
+  int j;
+  sln_brigade_slot_t *slot;
+
+  SLN_ASSERT(i >= 0 && i <= bb->count);
+  SLN_ASSERT(e->brigade == NULL);
+
+  if (bb->count == bb->capacity) {
+    brigade_grow(bb);
+  }
 
-  SLN_RING_FOREACH(b, &(bb)->list, sln_bucket_t, link) { total += b->size; }
+  if (i == 0) {
+    bb->head = (bb->head - 1) & (bb->capacity - 1);
+  } else {
+    for (j = bb->count; j > i; j--) {
+      *SLN_BRIGADE_SLOT(bb, j) = *SLN_BRIGADE_SLOT(bb, j - 1);
+    }
+  }
+
+  /* appending leaves the offsets of every other bucket alone */
+  if (i != bb->count) {
+    bb->generation++;
+  }
+
+  bb->count++;
+  bb->size += e->size;
+  e->brigade = bb;
 
-  return total;
+  slot = SLN_BRIGADE_SLOT(bb, i);
+  slot->bucket = e;
+  slot->data = e->data;
+  slot->size = e->size;
+
+  SLN_BRIGADE_CHECK_CONSISTENCY(bb);
 }
 
-int sln_brigade_bucket_count(sln_brigade_t *bb) {
-  /* TODO: cache current value inside the sln_brigade_t structure */
-  int total = 0;
-  sln_bucket_t *b;
+int sln_brigade_index(sln_brigade_t *bb, sln_bucket_t *e) {
+  int i;
 
-  SLN_RING_FOREACH(b, &(bb)->list, sln_bucket_t, link) { total++; }
+  /* buckets almost always leave from the front, or get looked up right
+   * after being appended */
+  for (i = 0; i < bb->count; i++) {
+    if (SLN_BRIGADE_BUCKET(bb, i) == e) {
+      return i;
+    }
+    if (SLN_BRIGADE_BUCKET(bb, bb->count - 1 - i) == e) {
+      return bb->count - 1 - i;
+    }
+  }
 
-  return total;
+  return -1;
 }
 
+void sln_brigade_remove(sln_brigade_t *bb, sln_bucket_t *e) {
+  int j;
+  int i = sln_brigade_index(bb, e);
+
+  SLN_ASSERT(i >= 0);
+
+  bb->size -= SLN_BRIGADE_SLOT(bb, i)->size;
+
+  if (i == 0) {
+    bb->head = (bb->head + 1) & (bb->capacity - 1);
+  } else {
+    for (j = i; j < bb->count - 1; j++) {
+      *SLN_BRIGADE_SLOT(bb, j) = *SLN_BRIGADE_SLOT(bb, j + 1);
+    }
+  }
+
+  bb->count--;
+  bb->generation++;
+  e->brigade = NULL;
+
+  SLN_BRIGADE_CHECK_CONSISTENCY(bb);
+}
+
+void sln_brigade_concat(sln_brigade_t *a, sln_brigade_t *b) {
+  sln_bucket_t *e;
+
+  while (!SLN_BRIGADE_EMPTY(b)) {
+    e = SLN_BRIGADE_FIRST(b);
+    sln_brigade_remove(b, e);
+    sln_brigade_insert(a, a->count, e);
+  }
+}
+
+#ifdef SLN_BRIGADE_DEBUG
+void sln_brigade_check_consistency(sln_brigade_t *bb) {
+  int i;
+  size_t size = 0;
+  sln_brigade_slot_t *slot;
+
+  SLN_ASSERT(bb->count >= 0 && bb->count <= bb->capacity);
+  SLN_ASSERT((bb->capacity & (bb->capacity - 1)) == 0);
+
+  for (i = 0; i < bb->count; i++) {
+    slot = SLN_BRIGADE_SLOT(bb, i);
+    SLN_ASSERT(slot->bucket->brigade == bb);
+    SLN_ASSERT(slot->data == slot->bucket->data);
+    SLN_ASSERT(slot->size == slot->bucket->size);
+    size += slot->size;
+  }
+
+  SLN_ASSERT(size == bb->size);
+}
+#endif
+
 static size_t sln_min(size_t x, size_t y) {
   if (x < y) {
     return x;
@@ -76,92 +185,135 @@ static size_t sln_min(size_t x, size_t y) {
   return y;
 }
 
-selene_error_t *sln_brigade_pread_bytes(sln_brigade_t *bb, size_t want_offset,
-                                        size_t want_length, char *buffer,
-                                        size_t *got_len) {
-  /* Read into an offset into a buffer, crossing buckets as needed.  This
-   * produces
-   * a copy of the data -- it is intended to be used for short reads where we
-   * are avoiding a malloc,
-   * for long reads your should probally use BRIGADE_SLICE, to cut up buckets.
-   */
-  size_t got = 0;
-  size_t offset = 0;
-  size_t buffer_offset = 0;
-  sln_bucket_t *b = NULL;
+void sln_brigade_cursor_init(sln_brigade_t *bb, sln_brigade_cursor_t *cur) {
+  cur->bb = bb;
+  cur->index = -1;
+  cur->bucket_offset = 0;
+  cur->generation = bb->generation;
+}
 
-  SLN_RING_FOREACH(b, &(bb)->list, sln_bucket_t, link) {
-    if (got == want_length) {
-      break;
+/* Moves the cursor to the bucket holding offset, or to the last bucket if
+ * the brigade is shorter than that, so that buckets appended later are
+ * still reachable from it. */
+static void cursor_seek(sln_brigade_cursor_t *cur, size_t offset) {
+  sln_brigade_t *bb = cur->bb;
+
+  if (cur->index < 0 || cur->generation != bb->generation ||
+      offset < cur->bucket_offset) {
+    cur->generation = bb->generation;
+    cur->bucket_offset = 0;
+    if (SLN_BRIGADE_EMPTY(bb)) {
+      cur->index = -1;
+      return;
     }
+    cur->index = 0;
+  }
+
+  while (cur->index + 1 < bb->count &&
+         offset >=
+             cur->bucket_offset + SLN_BRIGADE_SLOT(bb, cur->index)->size) {
+    cur->bucket_offset += SLN_BRIGADE_SLOT(bb, cur->index)->size;
+    cur->index++;
+  }
+}
 
-    if (want_offset <= (offset + b->size)) {
-      size_t startpoint = 0;
-      size_t tocopy = 0;
+selene_error_t *sln_brigade_cursor_pread_bytes(sln_brigade_cursor_t *cur,
+                                               size_t want_offset,
+                                               size_t want_length,
+                                               char *buffer, size_t *got_len) {
+  int i;
+  size_t got = 0;
+  size_t offset;
+  sln_brigade_t *bb = cur->bb;
+  sln_brigade_slot_t *slot;
 
-      if (want_offset > offset) {
-        startpoint = want_offset - offset;
-      }
+  cursor_seek(cur, want_offset);
 
-      tocopy = sln_min(b->size - startpoint, want_length - got);
+  offset = cur->bucket_offset;
+
+  for (i = cur->index; i >= 0 && i < bb->count && got < want_length; i++) {
+    slot = SLN_BRIGADE_SLOT(bb, i);
+    /* offset is where this bucket starts in the brigade */
+    if (want_offset + got < offset + slot->size) {
+      size_t startpoint = want_offset + got - offset;
+      size_t tocopy = sln_min(slot->size - startpoint, want_length - got);
+
+      memcpy(buffer + got, slot->data + startpoint, tocopy);
       got += tocopy;
-      memcpy(buffer + buffer_offset, b->data + startpoint, tocopy);
-      buffer_offset += tocopy;
-      offset += tocopy;
-    } else {
-      offset += b->size;
-      continue;
     }
+
+    offset += slot->size;
   }
 
   *got_len = got;
   return SELENE_SUCCESS;
 }
 
+selene_error_t *sln_brigade_cursor_copy_into(sln_brigade_cursor_t *cur,
+                                             size_t want_offset,
+                                             size_t want_length,
+                                             sln_brigade_t *into_bb) {
+  int i;
+  size_t got = 0;
+  size_t offset;
+  sln_brigade_t *bb = cur->bb;
+  sln_brigade_slot_t *slot;
+  sln_bucket_t *e = NULL;
+
+  cursor_seek(cur, want_offset);
+
+  offset = cur->bucket_offset;
+
+  for (i = cur->index; i >= 0 && i < bb->count && got < want_length; i++) {
+    slot = SLN_BRIGADE_SLOT(bb, i);
+    if (want_offset + got < offset + slot->size) {
+      size_t startpoint = want_offset + got - offset;
+      size_t tocopy = sln_min(slot->size - startpoint, want_length - got);
+
+      SELENE_ERR(sln_bucket_create_from_bucket(into_bb->alloc, &e,
+                                               slot->bucket, startpoint,
+                                               tocopy));
+
+      SLN_BRIGADE_INSERT_TAIL(into_bb, e);
+
+      got += tocopy;
+    }
+
+    offset += slot->size;
+  }
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_brigade_pread_bytes(sln_brigade_t *bb, size_t want_offset,
+                                        size_t want_length, char *buffer,
+                                        size_t *got_len) {
+  /* Read into an offset into a buffer, crossing buckets as needed.  This
+   * produces
+   * a copy of the data -- it is intended to be used for short reads where we
+   * are avoiding a malloc,
+   * for long reads your should probally use BRIGADE_SLICE, to cut up buckets.
+   */
+  sln_brigade_cursor_t cur;
+
+  sln_brigade_cursor_init(bb, &cur);
+
+  return sln_brigade_cursor_pread_bytes(&cur, want_offset, want_length, buffer,
+                                        got_len);
+}
+
 selene_error_t *sln_brigade_flatten(sln_brigade_t *bb, char *c, size_t *len) {
   /**
    * This is very similiar to APR's, and based upon apr_brigade_flatten.
    * The fundamental difference is that we consume buckets as they are
    * stored into the output buffer.
    */
-
   size_t actual = 0;
-  sln_bucket_t *b = NULL;
-  sln_bucket_t *iter = NULL;
-
-  SLN_RING_FOREACH_SAFE(b, iter, &(bb)->list, sln_bucket_t, link) {
-    size_t data_len = b->size;
-
-    /* If we would overflow. */
-    if (data_len + actual > *len) {
-      data_len = *len - actual;
-    }
 
-    /* XXX: It appears that overflow of the final bucket
-     * is DISCARDED without any warning to the caller.
-     *
-     * No, we only copy the data up to their requested size.  -- jre
-     */
-    memcpy(c, b->data, data_len);
-    c += data_len;
-    actual += data_len;
-
-    if (b->size != data_len) {
-      sln_bucket_t *tmpe;
-
-      SELENE_ERR(sln_bucket_create_from_bucket(bb->alloc, &tmpe, b, data_len,
-                                               b->size - data_len));
-      SLN_BRIGADE_INSERT_HEAD(bb, tmpe);
-    }
+  SELENE_ERR(sln_brigade_pread_bytes(bb, 0, *len, c, &actual));
 
-    sln_bucket_destroy(b);
-
-    /* This could probably be actual == *len, but be safe from stray
-     * photons. */
-    if (actual >= *len) {
-      break;
-    }
-  }
+  /* Only what fit into the buffer is consumed, the rest stays behind */
+  SELENE_ERR(sln_brigade_chomp(bb, actual));
 
   *len = actual;
 
@@ -171,38 +323,59 @@ selene_error_t *sln_brigade_flatten(sln_brigade_t *bb, char *c, size_t *len) {
 selene_error_t *sln_brigade_copy_into(sln_brigade_t *source_bb,
                                       size_t want_offset, size_t want_length,
                                       sln_brigade_t *into_bb) {
-  size_t got = 0;
-  size_t offset = 0;
-  size_t buffer_offset = 0;
+  sln_brigade_cursor_t cur;
+
+  sln_brigade_cursor_init(source_bb, &cur);
+
+  return sln_brigade_cursor_copy_into(&cur, want_offset, want_length, into_bb);
+}
+
+selene_error_t *sln_brigade_split(sln_brigade_t *bb, size_t offset) {
+  int i;
+  size_t start = 0;
   sln_bucket_t *b = NULL;
   sln_bucket_t *e = NULL;
 
-  SLN_RING_FOREACH(b, &(source_bb)->list, sln_bucket_t, link) {
-    if (got == want_length) {
-      break;
-    }
+  if (offset == 0 || offset >= bb->size) {
+    return SELENE_SUCCESS;
+  }
+
+  for (i = 0; i < bb->count; i++) {
+    size_t size = SLN_BRIGADE_SLOT(bb, i)->size;
 
-    if (want_offset <= (offset + b->size)) {
-      size_t startpoint = 0;
-      size_t tocopy;
+    if (offset < start + size) {
+      if (offset > start) {
+        size_t cut = offset - start;
 
-      if (want_offset > offset) {
-        startpoint = want_offset - offset;
+        b = SLN_BRIGADE_BUCKET(bb, i);
+        SELENE_ERR(sln_bucket_create_from_bucket(bb->alloc, &e, b, cut,
+                                                 size - cut));
+
+        /* b keeps its slot, truncated, and the rest goes right after it */
+        b->size = cut;
+        SLN_BRIGADE_SLOT_UPDATE(bb, i, b);
+        sln_brigade_insert(bb, i + 1, e);
       }
+      break;
+    }
+    start += size;
+  }
 
-      tocopy = sln_min(b->size - startpoint, want_length - got);
-      got += tocopy;
-      SELENE_ERR(sln_bucket_create_from_bucket(into_bb->alloc, &e, b,
-                                               startpoint, tocopy));
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_brigade_read(sln_brigade_t *bb, size_t length) {
+  int i;
+  size_t start = 0;
 
-      SLN_BRIGADE_INSERT_HEAD(into_bb, e);
+  for (i = 0; start < length && i < bb->count; i++) {
+    sln_bucket_t *b = SLN_BRIGADE_BUCKET(bb, i);
 
-      buffer_offset += tocopy;
-      offset += tocopy;
-    } else {
-      offset += b->size;
-      continue;
+    if (SLN_BUCKET_TYPE(b) != SLN_BUCKET_MEMORY) {
+      /* the bytes read are put in a memory bucket at index i */
+      SELENE_ERR(sln_bucket_read(b));
     }
+    start += SLN_BRIGADE_SLOT(bb, i)->size;
   }
 
   return SELENE_SUCCESS;
@@ -211,32 +384,30 @@ selene_error_t *sln_brigade_copy_into(sln_brigade_t *source_bb,
 selene_error_t *sln_brigade_chomp(sln_brigade_t *bb, size_t len) {
   size_t actual = 0;
   sln_bucket_t *b = NULL;
-  sln_bucket_t *iter = NULL;
 
-  SLN_RING_FOREACH_SAFE(b, iter, &(bb)->list, sln_bucket_t, link) {
-    size_t data_len = b->size;
+  SELENE_ERR(sln_brigade_split(bb, len));
 
-    /* If we would overflow. */
-    if (data_len + actual > len) {
-      data_len = len - actual;
-    }
+  while (actual < len && !SLN_BRIGADE_EMPTY(bb)) {
+    b = SLN_BRIGADE_FIRST(bb);
+    actual += b->size;
+    sln_bucket_destroy(b);
+  }
 
-    actual += data_len;
+  return SELENE_SUCCESS;
+}
 
-    if (b->size != data_len) {
-      sln_bucket_t *tmpe = NULL;
-      SELENE_ERR(sln_bucket_create_from_bucket(bb->alloc, &tmpe, b, data_len,
-                                               b->size - data_len));
-      SLN_BRIGADE_INSERT_HEAD(bb, tmpe);
-    }
+selene_error_t *sln_brigade_splice_into(sln_brigade_t *source_bb,
+                                        size_t length, sln_brigade_t *into_bb) {
+  size_t moved = 0;
+  sln_bucket_t *b = NULL;
 
-    sln_bucket_destroy(b);
+  SELENE_ERR(sln_brigade_split(source_bb, length));
 
-    /* This could probably be actual == *len, but be safe from stray
-     * photons. */
-    if (actual >= len) {
-      break;
-    }
+  while (moved < length && !SLN_BRIGADE_EMPTY(source_bb)) {
+    b = SLN_BRIGADE_FIRST(source_bb);
+    moved += b->size;
+    SLN_BUCKET_REMOVE(b);
+    SLN_BRIGADE_INSERT_TAIL(into_bb, b);
   }
 
   return SELENE_SUCCESS;
@@ -20,60 +20,242 @@
 #include "sln_types.h"
 #include "sln_assert.h"
 #include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+/* size bytes of memory follow the bookkeeping, in the same allocation.
+ * Backings for someone else's memory are created with a size of 0, and
+ * pointed at it afterwards. */
+static sln_backing_t *backing_create(selene_alloc_t *alloc, size_t size) {
+  sln_backing_t *backing =
+      alloc->malloc(alloc->baton, sizeof(sln_backing_t) + size);
+
+  backing->alloc = alloc;
+  backing->refcount = 0;
+  backing->size = size;
+  backing->data = (char *)(backing + 1);
+  backing->release = NULL;
+  backing->release_baton = NULL;
+  backing->type = SLN_BUCKET_MEMORY;
+  backing->fd = -1;
+
+  return backing;
+}
 
-static void create_sized(selene_alloc_t *alloc, sln_bucket_t *parent,
-                         size_t size, sln_bucket_t **out_b) {
-  sln_bucket_t *b = alloc->calloc(alloc->baton, sizeof(sln_bucket_t));
+static void backing_release(sln_backing_t *backing) {
+  backing->refcount--;
 
-  b->alloc = alloc;
-  b->parent = parent;
-  if (parent != NULL) {
-    sln_bucket_t *e = parent;
-    while (e != NULL) {
-      e->refcount++;
-      e = e->parent;
+  if (backing->refcount <= 0) {
+    if (backing->release != NULL) {
+      backing->release(backing->release_baton);
     }
-    /* TODO: perhaps have a CAS version for multi-threaded operation, but,
-     * no.... no. */
-    b->memory_is_mine = 0;
-  } else {
-    b->memory_is_mine = 1;
+    backing->alloc->free(backing->alloc->baton, backing);
   }
-  b->refcount = 1;
-  b->size = size;
+}
 
-  SLN_RING_ELEM_INIT(b, link);
+static void create_view(selene_alloc_t *alloc, sln_backing_t *backing,
+                        char *data, size_t size, sln_bucket_t **out_b) {
+  sln_bucket_t *b = alloc->malloc(alloc->baton, sizeof(sln_bucket_t));
+
+  b->alloc = alloc;
+  b->size = size;
+  b->data = data;
+  b->offset = 0;
+  /* TODO: perhaps have a CAS version for multi-threaded operation, but,
+   * no.... no. */
+  b->backing = backing;
+  backing->refcount++;
+  b->brigade = NULL;
 
   *out_b = b;
 }
 
 selene_error_t *sln_bucket_create_empty(selene_alloc_t *alloc,
                                         sln_bucket_t **out_b, size_t size) {
-  sln_bucket_t *b = NULL;
+  sln_backing_t *backing = backing_create(alloc, size);
 
-  create_sized(alloc, NULL, size, &b);
+  create_view(alloc, backing, backing->data, size, out_b);
+
+  return SELENE_SUCCESS;
+}
 
-  /* TODO: pool allocator */
-  b->data = malloc(size);
+selene_error_t *sln_bucket_create_with_room(selene_alloc_t *alloc,
+                                            sln_bucket_t **out_b,
+                                            size_t headroom, size_t size,
+                                            size_t tailroom) {
+  sln_backing_t *backing = backing_create(alloc, headroom + size + tailroom);
 
-  *out_b = b;
+  create_view(alloc, backing, backing->data + headroom, size, out_b);
 
   return SELENE_SUCCESS;
 }
 
+/* Only memory allocated along with the backing, and seen by no other bucket,
+ * is ours to grow into */
+static int owns_backing(sln_bucket_t *b) {
+  return b->backing->refcount == 1 &&
+         b->backing->data == (char *)(b->backing + 1);
+}
+
+size_t sln_bucket_headroom(sln_bucket_t *b) {
+  if (!owns_backing(b)) {
+    return 0;
+  }
+
+  return b->data - b->backing->data;
+}
+
+size_t sln_bucket_tailroom(sln_bucket_t *b) {
+  if (!owns_backing(b)) {
+    return 0;
+  }
+
+  return (b->backing->data + b->backing->size) - (b->data + b->size);
+}
+
+void sln_bucket_grow(sln_bucket_t *b, size_t head, size_t tail) {
+  SLN_ASSERT(b->brigade == NULL);
+  SLN_ASSERT(head <= sln_bucket_headroom(b));
+  SLN_ASSERT(tail <= sln_bucket_tailroom(b));
+
+  b->data -= head;
+  b->size += head + tail;
+}
+
 selene_error_t *sln_bucket_create_from_bucket(selene_alloc_t *alloc,
                                               sln_bucket_t **out_b,
                                               sln_bucket_t *parent,
                                               size_t offset, size_t length) {
-  sln_bucket_t *b = NULL;
-
   SLN_ASSERT(parent->size >= offset + length);
 
-  create_sized(alloc, parent, length, &b);
+  if (SLN_BUCKET_TYPE(parent) == SLN_BUCKET_MEMORY) {
+    create_view(alloc, parent->backing, parent->data + offset, length, out_b);
+  } else {
+    create_view(alloc, parent->backing, NULL, length, out_b);
+    (*out_b)->offset = parent->offset + offset;
+  }
 
-  b->data = parent->data + offset;
+  return SELENE_SUCCESS;
+}
 
-  *out_b = b;
+selene_error_t *sln_bucket_create_file(selene_alloc_t *alloc,
+                                       sln_bucket_t **out_b,
+                                       sln_bucket_type_e type, int fd,
+                                       off_t offset, size_t length,
+                                       selene_io_release_cb *cb, void *baton) {
+  sln_backing_t *backing;
+
+  SLN_ASSERT(type == SLN_BUCKET_FILE || type == SLN_BUCKET_MMAP);
+
+  backing = backing_create(alloc, 0);
+  backing->size = length;
+  backing->data = NULL;
+  backing->fd = fd;
+  backing->release = cb;
+  backing->release_baton = baton;
+  backing->type = type;
+
+  create_view(alloc, backing, NULL, length, out_b);
+  (*out_b)->offset = offset;
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *file_read(sln_bucket_t *b, size_t length,
+                                 sln_bucket_t **out_b) {
+  ssize_t rv;
+  size_t done = 0;
+  sln_bucket_t *m = NULL;
+
+  SELENE_ERR(sln_bucket_create_empty(b->alloc, &m, length));
+
+  while (done < length) {
+    rv = pread(b->backing->fd, m->data + done, length - done,
+               b->offset + done);
+    if (rv < 0 && errno == EINTR) {
+      continue;
+    }
+    if (rv <= 0) {
+      sln_bucket_destroy(m);
+      return selene_error_createf(
+          SELENE_EIO, "Reading file bucket at offset %lu failed: %s",
+          (unsigned long)(b->offset + done),
+          rv == 0 ? "unexpected end of file" : strerror(errno));
+    }
+    done += rv;
+  }
+
+  *out_b = m;
+
+  return SELENE_SUCCESS;
+}
+
+static void mmap_release(void *baton) {
+  sln_backing_t *backing = (sln_backing_t *)baton;
+
+  munmap(backing->data, backing->size);
+}
+
+static selene_error_t *mmap_read(sln_bucket_t *b, size_t length,
+                                 sln_bucket_t **out_b) {
+  void *p;
+  sln_backing_t *backing;
+  /* mappings have to start on a page boundary */
+  size_t skew = b->offset % sysconf(_SC_PAGESIZE);
+
+  p = mmap(NULL, skew + length, PROT_READ, MAP_SHARED, b->backing->fd,
+           b->offset - skew);
+
+  if (p == MAP_FAILED) {
+    return selene_error_createf(
+        SELENE_EIO, "Mapping file bucket at offset %lu failed: %s",
+        (unsigned long)b->offset, strerror(errno));
+  }
+
+  /* a backing of its own, so the chunk is unmapped as soon as the record
+   * layer is done with it */
+  backing = backing_create(b->alloc, 0);
+  backing->size = skew + length;
+  backing->data = p;
+  backing->release = mmap_release;
+  backing->release_baton = backing;
+
+  create_view(b->alloc, backing, (char *)p + skew, length, out_b);
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_bucket_read(sln_bucket_t *b) {
+  int i;
+  size_t length;
+  sln_brigade_t *bb = b->brigade;
+  sln_bucket_t *m = NULL;
+
+  if (SLN_BUCKET_TYPE(b) == SLN_BUCKET_MEMORY) {
+    return SELENE_SUCCESS;
+  }
+
+  SLN_ASSERT(bb != NULL);
+
+  length = b->size < SLN_BUCKET_READ_SIZE ? b->size : SLN_BUCKET_READ_SIZE;
+
+  if (SLN_BUCKET_TYPE(b) == SLN_BUCKET_FILE) {
+    SELENE_ERR(file_read(b, length, &m));
+  } else {
+    SELENE_ERR(mmap_read(b, length, &m));
+  }
+
+  /* the bytes move from b to m, in front of it */
+  i = sln_brigade_index(bb, b);
+  sln_brigade_insert(bb, i, m);
+  b->size -= length;
+  b->offset += length;
+  SLN_BRIGADE_SLOT_UPDATE(bb, i + 1, b);
+
+  if (b->size == 0) {
+    sln_bucket_destroy(b);
+  }
 
   return SELENE_SUCCESS;
 }
@@ -95,42 +277,58 @@ selene_error_t *sln_bucket_create_copy_bytes(selene_alloc_t *alloc,
 selene_error_t *sln_bucket_create_with_bytes(selene_alloc_t *alloc,
                                              sln_bucket_t **out_b, char *bytes,
                                              size_t size) {
-  sln_bucket_t *b = NULL;
+  sln_backing_t *backing = backing_create(alloc, 0);
 
-  create_sized(alloc, NULL, size, &b);
+  backing->size = size;
+  backing->data = bytes;
 
-  b->memory_is_mine = 0;
-
-  b->data = bytes;
-
-  *out_b = b;
+  create_view(alloc, backing, bytes, size, out_b);
 
   return SELENE_SUCCESS;
 }
 
-void bucket_try_destroy(sln_bucket_t *b) {
-  sln_bucket_t *parent = b->parent;
-  b->refcount--;
+selene_error_t *sln_bucket_create_borrowed_iovec(selene_alloc_t *alloc,
+                                                 sln_brigade_t *bb,
+                                                 const struct iovec *vec,
+                                                 int iovcnt,
+                                                 selene_io_release_cb *cb,
+                                                 void *baton) {
+  int i;
+  size_t total = 0;
+  sln_bucket_t *b = NULL;
+  sln_backing_t *backing;
 
-  /* fprintf(stderr, "bucket_try_destroy: b: %p ref: %d  parent: %p\n",
-   * (void*)b, b->refcount, (void*)parent); */
-  if (b->refcount <= 0) {
-    if (b->memory_is_mine == 1 && b->data != NULL) {
-      b->alloc->free(b->alloc->baton, b->data);
-    }
+  for (i = 0; i < iovcnt; i++) {
+    total += vec[i].iov_len;
+  }
 
-    b->data = NULL;
+  /* the views point into the caller's buffers, spread out as they are */
+  backing = backing_create(alloc, 0);
+  backing->size = total;
+  backing->data = NULL;
+  backing->release = cb;
+  backing->release_baton = baton;
 
-    b->alloc->free(b->alloc->baton, b);
-  }
+  /* keep the backing alive while the views are created */
+  backing->refcount++;
 
-  if (parent) {
-    bucket_try_destroy(parent);
+  for (i = 0; i < iovcnt; i++) {
+    if (vec[i].iov_len == 0) {
+      continue;
+    }
+    create_view(alloc, backing, vec[i].iov_base, vec[i].iov_len, &b);
+    SLN_BRIGADE_INSERT_TAIL(bb, b);
   }
+
+  backing_release(backing);
+
+  return SELENE_SUCCESS;
 }
 
 void sln_bucket_destroy(sln_bucket_t *b) {
   SLN_BUCKET_REMOVE(b);
 
-  bucket_try_destroy(b);
+  backing_release(b->backing);
+
+  b->alloc->free(b->alloc->baton, b);
 }
@@ -18,12 +18,25 @@
 #include "selene.h"
 #include "sln_types.h"
 #include "sln_brigades.h"
+#include "sln_pool.h"
+#include <string.h>
+
+/* Reserved space is carved out of chunks with room for a full TLS record, so
+ * that a run of MSS sized reads lands back to back */
+#define SLN_IN_ENC_CHUNK_SIZE (16384 + 2048)
+
+/* Spare space left over after a commit is kept for the next reservation,
+ * unless it is too small to be worth a read() */
+#define SLN_IN_ENC_SPARE_MIN 256
 
 selene_error_t *sln_iobb_create(selene_alloc_t *alloc, sln_iobb_t *iobb) {
   SELENE_ERR(sln_brigade_create(alloc, &iobb->in_enc));
   SELENE_ERR(sln_brigade_create(alloc, &iobb->out_enc));
   SELENE_ERR(sln_brigade_create(alloc, &iobb->in_cleartext));
   SELENE_ERR(sln_brigade_create(alloc, &iobb->out_cleartext));
+  SELENE_ERR(sln_brigade_create(alloc, &iobb->in_enc_spare));
+  SELENE_ERR(sln_brigade_create(alloc, &iobb->out_enc_inflight));
+  iobb->in_enc_reserved = 0;
   return SELENE_SUCCESS;
 }
 
@@ -32,6 +45,8 @@ void sln_iobb_destroy(sln_iobb_t *iobb) {
   sln_brigade_destroy(iobb->out_enc);
   sln_brigade_destroy(iobb->in_cleartext);
   sln_brigade_destroy(iobb->out_cleartext);
+  sln_brigade_destroy(iobb->in_enc_spare);
+  sln_brigade_destroy(iobb->out_enc_inflight);
 }
 
 SELENE_API(selene_error_t *)
@@ -50,20 +65,80 @@ selene_io_in_clear_bytes(selene_t *s, const char *bytes, size_t length) {
 SELENE_API(selene_error_t *)
 selene_io_in_clear_iovec(selene_t *s, const struct iovec *vec, int iovcnt) {
   int i;
+  char *p;
+  size_t total = 0;
   sln_bucket_t *e = NULL;
 
-  /* TODO: possible to optimize this? */
   for (i = 0; i < iovcnt; i++) {
-    SELENE_ERR(sln_bucket_create_copy_bytes(s->alloc, &e, vec[i].iov_base,
-                                            vec[i].iov_len));
-    SLN_BRIGADE_INSERT_TAIL(s->bb.in_enc, e);
+    total += vec[i].iov_len;
+  }
+
+  /* one bucket for the lot, records are cut across them anyway */
+  SELENE_ERR(sln_bucket_create_empty(s->alloc, &e, total));
+
+  p = e->data;
+  for (i = 0; i < iovcnt; i++) {
+    memcpy(p, vec[i].iov_base, vec[i].iov_len);
+    p += vec[i].iov_len;
   }
 
+  SLN_BRIGADE_INSERT_TAIL(s->bb.in_cleartext, e);
+
   SELENE_ERR(selene_publish(s, SELENE_EVENT_IO_IN_CLEAR));
 
   return SELENE_SUCCESS;
 }
 
+SELENE_API(selene_error_t *)
+selene_io_in_clear_borrow(selene_t *s, const char *bytes, size_t length,
+                          selene_io_release_cb *cb, void *baton) {
+  struct iovec vec;
+
+  vec.iov_base = (void *)bytes;
+  vec.iov_len = length;
+
+  return selene_io_in_clear_borrow_iovec(s, &vec, 1, cb, baton);
+}
+
+SELENE_API(selene_error_t *)
+selene_io_in_clear_borrow_iovec(selene_t *s, const struct iovec *vec,
+                                int iovcnt, selene_io_release_cb *cb,
+                                void *baton) {
+  SELENE_ERR(sln_bucket_create_borrowed_iovec(s->alloc, s->bb.in_cleartext,
+                                              vec, iovcnt, cb, baton));
+
+  SELENE_ERR(selene_publish(s, SELENE_EVENT_IO_IN_CLEAR));
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *in_clear_file(selene_t *s, sln_bucket_type_e type,
+                                     int fd, off_t offset, size_t length,
+                                     selene_io_release_cb *cb, void *baton) {
+  sln_bucket_t *e = NULL;
+
+  SELENE_ERR(sln_bucket_create_file(s->alloc, &e, type, fd, offset, length, cb,
+                                    baton));
+
+  SLN_BRIGADE_INSERT_TAIL(s->bb.in_cleartext, e);
+
+  SELENE_ERR(selene_publish(s, SELENE_EVENT_IO_IN_CLEAR));
+
+  return SELENE_SUCCESS;
+}
+
+SELENE_API(selene_error_t *)
+selene_io_in_clear_file(selene_t *s, int fd, off_t offset, size_t length,
+                        selene_io_release_cb *cb, void *baton) {
+  return in_clear_file(s, SLN_BUCKET_FILE, fd, offset, length, cb, baton);
+}
+
+SELENE_API(selene_error_t *)
+selene_io_in_clear_mmap(selene_t *s, int fd, off_t offset, size_t length,
+                        selene_io_release_cb *cb, void *baton) {
+  return in_clear_file(s, SLN_BUCKET_MMAP, fd, offset, length, cb, baton);
+}
+
 SELENE_API(selene_error_t *)
 selene_io_in_enc_bytes(selene_t *s, const char *bytes, size_t length) {
   sln_bucket_t *e = NULL;
@@ -77,6 +152,113 @@ selene_io_in_enc_bytes(selene_t *s, const char *bytes, size_t length) {
   return SELENE_SUCCESS;
 }
 
+static selene_error_t *in_enc_spare_grow(selene_t *s, size_t size) {
+  sln_bucket_t *e = NULL;
+
+  size_t want = sizeof(sln_backing_t) + size;
+
+  if (want < SLN_IN_ENC_CHUNK_SIZE) {
+    want = SLN_IN_ENC_CHUNK_SIZE;
+  }
+
+  /* use all of the pool chunk the backing lands in */
+  size = sln_pool_usable_size(want) - sizeof(sln_backing_t);
+
+  SELENE_ERR(sln_bucket_create_empty(s->alloc, &e, size));
+
+  SLN_BRIGADE_INSERT_TAIL(s->bb.in_enc_spare, e);
+
+  return SELENE_SUCCESS;
+}
+
+SELENE_API(selene_error_t *)
+selene_io_in_enc_reserve_iovec(selene_t *s, size_t hint, struct iovec *vec,
+                               int *iovcnt) {
+  int i = 0;
+  size_t total = 0;
+  sln_bucket_t *e = NULL;
+  sln_brigade_t *spare = s->bb.in_enc_spare;
+
+  if (*iovcnt < 1) {
+    return selene_error_create(SELENE_EINVAL, "iovcnt must be at least 1");
+  }
+
+  /* any space at all will do */
+  if (hint == 0) {
+    hint = 1;
+  }
+
+  while (total < hint && i < *iovcnt) {
+    if (i == sln_brigade_bucket_count(spare)) {
+      SELENE_ERR(in_enc_spare_grow(s, hint - total));
+    }
+
+    e = SLN_BRIGADE_BUCKET(spare, i);
+    vec[i].iov_base = e->data;
+    vec[i].iov_len = e->size;
+    total += e->size;
+    i++;
+  }
+
+  *iovcnt = i;
+  s->bb.in_enc_reserved = total;
+
+  return SELENE_SUCCESS;
+}
+
+SELENE_API(selene_error_t *)
+selene_io_in_enc_reserve(selene_t *s, size_t hint, char **buf, size_t *len) {
+  int iovcnt = 1;
+  struct iovec vec;
+  sln_brigade_t *spare = s->bb.in_enc_spare;
+
+  /* a single buffer must hold the whole hint, so leftovers from an earlier
+   * reservation only do if they are large enough */
+  if (hint > 0 && !SLN_BRIGADE_EMPTY(spare) &&
+      SLN_BRIGADE_FIRST(spare)->size < hint) {
+    sln_brigade_clear(spare);
+  }
+
+  SELENE_ERR(selene_io_in_enc_reserve_iovec(s, hint, &vec, &iovcnt));
+
+  *buf = vec.iov_base;
+  *len = vec.iov_len;
+
+  return SELENE_SUCCESS;
+}
+
+SELENE_API(selene_error_t *)
+selene_io_in_enc_commit(selene_t *s, size_t length) {
+  sln_bucket_t *e = NULL;
+  sln_brigade_t *spare = s->bb.in_enc_spare;
+  size_t reserved = s->bb.in_enc_reserved;
+
+  s->bb.in_enc_reserved = 0;
+
+  if (length > reserved) {
+    return selene_error_createf(
+        SELENE_EINVAL, "Committing %lu bytes, but only %lu reserved",
+        (unsigned long)length, (unsigned long)reserved);
+  }
+
+  if (length == 0) {
+    return SELENE_SUCCESS;
+  }
+
+  SELENE_ERR(sln_brigade_splice_into(spare, length, s->bb.in_enc));
+
+  if (!SLN_BRIGADE_EMPTY(spare)) {
+    e = SLN_BRIGADE_FIRST(spare);
+    if (e->size < SLN_IN_ENC_SPARE_MIN) {
+      sln_bucket_destroy(e);
+    }
+  }
+
+  SELENE_ERR(selene_publish(s, SELENE_EVENT_IO_IN_ENC));
+
+  return SELENE_SUCCESS;
+}
+
 static selene_error_t *bb_chomp_to_buffer(selene_t *s, sln_brigade_t *bb,
                                           char *buffer, size_t blen,
                                           size_t *length, size_t *remaining) {
@@ -107,3 +289,57 @@ selene_io_out_enc_bytes(selene_t *s, char *buffer, size_t blen, size_t *length,
                         size_t *remaining) {
   return bb_chomp_to_buffer(s, s->bb.out_enc, buffer, blen, length, remaining);
 }
+
+SELENE_API(selene_error_t *)
+selene_io_out_enc_peek_iovec(selene_t *s, struct iovec *vec, int max,
+                             int *count) {
+  int i;
+  sln_brigade_slot_t *slot;
+
+  for (i = 0; i < max && i < sln_brigade_bucket_count(s->bb.out_enc); i++) {
+    slot = SLN_BRIGADE_SLOT(s->bb.out_enc, i);
+    vec[i].iov_base = slot->data;
+    vec[i].iov_len = slot->size;
+  }
+
+  *count = i;
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *out_enc_check_length(selene_t *s, size_t length) {
+  if (length > sln_brigade_size(s->bb.out_enc)) {
+    return selene_error_createf(
+        SELENE_EINVAL, "Consuming %lu bytes, but only %lu are waiting",
+        (unsigned long)length, (unsigned long)sln_brigade_size(s->bb.out_enc));
+  }
+
+  return SELENE_SUCCESS;
+}
+
+SELENE_API(selene_error_t *)
+selene_io_out_enc_consume(selene_t *s, size_t length) {
+  SELENE_ERR(out_enc_check_length(s, length));
+
+  return sln_brigade_chomp(s->bb.out_enc, length);
+}
+
+SELENE_API(selene_error_t *)
+selene_io_out_enc_consume_deferred(selene_t *s, size_t length) {
+  SELENE_ERR(out_enc_check_length(s, length));
+
+  return sln_brigade_splice_into(s->bb.out_enc, length,
+                                 s->bb.out_enc_inflight);
+}
+
+SELENE_API(selene_error_t *)
+selene_io_out_enc_release(selene_t *s, size_t length) {
+  if (length > sln_brigade_size(s->bb.out_enc_inflight)) {
+    return selene_error_createf(
+        SELENE_EINVAL, "Releasing %lu bytes, but only %lu are in flight",
+        (unsigned long)length,
+        (unsigned long)sln_brigade_size(s->bb.out_enc_inflight));
+  }
+
+  return sln_brigade_chomp(s->bb.out_enc_inflight, length);
+}
@@ -22,127 +22,146 @@
 #include "sln_tok.h"
 #include "sln_assert.h"
 
-selene_error_t *sln_tok_parser(sln_brigade_t *bb, sln_tok_cb cb, void *baton) {
-  int keepgoing = 1;
-  selene_error_t *err = SELENE_SUCCESS;
-  sln_tok_value_t tvalue;
-  size_t rlen;
-  size_t offset = 0;
-  sln_brigade_t *tmpbb = NULL;
+void sln_tok_parser_init(sln_tok_parser_t *tok) {
+  memset(tok, 0, sizeof(*tok));
+  tok->value.next = TOK_INIT;
+}
 
-  memset(&tvalue, 0, sizeof(tvalue));
+void sln_tok_parser_reset(sln_tok_parser_t *tok) {
+  sln_brigade_t *tmpbb = tok->tmpbb;
 
-  tvalue.next = TOK_INIT;
+  sln_tok_parser_init(tok);
 
-  while (keepgoing == 1) {
-    tvalue.current = tvalue.next;
+  if (tmpbb != NULL) {
+    sln_brigade_clear(tmpbb);
+    tok->tmpbb = tmpbb;
+  }
+}
 
-    err = cb(&tvalue, baton);
+void sln_tok_parser_destroy(sln_tok_parser_t *tok) {
+  if (tok->tmpbb != NULL) {
+    sln_brigade_destroy(tok->tmpbb);
+    tok->tmpbb = NULL;
+  }
+}
 
-    if (err) {
-      break;
-    }
+selene_error_t *sln_tok_parser_resume(sln_tok_parser_t *tok, sln_brigade_t *bb,
+                                      sln_tok_cb cb, void *baton) {
+  selene_error_t *err = SELENE_SUCCESS;
+  sln_tok_value_t *tvalue = &tok->value;
+  size_t rlen;
 
-    switch (tvalue.next) {
+  if (tok->cursor.bb != bb) {
+    sln_brigade_cursor_init(bb, &tok->cursor);
+  }
+
+  while (1) {
+    /* Fill in the token the callback asked for, or stop where we are until
+     * more data arrives. */
+    switch (tvalue->next) {
       case TOK__UNUSED:
       case TOK__MAX:
-      case TOK_INIT:
       case TOK_DONE:
-        keepgoing = 0;
+        return SELENE_SUCCESS;
+
+      case TOK_INIT:
+        if (tok->steps != 0) {
+          return SELENE_SUCCESS;
+        }
         break;
 
       case TOK_SKIP:
-        if (tvalue.wantlen > sln_brigade_size(bb)) {
-          keepgoing = 0;
-          break;
+        if (tok->offset + tvalue->wantlen > sln_brigade_size(bb)) {
+          return SELENE_SUCCESS;
         }
         break;
 
       case TOK_UINT16:
-        SLN_ASSERT(tvalue.wantlen == 2);
+        SLN_ASSERT(tvalue->wantlen == 2);
 
-        err = sln_brigade_pread_bytes(bb, offset, tvalue.wantlen,
-                                      &tvalue.v.bytes[0], &rlen);
-        if (err) {
-          keepgoing = 0;
-          break;
-        }
+        SELENE_ERR(sln_brigade_cursor_pread_bytes(&tok->cursor, tok->offset,
+                                                  tvalue->wantlen,
+                                                  &tvalue->v.bytes[0], &rlen));
 
-        if (rlen != tvalue.wantlen) {
-          keepgoing = 0;
-          break;
+        if (rlen != tvalue->wantlen) {
+          return SELENE_SUCCESS;
         }
 
-        tvalue.v.uint16 = (((unsigned char)tvalue.v.bytes[0]) << 8 |
-                           ((unsigned char)tvalue.v.bytes[1]));
+        tvalue->v.uint16 = (((unsigned char)tvalue->v.bytes[0]) << 8 |
+                            ((unsigned char)tvalue->v.bytes[1]));
         break;
+
       case TOK_UINT24:
-        SLN_ASSERT(tvalue.wantlen == 3);
+        SLN_ASSERT(tvalue->wantlen == 3);
 
-        err = sln_brigade_pread_bytes(bb, offset, tvalue.wantlen,
-                                      &tvalue.v.bytes[0], &rlen);
-        if (err) {
-          keepgoing = 0;
-          break;
-        }
+        SELENE_ERR(sln_brigade_cursor_pread_bytes(&tok->cursor, tok->offset,
+                                                  tvalue->wantlen,
+                                                  &tvalue->v.bytes[0], &rlen));
 
-        if (rlen != tvalue.wantlen) {
-          keepgoing = 0;
-          break;
+        if (rlen != tvalue->wantlen) {
+          return SELENE_SUCCESS;
         }
 
-        tvalue.v.uint24 = (((unsigned char)tvalue.v.bytes[0]) << 16 |
-                           ((unsigned char)tvalue.v.bytes[1]) << 8 |
-                           ((unsigned char)tvalue.v.bytes[2]));
+        tvalue->v.uint24 = (((unsigned char)tvalue->v.bytes[0]) << 16 |
+                            ((unsigned char)tvalue->v.bytes[1]) << 8 |
+                            ((unsigned char)tvalue->v.bytes[2]));
         break;
 
       case TOK_COPY_BYTES:
-        SLN_ASSERT(tvalue.wantlen <= SLN_TOK_VALUE_MAX_BYTE_COPY_LEN);
+        SLN_ASSERT(tvalue->wantlen <= SLN_TOK_VALUE_MAX_BYTE_COPY_LEN);
 
-        err = sln_brigade_pread_bytes(bb, offset, tvalue.wantlen,
-                                      &tvalue.v.bytes[0], &rlen);
-        if (err) {
-          keepgoing = 0;
-          break;
-        }
-        if (rlen != tvalue.wantlen) {
-          keepgoing = 0;
+        SELENE_ERR(sln_brigade_cursor_pread_bytes(&tok->cursor, tok->offset,
+                                                  tvalue->wantlen,
+                                                  &tvalue->v.bytes[0], &rlen));
+
+        if (rlen != tvalue->wantlen) {
+          return SELENE_SUCCESS;
         }
         break;
 
       case TOK_COPY_BRIGADE:
-
-        if (tvalue.wantlen > sln_brigade_size(bb)) {
-          keepgoing = 0;
-          break;
+        if (tok->offset + tvalue->wantlen > sln_brigade_size(bb)) {
+          return SELENE_SUCCESS;
         }
 
-        if (tmpbb == NULL) {
-          err = sln_brigade_create(bb->alloc, &tmpbb);
-          if (err) {
-            keepgoing = 0;
-            break;
-          }
+        if (tok->tmpbb == NULL) {
+          SELENE_ERR(sln_brigade_create(bb->alloc, &tok->tmpbb));
         } else {
-          sln_brigade_clear(tmpbb);
+          sln_brigade_clear(tok->tmpbb);
         }
 
-        tvalue.v.bb = tmpbb;
+        tvalue->v.bb = tok->tmpbb;
         /* TODO: optimization, this isn't required */
-        err = sln_brigade_copy_into(bb, offset, tvalue.wantlen, tmpbb);
-        if (err) {
-          keepgoing = 0;
-          break;
-        }
+        SELENE_ERR(sln_brigade_cursor_copy_into(&tok->cursor, tok->offset,
+                                                tvalue->wantlen, tok->tmpbb));
         break;
     }
-    offset += tvalue.wantlen;
-    tvalue.current = TOK__UNUSED;
-  }
 
-  if (tmpbb != NULL) {
-    sln_brigade_destroy(tmpbb);
+    tok->offset += tvalue->wantlen;
+    tvalue->current = tvalue->next;
+    tok->steps++;
+
+    err = cb(tvalue, baton);
+
+    tvalue->current = TOK__UNUSED;
+
+    if (err) {
+      return err;
+    }
   }
 
   return err;
 }
+
+selene_error_t *sln_tok_parser(sln_brigade_t *bb, sln_tok_cb cb, void *baton) {
+  selene_error_t *err;
+  sln_tok_parser_t tok;
+
+  sln_tok_parser_init(&tok);
+
+  err = sln_tok_parser_resume(&tok, bb, cb, baton);
+
+  sln_tok_parser_destroy(&tok);
+
+  return err;
+}
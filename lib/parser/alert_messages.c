@@ -23,7 +23,7 @@ selene_error_t *sln_alert_serialize(selene_t *s, sln_msg_alert_t *alert,
   sln_bucket_t *b = NULL;
   size_t len = 2;
 
-  sln_bucket_create_empty(s->alloc, &b, len);
+  sln_tls_record_create(s, len, &b);
 
   b->data[0] = alert->level;
   b->data[1] = alert->description;
@@ -18,15 +18,329 @@
 #include "parser.h"
 #include "common.h"
 #include "handshake_messages.h"
+#include "alert_messages.h"
 #include "sln_tok.h"
 #include "sln_arrays.h"
 #include "sln_rsa.h"
+#include "sln_prf.h"
+#include "sln_sessions.h"
+#include "sln_tickets.h"
 #include <string.h>
+#include <time.h>
+
+/* Sends a fatal alert, and fails the connection with err */
+static selene_error_t *handshake_abort(selene_t *s,
+                                       sln_alert_description_e desc,
+                                       selene_error_t *err) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  selene_error_t *aerr;
+
+  aerr = sln_io_alert_fatal(s, desc);
+  if (aerr) {
+    selene_error_clear(aerr);
+  }
+
+  /* RFC 4346, Section 7.2.2: sessions of a failed connection are not to be
+   * resumed */
+  if (s->mode == SLN_MODE_CLIENT) {
+    sln_client_session_forget(s);
+  }
+
+  baton->connstate = SLN_CONNSTATE_ALERT_FATAL;
+  if (baton->fatal_err == SELENE_SUCCESS) {
+    baton->fatal_err = selene_error_dup(err);
+  }
+
+  return err;
+}
+
+static selene_error_t *unexpected_message(selene_t *s, const char *msg) {
+  return handshake_abort(
+      s, SLN_ALERT_DESC_UNEXPECTED_MESSAGE,
+      selene_error_createf(SELENE_EINVAL, "Unexpected %s", msg));
+}
+
+static int suite_listed(selene_cipher_suite_list_t *ciphers,
+                        selene_cipher_suite_e suite) {
+  int i;
+
+  for (i = 0; i < ciphers->used; i++) {
+    if (ciphers->ciphers[i] == (int)suite) {
+      return 1;
+    }
+  }
+
+  return 0;
+}
+
+/* The first suite of our own list the client offered as well, and we can
+ * use */
+static selene_cipher_suite_e select_suite(selene_t *s,
+                                          selene_cipher_suite_list_t *offered) {
+  selene_cipher_suite_list_t *ours = &s->conf->ciphers;
+  int i;
+
+  if (offered == NULL) {
+    return SELENE_CS__UNUSED0;
+  }
+
+  for (i = 0; i < ours->used; i++) {
+    if (suite_listed(offered, ours->ciphers[i]) &&
+        sln_tls_suite_available(s, ours->ciphers[i])) {
+      return ours->ciphers[i];
+    }
+  }
+
+  return SELENE_CS__UNUSED0;
+}
+
+/* RFC 4346, Section 8.1:
+ *
+ * master_secret = PRF(pre_master_secret, "master secret",
+ *                     ClientHello.random + ServerHello.random) [0..47];
+ */
+static selene_error_t *compute_master_secret(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  selene_error_t *err;
+
+  err = sln_prf(s, "master secret", strlen("master secret"),
+                baton->pre_master_secret, SLN_SECRET_LENGTH,
+                (const char *)&baton->client_utc_unix_time, 64,
+                baton->master_secret, SLN_SECRET_LENGTH);
+
+  memset(baton->pre_master_secret, 0, SLN_SECRET_LENGTH);
+
+  return err;
+}
+
+static selene_error_t *send_change_cipher_spec(selene_t *s) {
+  sln_msg_change_cipher_spec_t ccs;
+  sln_bucket_t *bccs = NULL;
+
+  slnDbg(s, "sending change cipher spec");
+
+  SELENE_ERR(sln_handshake_serialize_change_cipher_spec(s, &ccs, &bccs));
+
+  SELENE_ERR(sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_CHANGE_CIPHER_SPEC, bccs));
+
+  /* the Finished that follows is the first record under the new keys */
+  sln_tls_params_activate_send(s);
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *send_finished(selene_t *s) {
+  sln_msg_finished_t fin;
+  sln_bucket_t *bfin = NULL;
+
+  slnDbg(s, "sending finished");
+
+  SELENE_ERR(sln_handshake_finished_vdata(s, s->mode, fin.vdata));
+
+  SELENE_ERR(sln_handshake_serialize_finished(s, &fin, &bfin));
+
+  SELENE_ERR(sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_HANDSHAKE, bfin));
+
+  return SELENE_SUCCESS;
+}
+
+/* Both Finished went through, application data may flow */
+static selene_error_t *handshake_done(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+
+  if (s->mode == SLN_MODE_CLIENT) {
+    baton->handshake = SLN_HANDSHAKE_CLIENT_APPDATA;
+  } else {
+    baton->handshake = SLN_HANDSHAKE_SERVER_APPDATA;
+  }
+
+  baton->ready_for_appdata = 1;
+
+  memcpy(baton->session.master_secret, baton->master_secret,
+         SLN_SECRET_LENGTH);
+
+  s->session = sln_alloc(s, sizeof(selene_session_t));
+  memcpy(s->session, &baton->session, sizeof(selene_session_t));
+  s->session_resumed = baton->resumed;
+
+  memset(baton->session.master_secret, 0, SLN_SECRET_LENGTH);
+
+  if (s->mode == SLN_MODE_SERVER && !baton->resumed &&
+      s->session->id_len != 0) {
+    SELENE_ERR(selene_publish(s, SELENE_EVENT_SESSION_STORE));
+  }
+
+  slnDbg(s, "handshake done, resumed: %d", baton->resumed);
+
+  if (s->mode == SLN_MODE_CLIENT) {
+    return sln_client_session_store(s);
+  }
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *send_server_hello(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_msg_server_hello_t sh;
+  sln_bucket_t *bhs = NULL;
+
+  sh.version_major = baton->session.version_major;
+  sh.version_minor = baton->session.version_minor;
+  sh.utc_unix_time = time(NULL);
+  sln_parser_rand_bytes_secure(&sh.random_bytes[0], sizeof(sh.random_bytes));
+  sln_parser_hs_random(sh.utc_unix_time, sh.random_bytes,
+                       (char *)&baton->server_utc_unix_time);
+
+  sh.session_id_len = baton->session.id_len;
+  memcpy(&sh.session_id[0], baton->session.id, baton->session.id_len);
+  sh.cipher = baton->session.suite;
+  sh.comp = SELENE_COMP_NULL;
+  sh.have_ticket_ext = baton->ticket_expected;
+
+  SELENE_ERR(sln_handshake_serialize_server_hello(s, &sh, &bhs));
+
+  return sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_HANDSHAKE, bhs);
+}
+
+/* RFC 5077, Section 3.3: the session we just set up, or resumed, sealed
+ * for the client to keep */
+static selene_error_t *send_new_session_ticket(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_msg_new_session_ticket_t nst;
+  sln_bucket_t *bnst = NULL;
+  selene_session_t sealed;
+  char ticket[SLN_TICKET_LENGTH];
+  selene_error_t *err;
+
+  slnDbg(s, "sending new session ticket");
+
+  memcpy(&sealed, &baton->session, sizeof(sealed));
+  memcpy(sealed.master_secret, baton->master_secret, SLN_SECRET_LENGTH);
+
+  err = sln_ticket_seal(s, &sealed, ticket);
+
+  memset(&sealed, 0, sizeof(sealed));
+
+  if (err) {
+    return err;
+  }
+
+  nst.lifetime_hint = s->conf->ticket_lifetime;
+  nst.ticket_len = sizeof(ticket);
+  nst.ticket = ticket;
+
+  SELENE_ERR(sln_handshake_serialize_new_session_ticket(s, &nst, &bnst));
+
+  return sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_HANDSHAKE, bnst);
+}
+
+static int tickets_enabled(selene_t *s) {
+  return s->conf->ticket_lifetime > 0 && s->conf->ticket_keys != NULL;
+}
+
+/* default fallback */
+static selene_error_t *store_session(selene_t *s, selene_event_e event,
+                                     void *baton) {
+  if (s->conf->session_cache != NULL) {
+    sln_session_cache_put(s->conf->session_cache, s->session->id,
+                          s->session->id_len, s->session);
+  }
+
+  return SELENE_SUCCESS;
+}
+
+/* Only worth naming sessions if they can be resumed by ID, from our cache
+ * or the application's */
+static int ids_enabled(selene_t *s) {
+  return s->conf->session_cache != NULL ||
+         s->events[SELENE_EVENT_SESSION_STORE].handler != store_session;
+}
+
+/* Resumes cached, the session the client asked for, if the client can still
+ * use it.  Sets resumed if it answered with an abbreviated handshake, and
+ * wipes cached either way. */
+static selene_error_t *resume_session(selene_t *s, selene_session_t *cached,
+                                      int renew, int *resumed) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  selene_session_t *session = &baton->session;
+
+  *resumed = 0;
+
+  if (cached->version_major != session->version_major ||
+      cached->version_minor != session->version_minor ||
+      !suite_listed(&baton->offered_ciphers, cached->suite) ||
+      !sln_tls_suite_available(s, cached->suite)) {
+    memset(cached, 0, sizeof(*cached));
+    return SELENE_SUCCESS;
+  }
+
+  slnDbg(s, "resuming session");
+
+  /* the ID tells the client whether the server took its ticket */
+  cached->id_len = session->id_len;
+  memcpy(cached->id, session->id, session->id_len);
+
+  memcpy(session, cached, sizeof(*cached));
+  memcpy(baton->master_secret, cached->master_secret, SLN_SECRET_LENGTH);
+  memset(session->master_secret, 0, SLN_SECRET_LENGTH);
+  memset(cached, 0, sizeof(*cached));
+
+  baton->resumed = 1;
+  s->my_certs = session->chain;
+  *resumed = 1;
+
+  /* tickets sealed with the key on its way out get one with the new key */
+  baton->ticket_expected = renew;
+
+  SELENE_ERR(send_server_hello(s));
+  if (baton->ticket_expected) {
+    SELENE_ERR(send_new_session_ticket(s));
+  }
+  SELENE_ERR(sln_tls_params_init(s, session->suite));
+  SELENE_ERR(send_change_cipher_spec(s));
+  SELENE_ERR(send_finished(s));
+
+  baton->handshake = SLN_HANDSHAKE_SERVER_WAIT_CLIENT_FINISHED;
+
+  return SELENE_SUCCESS;
+}
+
+/* Sets up a new session, and has the application pick the certificates for
+ * it */
+static selene_error_t *full_handshake(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  selene_session_t *session = &baton->session;
+
+  session->suite = select_suite(s, &baton->offered_ciphers);
+  if (session->suite == SELENE_CS__UNUSED0) {
+    return handshake_abort(
+        s, SLN_ALERT_DESC_HANDSHAKE_FAILURE,
+        selene_error_create(SELENE_EINVAL,
+                            "No cipher suite in common with the client"));
+  }
+
+  baton->ticket_expected = baton->client_ticket_ext && tickets_enabled(s);
+
+  if (ids_enabled(s)) {
+    session->id_len = SLN_SESSION_ID_MAX_LENGTH;
+    sln_parser_rand_bytes_secure(session->id, session->id_len);
+  } else {
+    session->id_len = 0;
+  }
+  session->created = time(NULL);
+
+  return selene_publish(s, SELENE_EVENT_SELECT_CERTIFICATES);
+}
 
 static selene_error_t *handle_client_hello(selene_t *s, selene_event_e event,
                                            void *baton_) {
   sln_parser_baton_t *baton = s->backend_baton;
   sln_msg_client_hello_t *ch = baton->msg.client_hello;
+  selene_session_t *session = &baton->session;
+  selene_session_t cached;
+  int found = 0;
+  int renew = 0;
+  int resumed;
 
   if (ch->version_major < SLN_PARSER_VERSION_MAJOR_MIN) {
     /* Disable SSLv2 and 'older' */
@@ -34,9 +348,127 @@ static selene_error_t *handle_client_hello(selene_t *s, selene_event_e event,
     return SELENE_SUCCESS;
   }
 
+  if (baton->handshake != SLN_HANDSHAKE_SERVER_WAIT_CLIENT_HELLO ||
+      session->suite != SELENE_CS__UNUSED0 || baton->session_lookup) {
+    return unexpected_message(s, "ClientHello");
+  }
+
   /* TODO: validate other parameters / extensions */
 
-  return selene_publish(s, SELENE_EVENT_SELECT_CERTIFICATES);
+  baton->client_version_major = ch->version_major;
+  baton->client_version_minor = ch->version_minor;
+  /* already in wire order */
+  memcpy(&baton->client_utc_unix_time, &ch->utc_unix_time, 4);
+  memcpy(baton->client_random_bytes, ch->random_bytes, 28);
+
+  /* the message is gone by the time a session lookup is answered */
+  baton->client_ticket_ext = ch->have_ticket_ext;
+  if (ch->ciphers != NULL) {
+    memcpy(&baton->offered_ciphers, ch->ciphers,
+           sizeof(selene_cipher_suite_list_t));
+  }
+
+  sln_parser_tls_set_current_version(s, &session->version_major,
+                                     &session->version_minor);
+
+  session->id_len = ch->session_id_len;
+  memcpy(session->id, ch->session_id, ch->session_id_len);
+
+  /* RFC 5077, Section 3.4: a ticket may come with no session ID, the
+   * ChangeCipherSpec right after our ServerHello tells the client then */
+  if (ch->ticket_len != 0 && tickets_enabled(s)) {
+    SELENE_ERR(sln_ticket_open(s, ch->ticket, ch->ticket_len, time(NULL),
+                               &cached, &found, &renew));
+    if (found) {
+      SELENE_ERR(resume_session(s, &cached, renew, &resumed));
+      if (resumed) {
+        return SELENE_SUCCESS;
+      }
+    }
+  }
+
+  if (ch->session_id_len == 0) {
+    return full_handshake(s);
+  }
+
+  baton->session_lookup = 1;
+  SELENE_ERR(selene_publish(s, SELENE_EVENT_SESSION_LOOKUP));
+
+  /* answered right away, and it failed */
+  if (baton->fatal_err != SELENE_SUCCESS) {
+    return selene_error_dup(baton->fatal_err);
+  }
+
+  return SELENE_SUCCESS;
+}
+
+void selene_session_lookup_id(selene_t *s, const char **id, size_t *len) {
+  sln_parser_baton_t *baton = s->backend_baton;
+
+  *id = baton->session.id;
+  *len = baton->session_lookup ? baton->session.id_len : 0;
+}
+
+void selene_complete_session_lookup(selene_t *s,
+                                    const selene_session_t *session) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  selene_session_t cached;
+  selene_error_t *err;
+  int resumed = 0;
+
+  if (baton->fatal_err || !baton->session_lookup) {
+    return;
+  }
+
+  baton->session_lookup = 0;
+
+  /* the certificates may be selected right away, the state machine runs
+   * once for both */
+  baton->depth++;
+  if (session != NULL) {
+    memcpy(&cached, session, sizeof(cached));
+    err = resume_session(s, &cached, 0, &resumed);
+  } else {
+    err = SELENE_SUCCESS;
+  }
+  if (err == SELENE_SUCCESS && !resumed) {
+    err = full_handshake(s);
+  }
+  baton->depth--;
+
+  /* Completed later on, outside of the state machine: run it for whatever
+   * came in meanwhile */
+  if (err == SELENE_SUCCESS && baton->fatal_err == SELENE_SUCCESS &&
+      baton->depth == 0) {
+    err = sln_state_machine(s, baton);
+  }
+
+  if (err != SELENE_SUCCESS && baton->fatal_err == SELENE_SUCCESS) {
+    baton->fatal_err = err;
+  } else if (err != SELENE_SUCCESS) {
+    selene_error_clear(err);
+  }
+}
+
+/* default fallback, the session cache of the conf */
+static selene_error_t *lookup_session(selene_t *s, selene_event_e event,
+                                      void *baton) {
+  sln_session_cache_t *cache = s->conf->session_cache;
+  selene_session_t cached;
+  const char *id;
+  size_t len;
+
+  selene_session_lookup_id(s, &id, &len);
+
+  if (cache != NULL &&
+      sln_session_cache_get(cache, id, len, time(NULL), &cached)) {
+    selene_complete_session_lookup(s, &cached);
+    memset(&cached, 0, sizeof(cached));
+  } else {
+    selene_complete_session_lookup(s, NULL);
+  }
+
+  return SELENE_SUCCESS;
 }
 
 /* default fallback */
@@ -55,26 +487,16 @@ static selene_error_t *send_server_certs(selene_t *s) {
 
   SLN_ASSERT(s->my_certs != NULL);
 
-  /* TODO: move to post-finding certificate callback */
-  {
-    sln_msg_server_hello_t sh;
-    sln_bucket_t *bhs = NULL;
-
-    sln_parser_tls_max_supported_version(s, &sh.version_major,
-                                         &sh.version_minor);
-    sh.utc_unix_time = time(NULL);
-    sln_parser_rand_bytes_secure(&sh.random_bytes[0], sizeof(sh.random_bytes));
-    /* TODO: session ID lookup */
-    sh.session_id_len = 0;
-    /* TODO: select from client suggested ciphers in the order of our own cipher
-     * list. */
-    sh.cipher = SELENE_CS_RSA_WITH_RC4_128_SHA;
-    SELENE_ERR(sln_handshake_serialize_server_hello(s, &sh, &bhs));
+  if (s->my_certs->privkey == NULL) {
+    return handshake_abort(
+        s, SLN_ALERT_DESC_INTERNAL_ERROR,
+        selene_error_create(SELENE_EINVAL,
+                            "Selected certificate chain has no private key"));
+  }
 
-    /* TODO: create certificate message for non-PSK ciphers */
+  baton->session.chain = s->my_certs;
 
-    SELENE_ERR(sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_HANDSHAKE, bhs));
-  }
+  SELENE_ERR(send_server_hello(s));
 
   {
     /* TODO: more handshake extensions, client certificate request support */
@@ -98,7 +520,7 @@ static selene_error_t *send_server_certs(selene_t *s) {
 
   baton->handshake = SLN_HANDSHAKE_SERVER_WAIT_CLIENT_FINISHED;
 
-  return sln_state_machine(s, baton);
+  return SELENE_SUCCESS;
 }
 
 void selene_complete_select_certificates(selene_t *s,
@@ -113,6 +535,11 @@ void selene_complete_select_certificates(selene_t *s,
 
   if (s->my_certs != NULL) {
     baton->fatal_err = send_server_certs(s);
+    /* Completed later on, outside of the state machine: run it for
+     * whatever came in meanwhile */
+    if (baton->fatal_err == SELENE_SUCCESS && baton->depth == 0) {
+      baton->fatal_err = sln_state_machine(s, baton);
+    }
   } else {
     baton->fatal_err = selene_error_create(
         SELENE_EINVAL,
@@ -120,6 +547,62 @@ void selene_complete_select_certificates(selene_t *s,
   }
 }
 
+static selene_error_t *handle_client_key_exchange(selene_t *s,
+                                                  selene_event_e event,
+                                                  void *x) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_msg_client_key_exchange_t *cke = baton->msg.client_key_exchange;
+  sln_privkey_t *key = s->my_certs != NULL ? s->my_certs->privkey : NULL;
+  selene_error_t *err;
+  char fallback[SLN_SECRET_LENGTH];
+  char *plain;
+  size_t plainsize;
+  size_t plainlen = 0;
+  unsigned char mask;
+  int i;
+
+  if (baton->handshake != SLN_HANDSHAKE_SERVER_WAIT_CLIENT_FINISHED ||
+      baton->resumed || key == NULL ||
+      baton->pending_recv_parameters.suite != SELENE_CS__UNUSED0) {
+    return unexpected_message(s, "ClientKeyExchange");
+  }
+
+  /* RFC 4346, Section 7.4.7.1: a badly encrypted secret must look no
+   * different from a good one, carry on with a random one instead, the
+   * Finished fails later on */
+  sln_parser_rand_bytes_secure(fallback, sizeof(fallback));
+
+  plainsize = sln_rsa_private_size(key);
+  plain = sln_calloc(s, plainsize);
+
+  err = sln_rsa_private_decrypt(s, key, cke->pre_master_secret,
+                                cke->pre_master_secret_length, plain,
+                                &plainlen);
+  if (err) {
+    selene_error_clear(err);
+    plainlen = 0;
+  }
+
+  mask = (plainlen == SLN_SECRET_LENGTH &&
+          (uint8_t)plain[0] == baton->client_version_major &&
+          (uint8_t)plain[1] == baton->client_version_minor)
+             ? 0xFF
+             : 0x00;
+
+  for (i = 0; i < SLN_SECRET_LENGTH; i++) {
+    baton->pre_master_secret[i] =
+        (plain[i] & mask) | (fallback[i] & (unsigned char)~mask);
+  }
+
+  memset(plain, 0, plainsize);
+  sln_free(s, plain);
+  memset(fallback, 0, sizeof(fallback));
+
+  SELENE_ERR(compute_master_secret(s));
+
+  return sln_tls_params_init(s, baton->session.suite);
+}
+
 selene_cert_chain_t *selene_peer_certchain(selene_t *s) {
   return s->peer_certs;
 }
@@ -152,11 +635,126 @@ static selene_error_t *validate_certificate(selene_t *s, selene_event_e event,
   return SELENE_SUCCESS;
 }
 
+/* The server resumed the session we offered, the abbreviated handshake
+ * follows */
+static selene_error_t *resume_offer(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  selene_session_t *session = &baton->session;
+  selene_session_t *offer = s->offered_session;
+
+  baton->ticket_pending = 0;
+
+  if (offer->suite != session->suite) {
+    return handshake_abort(
+        s, SLN_ALERT_DESC_ILLEGAL_PARAMETER,
+        selene_error_create(SELENE_EINVAL,
+                            "Server resumed a session with another suite"));
+  }
+
+  slnDbg(s, "server resumed our session");
+
+  baton->resumed = 1;
+  session->created = offer->created;
+  memcpy(baton->master_secret, offer->master_secret, SLN_SECRET_LENGTH);
+  /* kept unless a NewSessionTicket replaces it */
+  session->ticket_lifetime_hint = offer->ticket_lifetime_hint;
+  session->ticket_len = offer->ticket_len;
+  memcpy(session->ticket, offer->ticket, offer->ticket_len);
+
+  SELENE_ERR(sln_tls_params_init(s, session->suite));
+
+  baton->handshake = SLN_HANDSHAKE_CLIENT_WAIT_SERVER_FINISHED;
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_handshake_peer_change_cipher_spec(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+
+  if (!baton->ticket_pending) {
+    return SELENE_SUCCESS;
+  }
+
+  return resume_offer(s);
+}
+
+static selene_error_t *handle_server_hello(selene_t *s, selene_event_e event,
+                                           void *x) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_msg_server_hello_t *sh = baton->msg.server_hello;
+  selene_session_t *session = &baton->session;
+  selene_session_t *offer = s->offered_session;
+
+  if (baton->handshake != SLN_HANDSHAKE_CLIENT_WAIT_SERVER_HELLO_DONE ||
+      session->suite != SELENE_CS__UNUSED0) {
+    return unexpected_message(s, "ServerHello");
+  }
+
+  sln_parser_tls_set_current_version(s, &session->version_major,
+                                     &session->version_minor);
+
+  if (sh->version_major != session->version_major ||
+      sh->version_minor != session->version_minor) {
+    return handshake_abort(
+        s, SLN_ALERT_DESC_PROTOCOL_VERSION,
+        selene_error_createf(SELENE_EINVAL, "Unsupported server version %u.%u",
+                             sh->version_major, sh->version_minor));
+  }
+
+  /* we always send the extension, the server may answer it */
+  baton->ticket_expected = sh->have_ticket_ext;
+
+  if (!suite_listed(&s->conf->ciphers, sh->cipher) ||
+      !sln_tls_suite_available(s, sh->cipher)) {
+    return handshake_abort(
+        s, SLN_ALERT_DESC_ILLEGAL_PARAMETER,
+        selene_error_create(SELENE_EINVAL,
+                            "Server picked a cipher suite we did not offer"));
+  }
+
+  /* already in wire order */
+  memcpy(&baton->server_utc_unix_time, &sh->utc_unix_time, 4);
+  memcpy(baton->server_random_bytes, sh->random_bytes, 28);
+
+  session->suite = sh->cipher;
+  session->id_len = sh->session_id_len;
+  memcpy(session->id, sh->session_id, sh->session_id_len);
+  session->created = time(NULL);
+
+  if (offer != NULL && offer->id_len == 0 && offer->ticket_len != 0 &&
+      offer->version_major == session->version_major &&
+      offer->version_minor == session->version_minor) {
+    /* RFC 5077, Section 3.4: with no ID to echo, the server took the ticket
+     * if its NewSessionTicket or ChangeCipherSpec follows instead of its
+     * Certificate */
+    baton->ticket_pending = 1;
+    return SELENE_SUCCESS;
+  }
+
+  if (offer == NULL || sh->session_id_len == 0 ||
+      offer->id_len != sh->session_id_len ||
+      memcmp(offer->id, sh->session_id, sh->session_id_len) != 0) {
+    /* a full handshake, the Certificate comes next */
+    return SELENE_SUCCESS;
+  }
+
+  return resume_offer(s);
+}
+
 static selene_error_t *handle_server_certificate(selene_t *s,
                                                  selene_event_e event,
                                                  void *x) {
   sln_parser_baton_t *baton = s->backend_baton;
   sln_msg_certificate_t *certs = baton->msg.certificate;
+
+  if (baton->handshake != SLN_HANDSHAKE_CLIENT_WAIT_SERVER_HELLO_DONE ||
+      s->peer_certs != NULL) {
+    return unexpected_message(s, "Certificate");
+  }
+
+  /* the server did not take our ticket */
+  baton->ticket_pending = 0;
+
   s->peer_certs = certs->chain;
   certs->chain = NULL;
   return selene_publish(s, SELENE_EVENT_VALIDATE_CERTIFICATE);
@@ -172,8 +770,9 @@ static selene_error_t *send_client_key_exchange(selene_t *s) {
 
   slnDbg(s, "sending client key exchange");
 
-  sln_parser_tls_set_current_version(s, (uint8_t *)&baton->pre_master_secret[0],
-                                     (uint8_t *)&baton->pre_master_secret[1]);
+  sln_parser_tls_max_supported_version(
+      s, (uint8_t *)&baton->pre_master_secret[0],
+      (uint8_t *)&baton->pre_master_secret[1]);
 
   sln_parser_rand_bytes_secure(baton->pre_master_secret + 2,
                                SLN_SECRET_LENGTH - 2);
@@ -196,48 +795,120 @@ static selene_error_t *send_client_key_exchange(selene_t *s) {
   return SELENE_SUCCESS;
 }
 
-static selene_error_t *send_change_cipher_spec(selene_t *s) {
-  sln_msg_change_cipher_spec_t ccs;
-  sln_bucket_t *bccs = NULL;
+static selene_error_t *handle_server_done(selene_t *s, selene_event_e event,
+                                          void *x) {
+  sln_parser_baton_t *baton = s->backend_baton;
 
-  slnDbg(s, "sending change cipher spec");
+  if (baton->handshake != SLN_HANDSHAKE_CLIENT_WAIT_SERVER_HELLO_DONE ||
+      baton->session.suite == SELENE_CS__UNUSED0 || s->peer_certs == NULL) {
+    return unexpected_message(s, "ServerHelloDone");
+  }
 
-  SELENE_ERR(sln_handshake_serialize_change_cipher_spec(s, &ccs, &bccs));
+  SELENE_ERR(send_client_key_exchange(s));
+  /* TODO: cert verify */
+  SELENE_ERR(compute_master_secret(s));
+  SELENE_ERR(sln_tls_params_init(s, baton->session.suite));
+  SELENE_ERR(send_change_cipher_spec(s));
+  SELENE_ERR(send_finished(s));
 
-  SELENE_ERR(sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_CHANGE_CIPHER_SPEC, bccs));
+  baton->handshake = SLN_HANDSHAKE_CLIENT_WAIT_SERVER_FINISHED;
 
   return SELENE_SUCCESS;
 }
 
-static selene_error_t *send_finished(selene_t *s) {
-  sln_msg_finished_t fin;
-  sln_bucket_t *bfin = NULL;
+static selene_error_t *handle_finished(selene_t *s, selene_event_e event,
+                                       void *x) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_msg_finished_t *fin = baton->msg.finished;
+  sln_handshake_e waiting;
+  unsigned char diff = 0;
+  int i;
 
-  slnDbg(s, "sending finished");
+  if (s->mode == SLN_MODE_CLIENT) {
+    waiting = SLN_HANDSHAKE_CLIENT_WAIT_SERVER_FINISHED;
+  } else {
+    waiting = SLN_HANDSHAKE_SERVER_WAIT_CLIENT_FINISHED;
+  }
 
-  SELENE_ERR(sln_handshake_serialize_finished(s, &fin, &bfin));
+  /* only ever under the keys the ChangeCipherSpec switched to */
+  if (baton->handshake != waiting ||
+      baton->active_recv_parameters.suite == SELENE_CS__UNUSED0 ||
+      (s->mode == SLN_MODE_CLIENT && baton->ticket_expected)) {
+    return unexpected_message(s, "Finished");
+  }
 
-  SELENE_ERR(sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_HANDSHAKE, bfin));
+  for (i = 0; i < SLN_MSG_FINISHED_VERIFY_LENGTH; i++) {
+    diff |= fin->vdata[i] ^ baton->peer_verify_data[i];
+  }
 
-  return SELENE_SUCCESS;
+  if (diff != 0) {
+    return handshake_abort(
+        s, SLN_ALERT_DESC_DECRYPT_ERROR,
+        selene_error_create(SELENE_EINVAL, "Peer Finished does not verify"));
+  }
+
+  /* Whoever spoke first in the handshake answers with their own */
+  if ((s->mode == SLN_MODE_CLIENT) == (baton->resumed != 0)) {
+    if (s->mode == SLN_MODE_SERVER && baton->ticket_expected) {
+      SELENE_ERR(send_new_session_ticket(s));
+    }
+    SELENE_ERR(send_change_cipher_spec(s));
+    SELENE_ERR(send_finished(s));
+  }
+
+  return handshake_done(s);
 }
 
-static selene_error_t *handle_server_done(selene_t *s, selene_event_e event,
-                                          void *x) {
-  SELENE_ERR(send_client_key_exchange(s));
-  /* TODO: cert verify */
-  SELENE_ERR(send_change_cipher_spec(s));
-  SELENE_ERR(send_finished(s));
+static selene_error_t *handle_new_session_ticket(selene_t *s,
+                                                  selene_event_e event,
+                                                  void *x) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_msg_new_session_ticket_t *nst = baton->msg.new_session_ticket;
+  selene_session_t *session = &baton->session;
+
+  /* right after the ServerHello, the server took our ticket to renew it */
+  if (baton->ticket_pending) {
+    SELENE_ERR(resume_offer(s));
+  }
+
+  /* only ever right before the server's ChangeCipherSpec */
+  if (baton->handshake != SLN_HANDSHAKE_CLIENT_WAIT_SERVER_FINISHED ||
+      !baton->ticket_expected ||
+      baton->active_recv_parameters.suite != SELENE_CS__UNUSED0) {
+    return unexpected_message(s, "NewSessionTicket");
+  }
+
+  baton->ticket_expected = 0;
+
+  if (nst->ticket_len == 0 || nst->ticket_len > sizeof(session->ticket)) {
+    session->ticket_len = 0;
+    return SELENE_SUCCESS;
+  }
+
+  session->ticket_lifetime_hint = nst->lifetime_hint;
+  session->ticket_len = nst->ticket_len;
+  memcpy(session->ticket, nst->ticket, nst->ticket_len);
+
+  /* RFC 5077, Section 3.4: offered along with the ticket, so we can tell
+   * whether the server resumed with it */
+  if (session->id_len == 0) {
+    session->id_len = SLN_SESSION_ID_MAX_LENGTH;
+    sln_parser_rand_bytes_secure(session->id, session->id_len);
+  }
 
   return SELENE_SUCCESS;
 }
 
 void sln_handshake_register_callbacks(selene_t *s) {
   if (s->mode == SLN_MODE_CLIENT) {
+    selene_handler_set(s, SELENE__EVENT_HS_GOT_SERVER_HELLO,
+                       handle_server_hello, NULL);
     selene_handler_set(s, SELENE__EVENT_HS_GOT_CERTIFICATE,
                        handle_server_certificate, NULL);
     selene_handler_set(s, SELENE__EVENT_HS_GOT_SERVER_HELLO_DONE,
                        handle_server_done, NULL);
+    selene_handler_set(s, SELENE__EVENT_HS_GOT_NEW_SESSION_TICKET,
+                       handle_new_session_ticket, NULL);
     selene_handler_set(s, SELENE_EVENT_VALIDATE_CERTIFICATE,
                        validate_certificate, NULL);
   } else {
@@ -245,5 +916,10 @@ void sln_handshake_register_callbacks(selene_t *s) {
                        handle_client_hello, NULL);
     selene_handler_set(s, SELENE_EVENT_SELECT_CERTIFICATES, select_certificates,
                        NULL);
+    selene_handler_set(s, SELENE_EVENT_SESSION_LOOKUP, lookup_session, NULL);
+    selene_handler_set(s, SELENE_EVENT_SESSION_STORE, store_session, NULL);
+    selene_handler_set(s, SELENE__EVENT_HS_GOT_CLIENT_KEY_EXCHANGE,
+                       handle_client_key_exchange, NULL);
   }
+  selene_handler_set(s, SELENE__EVENT_HS_GOT_FINISHED, handle_finished, NULL);
 }
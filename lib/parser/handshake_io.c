@@ -20,6 +20,8 @@
 #include "parser.h"
 #include "handshake_messages.h"
 #include "common.h"
+#include "sln_digest.h"
+#include "sln_sessions.h"
 
 #include <time.h>
 #include <string.h>
@@ -28,7 +30,7 @@
  *
  * enum {
  *          hello_request(0), client_hello(1), server_hello(2),
- *          certificate(11), server_key_exchange (12),
+ *          new_session_ticket(4), certificate(11), server_key_exchange (12),
  *          certificate_request(13), server_hello_done(14),
  *          certificate_verify(15), client_key_exchange(16),
  *          finished(20), (255)
@@ -39,6 +41,10 @@ selene_error_t *sln_io_handshake_client_hello(selene_t *s,
                                               sln_parser_baton_t *baton) {
   sln_msg_client_hello_t ch;
   sln_bucket_t *bhs = NULL;
+  selene_session_t *offer;
+
+  SELENE_ERR(sln_client_session_lookup(s));
+  offer = s->offered_session;
 
   sln_parser_tls_max_supported_version(s, &ch.version_major, &ch.version_minor);
 
@@ -46,11 +52,30 @@ selene_error_t *sln_io_handshake_client_hello(selene_t *s,
 
   sln_parser_rand_bytes_secure(&ch.random_bytes[0], sizeof(ch.random_bytes));
 
+  sln_parser_hs_random(ch.utc_unix_time, ch.random_bytes,
+                       (char *)&baton->client_utc_unix_time);
+
   ch.session_id_len = 0;
+  if (offer != NULL && (offer->version_major != ch.version_major ||
+                        offer->version_minor != ch.version_minor)) {
+    offer = NULL;
+  }
+  if (offer != NULL) {
+    ch.session_id_len = offer->id_len;
+    memcpy(&ch.session_id[0], offer->id, offer->id_len);
+  }
   ch.ciphers = &s->conf->ciphers;
   ch.server_name = (char *)s->client_sni;
   ch.have_npn = 0;
   ch.have_ocsp_stapling = 0;
+  /* ask for a ticket, or bring back the one we have */
+  ch.have_ticket_ext = 1;
+  ch.ticket_len = 0;
+  ch.ticket = NULL;
+  if (offer != NULL && offer->ticket_len != 0) {
+    ch.ticket_len = offer->ticket_len;
+    ch.ticket = (char *)offer->ticket;
+  }
   SELENE_ERR(sln_handshake_serialize_client_hello(s, &ch, &bhs));
 
   SELENE_ERR(sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_HANDSHAKE, bhs));
@@ -60,7 +85,8 @@ selene_error_t *sln_io_handshake_client_hello(selene_t *s,
 
 static int is_valid_message_type(uint8_t input) {
   if (input == SLN_HS_MT_HELLO_REQUEST || input == SLN_HS_MT_CLIENT_HELLO ||
-      input == SLN_HS_MT_SERVER_HELLO || input == SLN_HS_MT_CERTIFICATE ||
+      input == SLN_HS_MT_SERVER_HELLO ||
+      input == SLN_HS_MT_NEW_SESSION_TICKET || input == SLN_HS_MT_CERTIFICATE ||
       input == SLN_HS_MT_SERVER_KEY_EXCHANGE ||
       input == SLN_HS_MT_CERTIFICATE_REQUEST ||
       input == SLN_HS_MT_SERVER_HELLO_DONE ||
@@ -91,6 +117,12 @@ static selene_error_t *setup_mt_parser(sln_tok_value_t *v, sln_hs_baton_t *hs) {
       return sln_handshake_parse_server_hello_setup(hs, v,
                                                     &hs->current_msg_baton);
       break;
+    case SLN_HS_MT_NEW_SESSION_TICKET:
+      slnDbg(s, "parsing new session ticket...");
+      hs->state = SLN_HS_MESSAGE_PARSER;
+      return sln_handshake_parse_new_session_ticket_setup(
+          hs, v, &hs->current_msg_baton);
+      break;
     case SLN_HS_MT_CERTIFICATE:
       slnDbg(s, "parsing the certificate...");
       hs->state = SLN_HS_MESSAGE_PARSER;
@@ -103,11 +135,20 @@ static selene_error_t *setup_mt_parser(sln_tok_value_t *v, sln_hs_baton_t *hs) {
       return sln_handshake_parse_server_hello_done_setup(
           hs, v, &hs->current_msg_baton);
       break;
+    case SLN_HS_MT_CLIENT_KEY_EXCHANGE:
+      slnDbg(s, "parsing client key exchange...");
+      hs->state = SLN_HS_MESSAGE_PARSER;
+      return sln_handshake_parse_client_key_exchange_setup(
+          hs, v, &hs->current_msg_baton);
+      break;
+    case SLN_HS_MT_FINISHED:
+      slnDbg(s, "parsing finished...");
+      hs->state = SLN_HS_MESSAGE_PARSER;
+      return sln_handshake_parse_finished_setup(hs, v, &hs->current_msg_baton);
+      break;
     case SLN_HS_MT_SERVER_KEY_EXCHANGE:
     case SLN_HS_MT_CERTIFICATE_REQUEST:
     case SLN_HS_MT_CERTIFICATE_VERIFY:
-    case SLN_HS_MT_CLIENT_KEY_EXCHANGE:
-    case SLN_HS_MT_FINISHED:
     default:
       hs->state = SLN_HS__DONE;
       v->next = TOK_DONE;
@@ -117,6 +158,55 @@ static selene_error_t *setup_mt_parser(sln_tok_value_t *v, sln_hs_baton_t *hs) {
   return SELENE_SUCCESS;
 }
 
+/* Adds the message at the front of in_handshake to the handshake digests,
+ * where it still is in the buckets it arrived in */
+static void hash_message(sln_hs_baton_t *hs) {
+  sln_parser_baton_t *baton = hs->baton;
+  sln_brigade_t *bb = baton->in_handshake;
+  size_t left = hs->current_msg_consume;
+  sln_brigade_slot_t *slot;
+  size_t len;
+  int i;
+
+  for (i = 0; i < bb->count && left > 0; i++) {
+    slot = SLN_BRIGADE_SLOT(bb, i);
+    len = slot->size < left ? slot->size : left;
+    sln_digest_update(baton->md5_handshake_digest, slot->data, len);
+    sln_digest_update(baton->sha1_handshake_digest, slot->data, len);
+    left -= len;
+  }
+}
+
+/* The parser has all of the message, hash it and tell whoever handles it */
+static selene_error_t *finish_message(sln_hs_baton_t *hs, sln_tok_value_t *v) {
+  selene_error_t *err = SELENE_SUCCESS;
+
+  if (sln_brigade_size(hs->baton->in_handshake) < hs->current_msg_consume) {
+    /* the parser stopped short of where the length said the message ends */
+    return selene_error_createf(SELENE_EINVAL,
+                                "Malformed handshake message type: %u",
+                                hs->message_type);
+  }
+
+  hash_message(hs);
+
+  if (hs->current_msg_baton != NULL && hs->current_msg_finish != NULL) {
+    err = hs->current_msg_finish(hs, hs->current_msg_baton);
+  }
+
+  if (hs->current_msg_baton != NULL && hs->current_msg_destroy != NULL) {
+    hs->current_msg_destroy(hs, hs->current_msg_baton);
+  }
+
+  hs->current_msg_baton = NULL;
+
+  hs->state = SLN_HS__DONE;
+  v->next = TOK_DONE;
+  v->wantlen = 0;
+
+  return err;
+}
+
 static selene_error_t *read_handshake_parser(sln_tok_value_t *v, void *baton_) {
   selene_error_t *err = SELENE_SUCCESS;
   sln_hs_baton_t *hs = (sln_hs_baton_t *)baton_;
@@ -149,27 +239,20 @@ static selene_error_t *read_handshake_parser(sln_tok_value_t *v, void *baton_) {
       hs->remaining = hs->length;
       err = setup_mt_parser(v, hs);
       hs->remaining -= v->wantlen;
+      if (!err && hs->state == SLN_HS_MESSAGE_PARSER &&
+          (hs->remaining < 0 || v->next == TOK_DONE)) {
+        err = finish_message(hs, v);
+      }
       break;
     case SLN_HS_MESSAGE_PARSER:
       err = hs->current_msg_step(hs, v, hs->current_msg_baton);
 
       hs->remaining -= v->wantlen;
       /* slnDbg(s, "remaining: %d want: %u\n", hs->remaining, v->wantlen); */
-      if (hs->remaining < 0) {
-
-        if (hs->current_msg_baton != NULL && hs->current_msg_finish != NULL) {
-          err = hs->current_msg_finish(hs, hs->current_msg_baton);
-        }
-
-        if (hs->current_msg_baton != NULL && hs->current_msg_destroy != NULL) {
-          hs->current_msg_destroy(hs, hs->current_msg_baton);
-        }
-
-        hs->current_msg_baton = NULL;
-
-        hs->state = SLN_HS__DONE;
-        v->next = TOK_DONE;
-        v->wantlen = 0;
+      /* Parsers either ask for more than is left of the message, or say they
+       * are done with it */
+      if (!err && (hs->remaining < 0 || v->next == TOK_DONE)) {
+        err = finish_message(hs, v);
       }
       break;
     default:
@@ -180,31 +263,61 @@ static selene_error_t *read_handshake_parser(sln_tok_value_t *v, void *baton_) {
   return err;
 }
 
+static void hs_reset(selene_t *s, sln_parser_baton_t *baton) {
+  sln_hs_baton_t *hs = &baton->hs;
+
+  if (hs->current_msg_baton != NULL && hs->current_msg_destroy != NULL) {
+    hs->current_msg_destroy(hs, hs->current_msg_baton);
+  }
+
+  hs->s = s;
+  hs->baton = baton;
+  hs->state = SLN_HS__INIT;
+  hs->message_type = 0;
+  hs->length = 0;
+  hs->remaining = 0;
+  hs->current_msg_baton = NULL;
+  hs->current_msg_step = NULL;
+  hs->current_msg_finish = NULL;
+  hs->current_msg_destroy = NULL;
+  hs->current_msg_consume = 0;
+  sln_tok_parser_reset(&hs->tok);
+}
+
 selene_error_t *sln_io_handshake_read(selene_t *s, sln_parser_baton_t *baton) {
-  sln_hs_baton_t hs;
+  sln_hs_baton_t *hs = &baton->hs;
   selene_error_t *err = SELENE_SUCCESS;
-  do {
-    hs.s = s;
-    hs.baton = baton;
-    hs.state = SLN_HS__INIT;
-    hs.current_msg_baton = NULL;
-    hs.current_msg_step = NULL;
-    hs.current_msg_finish = NULL;
-    hs.current_msg_destroy = NULL;
-    hs.current_msg_consume = 0;
-
-    err = sln_tok_parser(baton->in_handshake, read_handshake_parser, &hs);
-
-    if (hs.current_msg_baton != NULL && hs.current_msg_destroy != NULL) {
-      hs.current_msg_destroy(&hs, hs.current_msg_baton);
+
+  if (hs->state == SLN_HS__UNUSED) {
+    hs_reset(s, baton);
+  }
+
+  while (!SLN_BRIGADE_EMPTY(baton->in_handshake)) {
+    err = sln_tok_parser_resume(&hs->tok, baton->in_handshake,
+                                read_handshake_parser, hs);
+
+    if (err) {
+      hs_reset(s, baton);
+      return err;
     }
 
-    if (hs.state == SLN_HS__DONE) {
-      slnDbg(s, "handshake chomping: %d", (int)hs.current_msg_consume);
-      sln_brigade_chomp(baton->in_handshake, hs.current_msg_consume);
+    if (hs->state != SLN_HS__DONE) {
+      /* part way through a message, resume here once more data arrives */
+      break;
     }
-  } while (err == SELENE_SUCCESS && hs.state == SLN_HS__DONE &&
-           !SLN_BRIGADE_EMPTY(baton->in_handshake));
+
+    slnDbg(s, "handshake chomping: %d", (int)hs->current_msg_consume);
+    sln_brigade_chomp(baton->in_handshake, hs->current_msg_consume);
+
+    hs_reset(s, baton);
+  }
 
   return err;
 }
+
+void sln_io_handshake_read_destroy(selene_t *s, sln_parser_baton_t *baton) {
+  if (baton->hs.state != SLN_HS__UNUSED) {
+    hs_reset(s, baton);
+    sln_tok_parser_destroy(&baton->hs.tok);
+  }
+}
@@ -18,6 +18,7 @@
 #include "sln_tok.h"
 #include "parser.h"
 #include "handshake_messages.h"
+#include <string.h>
 
 /* TODO: all other cipher suites */
 selene_cipher_suite_e sln_parser_hs_bytes_to_cipher_suite(uint8_t first,
@@ -35,6 +36,12 @@ selene_cipher_suite_e sln_parser_hs_bytes_to_cipher_suite(uint8_t first,
         case 0x35:
           suite = SELENE_CS_RSA_WITH_AES_256_CBC_SHA;
           break;
+        case 0x9C:
+          suite = SELENE_CS_RSA_WITH_AES_128_GCM_SHA256;
+          break;
+        case 0x9D:
+          suite = SELENE_CS_RSA_WITH_AES_256_GCM_SHA384;
+          break;
         default:
           break;
       }
@@ -46,6 +53,37 @@ selene_cipher_suite_e sln_parser_hs_bytes_to_cipher_suite(uint8_t first,
   return suite;
 }
 
+void sln_parser_hs_cipher_suite_to_bytes(selene_cipher_suite_e suite,
+                                         char *out) {
+  switch (suite) {
+    case SELENE_CS_RSA_WITH_RC4_128_SHA:
+      out[0] = 0x00;
+      out[1] = 0x05;
+      break;
+    case SELENE_CS_RSA_WITH_AES_128_CBC_SHA:
+      out[0] = 0x00;
+      out[1] = 0x2F;
+      break;
+    case SELENE_CS_RSA_WITH_AES_256_CBC_SHA:
+      out[0] = 0x00;
+      out[1] = 0x35;
+      break;
+    case SELENE_CS_RSA_WITH_AES_128_GCM_SHA256:
+      out[0] = 0x00;
+      out[1] = (char)0x9C;
+      break;
+    case SELENE_CS_RSA_WITH_AES_256_GCM_SHA384:
+      out[0] = 0x00;
+      out[1] = (char)0x9D;
+      break;
+    case SELENE_CS__UNUSED0:
+    case SELENE_CS__MAX:
+      /* TODO: handle this */
+      abort();
+      break;
+  }
+}
+
 selene_compression_method_e sln_parser_hs_bytes_to_comp_method(uint8_t in) {
   selene_compression_method_e comp = SELENE_COMP_NULL;
 
@@ -63,3 +101,12 @@ selene_compression_method_e sln_parser_hs_bytes_to_comp_method(uint8_t in) {
 
   return comp;
 }
+
+void sln_parser_hs_random(uint32_t utc_unix_time, const char *random_bytes,
+                          char *out) {
+  out[0] = utc_unix_time >> 24;
+  out[1] = utc_unix_time >> 16;
+  out[2] = utc_unix_time >> 8;
+  out[3] = utc_unix_time;
+  memcpy(out + 4, random_bytes, 28);
+}
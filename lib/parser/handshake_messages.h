@@ -25,6 +25,7 @@ typedef enum sln_hs_mt_e {
    * 0	HelloRequest
    * 1	ClientHello
    * 2	ServerHello
+   * 4	NewSessionTicket
    * 11	Certificate
    * 12	ServerKeyExchange
    * 13	CertificateRequest
@@ -36,6 +37,7 @@ typedef enum sln_hs_mt_e {
   SLN_HS_MT_HELLO_REQUEST = 0,
   SLN_HS_MT_CLIENT_HELLO = 1,
   SLN_HS_MT_SERVER_HELLO = 2,
+  SLN_HS_MT_NEW_SESSION_TICKET = 4,
   SLN_HS_MT_CERTIFICATE = 11,
   SLN_HS_MT_SERVER_KEY_EXCHANGE = 12,
   SLN_HS_MT_CERTIFICATE_REQUEST = 13,
@@ -45,6 +47,13 @@ typedef enum sln_hs_mt_e {
   SLN_HS_MT_FINISHED = 20
 } sln_hs_mt_e;
 
+/* Hello extensions we know of, from the registry at
+ * <http://www.iana.org/assignments/tls-extensiontype-values/> */
+typedef enum sln_hs_ext_e {
+  SLN_HS_EXT_SERVER_NAME = 0,
+  SLN_HS_EXT_SESSION_TICKET = 35
+} sln_hs_ext_e;
+
 typedef enum sln_handshake_state_e {
   SLN_HS__UNUSED,
   SLN_HS__INIT,
@@ -75,6 +84,8 @@ struct sln_hs_baton_t {
   sln_hs_msg_finish_cb *current_msg_finish;
   sln_hs_msg_destroy_cb *current_msg_destroy;
   size_t current_msg_consume;
+  /* Kept across calls, so a partial message is not parsed again */
+  sln_tok_parser_t tok;
 };
 
 /* utility methods */
@@ -82,8 +93,16 @@ struct sln_hs_baton_t {
 selene_cipher_suite_e sln_parser_hs_bytes_to_cipher_suite(uint8_t first,
                                                           uint8_t second);
 
+/* Writes the two byte code of suite to out */
+void sln_parser_hs_cipher_suite_to_bytes(selene_cipher_suite_e suite,
+                                         char *out);
+
 selene_compression_method_e sln_parser_hs_bytes_to_comp_method(uint8_t in);
 
+/* Writes the 32 byte Random of a hello, as it goes on the wire, to out */
+void sln_parser_hs_random(uint32_t utc_unix_time, const char *random_bytes,
+                          char *out);
+
 /* Client Hello Message Methods */
 
 typedef enum sln_handshake_client_hello_state_e {
@@ -96,13 +115,14 @@ typedef enum sln_handshake_client_hello_state_e {
   SLN_HS_CLIENT_HELLO_CIPHER_SUITES,
   SLN_HS_CLIENT_HELLO_COMPRESSION_LENGTH,
   SLN_HS_CLIENT_HELLO_COMPRESSION,
+  SLN_HS_CLIENT_HELLO_EXTS_LENGTH,
   SLN_HS_CLIENT_HELLO_EXT_DEF,
   SLN_HS_CLIENT_HELLO_EXT_SKIP, /* skipping an unknown extension*/
   SLN_HS_CLIENT_HELLO_EXT_SNI_LENGTH,
-  SLN_HS_CLIENT_HELLO_EXT_SNI_NUM_NAMES,
   SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_TYPE,
   SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_LENGTH,
-  SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_VALUE
+  SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_VALUE,
+  SLN_HS_CLIENT_HELLO_EXT_TICKET
 } sln_handshake_client_hello_state_e;
 
 typedef struct sln_msg_client_hello_t {
@@ -116,6 +136,10 @@ typedef struct sln_msg_client_hello_t {
   char *server_name;
   int have_npn;
   int have_ocsp_stapling;
+  /* RFC 5077, the extension may come empty, asking for a ticket */
+  int have_ticket_ext;
+  uint16_t ticket_len;
+  char *ticket;
 } sln_msg_client_hello_t;
 
 selene_error_t *sln_handshake_serialize_client_hello(selene_t *s,
@@ -136,6 +160,7 @@ typedef enum sln_handshake_server_hello_state_e {
   SLN_HS_SERVER_HELLO_SESSION_ID,
   SLN_HS_SERVER_HELLO_CIPHER_SUITE,
   SLN_HS_SERVER_HELLO_COMPRESSION,
+  SLN_HS_SERVER_HELLO_EXTS_LENGTH,
   SLN_HS_SERVER_HELLO_EXT_DEF,
   SLN_HS_SERVER_HELLO_EXT_SKIP
 } sln_handshake_server_hello_state_e;
@@ -149,7 +174,9 @@ typedef struct sln_msg_server_hello_t {
   char session_id[32];
   selene_cipher_suite_e cipher;
   selene_compression_method_e comp;
-  /* TODO: extensions and compression */
+  /* A NewSessionTicket follows */
+  int have_ticket_ext;
+  /* TODO: more extensions and compression */
 } sln_msg_server_hello_t;
 
 selene_error_t *sln_handshake_serialize_server_hello(selene_t *s,
@@ -162,6 +189,10 @@ selene_error_t *sln_handshake_parse_server_hello_setup(sln_hs_baton_t *hs,
 
 void sln_handshake_register_callbacks(selene_t *s);
 
+/* A ChangeCipherSpec came in, for a client that offered a ticket without a
+ * session ID right after the ServerHello that means the server resumed */
+selene_error_t *sln_handshake_peer_change_cipher_spec(selene_t *s);
+
 /* Certificate Message Methods */
 
 typedef enum sln_handshake_certificate_state_e {
@@ -236,4 +267,33 @@ selene_error_t *sln_handshake_serialize_finished(selene_t *s,
                                                  sln_msg_finished_t *fin,
                                                  sln_bucket_t **p_b);
 
+selene_error_t *sln_handshake_parse_finished_setup(sln_hs_baton_t *hs,
+                                                   sln_tok_value_t *v,
+                                                   void **baton);
+
+/* The verify_data of the Finished sent by mode, over the handshake messages
+ * so far */
+selene_error_t *sln_handshake_finished_vdata(selene_t *s, sln_mode_e mode,
+                                             char *vdata);
+
+/* New Session Ticket Message Methods, RFC 5077 */
+
+typedef enum sln_handshake_new_session_ticket_state_e {
+  SLN_HS_NEW_SESSION_TICKET_LIFETIME,
+  SLN_HS_NEW_SESSION_TICKET_LENGTH,
+  SLN_HS_NEW_SESSION_TICKET_DATA
+} sln_handshake_new_session_ticket_state_e;
+
+typedef struct sln_msg_new_session_ticket_t {
+  uint32_t lifetime_hint;
+  uint16_t ticket_len;
+  char *ticket;
+} sln_msg_new_session_ticket_t;
+
+selene_error_t *sln_handshake_serialize_new_session_ticket(
+    selene_t *s, sln_msg_new_session_ticket_t *nst, sln_bucket_t **p_b);
+
+selene_error_t *sln_handshake_parse_new_session_ticket_setup(
+    sln_hs_baton_t *hs, sln_tok_value_t *v, void **baton);
+
 #endif
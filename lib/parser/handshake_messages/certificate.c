@@ -51,7 +51,7 @@ selene_error_t *sln_handshake_serialize_certificate(selene_t *s,
     clen += l;
   }
 
-  sln_bucket_create_empty(s->alloc, &b, len);
+  sln_tls_record_create(s, len, &b);
 
   b->data[0] = SLN_HS_MT_CERTIFICATE;
   dlen = len - 4;
@@ -26,7 +26,7 @@ selene_error_t *sln_handshake_serialize_change_cipher_spec(
   /* message size */
   len += 1;
 
-  sln_bucket_create_empty(s->alloc, &b, len);
+  sln_tls_record_create(s, len, &b);
 
   b->data[0] = 1;
 
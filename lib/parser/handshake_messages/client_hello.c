@@ -72,6 +72,11 @@ selene_error_t *sln_handshake_serialize_client_hello(selene_t *s,
     extlen += snilen;
   }
 
+  if (ch->have_ticket_ext) {
+    num_extensions++;
+    extlen += ch->ticket_len;
+  }
+
   if (ch->have_npn) {
     /* num_extensions++; */
     /* TODO: npn support */
@@ -92,7 +97,7 @@ selene_error_t *sln_handshake_serialize_client_hello(selene_t *s,
   extlen += 4 * num_extensions;
   len += extlen;
 
-  sln_bucket_create_empty(s->alloc, &b, len);
+  sln_tls_record_create(s, len, &b);
 
   b->data[0] = SLN_HS_MT_CLIENT_HELLO;
   dlen = len - 4;
@@ -128,25 +133,8 @@ selene_error_t *sln_handshake_serialize_client_hello(selene_t *s,
   off += 2;
 
   for (i = 0; i < ch->ciphers->used; i++) {
-    switch (ch->ciphers->ciphers[i]) {
-      /* TODO: move a better utility place */
-      case SELENE_CS_RSA_WITH_RC4_128_SHA:
-        b->data[off] = 0x00;
-        b->data[off + 1] = 0x05;
-        break;
-      case SELENE_CS_RSA_WITH_AES_128_CBC_SHA:
-        b->data[off] = 0x00;
-        b->data[off + 1] = 0x2F;
-        break;
-      case SELENE_CS_RSA_WITH_AES_256_CBC_SHA:
-        b->data[off] = 0x00;
-        b->data[off + 1] = 0x35;
-        break;
-      default:
-        /* TODO: handle this */
-        abort();
-        break;
-    }
+    sln_parser_hs_cipher_suite_to_bytes(ch->ciphers->ciphers[i],
+                                        b->data + off);
     off += 2;
   }
 
@@ -192,6 +180,22 @@ selene_error_t *sln_handshake_serialize_client_hello(selene_t *s,
     off += sninamelen;
   }
 
+  if (ch->have_ticket_ext) {
+    b->data[off] = SLN_HS_EXT_SESSION_TICKET >> 8;
+    b->data[off + 1] = SLN_HS_EXT_SESSION_TICKET;
+    off += 2;
+
+    /* empty unless resuming with a ticket */
+    b->data[off] = ch->ticket_len >> 8;
+    b->data[off + 1] = ch->ticket_len;
+    off += 2;
+
+    if (ch->ticket_len != 0) {
+      memcpy(&b->data[off], ch->ticket, ch->ticket_len);
+      off += ch->ticket_len;
+    }
+  }
+
   SLN_ASSERT(off == len);
 
   *p_b = b;
@@ -204,8 +208,11 @@ typedef struct ch_baton_t {
   sln_msg_client_hello_t ch;
   int cipher_suites_num;
   int compression_num;
-  int sni_num;
+  /* Bytes of the server_name_list not read yet */
+  int sni_left;
+  uint8_t sni_name_type;
   uint16_t sni_name_len;
+  uint16_t ext_len;
 } ch_baton_t;
 
 static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
@@ -245,8 +252,10 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
 
     case SLN_HS_CLIENT_HELLO_SESSION_LENGTH: {
       ch->session_id_len = v->v.bytes[0];
-      if (ch->session_id_len > 32) {
-        /* TODO: session id errors*/
+      if (ch->session_id_len > sizeof(ch->session_id)) {
+        return selene_error_createf(SELENE_EINVAL,
+                                    "Invalid session id length: %u",
+                                    ch->session_id_len);
       }
       slnDbg(s, "got session length: %d", ch->session_id_len);
 
@@ -266,7 +275,7 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
       memcpy(&ch->session_id[0], &v->v.bytes[0], ch->session_id_len);
       chb->state = SLN_HS_CLIENT_HELLO_CIPHER_SUITES_LENGTH;
       v->next = TOK_UINT16;
-      v->wantlen = 1;
+      v->wantlen = 2;
       break;
     }
 
@@ -324,9 +333,10 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
       chb->compression_num--;
       slnDbg(s, "compression type: %u\n", (unsigned int)v->v.bytes[0]);
       if (chb->compression_num <= 0) {
-        chb->state = SLN_HS_CLIENT_HELLO_EXT_DEF;
-        v->next = TOK_COPY_BYTES;
-        v->wantlen = 4;
+        /* Asking past the end of a message without extensions ends it */
+        chb->state = SLN_HS_CLIENT_HELLO_EXTS_LENGTH;
+        v->next = TOK_UINT16;
+        v->wantlen = 2;
       } else {
         chb->state = SLN_HS_CLIENT_HELLO_COMPRESSION;
         v->next = TOK_COPY_BYTES;
@@ -334,24 +344,43 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
       }
       break;
 
+    case SLN_HS_CLIENT_HELLO_EXTS_LENGTH: {
+      /* the message ends with the last one */
+      chb->state = SLN_HS_CLIENT_HELLO_EXT_DEF;
+      v->next = TOK_COPY_BYTES;
+      v->wantlen = 4;
+      break;
+    }
+
     case SLN_HS_CLIENT_HELLO_EXT_DEF: {
       /* Extensions Registry:
        *   <http://www.iana.org/assignments/tls-extensiontype-values/tls-extensiontype-values.xml>
       */
-      uint16_t ext_len = (((unsigned char)v->v.bytes[0]) << 8 |
-                          ((unsigned char)v->v.bytes[1]));
-      uint16_t ext_type = (((unsigned char)v->v.bytes[2]) << 8 |
-                           ((unsigned char)v->v.bytes[3]));
+      uint16_t ext_type = (((unsigned char)v->v.bytes[0]) << 8 |
+                           ((unsigned char)v->v.bytes[1]));
+      uint16_t ext_len = (((unsigned char)v->v.bytes[2]) << 8 |
+                          ((unsigned char)v->v.bytes[3]));
       slnDbg(s, "extension: %u len: %u\n", ext_type, ext_len);
-      if (ext_type == 0) {
-        /* SNI */
+      chb->ext_len = ext_len;
+      if (ext_type == SLN_HS_EXT_SESSION_TICKET) {
+        ch->have_ticket_ext = 1;
+      }
+      if (ext_len == 0) {
+        chb->state = SLN_HS_CLIENT_HELLO_EXT_DEF;
+        v->next = TOK_COPY_BYTES;
+        v->wantlen = 4;
+      } else if (ext_type == SLN_HS_EXT_SERVER_NAME) {
         chb->state = SLN_HS_CLIENT_HELLO_EXT_SNI_LENGTH;
         v->next = TOK_UINT16;
         v->wantlen = 2;
+      } else if (ext_type == SLN_HS_EXT_SESSION_TICKET) {
+        chb->state = SLN_HS_CLIENT_HELLO_EXT_TICKET;
+        v->next = TOK_COPY_BRIGADE;
+        v->wantlen = ext_len;
       } else {
         chb->state = SLN_HS_CLIENT_HELLO_EXT_SKIP;
         v->next = TOK_SKIP;
-        v->wantlen = ext_len - 4;
+        v->wantlen = ext_len;
       }
       break;
     }
@@ -364,16 +393,12 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
     }
 
     case SLN_HS_CLIENT_HELLO_EXT_SNI_LENGTH: {
-      /* TODO: is this variable actually ever needed? */
-      /* uint16_t sni_len = v->v.uint16; */
-      chb->state = SLN_HS_CLIENT_HELLO_EXT_SNI_NUM_NAMES;
-      v->next = TOK_UINT16;
-      v->wantlen = 2;
-      break;
-    }
-
-    case SLN_HS_CLIENT_HELLO_EXT_SNI_NUM_NAMES: {
-      chb->sni_num = v->v.uint16;
+      chb->sni_left = v->v.uint16;
+      if (chb->sni_left + 2 != chb->ext_len || chb->sni_left < 3) {
+        return selene_error_createf(SELENE_EINVAL,
+                                    "Invalid server name list length: %d",
+                                    chb->sni_left);
+      }
       chb->state = SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_TYPE;
       v->next = TOK_COPY_BYTES;
       v->wantlen = 1;
@@ -382,6 +407,7 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
 
     case SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_TYPE: {
       /* TODO: alert on unknown name type? */
+      chb->sni_name_type = v->v.bytes[0];
       chb->state = SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_LENGTH;
       v->next = TOK_UINT16;
       v->wantlen = 2;
@@ -390,6 +416,12 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
 
     case SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_LENGTH: {
       chb->sni_name_len = v->v.uint16;
+      chb->sni_left -= 3 + chb->sni_name_len;
+      if (chb->sni_left < 0) {
+        return selene_error_createf(SELENE_EINVAL,
+                                    "Invalid server name length: %u",
+                                    chb->sni_name_len);
+      }
       chb->state = SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_VALUE;
       v->next = TOK_COPY_BRIGADE;
       v->wantlen = chb->sni_name_len;
@@ -406,27 +438,52 @@ static selene_error_t *parse_client_hello_step(sln_hs_baton_t *hs,
         break;
       }
 
-      if (ch->server_name != NULL) {
-        sln_free(s, (char *)ch->server_name);
-      }
-
-      ch->server_name = sln_alloc(s, l + 1);
-      sln_brigade_flatten(v->v.bb, ch->server_name, &l);
-      ch->server_name[l] = '\0';
+      /* only host_name(0) is defined */
+      if (chb->sni_name_type == 0) {
+        if (ch->server_name != NULL) {
+          sln_free(s, (char *)ch->server_name);
+        }
 
-      chb->sni_num--;
+        ch->server_name = sln_alloc(s, l + 1);
+        sln_brigade_flatten(v->v.bb, ch->server_name, &l);
+        ch->server_name[l] = '\0';
+      }
 
-      if (chb->sni_num <= 0) {
+      if (chb->sni_left <= 0) {
         chb->state = SLN_HS_CLIENT_HELLO_EXT_DEF;
         v->next = TOK_COPY_BYTES;
         v->wantlen = 4;
       } else {
-        chb->state = SLN_HS_CLIENT_HELLO_EXT_SNI_NUM_NAMES;
+        chb->state = SLN_HS_CLIENT_HELLO_EXT_SNI_NAME_TYPE;
         v->next = TOK_COPY_BYTES;
         v->wantlen = 1;
       }
       break;
     }
+
+    case SLN_HS_CLIENT_HELLO_EXT_TICKET: {
+      size_t l = sln_brigade_size(v->v.bb);
+
+      if (l != chb->ext_len) {
+        /* short read. */
+        v->next = TOK_DONE;
+        v->wantlen = 0;
+        break;
+      }
+
+      if (ch->ticket != NULL) {
+        sln_free(s, ch->ticket);
+      }
+
+      ch->ticket = sln_alloc(s, l);
+      sln_brigade_flatten(v->v.bb, ch->ticket, &l);
+      ch->ticket_len = l;
+
+      chb->state = SLN_HS_CLIENT_HELLO_EXT_DEF;
+      v->next = TOK_COPY_BYTES;
+      v->wantlen = 4;
+      break;
+    }
   }
 
   return err;
@@ -449,6 +506,10 @@ static void parse_client_hello_destroy(sln_hs_baton_t *hs, void *baton) {
     selene_cipher_suite_list_destroy(chb->ch.ciphers);
   }
 
+  if (chb->ch.ticket != NULL) {
+    sln_free(hs->s, chb->ch.ticket);
+  }
+
   sln_free(hs->s, chb);
 }
 
@@ -36,7 +36,7 @@ selene_error_t *sln_handshake_serialize_client_key_exchange(
   len += 2;
   len += cke->pre_master_secret_length;
 
-  sln_bucket_create_empty(s->alloc, &b, len);
+  sln_tls_record_create(s, len, &b);
 
   dlen = len - 4;
 
@@ -72,7 +72,7 @@ static selene_error_t *parse_client_key_exchange_step(sln_hs_baton_t *hs,
 
   switch (ckb->state) {
     case SLN_HS_CLIENT_KEY_EXCHANGE_LENGTH: {
-      ckb->cke.pre_master_secret_length = v->v.uint24;
+      ckb->cke.pre_master_secret_length = v->v.uint16;
       ckb->state = SLN_HS_CLIENT_KEY_EXCHANGE_DATA;
       v->next = TOK_COPY_BRIGADE;
       v->wantlen = ckb->cke.pre_master_secret_length;
@@ -100,6 +100,10 @@ static selene_error_t *parse_client_key_exchange_finish(sln_hs_baton_t *hs,
 static void parse_client_key_exchange_destroy(sln_hs_baton_t *hs, void *baton) {
   cke_baton_t *ckb = (cke_baton_t *)baton;
 
+  if (ckb->cke.pre_master_secret != NULL) {
+    sln_free(hs->s, ckb->cke.pre_master_secret);
+  }
+
   sln_free(hs->s, ckb);
 }
 
@@ -111,8 +115,9 @@ selene_error_t *sln_handshake_parse_client_key_exchange_setup(
   hs->current_msg_step = parse_client_key_exchange_step;
   hs->current_msg_finish = parse_client_key_exchange_finish;
   hs->current_msg_destroy = parse_client_key_exchange_destroy;
-  v->next = TOK_UINT24;
-  v->wantlen = 3;
+  /* TLS 1.0 and up put the length of the encrypted secret in front of it */
+  v->next = TOK_UINT16;
+  v->wantlen = 2;
   *baton = (void *)ckb;
   return SELENE_SUCCESS;
 }
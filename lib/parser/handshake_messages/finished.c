@@ -17,6 +17,8 @@
 
 #include "../parser.h"
 #include "../handshake_messages.h"
+#include "sln_digest.h"
+#include "sln_prf.h"
 #include <string.h>
 
 selene_error_t *sln_handshake_serialize_finished(selene_t *s,
@@ -35,7 +37,7 @@ selene_error_t *sln_handshake_serialize_finished(selene_t *s,
   /* verify data size */
   len += SLN_MSG_FINISHED_VERIFY_LENGTH;
 
-  sln_bucket_create_empty(s->alloc, &b, len);
+  sln_tls_record_create(s, len, &b);
 
   b->data[off] = SLN_HS_MT_FINISHED;
   off += 1;
@@ -54,3 +56,90 @@ selene_error_t *sln_handshake_serialize_finished(selene_t *s,
 
   return SELENE_SUCCESS;
 }
+
+selene_error_t *sln_handshake_finished_vdata(selene_t *s, sln_mode_e mode,
+                                             char *vdata) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  selene_error_t *err;
+  sln_digest_t *md5 = NULL;
+  sln_digest_t *sha1 = NULL;
+  const char *label;
+  unsigned char seed[SLN_MD5_DIGEST_LENGTH + SLN_SHA1_DIGEST_LENGTH];
+
+  if (mode == SLN_MODE_CLIENT) {
+    label = "client finished";
+  } else {
+    label = "server finished";
+  }
+
+  /* the digests go on, the peer's Finished still has to go into them */
+  SELENE_ERR(sln_digest_copy(baton->md5_handshake_digest, &md5));
+  err = sln_digest_copy(baton->sha1_handshake_digest, &sha1);
+  if (err) {
+    sln_digest_destroy(md5);
+    return err;
+  }
+
+  sln_digest_final(md5, &seed[0]);
+  sln_digest_final(sha1, &seed[SLN_MD5_DIGEST_LENGTH]);
+
+  sln_digest_destroy(md5);
+  sln_digest_destroy(sha1);
+
+  return sln_prf(s, label, strlen(label), baton->master_secret,
+                 SLN_SECRET_LENGTH, (const char *)seed, sizeof(seed), vdata,
+                 SLN_MSG_FINISHED_VERIFY_LENGTH);
+}
+
+typedef struct fin_baton_t {
+  sln_msg_finished_t fin;
+} fin_baton_t;
+
+static selene_error_t *parse_finished_step(sln_hs_baton_t *hs,
+                                           sln_tok_value_t *v, void *baton) {
+  fin_baton_t *fb = (fin_baton_t *)baton;
+
+  memcpy(fb->fin.vdata, &v->v.bytes[0], SLN_MSG_FINISHED_VERIFY_LENGTH);
+  v->next = TOK_DONE;
+  v->wantlen = 0;
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *parse_finished_finish(sln_hs_baton_t *hs,
+                                             void *baton) {
+  return selene_publish(hs->s, SELENE__EVENT_HS_GOT_FINISHED);
+}
+
+static void parse_finished_destroy(sln_hs_baton_t *hs, void *baton) {
+  sln_free(hs->s, baton);
+}
+
+selene_error_t *sln_handshake_parse_finished_setup(sln_hs_baton_t *hs,
+                                                   sln_tok_value_t *v,
+                                                   void **baton) {
+  selene_t *s = hs->s;
+  fin_baton_t *fb;
+  sln_mode_e peer;
+
+  if (hs->length != SLN_MSG_FINISHED_VERIFY_LENGTH) {
+    return selene_error_createf(SELENE_EINVAL,
+                                "Invalid Finished message length: %u",
+                                hs->length);
+  }
+
+  /* ours to check it against, before it goes into the handshake digests */
+  peer = s->mode == SLN_MODE_CLIENT ? SLN_MODE_SERVER : SLN_MODE_CLIENT;
+  SELENE_ERR(
+      sln_handshake_finished_vdata(s, peer, hs->baton->peer_verify_data));
+
+  fb = sln_calloc(s, sizeof(fin_baton_t));
+  hs->baton->msg.finished = &fb->fin;
+  hs->current_msg_step = parse_finished_step;
+  hs->current_msg_finish = parse_finished_finish;
+  hs->current_msg_destroy = parse_finished_destroy;
+  v->next = TOK_COPY_BYTES;
+  v->wantlen = SLN_MSG_FINISHED_VERIFY_LENGTH;
+  *baton = (void *)fb;
+  return SELENE_SUCCESS;
+}
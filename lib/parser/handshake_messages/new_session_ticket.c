@@ -0,0 +1,154 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../parser.h"
+#include "../handshake_messages.h"
+#include <string.h>
+
+/* RFC 5077, Section 3.3:
+ *
+ * struct {
+ *     uint32 ticket_lifetime_hint;
+ *     opaque ticket<0..2^16-1>;
+ * } NewSessionTicket;
+ */
+
+selene_error_t *sln_handshake_serialize_new_session_ticket(
+    selene_t *s, sln_msg_new_session_ticket_t *nst, sln_bucket_t **p_b) {
+  sln_bucket_t *b = NULL;
+  size_t len = 0;
+  size_t dlen = 0;
+  size_t off = 0;
+
+  /* header size */
+  len += 4;
+
+  /* ticket_lifetime_hint */
+  len += 4;
+
+  /* ticket */
+  len += 2;
+  len += nst->ticket_len;
+
+  sln_tls_record_create(s, len, &b);
+
+  dlen = len - 4;
+
+  b->data[0] = SLN_HS_MT_NEW_SESSION_TICKET;
+  b->data[1] = dlen >> 16;
+  b->data[2] = dlen >> 8;
+  b->data[3] = dlen;
+  off = 4;
+
+  b->data[off] = nst->lifetime_hint >> 24;
+  b->data[off + 1] = nst->lifetime_hint >> 16;
+  b->data[off + 2] = nst->lifetime_hint >> 8;
+  b->data[off + 3] = nst->lifetime_hint;
+  off += 4;
+
+  b->data[off] = nst->ticket_len >> 8;
+  b->data[off + 1] = nst->ticket_len;
+  off += 2;
+
+  memcpy(b->data + off, nst->ticket, nst->ticket_len);
+  off += nst->ticket_len;
+
+  SLN_ASSERT(off == len);
+
+  *p_b = b;
+
+  return SELENE_SUCCESS;
+}
+
+typedef struct nst_baton_t {
+  sln_handshake_new_session_ticket_state_e state;
+  sln_msg_new_session_ticket_t nst;
+} nst_baton_t;
+
+static selene_error_t *parse_new_session_ticket_step(sln_hs_baton_t *hs,
+                                                     sln_tok_value_t *v,
+                                                     void *baton) {
+  nst_baton_t *nb = (nst_baton_t *)baton;
+  sln_msg_new_session_ticket_t *nst = &nb->nst;
+
+  switch (nb->state) {
+    case SLN_HS_NEW_SESSION_TICKET_LIFETIME: {
+      nst->lifetime_hint = ((uint32_t)(unsigned char)v->v.bytes[0] << 24) |
+                           ((uint32_t)(unsigned char)v->v.bytes[1] << 16) |
+                           ((uint32_t)(unsigned char)v->v.bytes[2] << 8) |
+                           (uint32_t)(unsigned char)v->v.bytes[3];
+      nb->state = SLN_HS_NEW_SESSION_TICKET_LENGTH;
+      v->next = TOK_UINT16;
+      v->wantlen = 2;
+      break;
+    }
+    case SLN_HS_NEW_SESSION_TICKET_LENGTH: {
+      nst->ticket_len = v->v.uint16;
+      if (nst->ticket_len == 0) {
+        /* the server changed its mind */
+        v->next = TOK_DONE;
+        v->wantlen = 0;
+        break;
+      }
+      nb->state = SLN_HS_NEW_SESSION_TICKET_DATA;
+      v->next = TOK_COPY_BRIGADE;
+      v->wantlen = nst->ticket_len;
+      break;
+    }
+    case SLN_HS_NEW_SESSION_TICKET_DATA: {
+      size_t len = nst->ticket_len;
+      nst->ticket = sln_alloc(hs->s, sln_brigade_size(v->v.bb));
+      sln_brigade_flatten(v->v.bb, nst->ticket, &len);
+      SLN_ASSERT(nst->ticket_len == len);
+      v->next = TOK_DONE;
+      v->wantlen = 0;
+      break;
+    }
+  }
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *parse_new_session_ticket_finish(sln_hs_baton_t *hs,
+                                                       void *baton) {
+  return selene_publish(hs->s, SELENE__EVENT_HS_GOT_NEW_SESSION_TICKET);
+}
+
+static void parse_new_session_ticket_destroy(sln_hs_baton_t *hs,
+                                             void *baton) {
+  nst_baton_t *nb = (nst_baton_t *)baton;
+
+  if (nb->nst.ticket != NULL) {
+    sln_free(hs->s, nb->nst.ticket);
+  }
+
+  sln_free(hs->s, nb);
+}
+
+selene_error_t *sln_handshake_parse_new_session_ticket_setup(
+    sln_hs_baton_t *hs, sln_tok_value_t *v, void **baton) {
+  nst_baton_t *nb = sln_calloc(hs->s, sizeof(nst_baton_t));
+  nb->state = SLN_HS_NEW_SESSION_TICKET_LIFETIME;
+  hs->baton->msg.new_session_ticket = &nb->nst;
+  hs->current_msg_step = parse_new_session_ticket_step;
+  hs->current_msg_finish = parse_new_session_ticket_finish;
+  hs->current_msg_destroy = parse_new_session_ticket_destroy;
+  v->next = TOK_COPY_BYTES;
+  v->wantlen = 4;
+  *baton = (void *)nb;
+  return SELENE_SUCCESS;
+}
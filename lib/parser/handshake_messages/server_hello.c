@@ -49,8 +49,13 @@ selene_error_t *sln_handshake_serialize_server_hello(selene_t *s,
   /* compressionMethod */
   len += 1;
 
-  /* TODO: extensions */
-  sln_bucket_create_empty(s->alloc, &b, len);
+  /* TODO: more extensions */
+  if (sh->have_ticket_ext) {
+    /* length of extensions, and an empty SessionTicket */
+    len += 2 + 4;
+  }
+
+  sln_tls_record_create(s, len, &b);
 
   b->data[0] = SLN_HS_MT_SERVER_HELLO;
   dlen = len - 4;
@@ -80,31 +85,23 @@ selene_error_t *sln_handshake_serialize_server_hello(selene_t *s,
     off += sh->session_id_len;
   }
 
-  switch (sh->cipher) {
-    /* TODO: move a better utility place */
-    case SELENE_CS_RSA_WITH_RC4_128_SHA:
-      b->data[off] = 0x00;
-      b->data[off + 1] = 0x05;
-      break;
-    case SELENE_CS_RSA_WITH_AES_128_CBC_SHA:
-      b->data[off] = 0x00;
-      b->data[off + 1] = 0x2F;
-      break;
-    case SELENE_CS_RSA_WITH_AES_256_CBC_SHA:
-      b->data[off] = 0x00;
-      b->data[off + 1] = 0x35;
-      break;
-    default:
-      /* TODO: handle this */
-      abort();
-      break;
-  }
+  sln_parser_hs_cipher_suite_to_bytes(sh->cipher, b->data + off);
   off += 2;
 
   b->data[off] = 0;
 
   off += 1;
 
+  if (sh->have_ticket_ext) {
+    b->data[off] = 0;
+    b->data[off + 1] = 4;
+    b->data[off + 2] = SLN_HS_EXT_SESSION_TICKET >> 8;
+    b->data[off + 3] = SLN_HS_EXT_SESSION_TICKET;
+    b->data[off + 4] = 0;
+    b->data[off + 5] = 0;
+    off += 6;
+  }
+
   SLN_ASSERT(off == len);
 
   *p_b = b;
@@ -153,8 +150,10 @@ static selene_error_t *parse_server_hello_step(sln_hs_baton_t *hs,
 
     case SLN_HS_SERVER_HELLO_SESSION_LENGTH: {
       sh->session_id_len = v->v.bytes[0];
-      if (sh->session_id_len > 32) {
-        /* TODO: session id errors */
+      if (sh->session_id_len > sizeof(sh->session_id)) {
+        return selene_error_createf(SELENE_EINVAL,
+                                    "Invalid session id length: %u",
+                                    sh->session_id_len);
       }
 
       if (sh->session_id_len == 0) {
@@ -197,6 +196,15 @@ static selene_error_t *parse_server_hello_step(sln_hs_baton_t *hs,
     case SLN_HS_SERVER_HELLO_COMPRESSION: {
       sh->comp = sln_parser_hs_bytes_to_comp_method(v->v.bytes[0]);
       /* TODO: fatal alert on invalid comp method (?) */
+      /* Asking past the end of a message without extensions ends it */
+      shb->state = SLN_HS_SERVER_HELLO_EXTS_LENGTH;
+      v->next = TOK_UINT16;
+      v->wantlen = 2;
+      break;
+    }
+
+    case SLN_HS_SERVER_HELLO_EXTS_LENGTH: {
+      /* the message ends with the last one */
       shb->state = SLN_HS_SERVER_HELLO_EXT_DEF;
       v->next = TOK_COPY_BYTES;
       v->wantlen = 4;
@@ -207,23 +215,28 @@ static selene_error_t *parse_server_hello_step(sln_hs_baton_t *hs,
       /* Extensions Registry:
        *   <http://www.iana.org/assignments/tls-extensiontype-values/tls-extensiontype-values.xml>
       */
-      uint16_t ext_len = (((unsigned char)v->v.bytes[0]) << 8 |
-                          ((unsigned char)v->v.bytes[1]));
-      uint16_t ext_type = (((unsigned char)v->v.bytes[2]) << 8 |
-                           ((unsigned char)v->v.bytes[3]));
+      uint16_t ext_type = (((unsigned char)v->v.bytes[0]) << 8 |
+                           ((unsigned char)v->v.bytes[1]));
+      uint16_t ext_len = (((unsigned char)v->v.bytes[2]) << 8 |
+                          ((unsigned char)v->v.bytes[3]));
 
       slnDbg(s, "server extension: %u len: %u\n", ext_type, ext_len);
 
-      if (ext_type == 0) {
-        /* SNI  was supported by the server, but we don't care here, so we just
-         * skip it */
-        shb->state = SLN_HS_SERVER_HELLO_EXT_SKIP;
-        v->next = TOK_SKIP;
-        v->wantlen = ext_len - 4;
+      if (ext_type == SLN_HS_EXT_SESSION_TICKET) {
+        /* always empty from the server */
+        sh->have_ticket_ext = 1;
+      }
+
+      /* SNI was supported by the server, but we don't care here, so we just
+       * skip it, along with everything else */
+      if (ext_len == 0) {
+        shb->state = SLN_HS_SERVER_HELLO_EXT_DEF;
+        v->next = TOK_COPY_BYTES;
+        v->wantlen = 4;
       } else {
         shb->state = SLN_HS_SERVER_HELLO_EXT_SKIP;
         v->next = TOK_SKIP;
-        v->wantlen = ext_len - 4;
+        v->wantlen = ext_len;
       }
       break;
     }
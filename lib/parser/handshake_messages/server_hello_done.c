@@ -31,7 +31,7 @@ selene_error_t *sln_handshake_serialize_server_hello_done(
   /* length size */
   len += 3;
 
-  sln_bucket_create_empty(s->alloc, &b, len);
+  sln_tls_record_create(s, len, &b);
 
   b->data[off] = SLN_HS_MT_SERVER_HELLO_DONE;
   off += 1;
@@ -72,6 +72,11 @@ static selene_error_t *parse_server_hello_done_step(sln_hs_baton_t *hs,
   return SELENE_SUCCESS;
 }
 
+static selene_error_t *parse_server_hello_done_finish(sln_hs_baton_t *hs,
+                                                      void *baton) {
+  return selene_publish(hs->s, SELENE__EVENT_HS_GOT_SERVER_HELLO_DONE);
+}
+
 static void parse_server_hello_done_destroy(sln_hs_baton_t *hs, void *baton) {
   shd_baton_t *shd = (shd_baton_t *)baton;
 
@@ -88,13 +93,13 @@ selene_error_t *sln_handshake_parse_server_hello_done_setup(sln_hs_baton_t *hs,
   slnDbg(hs->s, "sln_handshake_parse_server_hello_done_setup");
   hs->baton->msg.server_hello_done = &shd->shd;
   hs->current_msg_step = parse_server_hello_done_step;
-  hs->current_msg_finish = NULL;
+  hs->current_msg_finish = parse_server_hello_done_finish;
   hs->current_msg_destroy = parse_server_hello_done_destroy;
 
+  /* SHD has no fields, it is done as soon as it is set up */
   v->next = TOK_DONE;
   v->wantlen = 0;
   *baton = (void *)shd;
 
-  /* SHD has no fields, so on setup we just emit the event. */
-  return selene_publish(hs->s, SELENE__EVENT_HS_GOT_SERVER_HELLO_DONE);
+  return SELENE_SUCCESS;
 }
@@ -50,6 +50,28 @@ typedef struct sln_parser_baton_t sln_parser_baton_t;
  *      Application Data             <------->     Application Data
  *
  *             Fig. 1. Message flow for a full handshake
+ *
+ *      Client                                                Server
+ *
+ *      ClientHello                   -------->
+ *                                                       ServerHello
+ *                                                [ChangeCipherSpec]
+ *                                    <--------             Finished
+ *      [ChangeCipherSpec]
+ *      Finished                      -------->
+ *      Application Data              <------->     Application Data
+ *
+ *          Fig. 2. Message flow for an abbreviated handshake
+ *
+ * With RFC 5077 session tickets, a server that put an empty SessionTicket
+ * extension in its ServerHello sends a NewSessionTicket right before its
+ * ChangeCipherSpec, in either flow.  A client resuming with a ticket sends a
+ * session ID along with it, and knows the server took the ticket when the
+ * ServerHello echoes the ID.
+ *
+ * The client stays in WAIT_SERVER_HELLO_DONE until the ServerHello tells it
+ * which of the two it is in, and the server waits in WAIT_CLIENT_FINISHED
+ * from the ClientKeyExchange on.
  */
 
 typedef enum {
@@ -79,14 +101,45 @@ typedef enum sln_connstate_e {
   ((SLN_PARAMS_MAC_SECRET_MAX_LENGTH * 2) + (SLN_PARAMS_KEY_MAX_LENGTH * 2) + \
    (SLN_PARAMS_IV_MAX_LENGTH * 2))
 
+/* The contexts one worker lane decrypts records with, aead for AEAD suites,
+ * hmac and cryptor for CBC ones.  hmac is a built-in one, like cbc_hmac. */
+typedef struct sln_params_lane_t {
+  sln_aead_t *aead;
+  sln_hmac_t *hmac;
+  sln_cryptor_t *cryptor;
+} sln_params_lane_t;
+
 typedef struct sln_params_t {
   int init;
   char mac_secret[SLN_PARAMS_MAC_SECRET_MAX_LENGTH];
   char key[SLN_PARAMS_KEY_MAX_LENGTH];
+  /* For receiving TLS 1.0 CBC records, the IV of the next one */
   char iv[SLN_PARAMS_IV_MAX_LENGTH];
   selene_cipher_suite_e suite;
   uint64_t seq_num;
+  size_t maclen;
+  /* 0 for stream ciphers */
+  size_t blocksize;
+  /* TLS 1.1+ sends a fresh IV in front of every CBC record */
+  int explicit_iv;
+  /* AEAD suites send this much of the nonce in front of every record, and
+   * keep the implicit part of it in iv */
+  size_t record_ivlen;
+  /* All are NULL until keys are set up, records then go out in the clear.
+   * AEAD suites only use aead. */
   sln_hmac_t *hmac;
+  sln_cryptor_t *cryptor;
+  sln_aead_t *aead;
+  /* Replaces hmac on the receiving side of CBC suites: a built-in HMAC, as
+   * record_verify needs the hash state to check the MAC in constant time */
+  sln_hmac_t *cbc_hmac;
+  /* Contexts per worker lane, for decrypting in parallel.  Made on first
+   * use. */
+  sln_params_lane_t *lanes;
+  int nlanes;
+  /* Replaces hmac and cryptor for CBC suites where OpenSSL can do both in
+   * one pass, NULL otherwise */
+  sln_stitched_t *stitched;
 } sln_params_t;
 
 #define SLN_SECRET_LENGTH (48)
@@ -104,6 +157,11 @@ struct sln_parser_baton_t {
   uint8_t peer_version_major;
   uint8_t peer_version_minor;
 
+  /* ClientHello.client_version, the client puts it in front of the
+   * pre-master secret */
+  uint8_t client_version_major;
+  uint8_t client_version_minor;
+
   char pre_master_secret[SLN_SECRET_LENGTH];
   char master_secret[SLN_SECRET_LENGTH];
 
@@ -115,22 +173,54 @@ struct sln_parser_baton_t {
   uint32_t server_utc_unix_time;
   char server_random_bytes[28];
 
-  int params_init;
   sln_params_t pending_send_parameters;
   sln_params_t pending_recv_parameters;
   sln_params_t active_send_parameters;
   sln_params_t active_recv_parameters;
 
+  /* Session set up by this handshake, or the one it resumes.  Its master
+   * secret is only filled in once the handshake is done, master_secret above
+   * is the one in use. */
+  selene_session_t session;
+  int resumed;
+
+  /* The server sends a NewSessionTicket before its ChangeCipherSpec */
+  int ticket_expected;
+
+  /* (client only) Offered a ticket with no session ID, what follows the
+   * ServerHello tells whether the server resumed with it */
+  int ticket_pending;
+
+  /* (server only) Waiting on selene_complete_session_lookup for the ID in
+   * session, with what it takes to answer the ClientHello afterwards */
+  int session_lookup;
+  int client_ticket_ext;
+  selene_cipher_suite_list_t offered_ciphers;
+
+  /* What the peer's Finished has to carry, worked out before the Finished
+   * itself goes into the handshake digests */
+  char peer_verify_data[SLN_MSG_FINISHED_VERIFY_LENGTH];
+
+  /* Calls to sln_state_machine on the stack, handlers completing events
+   * from inside it must not call it again */
+  int depth;
+
   /* TODO: TLS 1.2, plugable handshake digests */
   sln_digest_t *md5_handshake_digest;
   sln_digest_t *sha1_handshake_digest;
 
+  /* Record and handshake readers, resumed as more data arrives */
+  struct rtls_baton_t *rtls;
+  sln_hs_baton_t hs;
+
   union {
     sln_msg_client_hello_t *client_hello;
     sln_msg_server_hello_t *server_hello;
     sln_msg_certificate_t *certificate;
     sln_msg_server_hello_done_t *server_hello_done;
     sln_msg_client_key_exchange_t *client_key_exchange;
+    sln_msg_finished_t *finished;
+    sln_msg_new_session_ticket_t *new_session_ticket;
   } msg;
 };
 
@@ -141,12 +231,51 @@ selene_error_t *sln_state_machine(selene_t *s, sln_parser_baton_t *baton);
  */
 selene_error_t *sln_io_tls_read(selene_t *s, sln_parser_baton_t *baton);
 
+void sln_io_tls_read_destroy(selene_t *s, sln_parser_baton_t *baton);
+
+/* Sends the cleartext handed to us as application data records */
+selene_error_t *sln_io_tls_write_appdata(selene_t *s,
+                                         sln_parser_baton_t *baton);
+
 selene_error_t *sln_io_alert_read(selene_t *s, sln_parser_baton_t *baton);
 
-selene_error_t *sln_tls_params_update_mac(selene_t *s, sln_bucket_t *b);
+/**
+ * Derives the keys for suite from the master secret into the pending
+ * parameters of both directions, and sets up their MAC and cipher contexts.
+ */
+selene_error_t *sln_tls_params_init(selene_t *s, selene_cipher_suite_e suite);
+
+/* Whether suite works with the protocol version and crypto backend in use */
+int sln_tls_suite_available(selene_t *s, selene_cipher_suite_e suite);
+
+/* Switches a direction over to its pending parameters, on sending or
+ * receiving a ChangeCipherSpec */
+void sln_tls_params_activate_send(selene_t *s);
 
-selene_error_t *sln_tls_params_encrypt(selene_t *s, sln_bucket_t *b,
-                                       sln_bucket_t **out);
+void sln_tls_params_activate_recv(selene_t *s);
+
+void sln_tls_params_destroy(selene_t *s);
+
+/* Appends the MAC of the record in b to it, in its tailroom.  header is the
+ * record header, with the length of b.  Does nothing where
+ * sln_tls_params_encrypt does the MAC as well, for AEAD and stitched
+ * ciphers. */
+selene_error_t *sln_tls_params_update_mac(selene_t *s, const char *header,
+                                          sln_bucket_t *b);
+
+/* Encrypts b in place, growing it into its headroom for an explicit IV or
+ * nonce, and into its tailroom for padding or an AEAD tag.  header is the
+ * record header, with the plaintext length of b. */
+selene_error_t *sln_tls_params_encrypt(selene_t *s, const char *header,
+                                       sln_bucket_t *b);
+
+/**
+ * Decrypts the record in b in place, checks its padding and MAC, and trims b
+ * down to the plaintext.  header is the record header as received.  Fails
+ * with SELENE_EINVAL if the record does not authenticate.
+ */
+selene_error_t *sln_tls_params_decrypt(selene_t *s, const char *header,
+                                       sln_bucket_t *b);
 
 /**
  * Client Writing Methods
@@ -167,6 +296,8 @@ selene_error_t *sln_io_handshake_client_hello(selene_t *s,
  */
 selene_error_t *sln_io_handshake_read(selene_t *s, sln_parser_baton_t *baton);
 
+void sln_io_handshake_read_destroy(selene_t *s, sln_parser_baton_t *baton);
+
 typedef enum {
   SLN_CONTENT_TYPE__UNUSED0 = 0,
   SLN_CONTENT_TYPE_CHANGE_CIPHER_SPEC = 1,
@@ -183,8 +314,26 @@ typedef struct sln_msg_tls_t {
   int length;
 } sln_msg_tls_t;
 
-selene_error_t *sln_tls_serialize_header(selene_t *s, sln_msg_tls_t *tls,
-                                         sln_bucket_t **b);
+#define SLN_TLS_RECORD_HEADER_LENGTH (5)
+
+/* Largest plaintext in a single record, 2^14 */
+#define SLN_TLS_RECORD_MAX_PLAINTEXT (16384)
+
+/* Room kept around the payload of an outgoing record, for the record header
+ * and an explicit IV in front of it, and for the MAC and block padding
+ * behind it */
+#define SLN_TLS_RECORD_HEADROOM \
+  (SLN_TLS_RECORD_HEADER_LENGTH + SLN_PARAMS_IV_MAX_LENGTH)
+#define SLN_TLS_RECORD_TAILROOM \
+  (SLN_PARAMS_MAC_SECRET_MAX_LENGTH + SLN_PARAMS_IV_MAX_LENGTH)
+
+/**
+ * Allocates the bucket for an outgoing record with a payload of len bytes.
+ * Serializers write the payload into it, and sln_tls_toss_bucket then frames,
+ * MACs and encrypts it in place, so the record goes out as this one bucket.
+ */
+selene_error_t *sln_tls_record_create(selene_t *s, size_t len,
+                                      sln_bucket_t **b);
 
 /**
  * shortcut method that sends a whole message of the specified type, including
@@ -78,6 +78,10 @@ selene_error_t *sln_parser_destroy(selene_t *s) {
 
   baton = s->backend_baton;
 
+  sln_io_tls_read_destroy(s, baton);
+  sln_io_handshake_read_destroy(s, baton);
+  sln_tls_params_destroy(s);
+
   sln_brigade_destroy(baton->in_ccs);
   sln_brigade_destroy(baton->in_alert);
   sln_brigade_destroy(baton->in_handshake);
@@ -17,9 +17,64 @@
 
 #include "sln_brigades.h"
 #include "parser.h"
+#include "alert_messages.h"
 
-selene_error_t* sln_state_machine(selene_t* s, sln_parser_baton_t* baton) {
+/* A ChangeCipherSpec switches incoming records over to the keys the
+ * handshake set up, it is out of place anywhere else */
+static selene_error_t* read_change_cipher_spec(selene_t* s,
+                                               sln_parser_baton_t* baton) {
+  char ccs[2];
+  size_t len = sizeof(ccs);
+
+  SELENE_ERR(sln_brigade_flatten(baton->in_ccs, &ccs[0], &len));
+  sln_brigade_clear(baton->in_ccs);
+
+  SELENE_ERR(sln_handshake_peer_change_cipher_spec(s));
+
+  if (len != 1 || ccs[0] != 1 ||
+      baton->pending_recv_parameters.suite == SELENE_CS__UNUSED0) {
+    baton->connstate = SLN_CONNSTATE_ALERT_FATAL;
+    baton->fatal_err =
+        selene_error_create(SELENE_EINVAL, "Unexpected ChangeCipherSpec");
+    SELENE_ERR(sln_io_alert_fatal(s, SLN_ALERT_DESC_UNEXPECTED_MESSAGE));
+    return selene_error_dup(baton->fatal_err);
+  }
+
+  slnDbg(s, "got change cipher spec");
+
+  /* everything after this is protected with the new keys */
+  sln_tls_params_activate_recv(s);
+
+  return SELENE_SUCCESS;
+}
+
+/* Reads the handshake messages and ChangeCipherSpec that came in, sets
+ * changed if that moved the handshake along */
+static selene_error_t* read_handshake(selene_t* s, sln_parser_baton_t* baton,
+                                      int* changed) {
+  sln_handshake_e state = baton->handshake;
+
+  if (!SLN_BRIGADE_EMPTY(baton->in_handshake)) {
+    slnDbg(s, "input handshake brigade has content");
+    SELENE_ERR(sln_io_handshake_read(s, baton));
+  }
+
+  if (baton->handshake == state && !SLN_BRIGADE_EMPTY(baton->in_ccs)) {
+    SELENE_ERR(read_change_cipher_spec(s, baton));
+    /* the records behind it can be read now */
+    *changed = 1;
+  }
+
+  if (baton->handshake != state) {
+    *changed = 1;
+  }
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t* state_machine(selene_t* s, sln_parser_baton_t* baton) {
   selene_error_t* err = SELENE_SUCCESS;
+  int changed;
 
 enter_state_machine:
   slnDbg(s, "enter handshake_state_machine=%d", baton->handshake);
@@ -48,8 +103,13 @@ enter_state_machine:
     }
   }
 
+  if (!SLN_BRIGADE_EMPTY(baton->in_application)) {
+    /* already decrypted, the application gets it as is */
+    SLN_BRIGADE_CONCAT(s->bb.out_cleartext, baton->in_application);
+  }
+
   if (baton->ready_for_appdata && !SLN_BRIGADE_EMPTY(s->bb.in_cleartext)) {
-    /* err = sln_io_tls_write_appdata(s, baton); */
+    err = sln_io_tls_write_appdata(s, baton);
     if (err) {
       return err;
     }
@@ -67,43 +127,28 @@ enter_state_machine:
         goto enter_state_machine;
         break;
       case SLN_HANDSHAKE_CLIENT_WAIT_SERVER_HELLO_DONE:
-        slnDbg(s, "trying server hello done");
-        if (!SLN_BRIGADE_EMPTY(baton->in_handshake)) {
-          slnDbg(s, "input handshake brigade has content");
-          err = sln_io_handshake_read(s, baton);
-          if (err) {
-            return err;
-          }
-          if (baton->handshake != SLN_HANDSHAKE_CLIENT_WAIT_SERVER_HELLO_DONE) {
-            goto enter_state_machine;
-          }
+      case SLN_HANDSHAKE_CLIENT_WAIT_SERVER_FINISHED:
+      case SLN_HANDSHAKE_SERVER_WAIT_CLIENT_HELLO:
+      case SLN_HANDSHAKE_SERVER_WAIT_CLIENT_FINISHED:
+        changed = 0;
+        err = read_handshake(s, baton, &changed);
+        if (err) {
+          return err;
+        }
+        if (changed) {
+          goto enter_state_machine;
         }
         break;
       case SLN_HANDSHAKE_CLIENT_SEND_FINISHED:
         break;
-      case SLN_HANDSHAKE_CLIENT_WAIT_SERVER_FINISHED:
-        break;
       case SLN_HANDSHAKE_CLIENT_APPDATA:
         break;
 
       /***
        * Start Server Methods.
        */
-      case SLN_HANDSHAKE_SERVER_WAIT_CLIENT_HELLO:
-        if (!SLN_BRIGADE_EMPTY(baton->in_handshake)) {
-          err = sln_io_handshake_read(s, baton);
-          if (err) {
-            return err;
-          }
-          if (baton->handshake != SLN_HANDSHAKE_SERVER_WAIT_CLIENT_HELLO) {
-            goto enter_state_machine;
-          }
-        }
-        break;
       case SLN_HANDSHAKE_SERVER_SEND_SERVER_HELLO_DONE:
         break;
-      case SLN_HANDSHAKE_SERVER_WAIT_CLIENT_FINISHED:
-        break;
       case SLN_HANDSHAKE_SERVER_SEND_FINISHED:
         break;
       case SLN_HANDSHAKE_SERVER_APPDATA:
@@ -130,3 +175,13 @@ enter_state_machine:
   slnDbg(s, "exit handshake_state_machine=%d", baton->handshake);
   return SELENE_SUCCESS;
 }
+
+selene_error_t* sln_state_machine(selene_t* s, sln_parser_baton_t* baton) {
+  selene_error_t* err;
+
+  baton->depth++;
+  err = state_machine(s, baton);
+  baton->depth--;
+
+  return err;
+}
@@ -20,6 +20,13 @@
 #include "alert_messages.h"
 #include "sln_prf.h"
 #include "sln_hmac.h"
+#include "sln_encypt.h"
+#include "sln_aead.h"
+#include "sln_stitched.h"
+#include "sln_workers.h"
+#include "sln_crypto.h"
+#include "sln_ct.h"
+#include "common.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -58,7 +65,14 @@ typedef struct rtls_baton_t {
   uint8_t version_major;
   uint8_t version_minor;
   uint16_t length;
+  /* Length of the record header */
   size_t consume;
+  /* Where the record's payload goes, NULL to drop it */
+  sln_brigade_t *dest;
+  /* Kept across calls, so a partial record is not parsed again */
+  sln_tok_parser_t tok;
+  /* Holds a protected record while it is decrypted */
+  sln_brigade_t *record;
 } rtls_baton_t;
 
 static int is_valid_content_type(uint8_t input) {
@@ -129,27 +143,27 @@ static selene_error_t *read_tls(sln_tok_value_t *v, void *baton_) {
                       ((unsigned char)v->v.bytes[1]));
       rtls->state = TLS_RS_MESSAGE;
       rtls->consume += 2;
-      v->next = TOK_COPY_BRIGADE;
+      /* The payload is moved out of in_enc once the whole record is here */
+      v->next = TOK_SKIP;
       v->wantlen = rtls->length;
       break;
     case TLS_RS_MESSAGE:
-      /* TODO: efficient slicing of brigades instead of copying data here */
-      rtls->consume += sln_brigade_size(v->v.bb);
       switch (rtls->content_type) {
         case TLS_CT_CHANGE_CIPHER_SPEC:
-          SLN_BRIGADE_CONCAT(baton->in_ccs, v->v.bb);
+          rtls->dest = baton->in_ccs;
           break;
         case TLS_CT_ALERT:
-          SLN_BRIGADE_CONCAT(baton->in_alert, v->v.bb);
+          rtls->dest = baton->in_alert;
           break;
         case TLS_CT_HANDSHAKE:
-          SLN_BRIGADE_CONCAT(baton->in_handshake, v->v.bb);
+          rtls->dest = baton->in_handshake;
           break;
         case TLS_CT_APPLICATION:
-          SLN_BRIGADE_CONCAT(baton->in_application, v->v.bb);
+          rtls->dest = baton->in_application;
           break;
         default:
           /* TODO: send alert breaking connection */
+          rtls->dest = NULL;
           break;
       }
       rtls->state = TLS_RS__DONE;
@@ -166,167 +180,1014 @@ static selene_error_t *read_tls(sln_tok_value_t *v, void *baton_) {
   return SELENE_SUCCESS;
 }
 
+static void rtls_reset(rtls_baton_t *rtls) {
+  rtls->state = TLS_RS__INIT;
+  rtls->content_type = 0;
+  rtls->version_major = 0;
+  rtls->version_minor = 0;
+  rtls->length = 0;
+  rtls->consume = 0;
+  rtls->dest = NULL;
+  sln_tok_parser_reset(&rtls->tok);
+}
+
+static size_t record_length(const char *header) {
+  return ((unsigned char)header[3]) << 8 | ((unsigned char)header[4]);
+}
+
+/* Moves the len byte payload at the front of in_enc into a bucket of its
+ * own, without copying it unless it arrived split over reads: decrypting
+ * needs it in one place */
+static selene_error_t *take_record(selene_t *s, rtls_baton_t *rtls, size_t len,
+                                   sln_bucket_t **p_b) {
+  sln_bucket_t *b = NULL;
+  size_t flen = len;
+
+  SELENE_ERR(sln_brigade_splice_into(s->bb.in_enc, len, rtls->record));
+
+  if (sln_brigade_bucket_count(rtls->record) == 1) {
+    b = SLN_BRIGADE_FIRST(rtls->record);
+    SLN_BUCKET_REMOVE(b);
+  } else {
+    SELENE_ERR(sln_bucket_create_empty(s->alloc, &b, len));
+    SELENE_ERR(sln_brigade_flatten(rtls->record, b->data, &flen));
+  }
+
+  *p_b = b;
+
+  return SELENE_SUCCESS;
+}
+
+/* Records opened on conf->workers at once, at most */
+#define PARALLEL_MAX_RECORDS (64)
+
+/* Decrypts runs of whole application data records at the front of in_enc in
+ * parallel, and moves their plaintext to in_application in order.  Sets
+ * count to how many it took, 0 if in_enc does not start with such a run, or
+ * parallel decryption is not set up. */
+static selene_error_t *read_parallel(selene_t *s, rtls_baton_t *rtls,
+                                     size_t *count);
+
+/* Decrypts the record at the front of in_enc where it is, if it arrived in
+ * one piece, and moves the plaintext to its destination */
+static selene_error_t *read_protected(selene_t *s, rtls_baton_t *rtls) {
+  selene_error_t *err;
+  sln_bucket_t *b = NULL;
+  char header[SLN_TLS_RECORD_HEADER_LENGTH];
+
+  SELENE_ERR(take_record(s, rtls, rtls->length, &b));
+
+  header[0] = rtls->content_type;
+  header[1] = rtls->version_major;
+  header[2] = rtls->version_minor;
+  header[3] = rtls->length >> 8;
+  header[4] = rtls->length;
+
+  err = sln_tls_params_decrypt(s, header, b);
+  if (err) {
+    sln_bucket_destroy(b);
+    return err;
+  }
+
+  if (b->size == 0) {
+    sln_bucket_destroy(b);
+  } else {
+    SLN_BRIGADE_INSERT_TAIL(rtls->dest, b);
+  }
+
+  return SELENE_SUCCESS;
+}
+
 selene_error_t *sln_io_tls_read(selene_t *s, sln_parser_baton_t *baton) {
-  rtls_baton_t rtls;
+  rtls_baton_t *rtls = baton->rtls;
   selene_error_t *err;
+  size_t count;
+
+  if (rtls == NULL) {
+    rtls = sln_calloc(s, sizeof(*rtls));
+    rtls->s = s;
+    rtls->baton = baton;
+    rtls_reset(rtls);
+    SELENE_ERR(sln_brigade_create(s->alloc, &rtls->record));
+    baton->rtls = rtls;
+  }
 
-  do {
+  /* Records behind a ChangeCipherSpec wait for the state machine to act on
+   * it, they may be under keys the handshake has yet to work out */
+  while (!SLN_BRIGADE_EMPTY(s->bb.in_enc) && SLN_BRIGADE_EMPTY(baton->in_ccs)) {
     slnDbg(s, "tls read pending: %d", (int)sln_brigade_size(s->bb.in_enc));
-    memset(&rtls, 0, sizeof(rtls));
-    rtls.s = s;
-    rtls.baton = baton;
-    rtls.state = TLS_RS__INIT;
 
-    err = sln_tok_parser(s->bb.in_enc, read_tls, &rtls);
+    if (rtls->state == TLS_RS__INIT) {
+      err = read_parallel(s, rtls, &count);
+      if (err) {
+        sln_io_alert_fatal(s, SLN_ALERT_DESC_BAD_RECORD_MAC);
+        return err;
+      }
+      if (count != 0) {
+        continue;
+      }
+    }
+
+    err = sln_tok_parser_resume(&rtls->tok, s->bb.in_enc, read_tls, rtls);
 
     if (err) {
+      rtls_reset(rtls);
       /* TODO: logging here? */
       sln_io_alert_fatal(s, SLN_ALERT_DESC_INTERNAL_ERROR);
       return err;
     }
 
-    if (rtls.state == TLS_RS__DONE) {
-      /* Consumed a whole TLS packet, otherwise we got part way done */
-      sln_brigade_chomp(s->bb.in_enc, rtls.consume);
-      slnDbg(s, "tls read chomping: %d", (int)rtls.consume);
+    if (rtls->state != TLS_RS__DONE) {
+      /* part way through a record, resume here once more data arrives */
+      break;
+    }
 
-      /* TODO: only on first packet (?)  SSLv2 Hello?? */
-      baton->peer_version_major = rtls.version_major;
-      baton->peer_version_minor = rtls.version_minor;
+    /* Consumed a whole TLS packet, hand its payload over without copying */
+    SELENE_ERR(sln_brigade_chomp(s->bb.in_enc, rtls->consume));
+    if (rtls->dest == NULL) {
+      SELENE_ERR(sln_brigade_chomp(s->bb.in_enc, rtls->length));
+    } else if (baton->active_recv_parameters.suite == SELENE_CS__UNUSED0) {
+      SELENE_ERR(
+          sln_brigade_splice_into(s->bb.in_enc, rtls->length, rtls->dest));
+    } else {
+      err = read_protected(s, rtls);
+      if (err) {
+        rtls_reset(rtls);
+        sln_io_alert_fatal(s, SLN_ALERT_DESC_BAD_RECORD_MAC);
+        return err;
+      }
     }
-  } while (err == SELENE_SUCCESS && rtls.state == TLS_RS__DONE &&
-           !SLN_BRIGADE_EMPTY(s->bb.in_enc));
+    slnDbg(s, "tls read chomping: %d", (int)(rtls->consume + rtls->length));
+
+    /* TODO: only on first packet (?)  SSLv2 Hello?? */
+    baton->peer_version_major = rtls->version_major;
+    baton->peer_version_minor = rtls->version_minor;
+
+    rtls_reset(rtls);
+  }
 
   return SELENE_SUCCESS;
 }
 
-static void get_suite_info(selene_cipher_suite_e suite, size_t *maclen,
-                           size_t *keylen, size_t *ivlen) {
+void sln_io_tls_read_destroy(selene_t *s, sln_parser_baton_t *baton) {
+  if (baton->rtls != NULL) {
+    sln_tok_parser_destroy(&baton->rtls->tok);
+    sln_brigade_destroy(baton->rtls->record);
+    sln_free(s, baton->rtls);
+    baton->rtls = NULL;
+  }
+}
+
+typedef struct suite_info_t {
+  size_t maclen;
+  size_t keylen;
+  /* 0 for stream and AEAD ciphers */
+  size_t blocksize;
+  /* the implicit part of an AEAD nonce, taken from the key block */
+  size_t fixed_ivlen;
+  /* the part of an AEAD nonce sent in front of every record */
+  size_t record_ivlen;
+  int aead;
+  sln_cipher_e cipher;
+  sln_aead_e aead_type;
+  /* the TLS 1.2 PRF hash of the AEAD suites */
+  sln_hmac_e prf;
+} suite_info_t;
+
+static void get_suite_info(selene_cipher_suite_e suite, suite_info_t *info) {
+  memset(info, 0, sizeof(*info));
+
   switch (suite) {
     case SELENE_CS_RSA_WITH_RC4_128_SHA:
-      *maclen = 20;
-      *keylen = SLN_CIPHER_RC4_128_KEY_LENGTH;
-      *ivlen = 0;
+      info->maclen = 20;
+      info->keylen = SLN_CIPHER_RC4_128_KEY_LENGTH;
+      info->cipher = SLN_CIPHER_RC4;
       break;
     case SELENE_CS_RSA_WITH_AES_128_CBC_SHA:
-      *maclen = 20;
-      *keylen = 16;
-      *ivlen = 0;
+      info->maclen = 20;
+      info->keylen = 16;
+      info->blocksize = 16;
+      info->cipher = SLN_CIPHER_AES_128_CBC;
       break;
     case SELENE_CS_RSA_WITH_AES_256_CBC_SHA:
-      *maclen = 20;
-      *keylen = 32;
-      *ivlen = 0;
+      info->maclen = 20;
+      info->keylen = 32;
+      info->blocksize = 16;
+      info->cipher = SLN_CIPHER_AES_256_CBC;
+      break;
+    /* RFC 5288 */
+    case SELENE_CS_RSA_WITH_AES_128_GCM_SHA256:
+      info->aead = 1;
+      info->aead_type = SLN_AEAD_AES_128_GCM;
+      info->prf = SLN_HMAC_SHA256;
+      info->fixed_ivlen = 4;
+      info->record_ivlen = 8;
+      break;
+    case SELENE_CS_RSA_WITH_AES_256_GCM_SHA384:
+      info->aead = 1;
+      info->aead_type = SLN_AEAD_AES_256_GCM;
+      info->prf = SLN_HMAC_SHA384;
+      info->fixed_ivlen = 4;
+      info->record_ivlen = 8;
       break;
     case SELENE_CS__UNUSED0:
     case SELENE_CS__MAX:
       SLN_ASSERT(1);
       break;
   }
+
+  if (info->aead) {
+    info->keylen = sln_aead_key_length(info->aead_type);
+  }
 }
 
-static selene_error_t *init_params(selene_t *s) {
-  sln_parser_baton_t *baton = s->backend_baton;
+int sln_tls_suite_available(selene_t *s, selene_cipher_suite_e suite) {
+  suite_info_t info;
+  uint8_t major;
+  uint8_t minor;
 
-  if (baton->params_init == 1) {
-    return SELENE_SUCCESS;
+  if (suite <= SELENE_CS__UNUSED0 || suite >= SELENE_CS__MAX) {
+    return 0;
   }
 
-  {
-    sln_params_t *clientp;
-    sln_params_t *serverp;
-    size_t maclen = 0;
-    size_t keylen = 0;
-    size_t ivlen = 0;
-    size_t outlen = 0;
-    size_t off = 0;
-    char buf[64];
-    char kebuf[SLN_PARAMS_KR_MAX_LENGTH];
-
-    if (s->mode == SLN_MODE_CLIENT) {
-      clientp = &baton->active_send_parameters;
-      serverp = &baton->active_recv_parameters;
-    } else {
-      serverp = &baton->active_send_parameters;
-      clientp = &baton->active_recv_parameters;
+  get_suite_info(suite, &info);
+
+  /* AEAD suites are TLS 1.2 only */
+  if (info.aead) {
+    sln_parser_tls_set_current_version(s, &major, &minor);
+    return minor >= 3 && sln_crypto_openssl_aead(info.aead_type) != NULL;
+  }
+
+  /* RC4 is gone from OpenSSL 3 unless the legacy provider is loaded */
+  return sln_crypto_openssl_cipher(info.cipher) != NULL;
+}
+
+static void params_clear(sln_params_t *p) {
+  sln_params_lane_t *lane;
+  selene_t *s;
+  int i;
+
+  /* lanes are only made for keyed parameters */
+  if (p->lanes != NULL) {
+    s = p->aead != NULL ? p->aead->s : p->cryptor->s;
+    for (i = 0; i < p->nlanes; i++) {
+      lane = &p->lanes[i];
+      if (lane->aead != NULL) {
+        sln_aead_destroy(lane->aead);
+      }
+      if (lane->hmac != NULL) {
+        sln_hmac_builtin_destroy(lane->hmac);
+      }
+      if (lane->cryptor != NULL) {
+        sln_cryptor_destroy(lane->cryptor);
+      }
     }
+    sln_free(s, p->lanes);
+  }
 
-    outlen = (maclen * 2) + (keylen * 2) + (ivlen * 2);
+  if (p->hmac != NULL) {
+    sln_hmac_destroy(p->hmac);
+  }
 
-    get_suite_info(serverp->suite, &maclen, &keylen, &ivlen);
+  if (p->cbc_hmac != NULL) {
+    sln_hmac_builtin_destroy(p->cbc_hmac);
+  }
 
-    SLN_ASSERT(outlen <= SLN_PARAMS_KR_MAX_LENGTH);
+  if (p->cryptor != NULL) {
+    sln_cryptor_destroy(p->cryptor);
+  }
 
-    SLN_ASSERT(serverp->suite == clientp->suite);
+  if (p->aead != NULL) {
+    sln_aead_destroy(p->aead);
+  }
 
-    memcpy(buf, &baton->server_utc_unix_time, 32);
-    memcpy(buf + 32, &baton->client_utc_unix_time, 32);
+  if (p->stitched != NULL) {
+    sln_stitched_destroy(p->stitched);
+  }
 
-    sln_prf(s, "key expansion", strlen("key expansion"), baton->master_secret,
-            SLN_SECRET_LENGTH, buf, 64, kebuf, outlen);
+  memset(p, 0, sizeof(*p));
+}
 
-    memcpy(clientp->mac_secret, kebuf + off, maclen);
-    off += maclen;
-    memcpy(serverp->mac_secret, kebuf + off, maclen);
-    off += maclen;
+static selene_error_t *params_keys(selene_t *s, sln_params_t *p, int encrypt,
+                                   suite_info_t *info) {
+  selene_error_t *err;
+
+  if (info->aead) {
+    return sln_aead_create(s, info->aead_type, p->key, &p->aead);
+  }
+
+  if (!encrypt && info->blocksize != 0) {
+    SELENE_ERR(sln_hmac_builtin_create(s, SLN_HMAC_SHA1, p->mac_secret,
+                                       p->maclen, &p->cbc_hmac));
+  } else {
+    SELENE_ERR(sln_hmac_create(s, SLN_HMAC_SHA1, p->mac_secret, p->maclen,
+                               &p->hmac));
+  }
 
-    memcpy(clientp->key, kebuf + off, keylen);
-    off += keylen;
-    memcpy(serverp->key, kebuf + off, keylen);
-    off += keylen;
+  SELENE_ERR(sln_cryptor_create(s, encrypt, info->cipher, p->key, p->iv,
+                                &p->cryptor));
 
-    if (ivlen) {
-      memcpy(clientp->iv, kebuf + off, ivlen);
-      off += ivlen;
-      memcpy(serverp->iv, kebuf + off, ivlen);
-      off += ivlen;
+  if (info->blocksize != 0) {
+    err = sln_stitched_create(s, encrypt, info->cipher, p->key, p->iv,
+                              p->mac_secret, &p->stitched);
+    if (err) {
+      /* no AES-NI, stay on the two pass path */
+      selene_error_clear(err);
+      p->stitched = NULL;
     }
+  }
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_tls_params_init(selene_t *s, selene_cipher_suite_e suite) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_params_t *clientp;
+  sln_params_t *serverp;
+  suite_info_t info;
+  size_t ivlen = 0;
+  size_t outlen = 0;
+  size_t off = 0;
+  uint8_t major;
+  uint8_t minor;
+  char buf[64];
+  char kebuf[SLN_PARAMS_KR_MAX_LENGTH];
+
+  if (s->mode == SLN_MODE_CLIENT) {
+    clientp = &baton->pending_send_parameters;
+    serverp = &baton->pending_recv_parameters;
+  } else {
+    serverp = &baton->pending_send_parameters;
+    clientp = &baton->pending_recv_parameters;
+  }
 
-    sln_hmac_create(s, SLN_HMAC_SHA1, clientp->mac_secret, maclen,
-                    &clientp->hmac);
+  params_clear(clientp);
+  params_clear(serverp);
 
-    sln_hmac_create(s, SLN_HMAC_SHA1, serverp->mac_secret, maclen,
-                    &serverp->hmac);
+  get_suite_info(suite, &info);
 
-    baton->params_init = 1;
+  /* TLS 1.0 takes the first CBC IV from the key block, and chains the rest,
+   * later versions send one with every record instead */
+  sln_parser_tls_set_current_version(s, &major, &minor);
+  if (info.blocksize != 0 && minor < 2) {
+    ivlen = info.blocksize;
   }
+  if (info.aead) {
+    ivlen = info.fixed_ivlen;
+  }
+
+  outlen = (info.maclen * 2) + (info.keylen * 2) + (ivlen * 2);
+
+  SLN_ASSERT(outlen <= SLN_PARAMS_KR_MAX_LENGTH);
+
+  memcpy(buf, &baton->server_utc_unix_time, 32);
+  memcpy(buf + 32, &baton->client_utc_unix_time, 32);
+
+  /* the AEAD suites are TLS 1.2 only, and expand with its PRF */
+  if (info.aead) {
+    SELENE_ERR(sln_prf_tls12(s, info.prf, "key expansion",
+                             strlen("key expansion"), baton->master_secret,
+                             SLN_SECRET_LENGTH, buf, 64, kebuf, outlen));
+  } else {
+    SELENE_ERR(sln_prf(s, "key expansion", strlen("key expansion"),
+                       baton->master_secret, SLN_SECRET_LENGTH, buf, 64,
+                       kebuf, outlen));
+  }
+
+  memcpy(clientp->mac_secret, kebuf + off, info.maclen);
+  off += info.maclen;
+  memcpy(serverp->mac_secret, kebuf + off, info.maclen);
+  off += info.maclen;
+
+  memcpy(clientp->key, kebuf + off, info.keylen);
+  off += info.keylen;
+  memcpy(serverp->key, kebuf + off, info.keylen);
+  off += info.keylen;
+
+  if (ivlen) {
+    memcpy(clientp->iv, kebuf + off, ivlen);
+    off += ivlen;
+    memcpy(serverp->iv, kebuf + off, ivlen);
+    off += ivlen;
+  }
+
+  clientp->suite = serverp->suite = suite;
+  clientp->maclen = serverp->maclen = info.maclen;
+  clientp->blocksize = serverp->blocksize = info.blocksize;
+  clientp->explicit_iv = serverp->explicit_iv =
+      (info.blocksize != 0 && ivlen == 0);
+  clientp->record_ivlen = serverp->record_ivlen = info.record_ivlen;
+
+  SELENE_ERR(params_keys(s, clientp, s->mode == SLN_MODE_CLIENT, &info));
+  SELENE_ERR(params_keys(s, serverp, s->mode != SLN_MODE_CLIENT, &info));
+
+  memset(kebuf, 0, sizeof(kebuf));
 
   return SELENE_SUCCESS;
 }
 
-selene_error_t *sln_tls_params_update_mac(selene_t *s, sln_bucket_t *b) {
+static void params_activate(sln_params_t *pending, sln_params_t *active) {
+  params_clear(active);
+  memcpy(active, pending, sizeof(*active));
+  memset(pending, 0, sizeof(*pending));
+  active->seq_num = 0;
+}
+
+void sln_tls_params_activate_send(selene_t *s) {
   sln_parser_baton_t *baton = s->backend_baton;
-  sln_params_t *p;
+  params_activate(&baton->pending_send_parameters,
+                  &baton->active_send_parameters);
+}
+
+void sln_tls_params_activate_recv(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  params_activate(&baton->pending_recv_parameters,
+                  &baton->active_recv_parameters);
+}
+
+void sln_tls_params_destroy(selene_t *s) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  params_clear(&baton->pending_send_parameters);
+  params_clear(&baton->pending_recv_parameters);
+  params_clear(&baton->active_send_parameters);
+  params_clear(&baton->active_recv_parameters);
+}
+
+/* RFC 4346, Section 6.2.3.1: HMAC(seq_num + type + version + length + data),
+ * where header holds the type, version and length */
+static void seq_bytes(uint64_t seq_num, unsigned char *seq) {
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    seq[i] = seq_num >> (56 - (i * 8));
+  }
+}
+
+static void record_seq(sln_params_t *p, unsigned char *seq) {
+  seq_bytes(p->seq_num, seq);
+  p->seq_num++;
+}
+
+static void record_mac(sln_hmac_t *hmac, uint64_t seq_num, const char *header,
+                       const char *data, size_t len, char *out) {
+  unsigned char seq[8];
+
+  seq_bytes(seq_num, seq);
+
+  sln_hmac_reset(hmac);
+  sln_hmac_update(hmac, seq, sizeof(seq));
+  sln_hmac_update(hmac, header, SLN_TLS_RECORD_HEADER_LENGTH);
+  sln_hmac_update(hmac, data, len);
+  sln_hmac_final(hmac, (unsigned char *)out);
+}
 
-  init_params(s);
+/* The stitched context decides on an explicit IV from the version in the
+ * header, only use it when that agrees with ours */
+static int use_stitched(sln_params_t *p, const char *header) {
+  return p->stitched != NULL &&
+         ((unsigned char)header[2] >= 2) == (p->explicit_iv != 0);
+}
+
+static void stitched_aad(sln_params_t *p, const char *header, size_t len,
+                         char *aad) {
+  record_seq(p, (unsigned char *)aad);
+  memcpy(aad + 8, header, SLN_TLS_RECORD_HEADER_LENGTH);
+  aad[8 + 3] = len >> 8;
+  aad[8 + 4] = len;
+}
+
+static selene_error_t *stitched_seal(sln_params_t *p, const char *header,
+                                     sln_bucket_t *b) {
+  char aad[8 + SLN_TLS_RECORD_HEADER_LENGTH];
+  size_t len;
+
+  if (p->explicit_iv) {
+    SLN_ASSERT(sln_bucket_headroom(b) >=
+               p->blocksize + SLN_TLS_RECORD_HEADER_LENGTH);
+    sln_parser_rand_bytes_secure(b->data - p->blocksize, p->blocksize);
+    sln_bucket_grow(b, p->blocksize, 0);
+  }
+
+  SLN_ASSERT(sln_bucket_tailroom(b) >= SLN_STITCHED_MAX_OVERHEAD);
+
+  /* the MAC is over the plaintext, the length here includes the IV block */
+  stitched_aad(p, header, b->size, aad);
 
-  p = &baton->active_send_parameters;
+  SELENE_ERR(sln_stitched_seal(p->stitched, aad, b->data, b->size, &len));
+  sln_bucket_grow(b, 0, len - b->size);
 
-  /* TODO: impl */
   return SELENE_SUCCESS;
 }
 
-selene_error_t *sln_tls_params_encrypt(selene_t *s, sln_bucket_t *b,
-                                       sln_bucket_t **out) {
+static selene_error_t *stitched_open(sln_params_t *p, const char *header,
+                                     sln_bucket_t *b) {
+  char aad[8 + SLN_TLS_RECORD_HEADER_LENGTH];
+
+  stitched_aad(p, header, b->size, aad);
+
+  SELENE_ERR(sln_stitched_open(p->stitched, aad, b->data, b->size));
+
+  if (p->explicit_iv) {
+    b->data += p->blocksize;
+    b->size -= p->blocksize;
+  }
+
+  b->size -= (unsigned char)b->data[b->size - 1] + 1 + p->maclen;
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_tls_params_update_mac(selene_t *s, const char *header,
+                                          sln_bucket_t *b) {
   sln_parser_baton_t *baton = s->backend_baton;
+  sln_params_t *p = &baton->active_send_parameters;
+
+  if (p->hmac == NULL || use_stitched(p, header)) {
+    return SELENE_SUCCESS;
+  }
+
+  SLN_ASSERT(sln_bucket_tailroom(b) >= p->maclen);
+
+  record_mac(p->hmac, p->seq_num++, header, b->data, b->size,
+             b->data + b->size);
+  sln_bucket_grow(b, 0, p->maclen);
+
+  return SELENE_SUCCESS;
+}
+
+/* The additional data is seq_num + type + version + plaintext length, and the
+ * nonce is the implicit salt followed by the explicit part (RFC 5288).  The
+ * explicit part is seq_num itself, which never repeats under one key. */
+static void aead_nonce(sln_params_t *p, uint64_t seq_num, const char *header,
+                       size_t len, char *aad, char *nonce) {
+  size_t fixed = SLN_AEAD_NONCE_LENGTH - p->record_ivlen;
+
+  seq_bytes(seq_num, (unsigned char *)aad);
+  memcpy(aad + 8, header, SLN_TLS_RECORD_HEADER_LENGTH);
+  aad[8 + 3] = len >> 8;
+  aad[8 + 4] = len;
+
+  memcpy(nonce, p->iv, fixed);
+  memcpy(nonce + fixed, aad, p->record_ivlen);
+}
+
+static selene_error_t *aead_seal(sln_params_t *p, const char *header,
+                                 sln_bucket_t *b) {
+  char aad[8 + SLN_TLS_RECORD_HEADER_LENGTH];
+  char nonce[SLN_AEAD_NONCE_LENGTH];
+
+  SLN_ASSERT(sln_bucket_tailroom(b) >= SLN_AEAD_TAG_LENGTH);
+  SLN_ASSERT(sln_bucket_headroom(b) >=
+             p->record_ivlen + SLN_TLS_RECORD_HEADER_LENGTH);
+
+  aead_nonce(p, p->seq_num++, header, b->size, aad, nonce);
+
+  SELENE_ERR(sln_aead_seal(p->aead, nonce, aad, sizeof(aad), b->data, b->size,
+                           b->data + b->size));
+  sln_bucket_grow(b, 0, SLN_AEAD_TAG_LENGTH);
+
+  memcpy(b->data - p->record_ivlen, nonce + SLN_AEAD_NONCE_LENGTH -
+                                        p->record_ivlen, p->record_ivlen);
+  sln_bucket_grow(b, p->record_ivlen, 0);
+
+  return SELENE_SUCCESS;
+}
+
+/* Only reads p, so records of a connection can be opened in parallel, each
+ * with its own aead context and sequence number */
+static selene_error_t *aead_open(sln_params_t *p, sln_aead_t *aead,
+                                 uint64_t seq_num, const char *header,
+                                 sln_bucket_t *b) {
+  char aad[8 + SLN_TLS_RECORD_HEADER_LENGTH];
+  char nonce[SLN_AEAD_NONCE_LENGTH];
+  selene_error_t *err;
+
+  if (b->size < p->record_ivlen + SLN_AEAD_TAG_LENGTH) {
+    return selene_error_createf(SELENE_EINVAL, "Record too short: %lu",
+                                (unsigned long)b->size);
+  }
+
+  b->size -= p->record_ivlen + SLN_AEAD_TAG_LENGTH;
+
+  aead_nonce(p, seq_num, header, b->size, aad, nonce);
+  memcpy(nonce + SLN_AEAD_NONCE_LENGTH - p->record_ivlen, b->data,
+         p->record_ivlen);
+  b->data += p->record_ivlen;
+
+  err = sln_aead_open(aead, nonce, aad, sizeof(aad), b->data, b->size,
+                      b->data + b->size);
+  if (err) {
+    selene_error_clear(err);
+    return selene_error_create(SELENE_EINVAL, "Bad record MAC");
+  }
+
+  return SELENE_SUCCESS;
+}
+
+/* The length of a CBC or stream cipher record, before it is decrypted */
+static selene_error_t *record_check_length(sln_params_t *p,
+                                           sln_bucket_t *b) {
+  size_t minlen = p->maclen;
+
+  if (p->blocksize != 0) {
+    minlen += 1;
+    if (p->explicit_iv) {
+      minlen += p->blocksize;
+    }
+    if (b->size % p->blocksize != 0) {
+      return selene_error_createf(SELENE_EINVAL,
+                                  "Record length %lu is not a multiple of "
+                                  "the block size",
+                                  (unsigned long)b->size);
+    }
+  }
+
+  if (b->size < minlen) {
+    return selene_error_createf(SELENE_EINVAL, "Record too short: %lu",
+                                (unsigned long)b->size);
+  }
+
+  return SELENE_SUCCESS;
+}
+
+/* Checks the padding and the MAC of a decrypted record, and strips them and
+ * any explicit IV off.  Only reads p, like aead_open.
+ *
+ * For CBC suites the padding length is secret, so nothing may depend on it
+ * (Lucky 13): the last 256 bytes are always scanned for the padding, the MAC
+ * is hashed over the longest message the record could hold with the real end
+ * picked by sln_hmac_builtin_final_ct, and the received MAC is read out with
+ * masks.  hmac has to be a built-in one then. */
+static selene_error_t *record_verify(sln_params_t *p, sln_hmac_t *hmac,
+                                     uint64_t seq_num, const char *header,
+                                     sln_bucket_t *b) {
+  unsigned char mac[SLN_PARAMS_MAC_SECRET_MAX_LENGTH];
+  unsigned char theirs[SLN_PARAMS_MAC_SECRET_MAX_LENGTH];
+  char macheader[SLN_TLS_RECORD_HEADER_LENGTH];
+  unsigned char seq[8];
+  const unsigned char *data;
+  size_t maxlen;
+  size_t padlen;
+  size_t len;
+  size_t good;
+  size_t diff;
+  size_t scan;
+  size_t i;
+  size_t j;
+  int bad = 0;
+
+  if (p->blocksize == 0) {
+    b->size -= p->maclen;
+
+    memcpy(macheader, header, SLN_TLS_RECORD_HEADER_LENGTH);
+    macheader[3] = b->size >> 8;
+    macheader[4] = b->size;
+
+    record_mac(hmac, seq_num, macheader, b->data, b->size, (char *)mac);
+
+    for (i = 0; i < p->maclen; i++) {
+      bad |= mac[i] ^ (unsigned char)b->data[b->size + i];
+    }
+
+    if (bad) {
+      return selene_error_create(SELENE_EINVAL, "Bad record MAC");
+    }
+
+    return SELENE_SUCCESS;
+  }
+
+  if (p->explicit_iv) {
+    b->data += p->blocksize;
+    b->size -= p->blocksize;
+  }
+
+  data = (const unsigned char *)b->data;
+  maxlen = b->size - p->maclen - 1;
+  padlen = data[b->size - 1];
+  good = SLN_CT_GE(maxlen, padlen);
+
+  /* every padding byte holds padlen, look at all that could be padding */
+  scan = b->size < 256 ? b->size : 256;
+  for (i = 1; i < scan; i++) {
+    good &= ~(SLN_CT_GE(padlen, i) & (padlen ^ data[b->size - 1 - i]));
+  }
+  good = SLN_CT_EQ(good & 0xff, 0xff);
+
+  /* a bad pad still has its MAC checked, over the longest message */
+  len = maxlen - (padlen & good);
+
+  memcpy(macheader, header, SLN_TLS_RECORD_HEADER_LENGTH);
+  macheader[3] = len >> 8;
+  macheader[4] = len;
+
+  seq_bytes(seq_num, seq);
+  sln_hmac_builtin_reset(hmac);
+  sln_hmac_builtin_update(hmac, seq, sizeof(seq));
+  sln_hmac_builtin_update(hmac, macheader, SLN_TLS_RECORD_HEADER_LENGTH);
+  sln_hmac_builtin_final_ct(hmac, data, len, maxlen, mac);
+
+  /* the received MAC starts at len, somewhere in the last 256 + maclen */
+  memset(theirs, 0, sizeof(theirs));
+  for (i = maxlen > 255 ? maxlen - 255 : 0; i < maxlen + p->maclen; i++) {
+    for (j = 0; j < p->maclen; j++) {
+      theirs[j] |= data[i] & SLN_CT_EQ(j, i - len);
+    }
+  }
+
+  diff = 0;
+  for (i = 0; i < p->maclen; i++) {
+    diff |= mac[i] ^ theirs[i];
+  }
+  good &= SLN_CT_EQ(diff, 0);
+
+  b->size = len;
+
+  if (!good) {
+    return selene_error_create(SELENE_EINVAL, "Bad record MAC");
+  }
+
+  return SELENE_SUCCESS;
+}
+
+/* A CBC record on the contexts of a lane.  TLS 1.0 records chain on from iv,
+ * the last ciphertext block of the record before.  An explicit IV makes the
+ * chain state not matter: the first block decrypts to garbage and is
+ * dropped.  Two passes even where there is a stitched context, which cannot
+ * be shared between lanes; record_verify is constant time like it. */
+static selene_error_t *cbc_open(sln_params_t *p, sln_params_lane_t *lane,
+                                uint64_t seq_num, const char *iv,
+                                const char *header, sln_bucket_t *b) {
+  size_t len;
+
+  SELENE_ERR(record_check_length(p, b));
+
+  if (!p->explicit_iv) {
+    sln_cryptor_set_iv(lane->cryptor, iv);
+  }
+
+  len = b->size;
+  sln_cryptor_encrypt(lane->cryptor, b->data, b->size, b->data, &len);
+  SLN_ASSERT(len == b->size);
+
+  return record_verify(p, lane->hmac, seq_num, header, b);
+}
+
+typedef struct parallel_record_t {
+  char header[SLN_TLS_RECORD_HEADER_LENGTH];
+  /* CBC without an explicit IV only */
+  char iv[SLN_PARAMS_IV_MAX_LENGTH];
+  sln_bucket_t *b;
+  selene_error_t *err;
+} parallel_record_t;
+
+typedef struct parallel_baton_t {
   sln_params_t *p;
+  /* of the first record */
+  uint64_t seq_num;
+  parallel_record_t *records;
+} parallel_baton_t;
 
-  *out = NULL;
+static void parallel_open(void *baton, size_t job, int lane) {
+  parallel_baton_t *pb = (parallel_baton_t *)baton;
+  parallel_record_t *r = &pb->records[job];
+  sln_params_lane_t *l = &pb->p->lanes[lane];
 
-  init_params(s);
+  if (pb->p->aead != NULL) {
+    r->err = aead_open(pb->p, l->aead, pb->seq_num + job, r->header, r->b);
+  } else {
+    r->err = cbc_open(pb->p, l, pb->seq_num + job, r->iv, r->header, r->b);
+  }
+}
 
-  p = &baton->active_send_parameters;
+static selene_error_t *params_lanes(selene_t *s, sln_params_t *p, int nlanes) {
+  sln_params_lane_t *lane;
+  int i;
 
-  switch (p->suite) {
-    /* TODO: impl */
-    case SELENE_CS__UNUSED0:
-    case SELENE_CS__MAX:
-    case SELENE_CS_RSA_WITH_RC4_128_SHA:
-    case SELENE_CS_RSA_WITH_AES_128_CBC_SHA:
-    case SELENE_CS_RSA_WITH_AES_256_CBC_SHA:
+  if (p->lanes != NULL) {
+    return SELENE_SUCCESS;
+  }
+
+  p->lanes = sln_calloc(s, sizeof(sln_params_lane_t) * nlanes);
+  p->nlanes = nlanes;
+  for (i = 0; i < nlanes; i++) {
+    lane = &p->lanes[i];
+    if (p->aead != NULL) {
+      SELENE_ERR(sln_aead_create(s, p->aead->type, p->key, &lane->aead));
+    } else {
+      SELENE_ERR(sln_hmac_builtin_create(s, SLN_HMAC_SHA1, p->mac_secret,
+                                         p->maclen, &lane->hmac));
+      SELENE_ERR(sln_cryptor_create(s, 0, p->cryptor->type, p->key, p->iv,
+                                    &lane->cryptor));
+    }
+  }
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *read_parallel(selene_t *s, rtls_baton_t *rtls,
+                                     size_t *count) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_params_t *p = &baton->active_recv_parameters;
+  sln_workers_t *workers = s->conf->workers;
+  parallel_record_t records[PARALLEL_MAX_RECORDS];
+  parallel_baton_t pb;
+  sln_bucket_t *b;
+  selene_error_t *err = SELENE_SUCCESS;
+  size_t avail = sln_brigade_size(s->bb.in_enc);
+  size_t offset = 0;
+  size_t hlen;
+  size_t len;
+  size_t n = 0;
+  size_t i;
+
+  *count = 0;
+
+  /* RC4 is one keystream over the whole connection, it does not split */
+  if (workers == NULL ||
+      (p->aead == NULL && (p->cryptor == NULL || p->blocksize == 0))) {
+    return SELENE_SUCCESS;
+  }
+
+  /* whole application data records, up to anything else */
+  while (n < PARALLEL_MAX_RECORDS) {
+    SELENE_ERR(sln_brigade_pread_bytes(s->bb.in_enc, offset,
+                                       SLN_TLS_RECORD_HEADER_LENGTH,
+                                       records[n].header, &hlen));
+    if (hlen < SLN_TLS_RECORD_HEADER_LENGTH ||
+        records[n].header[0] != TLS_CT_APPLICATION) {
+      break;
+    }
+    len = record_length(records[n].header);
+    if (avail < offset + SLN_TLS_RECORD_HEADER_LENGTH + len) {
       break;
+    }
+    offset += SLN_TLS_RECORD_HEADER_LENGTH + len;
+    n++;
+  }
+
+  if (n < 2) {
+    return SELENE_SUCCESS;
+  }
+
+  SELENE_ERR(params_lanes(s, p, sln_workers_lanes(workers)));
+
+  for (i = 0; i < n; i++) {
+    records[i].err = SELENE_SUCCESS;
+    SELENE_ERR(
+        sln_brigade_chomp(s->bb.in_enc, SLN_TLS_RECORD_HEADER_LENGTH));
+    err = take_record(s, rtls, record_length(records[i].header),
+                      &records[i].b);
+    if (err) {
+      while (i-- > 0) {
+        sln_bucket_destroy(records[i].b);
+      }
+      return err;
+    }
+  }
+
+  if (p->aead == NULL && !p->explicit_iv) {
+    /* Each record chains on from the last ciphertext block of the one before,
+     * kept before they are decrypted in place.  The sequential contexts go
+     * on from the end of the batch. */
+    for (i = 0; i < n; i++) {
+      memcpy(records[i].iv, p->iv, p->blocksize);
+      b = records[i].b;
+      if (b->size >= p->blocksize) {
+        memcpy(p->iv, b->data + b->size - p->blocksize, p->blocksize);
+      }
+    }
+    sln_cryptor_set_iv(p->cryptor, p->iv);
+    if (p->stitched != NULL) {
+      sln_stitched_set_iv(p->stitched, p->iv);
+    }
+  }
+
+  pb.p = p;
+  pb.seq_num = p->seq_num;
+  pb.records = records;
+  sln_workers_run(workers, parallel_open, &pb, n);
+  p->seq_num += n;
+
+  /* back in order, nothing after a bad record is let through */
+  for (i = 0; i < n; i++) {
+    if (err == SELENE_SUCCESS) {
+      err = records[i].err;
+    } else if (records[i].err) {
+      selene_error_clear(records[i].err);
+    }
+
+    if (err || records[i].b->size == 0) {
+      sln_bucket_destroy(records[i].b);
+    } else {
+      SLN_BRIGADE_INSERT_TAIL(baton->in_application, records[i].b);
+    }
+  }
+
+  baton->peer_version_major = records[n - 1].header[1];
+  baton->peer_version_minor = records[n - 1].header[2];
+
+  *count = n;
+
+  return err;
+}
+
+selene_error_t *sln_tls_params_encrypt(selene_t *s, const char *header,
+                                       sln_bucket_t *b) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_params_t *p = &baton->active_send_parameters;
+  size_t padlen;
+  size_t len;
+
+  if (p->aead != NULL) {
+    return aead_seal(p, header, b);
+  }
+
+  if (use_stitched(p, header)) {
+    return stitched_seal(p, header, b);
+  }
+
+  if (p->cryptor == NULL) {
+    return SELENE_SUCCESS;
+  }
+
+  if (p->blocksize != 0) {
+    /* padding_length bytes of padding_length, and padding_length itself */
+    padlen = p->blocksize - (b->size % p->blocksize);
+    SLN_ASSERT(sln_bucket_tailroom(b) >= padlen);
+    memset(b->data + b->size, padlen - 1, padlen);
+    sln_bucket_grow(b, 0, padlen);
+
+    if (p->explicit_iv) {
+      /* A random first block, the receiver uses its ciphertext as the IV of
+       * the rest of the record, whatever our CBC state was */
+      SLN_ASSERT(sln_bucket_headroom(b) >=
+                 p->blocksize + SLN_TLS_RECORD_HEADER_LENGTH);
+      sln_parser_rand_bytes_secure(b->data - p->blocksize, p->blocksize);
+      sln_bucket_grow(b, p->blocksize, 0);
+    }
+  }
+
+  len = b->size;
+  sln_cryptor_encrypt(p->cryptor, b->data, b->size, b->data, &len);
+  SLN_ASSERT(len == b->size);
+
+  return SELENE_SUCCESS;
+}
+
+selene_error_t *sln_tls_params_decrypt(selene_t *s, const char *header,
+                                       sln_bucket_t *b) {
+  sln_parser_baton_t *baton = s->backend_baton;
+  sln_params_t *p = &baton->active_recv_parameters;
+  size_t len;
+
+  if (p->aead != NULL) {
+    return aead_open(p, p->aead, p->seq_num++, header, b);
+  }
+
+  if (p->cryptor == NULL) {
+    return SELENE_SUCCESS;
+  }
+
+  SELENE_ERR(record_check_length(p, b));
+
+  if (p->blocksize != 0 && !p->explicit_iv) {
+    /* what the next record chains on from, read_parallel starts there */
+    memcpy(p->iv, b->data + b->size - p->blocksize, p->blocksize);
+  }
+
+  if (use_stitched(p, header)) {
+    return stitched_open(p, header, b);
+  }
+
+  len = b->size;
+  sln_cryptor_encrypt(p->cryptor, b->data, b->size, b->data, &len);
+  SLN_ASSERT(len == b->size);
+
+  return record_verify(p, p->blocksize != 0 ? p->cbc_hmac : p->hmac,
+                       p->seq_num++, header, b);
+}
+
+selene_error_t *sln_io_tls_write_appdata(selene_t *s,
+                                         sln_parser_baton_t *baton) {
+  sln_bucket_t *b = NULL;
+  size_t len;
+
+  while (!SLN_BRIGADE_EMPTY(s->bb.in_cleartext)) {
+    len = sln_brigade_size(s->bb.in_cleartext);
+    if (len > SLN_TLS_RECORD_MAX_PLAINTEXT) {
+      len = SLN_TLS_RECORD_MAX_PLAINTEXT;
+    }
+
+    /* file and mmap buckets are only read a record at a time, here */
+    SELENE_ERR(sln_brigade_read(s->bb.in_cleartext, len));
+
+    /* the one copy of the cleartext, it is encrypted where it lands */
+    SELENE_ERR(sln_tls_record_create(s, len, &b));
+    SELENE_ERR(sln_brigade_flatten(s->bb.in_cleartext, b->data, &len));
+    SLN_ASSERT(len == b->size);
+
+    SELENE_ERR(sln_tls_toss_bucket(s, SLN_CONTENT_TYPE_APPLICATION, b));
   }
 
-  /* TODO: padding, sln_cryptor_blocksize() */
   return SELENE_SUCCESS;
 }
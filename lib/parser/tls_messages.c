@@ -18,76 +18,79 @@
 #include "parser.h"
 #include "common.h"
 #include "sln_digest.h"
+#include <string.h>
 
-selene_error_t *sln_tls_serialize_header(selene_t *s, sln_msg_tls_t *tls,
-                                         sln_bucket_t **p_b) {
-  sln_bucket_t *b = NULL;
-
-  size_t len = 5;
-
-  sln_bucket_create_empty(s->alloc, &b, len);
-
+static selene_error_t *write_header(sln_msg_tls_t *tls, char *buf) {
   switch (tls->content_type) {
     case SLN_CONTENT_TYPE_CHANGE_CIPHER_SPEC:
-      b->data[0] = 0x14;
+      buf[0] = 0x14;
       break;
     case SLN_CONTENT_TYPE_ALERT:
-      b->data[0] = 0x15;
+      buf[0] = 0x15;
       break;
     case SLN_CONTENT_TYPE_HANDSHAKE:
-      b->data[0] = 0x16;
+      buf[0] = 0x16;
       break;
     case SLN_CONTENT_TYPE_APPLICATION:
-      b->data[0] = 0x17;
+      buf[0] = 0x17;
       break;
     default:
       return selene_error_createf(SELENE_EINVAL, "Unknown content type: %d",
                                   tls->content_type);
   }
 
-  b->data[1] = tls->version_major;
-  b->data[2] = tls->version_minor;
-  b->data[3] = tls->length >> 8;
-  b->data[4] = tls->length;
-
-  *p_b = b;
+  buf[1] = tls->version_major;
+  buf[2] = tls->version_minor;
+  buf[3] = tls->length >> 8;
+  buf[4] = tls->length;
 
   return SELENE_SUCCESS;
 }
 
+selene_error_t *sln_tls_record_create(selene_t *s, size_t len,
+                                      sln_bucket_t **p_b) {
+  return sln_bucket_create_with_room(s->alloc, p_b, SLN_TLS_RECORD_HEADROOM,
+                                     len, SLN_TLS_RECORD_TAILROOM);
+}
+
 selene_error_t *sln_tls_toss_bucket(selene_t *s,
                                     sln_content_type_e content_type,
                                     sln_bucket_t *bout) {
   sln_msg_tls_t tls;
   sln_parser_baton_t *baton = s->backend_baton;
-  sln_bucket_t *btls = NULL;
-  sln_bucket_t *benc = NULL;
+  sln_bucket_t *brec = NULL;
+  char header[SLN_TLS_RECORD_HEADER_LENGTH];
+
+  if (sln_bucket_headroom(bout) < SLN_TLS_RECORD_HEADROOM ||
+      sln_bucket_tailroom(bout) < SLN_TLS_RECORD_TAILROOM) {
+    /* Not made by sln_tls_record_create, move it somewhere it can grow */
+    SELENE_ERR(sln_tls_record_create(s, bout->size, &brec));
+    memcpy(brec->data, bout->data, bout->size);
+    sln_bucket_destroy(bout);
+    bout = brec;
+  }
 
   if (content_type == SLN_CONTENT_TYPE_HANDSHAKE) {
     sln_digest_update(baton->md5_handshake_digest, bout->data, bout->size);
     sln_digest_update(baton->sha1_handshake_digest, bout->data, bout->size);
   }
 
-  SELENE_ERR(sln_tls_params_update_mac(s, bout));
-
-  SELENE_ERR(sln_tls_params_encrypt(s, bout, &benc));
-
   tls.content_type = content_type;
   sln_parser_tls_set_current_version(s, &tls.version_major, &tls.version_minor);
-  if (benc != NULL) {
-    tls.length = benc->size;
-  } else {
-    tls.length = bout->size;
-  }
+  tls.length = bout->size;
 
-  SELENE_ERR(sln_tls_serialize_header(s, &tls, &btls));
+  SELENE_ERR(write_header(&tls, &header[0]));
 
-  SLN_BRIGADE_INSERT_TAIL(s->bb.out_enc, btls);
-  if (benc != NULL) {
-    SLN_BRIGADE_INSERT_TAIL(s->bb.out_enc, benc);
-  } else {
-    SLN_BRIGADE_INSERT_TAIL(s->bb.out_enc, bout);
-  }
+  SELENE_ERR(sln_tls_params_update_mac(s, header, bout));
+
+  SELENE_ERR(sln_tls_params_encrypt(s, header, bout));
+
+  /* Frame the record where it is, it goes out as this one bucket */
+  tls.length = bout->size;
+  SELENE_ERR(write_header(&tls, bout->data - SLN_TLS_RECORD_HEADER_LENGTH));
+  sln_bucket_grow(bout, SLN_TLS_RECORD_HEADER_LENGTH, 0);
+
+  SLN_BRIGADE_INSERT_TAIL(s->bb.out_enc, bout);
 
   return SELENE_SUCCESS;
 }
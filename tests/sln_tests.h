@@ -91,9 +91,15 @@ SLN_TEST_MODULE(arrays)
 SLN_TEST_MODULE(logging)
 SLN_TEST_MODULE(crypto_digest)
 SLN_TEST_MODULE(crypto_prf)
+SLN_TEST_MODULE(crypto_aead)
 SLN_TEST_MODULE(init)
 SLN_TEST_MODULE(brigade)
 SLN_TEST_MODULE(buckets)
+SLN_TEST_MODULE(pool)
+SLN_TEST_MODULE(sessions)
+SLN_TEST_MODULE(tickets)
+SLN_TEST_MODULE(workers)
+SLN_TEST_MODULE(io)
 SLN_TEST_MODULE(events)
 SLN_TEST_MODULE(certs)
 SLN_TEST_MODULE(tok)
@@ -130,8 +130,37 @@ static void alert_to_self(void **state) {
   selene_conf_destroy(conf);
 }
 
+static void alert_send(void **state) {
+  sln_bucket_t *e;
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  SLN_ERR(sln_io_alert_fatal(s, SLN_ALERT_DESC_UNEXPECTED_MESSAGE));
+
+  /* header and payload go out as a single bucket */
+  assert_int_equal(1, s->bb.out_enc->count);
+  e = SLN_BRIGADE_FIRST(s->bb.out_enc);
+  assert_int_equal(7, e->size);
+  assert_int_equal(0x15, e->data[0]);
+  assert_int_equal(3, e->data[1]);
+  assert_int_equal(1, e->data[2]);
+  assert_int_equal(0, e->data[3]);
+  assert_int_equal(2, e->data[4]);
+  assert_int_equal(SLN_ALERT_LEVEL_FATAL, e->data[5]);
+  assert_int_equal(SLN_ALERT_DESC_UNEXPECTED_MESSAGE, e->data[6]);
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
 SLN_TESTS_START(alert_io)
 SLN_TESTS_ENTRY(alert_msg)
 SLN_TESTS_ENTRY(alert_invalid_msg)
 SLN_TESTS_ENTRY(alert_to_self)
+SLN_TESTS_ENTRY(alert_send)
 SLN_TESTS_END()
@@ -45,9 +45,15 @@ int main(int argc, char* argv[]) {
   RUNT(logging);
   RUNT(crypto_digest);
   RUNT(crypto_prf);
+  RUNT(crypto_aead);
   RUNT(init);
   RUNT(brigade);
   RUNT(buckets);
+  RUNT(pool);
+  RUNT(sessions);
+  RUNT(tickets);
+  RUNT(workers);
+  RUNT(io);
   RUNT(events);
   RUNT(certs);
   RUNT(tok);
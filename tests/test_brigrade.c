@@ -243,6 +243,229 @@ static void brigade_chomp(void **state) {
   sln_brigade_destroy(bb);
 }
 
+static void brigade_cached_size(void **state) {
+  sln_brigade_t *a;
+  sln_brigade_t *b;
+  sln_bucket_t *e;
+  char buf[10];
+  size_t len = sizeof(buf);
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &a));
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &b));
+
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, "AAAA", 4));
+  SLN_BRIGADE_INSERT_TAIL(a, e);
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, "BB", 2));
+  SLN_BRIGADE_INSERT_HEAD(a, e);
+  assert_int_equal(sln_brigade_size(a), 6);
+  assert_int_equal(sln_brigade_bucket_count(a), 2);
+
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, "CCC", 3));
+  SLN_BRIGADE_INSERT_TAIL(b, e);
+  SLN_BRIGADE_CONCAT(a, b);
+  assert_int_equal(sln_brigade_size(a), 9);
+  assert_int_equal(sln_brigade_bucket_count(a), 3);
+  assert_int_equal(sln_brigade_size(b), 0);
+  assert_int_equal(sln_brigade_bucket_count(b), 0);
+
+  /* buckets moved by the concat now account against a */
+  sln_bucket_destroy(e);
+  assert_int_equal(sln_brigade_size(a), 6);
+  assert_int_equal(sln_brigade_size(b), 0);
+
+  SLN_ERR(sln_brigade_chomp(a, 3));
+  assert_int_equal(sln_brigade_size(a), 3);
+  assert_int_equal(sln_brigade_bucket_count(a), 1);
+
+  SLN_ERR(sln_brigade_flatten(a, &buf[0], &len));
+  assert_int_equal(len, 3);
+  assert_memory_equal(buf, "AAA", 3);
+  assert_int_equal(sln_brigade_size(a), 0);
+  assert_int_equal(sln_brigade_bucket_count(a), 0);
+
+  sln_brigade_destroy(a);
+  sln_brigade_destroy(b);
+}
+
+static void brigade_cursor(void **state) {
+  int i;
+  sln_brigade_t *bb;
+  sln_bucket_t *e;
+  sln_brigade_cursor_t cur;
+  char c;
+  char buf[4];
+  size_t len;
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  sln_brigade_cursor_init(bb, &cur);
+
+  /* reading an empty brigade leaves the cursor unpositioned */
+  SLN_ERR(sln_brigade_cursor_pread_bytes(&cur, 0, 1, &c, &len));
+  assert_int_equal(len, 0);
+
+  for (i = 0; i < 26; i++) {
+    c = 'a' + i;
+    SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, &c, 1));
+    SLN_BRIGADE_INSERT_TAIL(bb, e);
+  }
+
+  for (i = 0; i < 26; i++) {
+    SLN_ERR(sln_brigade_cursor_pread_bytes(&cur, i, 1, &c, &len));
+    assert_int_equal(len, 1);
+    assert_int_equal(c, 'a' + i);
+    /* sequential reads leave the cursor on the bucket they read */
+    assert_int_equal(cur.bucket_offset, i);
+  }
+
+  /* reads past the end wait on the last bucket, and see appended data */
+  SLN_ERR(sln_brigade_cursor_pread_bytes(&cur, 26, 2, &buf[0], &len));
+  assert_int_equal(len, 0);
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, "XY", 2));
+  SLN_BRIGADE_INSERT_TAIL(bb, e);
+  SLN_ERR(sln_brigade_cursor_pread_bytes(&cur, 25, 3, &buf[0], &len));
+  assert_int_equal(len, 3);
+  assert_memory_equal(buf, "zXY", 3);
+
+  /* seeking backwards works */
+  SLN_ERR(sln_brigade_cursor_pread_bytes(&cur, 1, 3, &buf[0], &len));
+  assert_int_equal(len, 3);
+  assert_memory_equal(buf, "bcd", 3);
+
+  /* removing buckets invalidates the cursor's position */
+  SLN_ERR(sln_brigade_cursor_pread_bytes(&cur, 10, 1, &c, &len));
+  SLN_ERR(sln_brigade_chomp(bb, 5));
+  SLN_ERR(sln_brigade_cursor_pread_bytes(&cur, 10, 2, &buf[0], &len));
+  assert_int_equal(len, 2);
+  assert_memory_equal(buf, "pq", 2);
+
+  sln_brigade_destroy(bb);
+}
+
+static void brigade_split(void **state) {
+  sln_brigade_t *bb;
+  sln_bucket_t *e;
+  char buf[10];
+  size_t len;
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, "AAAABBBB", 8));
+  SLN_BRIGADE_INSERT_TAIL(bb, e);
+
+  /* boundaries that already exist are left alone */
+  SLN_ERR(sln_brigade_split(bb, 0));
+  SLN_ERR(sln_brigade_split(bb, 8));
+  SLN_ERR(sln_brigade_split(bb, 100));
+  assert_int_equal(sln_brigade_bucket_count(bb), 1);
+
+  SLN_ERR(sln_brigade_split(bb, 4));
+  assert_int_equal(sln_brigade_bucket_count(bb), 2);
+  assert_int_equal(sln_brigade_size(bb), 8);
+  assert_true(SLN_BRIGADE_FIRST(bb) == e);
+  assert_int_equal(e->size, 4);
+
+  SLN_ERR(sln_brigade_split(bb, 4));
+  assert_int_equal(sln_brigade_bucket_count(bb), 2);
+
+  SLN_ERR(sln_brigade_pread_bytes(bb, 2, 4, &buf[0], &len));
+  assert_int_equal(len, 4);
+  assert_memory_equal(buf, "AABB", 4);
+
+  sln_brigade_destroy(bb);
+}
+
+static void brigade_splice_into(void **state) {
+  sln_brigade_t *source;
+  sln_brigade_t *dest;
+  sln_bucket_t *e1;
+  sln_bucket_t *e2;
+  char buf[10];
+  size_t len;
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &source));
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &dest));
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e1, "AAAA", 4));
+  SLN_BRIGADE_INSERT_TAIL(source, e1);
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e2, "BBBB", 4));
+  SLN_BRIGADE_INSERT_TAIL(source, e2);
+
+  /* whole buckets move as they are */
+  SLN_ERR(sln_brigade_splice_into(source, 4, dest));
+  assert_true(SLN_BRIGADE_FIRST(dest) == e1);
+  assert_int_equal(e1->backing->refcount, 1);
+  assert_int_equal(sln_brigade_size(dest), 4);
+  assert_int_equal(sln_brigade_size(source), 4);
+
+  /* partial buckets are split once */
+  SLN_ERR(sln_brigade_splice_into(source, 1, dest));
+  assert_true(SLN_BRIGADE_LAST(dest) == e2);
+  assert_int_equal(sln_brigade_bucket_count(dest), 2);
+  assert_int_equal(sln_brigade_size(dest), 5);
+  assert_int_equal(sln_brigade_size(source), 3);
+
+  len = sizeof(buf);
+  SLN_ERR(sln_brigade_flatten(dest, &buf[0], &len));
+  assert_int_equal(len, 5);
+  assert_memory_equal(buf, "AAAAB", 5);
+
+  /* asking for more than is there moves everything */
+  SLN_ERR(sln_brigade_splice_into(source, 10, dest));
+  assert_true(SLN_BRIGADE_EMPTY(source));
+  assert_int_equal(sln_brigade_size(dest), 3);
+
+  sln_brigade_destroy(source);
+  sln_brigade_destroy(dest);
+}
+
+static void brigade_deque(void **state) {
+  int i;
+  char c;
+  char buf[16];
+  size_t len;
+  sln_brigade_t *bb;
+  sln_bucket_t *e[10];
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+
+  for (i = 0; i < 10; i++) {
+    c = '0' + i;
+    SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e[i], &c, 1));
+  }
+
+  /* wrap around the inline slots, then outgrow them while wrapped */
+  SLN_BRIGADE_INSERT_TAIL(bb, e[2]);
+  SLN_BRIGADE_INSERT_TAIL(bb, e[3]);
+  SLN_BRIGADE_INSERT_HEAD(bb, e[1]);
+  SLN_BRIGADE_INSERT_HEAD(bb, e[0]);
+  assert_int_equal(SLN_BRIGADE_INLINE_SLOTS, bb->capacity);
+  for (i = 4; i < 10; i++) {
+    SLN_BRIGADE_INSERT_TAIL(bb, e[i]);
+  }
+  assert_true(bb->capacity >= 10);
+  assert_int_equal(10, sln_brigade_bucket_count(bb));
+  SLN_ERR(sln_brigade_pread_bytes(bb, 0, 10, buf, &len));
+  assert_int_equal(10, len);
+  assert_memory_equal("0123456789", buf, 10);
+
+  /* from the middle, and back in somewhere else */
+  SLN_BUCKET_REMOVE(e[5]);
+  assert_int_equal(9, sln_brigade_size(bb));
+  assert_true(e[5]->brigade == NULL);
+  sln_brigade_insert(bb, 2, e[5]);
+  assert_int_equal(2, sln_brigade_index(bb, e[5]));
+  assert_int_equal(9, sln_brigade_index(bb, e[9]));
+  SLN_ERR(sln_brigade_pread_bytes(bb, 0, 10, buf, &len));
+  assert_memory_equal("0152346789", buf, 10);
+
+  SLN_BUCKET_REMOVE(e[9]);
+  SLN_BUCKET_REMOVE(e[0]);
+  assert_true(SLN_BRIGADE_FIRST(bb) == e[1]);
+  assert_true(SLN_BRIGADE_LAST(bb) == e[8]);
+  sln_bucket_destroy(e[9]);
+  sln_bucket_destroy(e[0]);
+
+  sln_brigade_destroy(bb);
+}
+
 SLN_TESTS_START(brigade)
 SLN_TESTS_ENTRY(brigade_operations)
 SLN_TESTS_ENTRY(brigade_flatten)
@@ -251,4 +474,9 @@ SLN_TESTS_ENTRY(brigade_pread_simple)
 SLN_TESTS_ENTRY(brigade_pread_more_buckets)
 SLN_TESTS_ENTRY(brigade_copy_into)
 SLN_TESTS_ENTRY(brigade_chomp)
+SLN_TESTS_ENTRY(brigade_cached_size)
+SLN_TESTS_ENTRY(brigade_cursor)
+SLN_TESTS_ENTRY(brigade_split)
+SLN_TESTS_ENTRY(brigade_splice_into)
+SLN_TESTS_ENTRY(brigade_deque)
 SLN_TESTS_END()
@@ -18,7 +18,11 @@
 #include "selene.h"
 #include "sln_tests.h"
 #include "sln_buckets.h"
+#include "sln_brigades.h"
 #include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 
 static void bucket_empty(void **state) {
   sln_bucket_t *e;
@@ -43,6 +47,38 @@ static void bucket_copy_bytes(void **state) {
   sln_bucket_destroy(e);
 }
 
+static void bucket_with_room(void **state) {
+  const char *data = "foobar";
+  sln_bucket_t *e;
+  sln_bucket_t *b;
+  SLN_ERR(sln_bucket_create_with_room(sln_test_alloc, &e, 5, 6, 20));
+  assert_int_equal(6, e->size);
+  assert_int_equal(5, sln_bucket_headroom(e));
+  assert_int_equal(20, sln_bucket_tailroom(e));
+  memcpy(e->data, data, 6);
+
+  memcpy(e->data - 2, "<<", 2);
+  memcpy(e->data + e->size, ">>", 2);
+  sln_bucket_grow(e, 2, 2);
+  assert_int_equal(10, e->size);
+  assert_memory_equal("<<foobar>>", e->data, 10);
+  assert_int_equal(3, sln_bucket_headroom(e));
+  assert_int_equal(18, sln_bucket_tailroom(e));
+
+  /* nothing to grow into once the memory is shared */
+  SLN_ERR(sln_bucket_create_from_bucket(sln_test_alloc, &b, e, 2, 6));
+  assert_int_equal(0, sln_bucket_headroom(e));
+  assert_int_equal(0, sln_bucket_tailroom(b));
+  sln_bucket_destroy(b);
+  assert_int_equal(3, sln_bucket_headroom(e));
+  sln_bucket_destroy(e);
+
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, data, 6));
+  assert_int_equal(0, sln_bucket_headroom(e));
+  assert_int_equal(0, sln_bucket_tailroom(e));
+  sln_bucket_destroy(e);
+}
+
 static void bucket_from_bucket(void **state) {
   const char *data = "foobar";
   sln_bucket_t *e;
@@ -71,10 +107,201 @@ static void bucket_from_bucket_deeper(void **state) {
   sln_bucket_destroy(b);
 }
 
+static void bucket_from_bucket_shared_backing(void **state) {
+  int i;
+  const char *data = "foobar";
+  sln_bucket_t *e;
+  sln_bucket_t *b;
+  sln_bucket_t *slices[1000];
+
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, data, strlen(data)));
+  assert_int_equal(1, e->backing->refcount);
+
+  /* slices of slices all point at the same backing */
+  b = e;
+  for (i = 0; i < 1000; i++) {
+    SLN_ERR(sln_bucket_create_from_bucket(sln_test_alloc, &slices[i], b, 0,
+                                          b->size > 1 ? b->size - 1 : 1));
+    assert_true(slices[i]->backing == e->backing);
+    b = slices[i];
+  }
+  assert_int_equal(1001, e->backing->refcount);
+  assert_memory_equal(data, b->data, 1);
+
+  /* the original can go first, the memory stays until the last slice */
+  sln_bucket_destroy(e);
+  assert_int_equal(1000, b->backing->refcount);
+  assert_memory_equal(data, b->data, 1);
+
+  for (i = 0; i < 1000; i++) {
+    sln_bucket_destroy(slices[i]);
+  }
+}
+
+static void count_release(void *baton) { (*(int *)baton)++; }
+
+static void bucket_borrowed_iovec(void **state) {
+  int released = 0;
+  char a[] = "foo";
+  char b[] = "barbaz";
+  struct iovec vec[3];
+  sln_brigade_t *bb;
+  sln_bucket_t *e;
+  sln_bucket_t *slice;
+
+  vec[0].iov_base = a;
+  vec[0].iov_len = 3;
+  vec[1].iov_base = NULL;
+  vec[1].iov_len = 0;
+  vec[2].iov_base = b;
+  vec[2].iov_len = 6;
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  SLN_ERR(sln_bucket_create_borrowed_iovec(sln_test_alloc, bb, vec, 3,
+                                           count_release, &released));
+
+  /* no bucket for the empty buffer, and nothing copied */
+  assert_int_equal(2, sln_brigade_bucket_count(bb));
+  assert_int_equal(9, sln_brigade_size(bb));
+  e = SLN_BRIGADE_LAST(bb);
+  assert_true(e->data == b);
+  assert_true(SLN_BRIGADE_FIRST(bb)->backing == e->backing);
+
+  SLN_ERR(sln_bucket_create_from_bucket(sln_test_alloc, &slice, e, 3, 3));
+
+  sln_brigade_destroy(bb);
+  assert_int_equal(0, released);
+
+  sln_bucket_destroy(slice);
+  assert_int_equal(1, released);
+
+  /* nothing to reference, so released right away */
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  SLN_ERR(sln_bucket_create_borrowed_iovec(sln_test_alloc, bb, vec + 1, 1,
+                                           count_release, &released));
+  assert_true(SLN_BRIGADE_EMPTY(bb));
+  assert_int_equal(2, released);
+  sln_brigade_destroy(bb);
+}
+
+#define FILE_SIZE 40000
+
+static int file_create(void **state, char *content) {
+  int i;
+  int fd;
+  char path[] = "/tmp/sln_test_bucket_XXXXXX";
+
+  for (i = 0; i < FILE_SIZE; i++) {
+    content[i] = i % 251;
+  }
+
+  fd = mkstemp(path);
+  assert_true(fd >= 0);
+  unlink(path);
+  assert_int_equal(FILE_SIZE, write(fd, content, FILE_SIZE));
+
+  return fd;
+}
+
+static void bucket_file_type(void **state, sln_bucket_type_e type) {
+  int i;
+  int fd;
+  int released = 0;
+  size_t len;
+  char *content = malloc(FILE_SIZE);
+  char *out = malloc(FILE_SIZE);
+  sln_brigade_t *bb;
+  sln_bucket_t *e;
+
+  fd = file_create(state, content);
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  /* skip the first 100 bytes, so mappings don't start on a page */
+  SLN_ERR(sln_bucket_create_file(sln_test_alloc, &e, type, fd, 100,
+                                 FILE_SIZE - 100, count_release, &released));
+  SLN_BRIGADE_INSERT_TAIL(bb, e);
+  assert_true(e->data == NULL);
+
+  /* only one record's worth is brought in */
+  SLN_ERR(sln_brigade_read(bb, 10));
+  assert_int_equal(2, sln_brigade_bucket_count(bb));
+  assert_int_equal(FILE_SIZE - 100, sln_brigade_size(bb));
+  e = SLN_BRIGADE_FIRST(bb);
+  assert_int_equal(SLN_BUCKET_MEMORY, SLN_BUCKET_TYPE(e));
+  assert_int_equal(SLN_BUCKET_READ_SIZE, e->size);
+  assert_memory_equal(content + 100, e->data, SLN_BUCKET_READ_SIZE);
+  e = SLN_BRIGADE_LAST(bb);
+  assert_int_equal(type, SLN_BUCKET_TYPE(e));
+  assert_int_equal(100 + SLN_BUCKET_READ_SIZE, e->offset);
+
+  /* and dropped again once consumed */
+  SLN_ERR(sln_brigade_chomp(bb, SLN_BUCKET_READ_SIZE));
+  assert_int_equal(1, sln_brigade_bucket_count(bb));
+
+  /* splitting doesn't read anything either */
+  SLN_ERR(sln_brigade_split(bb, 1000));
+  assert_int_equal(2, sln_brigade_bucket_count(bb));
+  assert_int_equal(type, SLN_BUCKET_TYPE(SLN_BRIGADE_LAST(bb)));
+
+  assert_int_equal(0, released);
+  SLN_ERR(sln_brigade_read(bb, sln_brigade_size(bb)));
+  for (i = 0; i < sln_brigade_bucket_count(bb); i++) {
+    e = SLN_BRIGADE_BUCKET(bb, i);
+    assert_int_equal(SLN_BUCKET_MEMORY, SLN_BUCKET_TYPE(e));
+  }
+  SLN_ERR(sln_brigade_pread_bytes(bb, 0, FILE_SIZE, out, &len));
+  assert_int_equal(FILE_SIZE - 100 - SLN_BUCKET_READ_SIZE, len);
+  assert_memory_equal(content + 100 + SLN_BUCKET_READ_SIZE, out, len);
+
+  /* everything is in memory now, so fd isn't needed anymore */
+  assert_int_equal(1, released);
+  sln_brigade_destroy(bb);
+  assert_int_equal(1, released);
+
+  close(fd);
+  free(content);
+  free(out);
+}
+
+static void bucket_file(void **state) {
+  bucket_file_type(state, SLN_BUCKET_FILE);
+}
+
+static void bucket_mmap(void **state) {
+  bucket_file_type(state, SLN_BUCKET_MMAP);
+}
+
+static void bucket_file_short(void **state) {
+  int fd;
+  char *content = malloc(FILE_SIZE);
+  sln_brigade_t *bb;
+  sln_bucket_t *e;
+
+  fd = file_create(state, content);
+
+  /* claims more than the file has */
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  SLN_ERR(sln_bucket_create_file(sln_test_alloc, &e, SLN_BUCKET_FILE, fd,
+                                 FILE_SIZE - 10, 20, NULL, NULL));
+  SLN_BRIGADE_INSERT_TAIL(bb, e);
+  SLN_FAIL(sln_brigade_read(bb, 20));
+  assert_int_equal(1, sln_brigade_bucket_count(bb));
+
+  sln_brigade_destroy(bb);
+  close(fd);
+  free(content);
+}
+
 SLN_TESTS_START(buckets)
 SLN_TESTS_ENTRY(bucket_empty)
 SLN_TESTS_ENTRY(bucket_with_bytes)
 SLN_TESTS_ENTRY(bucket_copy_bytes)
+SLN_TESTS_ENTRY(bucket_with_room)
 SLN_TESTS_ENTRY(bucket_from_bucket)
 SLN_TESTS_ENTRY(bucket_from_bucket_deeper)
+SLN_TESTS_ENTRY(bucket_from_bucket_shared_backing)
+SLN_TESTS_ENTRY(bucket_borrowed_iovec)
+SLN_TESTS_ENTRY(bucket_file)
+SLN_TESTS_ENTRY(bucket_mmap)
+SLN_TESTS_ENTRY(bucket_file_short)
 SLN_TESTS_END()
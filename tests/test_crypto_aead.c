@@ -0,0 +1,147 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "sln_tests.h"
+#include "sln_types.h"
+#include "sln_aead.h"
+#include <string.h>
+#include <stdio.h>
+
+static void unhex(const char *hex, char *out, size_t *len) {
+  size_t i;
+  unsigned int v;
+
+  *len = strlen(hex) / 2;
+  for (i = 0; i < *len; i++) {
+    sscanf(hex + (i * 2), "%2x", &v);
+    out[i] = (char)v;
+  }
+}
+
+typedef struct aead_vector_t {
+  sln_aead_e type;
+  const char *key;
+  const char *nonce;
+  const char *aad;
+  const char *plaintext;
+  const char *ciphertext;
+  const char *tag;
+} aead_vector_t;
+
+/* Test Case 4 of "The Galois/Counter Mode of Operation", and RFC 7539,
+ * Section 2.8.2 */
+static const aead_vector_t vectors[] = {
+    {SLN_AEAD_AES_128_GCM, "feffe9928665731c6d6a8f9467308308",
+     "cafebabefacedbaddecaf888", "feedfacedeadbeeffeedfacedeadbeefabaddad2",
+     "d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+     "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39",
+     "42831ec2217774244b7221b784d0d49ce3aa212f2c02a4e035c17e2329aca12e"
+     "21d514b25466931c7d8f6a5aac84aa051ba30b396a0aac973d58e091",
+     "5bc94fbc3221a5db94fae95ae7121a47"},
+    {SLN_AEAD_CHACHA20_POLY1305,
+     "808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f",
+     "070000004041424344454647", "50515253c0c1c2c3c4c5c6c7",
+     "4c616469657320616e642047656e746c656d656e206f662074686520636c6173"
+     "73206f66202739393a204966204920636f756c64206f6666657220796f75206f"
+     "6e6c79206f6e652074697020666f7220746865206675747572652c2073756e73"
+     "637265656e20776f756c642062652069742e",
+     "d31a8d34648e60db7b86afbc53ef7ec2a4aded51296e08fea9e2b5a736ee62d6"
+     "3dbea45e8ca9671282fafb69da92728b1a71de0a9e060b2905d6a5b67ecd3b36"
+     "92ddbd7f2d778b8c9803aee328091b58fab324e4fad675945585808b4831d7bc"
+     "3ff4def08e4b7a9de576d26586cec64b6116",
+     "1ae10b594f09e26a7e902ecbd0600691"}};
+
+/* Returns 0 if the OpenSSL we run against lacks type */
+static int aead_create(selene_t *s, sln_aead_e type, const char *key,
+                       sln_aead_t **aead) {
+  selene_error_t *err = sln_aead_create(s, type, key, aead);
+
+  if (err && err->err == SELENE_ENOTIMPL) {
+    selene_error_clear(err);
+    return 0;
+  }
+
+  SLN_ERR(err);
+
+  return 1;
+}
+
+static void aead_vector(const aead_vector_t *v) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  sln_aead_t *aead = NULL;
+  char key[32], nonce[SLN_AEAD_NONCE_LENGTH], aad[32];
+  char pt[128], ct[128], tag[SLN_AEAD_TAG_LENGTH];
+  char buf[128], outtag[SLN_AEAD_TAG_LENGTH];
+  size_t len, aadlen, ptlen;
+  selene_error_t *err;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  unhex(v->key, key, &len);
+  assert_int_equal(len, sln_aead_key_length(v->type));
+  unhex(v->nonce, nonce, &len);
+  unhex(v->aad, aad, &aadlen);
+  unhex(v->plaintext, pt, &ptlen);
+  unhex(v->ciphertext, ct, &len);
+  unhex(v->tag, tag, &len);
+
+  if (aead_create(s, v->type, key, &aead)) {
+    memcpy(buf, pt, ptlen);
+    SLN_ERR(sln_aead_seal(aead, nonce, aad, aadlen, buf, ptlen, outtag));
+    assert_memory_equal(buf, ct, ptlen);
+    assert_memory_equal(outtag, tag, sizeof(tag));
+
+    /* the context is reused for the next message */
+    SLN_ERR(sln_aead_open(aead, nonce, aad, aadlen, buf, ptlen, tag));
+    assert_memory_equal(buf, pt, ptlen);
+
+    memcpy(buf, ct, ptlen);
+    buf[0] ^= 1;
+    err = sln_aead_open(aead, nonce, aad, aadlen, buf, ptlen, tag);
+    SLN_ASSERT(err != NULL);
+    assert_int_equal(SELENE_EINVAL, err->err);
+    selene_error_clear(err);
+
+    memcpy(buf, ct, ptlen);
+    aad[0] ^= 1;
+    err = sln_aead_open(aead, nonce, aad, aadlen, buf, ptlen, tag);
+    SLN_ASSERT(err != NULL);
+    assert_int_equal(SELENE_EINVAL, err->err);
+    selene_error_clear(err);
+
+    sln_aead_destroy(aead);
+  }
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+static void aead_aes_gcm_vector(void **state) { aead_vector(&vectors[0]); }
+
+static void aead_chacha20_poly1305_vector(void **state) {
+  aead_vector(&vectors[1]);
+}
+
+SLN_TESTS_START(crypto_aead)
+SLN_TESTS_ENTRY(aead_aes_gcm_vector)
+SLN_TESTS_ENTRY(aead_chacha20_poly1305_vector)
+SLN_TESTS_END()
@@ -18,6 +18,8 @@
 #include "selene.h"
 #include "sln_tests.h"
 #include "sln_digest.h"
+#include "sln_hmac.h"
+#include "../lib/crypto/digest_builtin.h"
 #include <string.h>
 
 static struct {
@@ -141,7 +143,333 @@ static void digest_sha1(void **state) {
   }
 }
 
+/* RFC 2202, test case 2 of each */
+static void hmac_reset(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  unsigned char digest[SLN_SHA1_DIGEST_LENGTH];
+  const char *data = "what do ya want for nothing?";
+  sln_hmac_t *h;
+  int i;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  /* every MAC after a reset has to match one from a freshly keyed context */
+  SLN_ERR(sln_hmac_create(s, SLN_HMAC_SHA1, "Jefe", 4, &h));
+  for (i = 0; i < 3; i++) {
+    memset(digest, 0, sizeof(digest));
+    sln_hmac_update(h, data, strlen(data));
+    sln_hmac_final(h, digest);
+    assert_memory_equal(digest,
+                        "\xef\xfc\xdf\x6a\xe5\xeb\x2f\xa2\xd2\x74\x16\xd5"
+                        "\xf1\x84\xdf\x9c\x25\x9a\x7c\x79",
+                        SLN_SHA1_DIGEST_LENGTH);
+    sln_hmac_reset(h);
+  }
+  sln_hmac_destroy(h);
+
+  SLN_ERR(sln_hmac_create(s, SLN_HMAC_MD5, "Jefe", 4, &h));
+  for (i = 0; i < 3; i++) {
+    memset(digest, 0, sizeof(digest));
+    sln_hmac_update(h, data, 10);
+    sln_hmac_update(h, data + 10, strlen(data) - 10);
+    sln_hmac_final(h, digest);
+    assert_memory_equal(digest,
+                        "\x75\x0c\x78\x3e\x6a\xb0\xb5\x03\xea\xa8\x6e\x31"
+                        "\x0a\x5d\xb7\x38",
+                        SLN_MD5_DIGEST_LENGTH);
+    sln_hmac_reset(h);
+  }
+  sln_hmac_destroy(h);
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+static const sln_digest_e builtin_types[] = {
+    SLN_DIGEST_MD5, SLN_DIGEST_SHA1, SLN_DIGEST_SHA256, SLN_DIGEST_SHA384};
+
+static const sln_hmac_e builtin_hmac_types[] = {
+    SLN_HMAC_MD5, SLN_HMAC_SHA1, SLN_HMAC_SHA256, SLN_HMAC_SHA384};
+
+#define NUM_BUILTIN_TYPES \
+  (sizeof(builtin_types) / sizeof(builtin_types[0]))
+
+static void fill_pattern(unsigned char *buf, size_t len, unsigned int seed) {
+  size_t i;
+
+  for (i = 0; i < len; i++) {
+    seed = seed * 1103515245 + 12345;
+    buf[i] = (unsigned char)(seed >> 16);
+  }
+}
+
+/* Every length around the block boundaries, fed in uneven pieces */
+static void digest_builtin(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  unsigned char data[300];
+  unsigned char expected[SLN_BIG_DIGEST_LENGTH];
+  unsigned char digest[SLN_BIG_DIGEST_LENGTH];
+  sln_digest_t *d;
+  size_t t;
+  size_t len;
+  size_t off;
+  size_t step;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  fill_pattern(data, sizeof(data), 1);
+
+  for (t = 0; t < NUM_BUILTIN_TYPES; t++) {
+    for (len = 0; len <= sizeof(data); len++) {
+      SLN_ERR(sln_digest_openssl_create(s, builtin_types[t], &d));
+      sln_digest_openssl_update(d, data, len);
+      sln_digest_openssl_final(d, expected);
+      sln_digest_openssl_destroy(d);
+
+      memset(digest, 0, sizeof(digest));
+      SLN_ERR(sln_digest_builtin_create(s, builtin_types[t], &d));
+      for (off = 0, step = 1; off < len; off += step, step = step * 3 + 1) {
+        sln_digest_builtin_update(d, data + off,
+                                  len - off < step ? len - off : step);
+      }
+      sln_digest_builtin_final(d, digest);
+      sln_digest_builtin_destroy(d);
+
+      assert_memory_equal(digest, expected, sln_md_length(builtin_types[t]));
+    }
+  }
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+/* The accelerated block functions against the plain C ones, on whatever the
+ * CPU running the tests has */
+static void digest_builtin_kernels(void **state) {
+#ifdef SLN_DIGEST_X86
+  unsigned char data[8][64 * 5];
+  const unsigned char *lanes[8];
+  uint32_t expected[8][8];
+  uint32_t h[8][8];
+  uint32_t *hp[8];
+  int i;
+  int j;
+
+  for (i = 0; i < 8; i++) {
+    fill_pattern(data[i], sizeof(data[i]), i + 7);
+    lanes[i] = data[i];
+    hp[i] = h[i];
+    for (j = 0; j < 8; j++) {
+      expected[i][j] = 0x01020304 * (i + 1) + j;
+    }
+  }
+
+  if (sln_cpu_has_shani()) {
+    memcpy(h[0], expected[0], sizeof(h[0]));
+    sln_sha1_blocks_c(expected[0], data[0], 5);
+    sln_sha1_blocks_shani(h[0], data[0], 5);
+    assert_memory_equal(h[0], expected[0], 5 * sizeof(uint32_t));
+
+    memcpy(h[1], expected[1], sizeof(h[1]));
+    sln_sha256_blocks_c(expected[1], data[1], 5);
+    sln_sha256_blocks_shani(h[1], data[1], 5);
+    assert_memory_equal(h[1], expected[1], sizeof(h[1]));
+  }
+
+  if (sln_cpu_has_avx2()) {
+    memcpy(h, expected, sizeof(h));
+    for (i = 0; i < 8; i++) {
+      sln_md5_blocks_c(expected[i], data[i], 5);
+    }
+    sln_md5_x8_avx2(hp, lanes, 5);
+    assert_memory_equal(h, expected, sizeof(h));
+
+    memcpy(h, expected, sizeof(h));
+    for (i = 0; i < 8; i++) {
+      sln_sha1_blocks_c(expected[i], data[i], 5);
+    }
+    sln_sha1_x8_avx2(hp, lanes, 5);
+    assert_memory_equal(h, expected, sizeof(h));
+
+    memcpy(h, expected, sizeof(h));
+    for (i = 0; i < 8; i++) {
+      sln_sha256_blocks_c(expected[i], data[i], 5);
+    }
+    sln_sha256_x8_avx2(hp, lanes, 5);
+    assert_memory_equal(h, expected, sizeof(h));
+  }
+#endif
+}
+
+/* More digests than lanes, some partially filled, with lengths that leave
+ * lanes idle part way through */
+static void digest_update_many(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  unsigned char data[11][800];
+  unsigned char expected[SLN_BIG_DIGEST_LENGTH];
+  unsigned char digest[SLN_BIG_DIGEST_LENGTH];
+  sln_digest_t *d[11];
+  sln_digest_t *ref;
+  const void *ptrs[11];
+  size_t lens[11];
+  size_t t;
+  size_t i;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  for (i = 0; i < 11; i++) {
+    fill_pattern(data[i], sizeof(data[i]), i + 100);
+  }
+
+  for (t = 0; t < NUM_BUILTIN_TYPES; t++) {
+    for (i = 0; i < 11; i++) {
+      SLN_ERR(sln_digest_builtin_create(s, builtin_types[t], &d[i]));
+      sln_digest_builtin_update(d[i], data[i], i * 5);
+      ptrs[i] = data[i] + (i * 5);
+      lens[i] = 64 * (i + 1) + i;
+    }
+
+    sln_digest_builtin_update_many(d, ptrs, lens, 11);
+
+    for (i = 0; i < 11; i++) {
+      SLN_ERR(sln_digest_openssl_create(s, builtin_types[t], &ref));
+      sln_digest_openssl_update(ref, data[i], (i * 5) + lens[i]);
+      sln_digest_openssl_final(ref, expected);
+      sln_digest_openssl_destroy(ref);
+
+      memset(digest, 0, sizeof(digest));
+      sln_digest_builtin_final(d[i], digest);
+      sln_digest_builtin_destroy(d[i]);
+
+      assert_memory_equal(digest, expected, sln_md_length(builtin_types[t]));
+    }
+  }
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+/* Short, block sized and hashed down keys, reset between MACs */
+static void hmac_builtin(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  static const size_t klens[] = {4, 64, 128, 200};
+  char key[200];
+  unsigned char data[150];
+  unsigned char expected[SLN_BIG_DIGEST_LENGTH];
+  unsigned char digest[SLN_BIG_DIGEST_LENGTH];
+  sln_hmac_t *ref;
+  sln_hmac_t *h;
+  size_t t;
+  size_t k;
+  int i;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  fill_pattern((unsigned char *)key, sizeof(key), 3);
+  fill_pattern(data, sizeof(data), 4);
+
+  for (t = 0; t < NUM_BUILTIN_TYPES; t++) {
+    for (k = 0; k < sizeof(klens) / sizeof(klens[0]); k++) {
+      SLN_ERR(sln_hmac_openssl_create(s, builtin_hmac_types[t], key, klens[k],
+                                      &ref));
+      sln_hmac_openssl_update(ref, data, sizeof(data));
+      sln_hmac_openssl_final(ref, expected);
+      sln_hmac_openssl_destroy(ref);
+
+      SLN_ERR(sln_hmac_builtin_create(s, builtin_hmac_types[t], key,
+                                      klens[k], &h));
+      for (i = 0; i < 3; i++) {
+        memset(digest, 0, sizeof(digest));
+        sln_hmac_builtin_update(h, data, 70);
+        sln_hmac_builtin_update(h, data + 70, sizeof(data) - 70);
+        sln_hmac_builtin_final(h, digest);
+        assert_memory_equal(digest, expected, sln_hmac_length(h));
+        sln_hmac_builtin_reset(h);
+      }
+      sln_hmac_builtin_destroy(h);
+    }
+  }
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+/* Every length the padding of a CBC record allows, after a header like the
+ * one record MACs start with, against the same MACs done normally */
+static void hmac_builtin_final_ct(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  static const size_t maxlens[] = {0, 1, 50, 64, 115, 255, 256, 300, 1000};
+  char key[20];
+  unsigned char header[13];
+  unsigned char data[1000];
+  unsigned char expected[SLN_BIG_DIGEST_LENGTH];
+  unsigned char digest[SLN_BIG_DIGEST_LENGTH];
+  sln_hmac_t *ref;
+  sln_hmac_t *h;
+  size_t t;
+  size_t m;
+  size_t len;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  fill_pattern((unsigned char *)key, sizeof(key), 5);
+  fill_pattern(header, sizeof(header), 6);
+  fill_pattern(data, sizeof(data), 7);
+
+  for (t = 0; t < NUM_BUILTIN_TYPES; t++) {
+    SLN_ERR(sln_hmac_builtin_create(s, builtin_hmac_types[t], key,
+                                    sizeof(key), &h));
+    for (m = 0; m < sizeof(maxlens) / sizeof(maxlens[0]); m++) {
+      len = maxlens[m] > 255 ? maxlens[m] - 255 : 0;
+      for (; len <= maxlens[m]; len++) {
+        SLN_ERR(sln_hmac_openssl_create(s, builtin_hmac_types[t], key,
+                                        sizeof(key), &ref));
+        sln_hmac_openssl_update(ref, header, sizeof(header));
+        sln_hmac_openssl_update(ref, data, len);
+        sln_hmac_openssl_final(ref, expected);
+        sln_hmac_openssl_destroy(ref);
+
+        memset(digest, 0, sizeof(digest));
+        sln_hmac_builtin_reset(h);
+        sln_hmac_builtin_update(h, header, sizeof(header));
+        sln_hmac_builtin_final_ct(h, data, len, maxlens[m], digest);
+        assert_memory_equal(digest, expected, sln_hmac_length(h));
+      }
+    }
+    sln_hmac_builtin_destroy(h);
+  }
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
 SLN_TESTS_START(crypto_digest)
 SLN_TESTS_ENTRY(digest_md5)
 SLN_TESTS_ENTRY(digest_sha1)
+SLN_TESTS_ENTRY(hmac_reset)
+SLN_TESTS_ENTRY(digest_builtin)
+SLN_TESTS_ENTRY(digest_builtin_kernels)
+SLN_TESTS_ENTRY(digest_update_many)
+SLN_TESTS_ENTRY(hmac_builtin)
+SLN_TESTS_ENTRY(hmac_builtin_final_ct)
 SLN_TESTS_END()
@@ -20,10 +20,11 @@
 #include "sln_types.h"
 #include "sln_prf.h"
 #include <string.h>
+#include <stdio.h>
 
 unsigned char ssl_test_vector[] = {0xb5, 0xba, 0xf4, 0x72, 0x2b, 0x91, 0x85,
                                    0x1a, 0x88, 0x16, 0xd2, 0x2e, 0xbd, 0x8c,
-                                   0x1d, 0x8c, 0xa0, 0x33, 0x25, 0x85};
+                                   0x1d, 0x8c, 0xc2, 0xe9, 0x4d, 0x55};
 
 static void prf_vector_from_book(void **state) {
   selene_conf_t *conf = NULL;
@@ -49,6 +50,100 @@ static void prf_vector_from_book(void **state) {
   selene_conf_destroy(conf);
 }
 
+static void unhex(const char *hex, char *out, size_t *len) {
+  size_t i;
+  unsigned int v;
+
+  *len = strlen(hex) / 2;
+  for (i = 0; i < *len; i++) {
+    sscanf(hex + (i * 2), "%2x", &v);
+    out[i] = (char)v;
+  }
+}
+
+/* Several blocks of each hash, and an odd length secret, whose halves share
+ * a byte */
+static void prf_key_block(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  char buf[104];
+  char expected[104];
+  size_t len;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  unhex("18815a46f3d2bd6505f99836b7b5d8dfe6b3a1b749741a70a2a19043c2426067"
+        "b088cd0351535f879ab0d86f358d6861860e01808d92dbb7e07a5f46632597e1"
+        "cbaa617f996f7c765f545dfcdc766797ae55d406d9c5c485524dbe38b431623e"
+        "12b1d3ce9f1cf71d",
+        expected, &len);
+  assert_int_equal(len, sizeof(buf));
+
+  SLN_ERR(sln_prf(s, "key expansion", strlen("key expansion"), "master secret",
+                  strlen("master secret"),
+                  "0123456789abcdef0123456789abcdef"
+                  "0123456789abcdef0123456789abcdef",
+                  64, buf, sizeof(buf)));
+
+  assert_memory_equal(buf, expected, sizeof(buf));
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+/* The TLS 1.2 PRF vectors posted to the IETF TLS list */
+static void prf_tls12_vectors(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  char secret[16];
+  char seed[16];
+  char buf[148];
+  char expected[148];
+  size_t len;
+  size_t slen;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  unhex("9bbe436ba940f017b17652849a71db35", secret, &slen);
+  unhex("a0ba9f936cda311827a6f796ffd5198c", seed, &slen);
+  unhex("e3f229ba727be17b8d122620557cd453c2aab21d07c3d495329b52d4e61edb5a"
+        "6b301791e90d35c9c9a46b4e14baf9af0fa022f7077def17abfd3797c0564bab"
+        "4fbc91666e9def9b97fce34f796789baa48082d122ee42c5a72e5a5110fff701"
+        "87347b66",
+        expected, &len);
+
+  SLN_ERR(sln_prf_tls12(s, SLN_HMAC_SHA256, "test label",
+                        strlen("test label"), secret, sizeof(secret), seed,
+                        sizeof(seed), buf, len));
+  assert_memory_equal(buf, expected, len);
+
+  unhex("b80b733d6ceefcdc71566ea48e5567df", secret, &slen);
+  unhex("cd665cf6a8447dd6ff8b27555edb7465", seed, &slen);
+  unhex("7b0c18e9ced410ed1804f2cfa34a336a1c14dffb4900bb5fd7942107e81c83cd"
+        "e9ca0faa60be9fe34f82b1233c9146a0e534cb400fed2700884f9dc236f80edd"
+        "8bfa961144c9e8d792eca722a7b32fc3d416d473ebc2c5fd4abfdad05d918425"
+        "9b5bf8cd4d90fa0d31e2dec479e4f1a26066f2eea9a69236a3e52655c9e9aee6"
+        "91c8f3a26854308d5eaa3be85e0990703d73e56f",
+        expected, &len);
+  assert_int_equal(len, sizeof(buf));
+
+  SLN_ERR(sln_prf_tls12(s, SLN_HMAC_SHA384, "test label",
+                        strlen("test label"), secret, sizeof(secret), seed,
+                        sizeof(seed), buf, len));
+  assert_memory_equal(buf, expected, len);
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
 SLN_TESTS_START(crypto_prf)
 SLN_TESTS_ENTRY(prf_vector_from_book)
+SLN_TESTS_ENTRY(prf_key_block)
+SLN_TESTS_ENTRY(prf_tls12_vectors)
 SLN_TESTS_END()
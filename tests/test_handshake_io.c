@@ -197,8 +197,62 @@ static void handshake_io_server_hello_sni(void **state) {
   selene_conf_destroy(conf);
 }
 
+/* Feeds the first len bytes of the SNI client hello in chunk sized pieces,
+ * returning how many tokens the handshake reader has processed. */
+static size_t client_hello_sni_steps(size_t len, size_t chunk) {
+  sln_parser_baton_t *baton;
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  sln_bucket_t *e1;
+  size_t i;
+  size_t n;
+  size_t steps;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+
+  baton = (sln_parser_baton_t *)s->backend_baton;
+
+  for (i = 0; i < len; i += n) {
+    n = len - i < chunk ? len - i : chunk;
+    SLN_ERR(sln_bucket_create_copy_bytes(
+        sln_test_alloc, &e1, (const char *)curl_client_hello_sni + i, n));
+    SLN_BRIGADE_INSERT_TAIL(baton->in_handshake, e1);
+    SLN_ERR(sln_io_handshake_read(s, baton));
+  }
+
+  steps = baton->hs.tok.steps;
+
+  if (len == sizeof(curl_client_hello_sni)) {
+    /* whole message consumed, reader ready for the next one */
+    assert_true(SLN_BRIGADE_EMPTY(baton->in_handshake));
+    assert_int_equal(SLN_HS__INIT, baton->hs.state);
+  }
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+
+  return steps;
+}
+
+static void handshake_io_client_hello_bytewise(void **state) {
+  size_t len = sizeof(curl_client_hello_sni) - 1;
+  size_t whole = client_hello_sni_steps(len, len);
+
+  /* The work done for a fragmented message must not depend on how many
+   * fragments it arrived in. */
+  assert_true(whole > 0);
+  assert_int_equal(whole, client_hello_sni_steps(len, 1));
+  assert_int_equal(whole, client_hello_sni_steps(len, 7));
+
+  client_hello_sni_steps(len + 1, 1);
+}
+
 SLN_TESTS_START(handshake_io)
 SLN_TESTS_ENTRY(handshake_io_client_hello)
 SLN_TESTS_ENTRY(handshake_io_client_hello_sni)
 SLN_TESTS_ENTRY(handshake_io_server_hello_sni)
+SLN_TESTS_ENTRY(handshake_io_client_hello_bytewise)
 SLN_TESTS_END()
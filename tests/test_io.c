@@ -0,0 +1,398 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "selene.h"
+#include "sln_tests.h"
+#include "sln_brigades.h"
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../lib/parser/parser.h"
+
+#define RECORD_SIZE 16384
+
+static void init_ctxt(void **state, selene_t **s_, selene_conf_t **conf_) {
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_server_create(conf, &s));
+  SLN_ASSERT_CONTEXT(s);
+  SLN_ERR(selene_start(s));
+
+  *s_ = s;
+  *conf_ = conf;
+}
+
+static void destroy_ctxt(void **state, selene_t *s, selene_conf_t *conf) {
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+/* count application data records of RECORD_SIZE bytes each */
+static char *build_records(int count, size_t *outlen) {
+  int i;
+  size_t len = count * (5 + RECORD_SIZE);
+  char *buf = malloc(len);
+  char *p = buf;
+
+  for (i = 0; i < count; i++) {
+    p[0] = 23;
+    p[1] = 3;
+    p[2] = 1;
+    p[3] = (RECORD_SIZE >> 8) & 0xFF;
+    p[4] = RECORD_SIZE & 0xFF;
+    memset(p + 5, 'a' + i, RECORD_SIZE);
+    p += 5 + RECORD_SIZE;
+  }
+
+  *outlen = len;
+  return buf;
+}
+
+static void check_application(void **state, selene_t *s, int count) {
+  int i;
+  char *out;
+  char expect[RECORD_SIZE];
+  size_t len = 0;
+
+  assert_int_equal(0, sln_brigade_size(s->bb.in_enc));
+  assert_int_equal(count * RECORD_SIZE,
+                   sln_brigade_size(s->bb.out_cleartext));
+
+  out = malloc(count * RECORD_SIZE);
+  SLN_ERR(sln_brigade_pread_bytes(s->bb.out_cleartext, 0, count * RECORD_SIZE,
+                                  out, &len));
+  assert_int_equal(count * RECORD_SIZE, len);
+
+  for (i = 0; i < count; i++) {
+    memset(expect, 'a' + i, RECORD_SIZE);
+    assert_memory_equal(expect, out + i * RECORD_SIZE, RECORD_SIZE);
+  }
+
+  free(out);
+}
+
+static void io_in_enc_reserve_commit(void **state) {
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  char *record;
+  char *buf;
+  char *expect = NULL;
+  size_t len;
+  size_t off;
+  size_t n;
+  size_t rlen;
+
+  init_ctxt(state, &s, &conf);
+  record = build_records(1, &rlen);
+
+  for (off = 0; off < rlen; off += n) {
+    SLN_ERR(selene_io_in_enc_reserve(s, 1460, &buf, &len));
+    assert_true(len >= 1460);
+
+    /* MSS sized reads land back to back in the same chunk */
+    if (expect != NULL) {
+      assert_true(buf == expect);
+    }
+
+    n = rlen - off < 1460 ? rlen - off : 1460;
+    memcpy(buf, record + off, n);
+    expect = buf + n;
+    SLN_ERR(selene_io_in_enc_commit(s, n));
+  }
+
+  check_application(state, s, 1);
+
+  free(record);
+  destroy_ctxt(state, s, conf);
+}
+
+static void io_in_enc_reserve_default(void **state) {
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  char *record;
+  char *buf;
+  size_t len;
+  size_t rlen;
+
+  init_ctxt(state, &s, &conf);
+  record = build_records(1, &rlen);
+
+  SLN_ERR(selene_io_in_enc_reserve(s, 0, &buf, &len));
+  assert_true(len >= rlen);
+  memcpy(buf, record, rlen);
+  SLN_ERR(selene_io_in_enc_commit(s, rlen));
+
+  check_application(state, s, 1);
+
+  free(record);
+  destroy_ctxt(state, s, conf);
+}
+
+static void io_in_enc_reserve_iovec(void **state) {
+  int i;
+  int iovcnt;
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  struct iovec vec[4];
+  char *records;
+  char *buf;
+  size_t len;
+  size_t rlen;
+  size_t off;
+  size_t want;
+
+  init_ctxt(state, &s, &conf);
+  records = build_records(2, &rlen);
+
+  /* leave a little spare room at the end of the first chunk */
+  SLN_ERR(selene_io_in_enc_reserve(s, 0, &buf, &len));
+  off = len - 300;
+  memcpy(buf, records, off);
+  SLN_ERR(selene_io_in_enc_commit(s, off));
+
+  want = rlen - off;
+  iovcnt = 4;
+  SLN_ERR(selene_io_in_enc_reserve_iovec(s, want, vec, &iovcnt));
+  assert_int_equal(2, iovcnt);
+  assert_int_equal(300, vec[0].iov_len);
+  assert_true(vec[0].iov_base == buf + off);
+  assert_true(vec[0].iov_len + vec[1].iov_len >= want);
+
+  /* what readv() would do */
+  for (i = 0; i < iovcnt && off < rlen; i++) {
+    size_t n = rlen - off;
+    if (n > vec[i].iov_len) {
+      n = vec[i].iov_len;
+    }
+    memcpy(vec[i].iov_base, records + off, n);
+    off += n;
+  }
+
+  SLN_ERR(selene_io_in_enc_commit(s, want));
+
+  check_application(state, s, 2);
+
+  free(records);
+  destroy_ctxt(state, s, conf);
+}
+
+static void io_in_enc_commit_invalid(void **state) {
+  int iovcnt = 0;
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  struct iovec vec[1];
+  char *buf;
+  size_t len;
+
+  init_ctxt(state, &s, &conf);
+
+  /* nothing reserved yet */
+  SLN_FAIL(selene_io_in_enc_commit(s, 1));
+  SLN_ERR(selene_io_in_enc_commit(s, 0));
+
+  SLN_ERR(selene_io_in_enc_reserve(s, 10, &buf, &len));
+  SLN_FAIL(selene_io_in_enc_commit(s, len + 1));
+
+  /* a failed commit still ends the reservation */
+  SLN_FAIL(selene_io_in_enc_commit(s, 1));
+
+  SLN_FAIL(selene_io_in_enc_reserve_iovec(s, 10, vec, &iovcnt));
+
+  destroy_ctxt(state, s, conf);
+}
+
+static void fill_out_enc(void **state, selene_t *s, int count) {
+  int i;
+  char buf[100];
+  sln_bucket_t *e = NULL;
+
+  for (i = 0; i < count; i++) {
+    memset(buf, 'a' + i, sizeof(buf));
+    SLN_ERR(sln_bucket_create_copy_bytes(s->alloc, &e, buf, sizeof(buf)));
+    SLN_BRIGADE_INSERT_TAIL(s->bb.out_enc, e);
+  }
+}
+
+static void io_out_enc_peek_consume(void **state) {
+  int count;
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  struct iovec vec[4];
+  char *second;
+
+  init_ctxt(state, &s, &conf);
+
+  SLN_ERR(selene_io_out_enc_peek_iovec(s, vec, 4, &count));
+  assert_int_equal(0, count);
+
+  fill_out_enc(state, s, 3);
+
+  SLN_ERR(selene_io_out_enc_peek_iovec(s, vec, 2, &count));
+  assert_int_equal(2, count);
+  assert_int_equal(100, vec[0].iov_len);
+  assert_int_equal(100, vec[1].iov_len);
+  assert_memory_equal("aaaa", vec[0].iov_base, 4);
+  assert_memory_equal("bbbb", vec[1].iov_base, 4);
+  second = vec[1].iov_base;
+
+  /* a short write, ending in the middle of the second buffer */
+  SLN_ERR(selene_io_out_enc_consume(s, 130));
+  assert_int_equal(170, sln_brigade_size(s->bb.out_enc));
+
+  SLN_ERR(selene_io_out_enc_peek_iovec(s, vec, 4, &count));
+  assert_int_equal(2, count);
+  assert_int_equal(70, vec[0].iov_len);
+  assert_true(vec[0].iov_base == second + 30);
+  assert_int_equal(100, vec[1].iov_len);
+  assert_memory_equal("cccc", vec[1].iov_base, 4);
+
+  SLN_FAIL(selene_io_out_enc_consume(s, 171));
+  SLN_ERR(selene_io_out_enc_consume(s, 170));
+  assert_true(SLN_BRIGADE_EMPTY(s->bb.out_enc));
+
+  destroy_ctxt(state, s, conf);
+}
+
+static void io_out_enc_consume_deferred(void **state) {
+  int count;
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  struct iovec vec[4];
+  char expect[100];
+  char *first;
+
+  init_ctxt(state, &s, &conf);
+  fill_out_enc(state, s, 2);
+
+  SLN_ERR(selene_io_out_enc_peek_iovec(s, vec, 4, &count));
+  assert_int_equal(2, count);
+  first = vec[0].iov_base;
+
+  SLN_ERR(selene_io_out_enc_consume_deferred(s, 150));
+  assert_int_equal(50, sln_brigade_size(s->bb.out_enc));
+  assert_int_equal(150, sln_brigade_size(s->bb.out_enc_inflight));
+
+  /* the kernel may still be reading these */
+  memset(expect, 'a', sizeof(expect));
+  assert_memory_equal(expect, first, 100);
+
+  SLN_FAIL(selene_io_out_enc_release(s, 151));
+  SLN_ERR(selene_io_out_enc_release(s, 100));
+  assert_int_equal(50, sln_brigade_size(s->bb.out_enc_inflight));
+  SLN_ERR(selene_io_out_enc_release(s, 50));
+  assert_true(SLN_BRIGADE_EMPTY(s->bb.out_enc_inflight));
+
+  SLN_ERR(selene_io_out_enc_peek_iovec(s, vec, 4, &count));
+  assert_int_equal(1, count);
+  assert_int_equal(50, vec[0].iov_len);
+  assert_memory_equal("bbbb", vec[0].iov_base, 4);
+
+  destroy_ctxt(state, s, conf);
+}
+
+static void count_release(void *baton) { (*(int *)baton)++; }
+
+static void io_in_clear_borrow(void **state) {
+  int released = 0;
+  const char *body = "HTTP/1.1 200 OK\r\n\r\n";
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  sln_bucket_t *e;
+
+  init_ctxt(state, &s, &conf);
+
+  SLN_ERR(selene_io_in_clear_borrow(s, body, strlen(body), count_release,
+                                    &released));
+
+  e = SLN_BRIGADE_FIRST(s->bb.in_cleartext);
+  assert_true(e->data == body);
+  assert_int_equal(strlen(body), sln_brigade_size(s->bb.in_cleartext));
+  assert_int_equal(0, released);
+
+  destroy_ctxt(state, s, conf);
+  assert_int_equal(1, released);
+}
+
+static void io_in_clear_iovec(void **state) {
+  char buf[9];
+  size_t len = 0;
+  struct iovec vec[2];
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+
+  init_ctxt(state, &s, &conf);
+
+  vec[0].iov_base = "foo";
+  vec[0].iov_len = 3;
+  vec[1].iov_base = "barbaz";
+  vec[1].iov_len = 6;
+
+  SLN_ERR(selene_io_in_clear_iovec(s, vec, 2));
+
+  assert_true(SLN_BRIGADE_EMPTY(s->bb.in_enc));
+  assert_int_equal(1, sln_brigade_bucket_count(s->bb.in_cleartext));
+  SLN_ERR(sln_brigade_pread_bytes(s->bb.in_cleartext, 0, 9, buf, &len));
+  assert_int_equal(9, len);
+  assert_memory_equal("foobarbaz", buf, 9);
+
+  destroy_ctxt(state, s, conf);
+}
+
+static void io_in_clear_file(void **state) {
+  int i;
+  int fd;
+  int released = 0;
+  char path[] = "/tmp/sln_test_io_XXXXXX";
+  selene_t *s = NULL;
+  selene_conf_t *conf = NULL;
+  sln_bucket_t *e;
+
+  fd = mkstemp(path);
+  assert_true(fd >= 0);
+  unlink(path);
+  assert_int_equal(9, write(fd, "foobarbaz", 9));
+
+  init_ctxt(state, &s, &conf);
+
+  SLN_ERR(selene_io_in_clear_file(s, fd, 3, 6, count_release, &released));
+  SLN_ERR(selene_io_in_clear_mmap(s, fd, 0, 3, count_release, &released));
+
+  /* nothing read until the record layer asks for it */
+  assert_int_equal(9, sln_brigade_size(s->bb.in_cleartext));
+  for (i = 0; i < sln_brigade_bucket_count(s->bb.in_cleartext); i++) {
+    e = SLN_BRIGADE_BUCKET(s->bb.in_cleartext, i);
+    assert_true(e->data == NULL);
+  }
+
+  destroy_ctxt(state, s, conf);
+  assert_int_equal(2, released);
+  close(fd);
+}
+
+SLN_TESTS_START(io)
+SLN_TESTS_ENTRY(io_in_enc_reserve_commit)
+SLN_TESTS_ENTRY(io_in_enc_reserve_default)
+SLN_TESTS_ENTRY(io_in_enc_reserve_iovec)
+SLN_TESTS_ENTRY(io_in_enc_commit_invalid)
+SLN_TESTS_ENTRY(io_out_enc_peek_consume)
+SLN_TESTS_ENTRY(io_out_enc_consume_deferred)
+SLN_TESTS_ENTRY(io_in_clear_borrow)
+SLN_TESTS_ENTRY(io_in_clear_iovec)
+SLN_TESTS_ENTRY(io_in_clear_file)
+SLN_TESTS_END()
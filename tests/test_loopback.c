@@ -17,7 +17,11 @@
 
 #include "selene.h"
 #include "sln_tests.h"
+#include "sln_sessions.h"
+#include "sln_tickets.h"
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 typedef struct s_baton_t {
   selene_t *s;
@@ -147,6 +151,623 @@ static void loopback_basic(void **state) {
   selene_conf_destroy(cconf);
 }
 
+typedef struct pair_t {
+  selene_conf_t *sconf;
+  selene_conf_t *cconf;
+  selene_t *server;
+  selene_t *client;
+  s_baton_t serverb;
+  s_baton_t clientb;
+  /* Client session tag, if any */
+  const char *tag;
+  /* Session store the server looks in instead of its conf, if any */
+  struct ext_store_t *store;
+  /* Cleartext each side received, room for a few full records */
+  char sclear[3 * 16384];
+  size_t sclearlen;
+  char cclear[3 * 16384];
+  size_t cclearlen;
+} pair_t;
+
+static selene_error_t *take_cleartext(selene_t *s, selene_event_e event,
+                                      void *baton) {
+  pair_t *p = baton;
+  char *buf = s == p->server ? p->sclear : p->cclear;
+  size_t *len = s == p->server ? &p->sclearlen : &p->cclearlen;
+  size_t blen = 0;
+  size_t remaining = 0;
+
+  SLN_ERR(selene_io_out_clear_bytes(s, buf + *len, sizeof(p->sclear) - *len,
+                                    &blen, &remaining));
+  *len += blen;
+
+  return SELENE_SUCCESS;
+}
+
+/* Stand-in for a session cache shared by a fleet of servers, holding a
+ * single exported session */
+typedef struct ext_store_t {
+  char id[32];
+  size_t id_len;
+  char blob[SELENE_SESSION_EXPORT_LENGTH];
+  size_t blob_len;
+  int lookups;
+  int stores;
+  /* Leave lookups to ext_store_answer, as if the store were remote */
+  int defer;
+  selene_t *pending;
+} ext_store_t;
+
+static void ext_store_answer(ext_store_t *store, selene_t *s) {
+  selene_session_t *session = NULL;
+  const char *id;
+  size_t len;
+
+  selene_session_lookup_id(s, &id, &len);
+
+  if (len != 0 && len == store->id_len && memcmp(id, store->id, len) == 0) {
+    SLN_ERR(selene_session_import(s->conf, store->blob, store->blob_len,
+                                  &session));
+  }
+
+  store->pending = NULL;
+  selene_complete_session_lookup(s, session);
+
+  if (session != NULL) {
+    selene_session_destroy(session);
+  }
+}
+
+static selene_error_t *ext_store_lookup(selene_t *s, selene_event_e event,
+                                        void *baton) {
+  ext_store_t *store = baton;
+
+  store->lookups++;
+
+  if (store->defer) {
+    store->pending = s;
+  } else {
+    ext_store_answer(store, s);
+  }
+
+  return SELENE_SUCCESS;
+}
+
+static selene_error_t *ext_store_store(selene_t *s, selene_event_e event,
+                                       void *baton) {
+  ext_store_t *store = baton;
+  selene_session_t *session = NULL;
+  const char *id;
+
+  store->stores++;
+
+  SLN_ERR(selene_session_get(s, &session));
+  selene_session_id(session, &id, &store->id_len);
+  memcpy(store->id, id, store->id_len);
+  SLN_ERR(selene_session_export(session, store->blob, &store->blob_len));
+  selene_session_destroy(session);
+
+  return SELENE_SUCCESS;
+}
+
+static void pair_confs(pair_t *p, int cache) {
+  const char *ca = sln_tests_load_cert("test_ca.pem");
+  const char *cert = sln_tests_load_cert("test_cert.pem");
+  const char *pkey = sln_tests_load_cert("test_key.pem");
+
+  memset(p, 0, sizeof(*p));
+
+  SLN_ERR(selene_conf_create(&p->sconf));
+  SLN_ERR(selene_conf_use_reasonable_defaults(p->sconf));
+  SLN_ERR(selene_conf_cert_chain_add(p->sconf, cert, pkey));
+  if (cache) {
+    SLN_ERR(selene_conf_session_cache(p->sconf, 16, 300));
+  }
+
+  SLN_ERR(selene_conf_create(&p->cconf));
+  SLN_ERR(selene_conf_use_reasonable_defaults(p->cconf));
+  SLN_ERR(selene_conf_ca_trusted_cert_add(p->cconf, ca));
+
+  free((void *)ca);
+  free((void *)cert);
+  free((void *)pkey);
+}
+
+/* Starts a handshake between a new client and server, the client offering
+ * session */
+static void pair_start(pair_t *p, selene_session_t *session) {
+  memset(&p->serverb, 0, sizeof(s_baton_t));
+  memset(&p->clientb, 0, sizeof(s_baton_t));
+  p->sclearlen = 0;
+  p->cclearlen = 0;
+
+  SLN_ERR(selene_server_create(p->sconf, &p->server));
+  SLN_ERR(selene_client_create(p->cconf, &p->client));
+
+  p->serverb.s = p->server;
+  p->serverb.sendto = p->client;
+  p->clientb.s = p->client;
+  p->clientb.sendto = p->server;
+
+  SLN_ERR(selene_client_name_indication(p->client, "localhost"));
+  SLN_ERR(selene_client_session_tag(p->client, p->tag));
+  if (session != NULL) {
+    SLN_ERR(selene_client_session_set(p->client, session));
+  }
+
+  if (p->store != NULL) {
+    SLN_ERR(selene_handler_set(p->server, SELENE_EVENT_SESSION_LOOKUP,
+                               ext_store_lookup, p->store));
+    SLN_ERR(selene_handler_set(p->server, SELENE_EVENT_SESSION_STORE,
+                               ext_store_store, p->store));
+  }
+
+  SLN_ERR(selene_subscribe(p->server, SELENE__EVENT_HS_GOT_FINISHED,
+                           inc_counter, &p->serverb));
+  SLN_ERR(selene_subscribe(p->server, SELENE_EVENT_SELECT_CERTIFICATES,
+                           inc_counter, &p->serverb));
+  SLN_ERR(selene_subscribe(p->client, SELENE__EVENT_HS_GOT_FINISHED,
+                           inc_counter, &p->clientb));
+  SLN_ERR(selene_subscribe(p->client, SELENE__EVENT_HS_GOT_CERTIFICATE,
+                           inc_counter, &p->clientb));
+
+  SLN_ERR(selene_subscribe(p->server, SELENE_EVENT_IO_OUT_ENC, want_pull,
+                           &p->serverb));
+  SLN_ERR(selene_subscribe(p->server, SELENE_EVENT_IO_OUT_CLEAR,
+                           take_cleartext, p));
+  SLN_ERR(selene_subscribe(p->client, SELENE_EVENT_IO_OUT_ENC, want_pull,
+                           &p->clientb));
+  SLN_ERR(selene_subscribe(p->client, SELENE_EVENT_IO_OUT_CLEAR,
+                           take_cleartext, p));
+
+  SLN_ERR(selene_start(p->server));
+  SLN_ERR(selene_start(p->client));
+}
+
+/* Checks the handshake pair_start began went through */
+static void pair_check(pair_t *p) {
+  assert_int_equal(p->serverb.ecount[SELENE__EVENT_HS_GOT_FINISHED], 1);
+  assert_int_equal(p->clientb.ecount[SELENE__EVENT_HS_GOT_FINISHED], 1);
+
+  /* records flow both ways under the negotiated keys */
+  SLN_ERR(selene_io_in_clear_bytes(p->client, "ping", 4));
+  SLN_ERR(selene_io_in_clear_bytes(p->server, "pong", 4));
+  assert_int_equal(p->sclearlen, 4);
+  assert_memory_equal(p->sclear, "ping", 4);
+  assert_int_equal(p->cclearlen, 4);
+  assert_memory_equal(p->cclear, "pong", 4);
+}
+
+/* Runs a handshake between a new client and server, the client offering
+ * session */
+static void pair_connect(pair_t *p, selene_session_t *session) {
+  pair_start(p, session);
+  pair_check(p);
+}
+
+static void pair_disconnect(pair_t *p) {
+  selene_destroy(p->server);
+  selene_destroy(p->client);
+  p->server = NULL;
+  p->client = NULL;
+}
+
+static void pair_destroy(pair_t *p) {
+  selene_conf_destroy(p->sconf);
+  selene_conf_destroy(p->cconf);
+}
+
+static void loopback_handshake(void **state) {
+  pair_t p;
+  selene_session_t *session = NULL;
+
+  pair_confs(&p, 0);
+
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.server), 0);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 1);
+
+  /* without a cache the server does not name the session, there is nothing
+   * to offer next time */
+  SLN_ERR(selene_session_get(p.client, &session));
+  assert_true(session != NULL);
+  assert_int_equal(session->id_len, 0);
+  selene_session_destroy(session);
+
+  pair_disconnect(&p);
+  pair_destroy(&p);
+}
+
+static void loopback_resume(void **state) {
+  pair_t p;
+  selene_session_t *session = NULL;
+  selene_session_t *again = NULL;
+  size_t hits, misses, evictions;
+
+  pair_confs(&p, 1);
+
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  SLN_ERR(selene_session_get(p.client, &session));
+  assert_int_equal(session->id_len, 32);
+  pair_disconnect(&p);
+
+  /* the abbreviated handshake skips the certificate */
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  assert_int_equal(p.serverb.ecount[SELENE_EVENT_SELECT_CERTIFICATES], 0);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 0);
+
+  /* and keeps the session as it was */
+  SLN_ERR(selene_session_get(p.client, &again));
+  assert_int_equal(again->id_len, session->id_len);
+  assert_memory_equal(again->id, session->id, session->id_len);
+  assert_memory_equal(again->master_secret, session->master_secret,
+                      sizeof(session->master_secret));
+  selene_session_destroy(again);
+  pair_disconnect(&p);
+
+  sln_session_cache_stats(p.sconf->session_cache, &hits, &misses, &evictions);
+  assert_int_equal(hits, 1);
+  assert_int_equal(misses, 0);
+
+  /* a session the server no longer has gets a full handshake */
+  sln_session_cache_remove(p.sconf->session_cache, session->id,
+                           session->id_len);
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 0);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 1);
+  pair_disconnect(&p);
+
+  selene_session_destroy(session);
+  pair_destroy(&p);
+}
+
+static void loopback_shared_cache(void **state) {
+  pair_t p;
+  selene_conf_t *other = NULL;
+  selene_session_t *session = NULL;
+  const char *cert = sln_tests_load_cert("test_cert.pem");
+  const char *pkey = sln_tests_load_cert("test_key.pem");
+  char path[] = "/tmp/sln_loopback_XXXXXX";
+  size_t hits, misses, evictions;
+  int fd;
+
+  fd = mkstemp(path);
+  assert_true(fd != -1);
+  close(fd);
+
+  pair_confs(&p, 0);
+  SLN_ERR(selene_conf_session_cache_shared(p.sconf, 16, 300, path));
+
+  pair_connect(&p, NULL);
+  SLN_ERR(selene_session_get(p.client, &session));
+  pair_disconnect(&p);
+
+  /* another server on the same file, like a sibling worker */
+  SLN_ERR(selene_conf_create(&other));
+  SLN_ERR(selene_conf_use_reasonable_defaults(other));
+  SLN_ERR(selene_conf_cert_chain_add(other, cert, pkey));
+  SLN_ERR(selene_conf_session_cache_shared(other, 16, 300, path));
+  selene_conf_destroy(p.sconf);
+  p.sconf = other;
+
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 0);
+  pair_disconnect(&p);
+
+  sln_session_cache_stats(p.sconf->session_cache, &hits, &misses, &evictions);
+  assert_int_equal(hits, 1);
+
+  selene_session_destroy(session);
+  pair_destroy(&p);
+  unlink(path);
+  free((void *)cert);
+  free((void *)pkey);
+}
+
+static void loopback_external_cache(void **state) {
+  pair_t p;
+  ext_store_t store;
+  selene_session_t *session = NULL;
+  selene_session_t *again = NULL;
+
+  memset(&store, 0, sizeof(store));
+
+  /* no session cache in the conf, the store names sessions */
+  pair_confs(&p, 0);
+  p.store = &store;
+
+  pair_connect(&p, NULL);
+  assert_int_equal(store.lookups, 0);
+  assert_int_equal(store.stores, 1);
+  SLN_ERR(selene_session_get(p.client, &session));
+  assert_int_equal(session->id_len, 32);
+  assert_int_equal(store.id_len, 32);
+  assert_memory_equal(store.id, session->id, 32);
+  pair_disconnect(&p);
+
+  pair_connect(&p, session);
+  assert_int_equal(store.lookups, 1);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  assert_int_equal(p.serverb.ecount[SELENE_EVENT_SELECT_CERTIFICATES], 0);
+  SLN_ERR(selene_session_get(p.client, &again));
+  assert_memory_equal(again->master_secret, session->master_secret,
+                      sizeof(session->master_secret));
+  selene_session_destroy(again);
+  pair_disconnect(&p);
+  assert_int_equal(store.stores, 1);
+
+  /* the handshake waits for an answer from outside of it */
+  store.defer = 1;
+  pair_start(&p, session);
+  assert_int_equal(store.lookups, 2);
+  assert_true(store.pending == p.server);
+  assert_int_equal(p.serverb.ecount[SELENE__EVENT_HS_GOT_FINISHED], 0);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_FINISHED], 0);
+  ext_store_answer(&store, store.pending);
+  pair_check(&p);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  pair_disconnect(&p);
+
+  /* and carries on with a full one if the store has nothing */
+  store.id_len = 0;
+  pair_start(&p, session);
+  assert_true(store.pending == p.server);
+  ext_store_answer(&store, store.pending);
+  pair_check(&p);
+  assert_int_equal(selene_session_resumed(p.server), 0);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  assert_int_equal(p.serverb.ecount[SELENE_EVENT_SELECT_CERTIFICATES], 1);
+  assert_int_equal(store.stores, 2);
+  pair_disconnect(&p);
+
+  selene_session_destroy(session);
+  pair_destroy(&p);
+}
+
+static void loopback_ticket(void **state) {
+  pair_t p;
+  selene_conf_t *sconf;
+  selene_conf_t *other = NULL;
+  selene_session_t *session = NULL;
+  selene_session_t *again = NULL;
+  const char *cert = sln_tests_load_cert("test_cert.pem");
+  const char *pkey = sln_tests_load_cert("test_key.pem");
+  char key[SELENE_SESSION_TICKET_KEY_LENGTH];
+
+  memset(key, 't', sizeof(key));
+
+  /* no session cache, tickets only */
+  pair_confs(&p, 0);
+  SLN_ERR(selene_conf_session_ticket_key(p.sconf, key));
+  SLN_ERR(selene_conf_session_tickets(p.sconf, 300));
+
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  SLN_ERR(selene_session_get(p.client, &session));
+  assert_int_equal(session->ticket_len, SLN_TICKET_LENGTH);
+  assert_int_equal(session->ticket_lifetime_hint, 300);
+  assert_int_equal(session->id_len, 32);
+  pair_disconnect(&p);
+
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 0);
+  /* the ticket is still good, no new one */
+  SLN_ERR(selene_session_get(p.client, &again));
+  assert_int_equal(again->ticket_len, session->ticket_len);
+  assert_memory_equal(again->ticket, session->ticket, session->ticket_len);
+  selene_session_destroy(again);
+  pair_disconnect(&p);
+
+  /* any server with the key resumes it */
+  SLN_ERR(selene_conf_create(&other));
+  SLN_ERR(selene_conf_use_reasonable_defaults(other));
+  SLN_ERR(selene_conf_cert_chain_add(other, cert, pkey));
+  SLN_ERR(selene_conf_session_ticket_key(other, key));
+  SLN_ERR(selene_conf_session_tickets(other, 300));
+  sconf = p.sconf;
+  p.sconf = other;
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  pair_disconnect(&p);
+  p.sconf = sconf;
+
+  /* after a rotation it still resumes, and gets a ticket under the new
+   * key */
+  SLN_ERR(selene_conf_session_ticket_key(p.sconf, NULL));
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  SLN_ERR(selene_session_get(p.client, &again));
+  assert_int_equal(again->ticket_len, SLN_TICKET_LENGTH);
+  assert_memory_not_equal(again->ticket, session->ticket,
+                          SLN_TICKET_KEY_NAME_LENGTH);
+  assert_memory_equal(again->master_secret, session->master_secret,
+                      sizeof(session->master_secret));
+  pair_disconnect(&p);
+
+  /* the new ticket resumes too */
+  pair_connect(&p, again);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  pair_disconnect(&p);
+  selene_session_destroy(again);
+
+  /* two rotations on, the old key is gone */
+  SLN_ERR(selene_conf_session_ticket_key(p.sconf, NULL));
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 0);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 1);
+  SLN_ERR(selene_session_get(p.client, &again));
+  assert_int_equal(again->ticket_len, SLN_TICKET_LENGTH);
+  selene_session_destroy(again);
+  pair_disconnect(&p);
+
+  selene_session_destroy(session);
+  selene_conf_destroy(other);
+  free((void *)cert);
+  free((void *)pkey);
+  pair_destroy(&p);
+}
+
+/* A ticket offered without a session ID, the client learns the server took
+ * it from the ChangeCipherSpec, or NewSessionTicket, right after the
+ * ServerHello */
+static void loopback_ticket_no_id(void **state) {
+  pair_t p;
+  selene_session_t *session = NULL;
+  selene_session_t *again = NULL;
+
+  pair_confs(&p, 0);
+  SLN_ERR(selene_conf_session_tickets(p.sconf, 300));
+
+  pair_connect(&p, NULL);
+  SLN_ERR(selene_session_get(p.client, &session));
+  pair_disconnect(&p);
+  session->id_len = 0;
+  memset(session->id, 0, sizeof(session->id));
+
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 0);
+  pair_disconnect(&p);
+
+  /* renewed, the NewSessionTicket comes first */
+  SLN_ERR(selene_conf_session_ticket_key(p.sconf, NULL));
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  SLN_ERR(selene_session_get(p.client, &again));
+  assert_int_equal(again->ticket_len, SLN_TICKET_LENGTH);
+  assert_memory_not_equal(again->ticket, session->ticket,
+                          SLN_TICKET_KEY_NAME_LENGTH);
+  selene_session_destroy(again);
+  pair_disconnect(&p);
+
+  /* not taken, the Certificate comes instead */
+  SLN_ERR(selene_conf_session_ticket_key(p.sconf, NULL));
+  pair_connect(&p, session);
+  assert_int_equal(selene_session_resumed(p.server), 0);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  assert_int_equal(p.clientb.ecount[SELENE__EVENT_HS_GOT_CERTIFICATE], 1);
+  pair_disconnect(&p);
+
+  selene_session_destroy(session);
+  pair_destroy(&p);
+}
+
+static void loopback_client_cache(void **state) {
+  pair_t p;
+  size_t hits, misses;
+
+  pair_confs(&p, 1);
+  /* room for a single server */
+  SLN_ERR(selene_conf_client_session_cache(p.cconf, 1, 300));
+
+  /* nothing cached yet */
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  pair_disconnect(&p);
+
+  /* offered and resumed without the application doing anything */
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.server), 1);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  pair_disconnect(&p);
+
+  selene_conf_client_session_cache_stats(p.cconf, &hits, &misses);
+  assert_int_equal(hits, 1);
+  assert_int_equal(misses, 1);
+
+  /* another port of the same name is another server */
+  p.tag = "8443";
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  pair_disconnect(&p);
+
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.client), 1);
+  pair_disconnect(&p);
+
+  /* which took the only slot */
+  p.tag = NULL;
+  pair_connect(&p, NULL);
+  assert_int_equal(selene_session_resumed(p.client), 0);
+  pair_disconnect(&p);
+
+  selene_conf_client_session_cache_stats(p.cconf, &hits, &misses);
+  assert_int_equal(hits, 2);
+  assert_int_equal(misses, 3);
+
+  pair_destroy(&p);
+}
+
+static void count_release(void *baton) { (*(int *)baton)++; }
+
+/* Sends two and a bit records worth of a file from the client, which Selene
+ * reads, or maps, a record at a time as it seals them */
+static void loopback_file_type(void **state, int mapped) {
+  pair_t p;
+  char path[] = "/tmp/sln_loopback_XXXXXX";
+  char data[2 * 16384 + 100];
+  size_t len = sizeof(data) - 3;
+  int released = 0;
+  size_t i;
+  int fd;
+
+  for (i = 0; i < sizeof(data); i++) {
+    data[i] = i % 251;
+  }
+
+  fd = mkstemp(path);
+  assert_true(fd != -1);
+  unlink(path);
+  assert_int_equal(write(fd, data, sizeof(data)), sizeof(data));
+
+  pair_confs(&p, 0);
+  pair_connect(&p, NULL);
+  p.sclearlen = 0;
+
+  if (mapped) {
+    SLN_ERR(selene_io_in_clear_mmap(p.client, fd, 3, len, count_release,
+                                    &released));
+  } else {
+    SLN_ERR(selene_io_in_clear_file(p.client, fd, 3, len, count_release,
+                                    &released));
+  }
+
+  assert_int_equal(p.sclearlen, len);
+  assert_memory_equal(p.sclear, data + 3, len);
+  assert_int_equal(released, 1);
+
+  pair_disconnect(&p);
+  pair_destroy(&p);
+  close(fd);
+}
+
+static void loopback_file(void **state) { loopback_file_type(state, 0); }
+
+static void loopback_mmap(void **state) { loopback_file_type(state, 1); }
+
 SLN_TESTS_START(loopback)
 SLN_TESTS_ENTRY(loopback_basic)
+SLN_TESTS_ENTRY(loopback_handshake)
+SLN_TESTS_ENTRY(loopback_resume)
+SLN_TESTS_ENTRY(loopback_shared_cache)
+SLN_TESTS_ENTRY(loopback_external_cache)
+SLN_TESTS_ENTRY(loopback_ticket)
+SLN_TESTS_ENTRY(loopback_ticket_no_id)
+SLN_TESTS_ENTRY(loopback_client_cache)
+SLN_TESTS_ENTRY(loopback_file)
+SLN_TESTS_ENTRY(loopback_mmap)
 SLN_TESTS_END()
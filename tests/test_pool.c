@@ -0,0 +1,145 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "sln_tests.h"
+#include "sln_pool.h"
+#include "sln_buckets.h"
+#include <string.h>
+
+static void pool_create(void **state) {
+  sln_pool_t *pool;
+  SLN_ERR(sln_pool_create(sln_test_alloc, &pool));
+  sln_pool_destroy(pool);
+}
+
+static void pool_size_classes(void **state) {
+  assert_int_equal(0, sln_pool_size_class(1));
+  assert_int_equal(1, sln_pool_size_class(sizeof(sln_bucket_t)));
+  assert_int_equal(4, sln_pool_size_class(16384 + 2048));
+  assert_int_equal(-1, sln_pool_size_class(16384 + 2049));
+}
+
+static void pool_reuse(void **state) {
+  sln_pool_t *pool;
+  selene_alloc_t *alloc;
+  void *p1;
+  void *p2;
+
+  SLN_ERR(sln_pool_create(sln_test_alloc, &pool));
+  alloc = sln_pool_alloc(pool);
+
+  p1 = alloc->malloc(alloc->baton, 100);
+  assert_true(p1 != NULL);
+  assert_int_equal(1, pool->misses);
+  alloc->free(alloc->baton, p1);
+
+  /* same size class, served from the free list */
+  p2 = alloc->malloc(alloc->baton, 200);
+  assert_true(p1 == p2);
+  assert_int_equal(1, pool->hits);
+  assert_int_equal(1, pool->misses);
+
+  memset(p2, 'x', 200);
+  alloc->free(alloc->baton, p2);
+
+  p2 = alloc->calloc(alloc->baton, 200);
+  assert_true(p1 == p2);
+  assert_int_equal(0, ((char *)p2)[0]);
+  assert_int_equal(0, ((char *)p2)[199]);
+  alloc->free(alloc->baton, p2);
+
+  sln_pool_destroy(pool);
+}
+
+static void pool_huge(void **state) {
+  sln_pool_t *pool;
+  selene_alloc_t *alloc;
+  char *p;
+
+  SLN_ERR(sln_pool_create(sln_test_alloc, &pool));
+  alloc = sln_pool_alloc(pool);
+
+  p = alloc->malloc(alloc->baton, 100000);
+  assert_true(p != NULL);
+  p[99999] = 'x';
+  alloc->free(alloc->baton, p);
+
+  p = alloc->malloc(alloc->baton, 100000);
+  alloc->free(alloc->baton, p);
+  assert_int_equal(0, pool->hits);
+  assert_int_equal(2, pool->misses);
+
+  sln_pool_destroy(pool);
+}
+
+static void pool_max_free(void **state) {
+  size_t i;
+  sln_pool_t *pool;
+  selene_alloc_t *alloc;
+  void *p[64];
+  sln_pool_class_t *pc;
+
+  SLN_ERR(sln_pool_create(sln_test_alloc, &pool));
+  alloc = sln_pool_alloc(pool);
+  pc = &pool->classes[sln_pool_size_class(4096)];
+
+  for (i = 0; i < 64; i++) {
+    p[i] = alloc->malloc(alloc->baton, 4096);
+  }
+
+  for (i = 0; i < 64; i++) {
+    alloc->free(alloc->baton, p[i]);
+  }
+
+  assert_int_equal(pc->max_free, pc->nfree);
+
+  sln_pool_destroy(pool);
+}
+
+static void pool_buckets(void **state) {
+  int i;
+  sln_pool_t *pool;
+  sln_bucket_t *e;
+  size_t misses;
+
+  SLN_ERR(sln_pool_create(sln_test_alloc, &pool));
+
+  SLN_ERR(sln_bucket_create_empty(sln_pool_alloc(pool), &e, 16384));
+  sln_bucket_destroy(e);
+  misses = pool->misses;
+
+  for (i = 0; i < 100; i++) {
+    SLN_ERR(sln_bucket_create_empty(sln_pool_alloc(pool), &e, 16384));
+    memset(e->data, 'x', 16384);
+    sln_bucket_destroy(e);
+  }
+
+  assert_int_equal(misses, pool->misses);
+  assert_int_equal(200, pool->hits);
+
+  sln_pool_destroy(pool);
+}
+
+SLN_TESTS_START(pool)
+SLN_TESTS_ENTRY(pool_create)
+SLN_TESTS_ENTRY(pool_size_classes)
+SLN_TESTS_ENTRY(pool_reuse)
+SLN_TESTS_ENTRY(pool_huge)
+SLN_TESTS_ENTRY(pool_max_free)
+SLN_TESTS_ENTRY(pool_buckets)
+SLN_TESTS_END()
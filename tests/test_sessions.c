@@ -0,0 +1,321 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "sln_tests.h"
+#include "sln_sessions.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static void make_session(selene_session_t *session, char id, int64_t created) {
+  memset(session, 0, sizeof(*session));
+  session->id_len = 32;
+  memset(session->id, id, session->id_len);
+  memset(session->master_secret, id + 1, sizeof(session->master_secret));
+  session->suite = SELENE_CS_RSA_WITH_AES_128_CBC_SHA;
+  session->version_major = 3;
+  session->version_minor = 1;
+  session->created = created;
+}
+
+static void sessions_put_get(void **state) {
+  sln_session_cache_t *cache;
+  selene_session_t session;
+  selene_session_t got;
+  size_t hits, misses, evictions;
+
+  SLN_ERR(sln_session_cache_create(sln_test_alloc, 4, 60, &cache));
+
+  make_session(&session, 'a', 100);
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 110, &got));
+  assert_memory_equal(got.master_secret, session.master_secret,
+                      sizeof(session.master_secret));
+  assert_int_equal(got.suite, SELENE_CS_RSA_WITH_AES_128_CBC_SHA);
+
+  /* only the full ID matches */
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 31, 110, &got));
+
+  /* storing the same ID again replaces the entry */
+  session.suite = SELENE_CS_RSA_WITH_AES_256_CBC_SHA;
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 110, &got));
+  assert_int_equal(got.suite, SELENE_CS_RSA_WITH_AES_256_CBC_SHA);
+
+  sln_session_cache_remove(cache, session.id, 32);
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 32, 110, &got));
+
+  sln_session_cache_stats(cache, &hits, &misses, &evictions);
+  assert_int_equal(2, hits);
+  assert_int_equal(2, misses);
+  assert_int_equal(0, evictions);
+
+  sln_session_cache_destroy(cache);
+}
+
+static void sessions_expire(void **state) {
+  sln_session_cache_t *cache;
+  selene_session_t session;
+  selene_session_t got;
+
+  SLN_ERR(sln_session_cache_create(sln_test_alloc, 4, 60, &cache));
+
+  make_session(&session, 'a', 100);
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 159, &got));
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 32, 160, &got));
+  /* and stays gone */
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 32, 100, &got));
+
+  sln_session_cache_destroy(cache);
+}
+
+static void sessions_evict(void **state) {
+  sln_session_cache_t *cache;
+  selene_session_t session;
+  selene_session_t got;
+  size_t hits, misses, evictions;
+  char id;
+
+  SLN_ERR(sln_session_cache_create(sln_test_alloc, 3, 60, &cache));
+
+  for (id = 'a'; id <= 'c'; id++) {
+    make_session(&session, id, 100);
+    sln_session_cache_put(cache, session.id, session.id_len, &session);
+  }
+
+  /* a session in use survives the next sweep */
+  make_session(&session, 'a', 100);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 100, &got));
+
+  make_session(&session, 'd', 100);
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+
+  make_session(&session, 'a', 100);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 100, &got));
+  make_session(&session, 'b', 100);
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 32, 100, &got));
+  make_session(&session, 'c', 100);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 100, &got));
+  make_session(&session, 'd', 100);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 100, &got));
+
+  sln_session_cache_stats(cache, &hits, &misses, &evictions);
+  assert_int_equal(1, evictions);
+
+  sln_session_cache_destroy(cache);
+}
+
+static void sessions_invalid(void **state) {
+  sln_session_cache_t *cache = NULL;
+  selene_error_t *err;
+
+  err = sln_session_cache_create(sln_test_alloc, 0, 60, &cache);
+  assert_true(err != NULL);
+  assert_int_equal(SELENE_EINVAL, err->err);
+  selene_error_clear(err);
+  assert_true(cache == NULL);
+}
+
+static void sessions_shared_put_get(void **state) {
+  sln_session_cache_t *cache;
+  selene_session_t session;
+  selene_session_t got;
+  size_t hits, misses, evictions;
+
+  SLN_ERR(sln_session_cache_create_shared(sln_test_alloc, 100, 60, NULL,
+                                          &cache));
+
+  make_session(&session, 'a', 100);
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 110, &got));
+  assert_memory_equal(got.master_secret, session.master_secret,
+                      sizeof(session.master_secret));
+  assert_true(got.alloc == NULL);
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 31, 110, &got));
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 32, 160, &got));
+
+  session.suite = SELENE_CS_RSA_WITH_AES_256_CBC_SHA;
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 110, &got));
+  assert_int_equal(got.suite, SELENE_CS_RSA_WITH_AES_256_CBC_SHA);
+
+  sln_session_cache_remove(cache, session.id, 32);
+  assert_int_equal(0, sln_session_cache_get(cache, session.id, 32, 110, &got));
+
+  sln_session_cache_stats(cache, &hits, &misses, &evictions);
+  assert_int_equal(2, hits);
+  assert_int_equal(3, misses);
+  assert_int_equal(0, evictions);
+
+  sln_session_cache_destroy(cache);
+}
+
+static void sessions_shared_evict(void **state) {
+  sln_session_cache_t *cache;
+  selene_session_t session;
+  selene_session_t got;
+  size_t hits, misses, evictions;
+  char id;
+
+  /* a single shard of 8 slots */
+  SLN_ERR(sln_session_cache_create_shared(sln_test_alloc, 8, 60, NULL,
+                                          &cache));
+
+  for (id = 'a'; id <= 'h'; id++) {
+    make_session(&session, id, 100);
+    sln_session_cache_put(cache, session.id, session.id_len, &session);
+  }
+
+  make_session(&session, 'a', 100);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 100, &got));
+
+  make_session(&session, 'i', 100);
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+
+  for (id = 'a'; id <= 'i'; id++) {
+    make_session(&session, id, 100);
+    assert_int_equal(id != 'b', sln_session_cache_get(cache, session.id, 32,
+                                                      100, &got));
+  }
+
+  sln_session_cache_stats(cache, &hits, &misses, &evictions);
+  assert_int_equal(1, evictions);
+
+  sln_session_cache_destroy(cache);
+}
+
+static void sessions_shared_fork(void **state) {
+  sln_session_cache_t *cache;
+  selene_session_t session;
+  selene_session_t got;
+  size_t hits, misses, evictions;
+  int status;
+  pid_t pid;
+
+  SLN_ERR(sln_session_cache_create_shared(sln_test_alloc, 100, 60, NULL,
+                                          &cache));
+
+  pid = fork();
+  assert_true(pid != -1);
+
+  if (pid == 0) {
+    make_session(&session, 'a', 100);
+    sln_session_cache_put(cache, session.id, session.id_len, &session);
+    _exit(0);
+  }
+
+  assert_int_equal(pid, waitpid(pid, &status, 0));
+  assert_int_equal(0, status);
+
+  make_session(&session, 'a', 100);
+  assert_int_equal(1, sln_session_cache_get(cache, session.id, 32, 110, &got));
+  assert_memory_equal(got.master_secret, session.master_secret,
+                      sizeof(session.master_secret));
+
+  sln_session_cache_stats(cache, &hits, &misses, &evictions);
+  assert_int_equal(1, hits);
+
+  sln_session_cache_destroy(cache);
+}
+
+static void sessions_shared_file(void **state) {
+  sln_session_cache_t *cache;
+  sln_session_cache_t *again;
+  selene_session_t session;
+  selene_session_t got;
+  selene_error_t *err;
+  char path[] = "/tmp/sln_sessions_XXXXXX";
+  int fd;
+
+  fd = mkstemp(path);
+  assert_true(fd != -1);
+  close(fd);
+
+  SLN_ERR(sln_session_cache_create_shared(sln_test_alloc, 100, 60, path,
+                                          &cache));
+  make_session(&session, 'a', 100);
+  sln_session_cache_put(cache, session.id, session.id_len, &session);
+
+  SLN_ERR(sln_session_cache_create_shared(sln_test_alloc, 100, 60, path,
+                                          &again));
+  assert_int_equal(1, sln_session_cache_get(again, session.id, 32, 110, &got));
+  sln_session_cache_destroy(again);
+
+  /* laid out for 100 sessions */
+  err = sln_session_cache_create_shared(sln_test_alloc, 1000, 60, path,
+                                        &again);
+  assert_true(err != NULL);
+  assert_int_equal(SELENE_EINVAL, err->err);
+  selene_error_clear(err);
+
+  sln_session_cache_destroy(cache);
+  unlink(path);
+}
+
+static void sessions_export(void **state) {
+  selene_session_t session;
+  selene_session_t *got = NULL;
+  selene_conf_t *conf = NULL;
+  selene_error_t *err;
+  char buf[SELENE_SESSION_EXPORT_LENGTH];
+  size_t len = 0;
+
+  SLN_ERR(selene_conf_create(&conf));
+
+  make_session(&session, 'a', (int64_t)1234567890 * 1000);
+  SLN_ERR(selene_session_export(&session, buf, &len));
+  assert_int_equal(SELENE_SESSION_EXPORT_LENGTH, len);
+
+  SLN_ERR(selene_session_import(conf, buf, len, &got));
+  assert_int_equal(got->id_len, 32);
+  assert_memory_equal(got->id, session.id, 32);
+  assert_memory_equal(got->master_secret, session.master_secret,
+                      sizeof(session.master_secret));
+  assert_int_equal(got->suite, session.suite);
+  assert_int_equal(got->version_major, 3);
+  assert_int_equal(got->version_minor, 1);
+  assert_true(got->created == session.created);
+  selene_session_destroy(got);
+
+  /* truncated */
+  got = NULL;
+  err = selene_session_import(conf, buf, len - 1, &got);
+  assert_true(err != NULL);
+  assert_int_equal(SELENE_EINVAL, err->err);
+  selene_error_clear(err);
+  assert_true(got == NULL);
+
+  selene_conf_destroy(conf);
+}
+
+SLN_TESTS_START(sessions)
+SLN_TESTS_ENTRY(sessions_put_get)
+SLN_TESTS_ENTRY(sessions_expire)
+SLN_TESTS_ENTRY(sessions_evict)
+SLN_TESTS_ENTRY(sessions_invalid)
+SLN_TESTS_ENTRY(sessions_shared_put_get)
+SLN_TESTS_ENTRY(sessions_shared_evict)
+SLN_TESTS_ENTRY(sessions_shared_fork)
+SLN_TESTS_ENTRY(sessions_shared_file)
+SLN_TESTS_ENTRY(sessions_export)
+SLN_TESTS_END()
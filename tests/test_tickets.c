@@ -0,0 +1,169 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "selene_conf.h"
+#include "sln_tests.h"
+#include "sln_tickets.h"
+#include <string.h>
+
+static void make_session(selene_session_t *session, int64_t created) {
+  memset(session, 0, sizeof(*session));
+  memset(session->master_secret, 'm', sizeof(session->master_secret));
+  session->suite = SELENE_CS_RSA_WITH_AES_256_CBC_SHA;
+  session->version_major = 3;
+  session->version_minor = 2;
+  session->created = created;
+}
+
+static void tickets_seal_open(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  selene_session_t session;
+  selene_session_t got;
+  char ticket[SLN_TICKET_LENGTH];
+  int valid;
+  int renew;
+
+  SLN_ERR(selene_conf_create(&conf));
+  SLN_ERR(selene_conf_session_tickets(conf, 60));
+  SLN_ERR(selene_server_create(conf, &s));
+
+  make_session(&session, 100);
+  SLN_ERR(sln_ticket_seal(s, &session, ticket));
+
+  /* nothing of the session shows through */
+  assert_memory_not_equal(
+      ticket + SLN_TICKET_KEY_NAME_LENGTH + SLN_AEAD_NONCE_LENGTH + 12,
+      session.master_secret, sizeof(session.master_secret));
+
+  SLN_ERR(sln_ticket_open(s, ticket, sizeof(ticket), 110, &got, &valid,
+                          &renew));
+  assert_int_equal(1, valid);
+  assert_int_equal(0, renew);
+  assert_int_equal(session.suite, got.suite);
+  assert_int_equal(3, got.version_major);
+  assert_int_equal(2, got.version_minor);
+  assert_int_equal(100, got.created);
+  assert_memory_equal(session.master_secret, got.master_secret,
+                      sizeof(got.master_secret));
+
+  /* expired */
+  SLN_ERR(sln_ticket_open(s, ticket, sizeof(ticket), 160, &got, &valid,
+                          &renew));
+  assert_int_equal(0, valid);
+
+  /* cut short */
+  SLN_ERR(sln_ticket_open(s, ticket, sizeof(ticket) - 1, 110, &got, &valid,
+                          &renew));
+  assert_int_equal(0, valid);
+
+  /* tampered with */
+  ticket[SLN_TICKET_KEY_NAME_LENGTH + SLN_AEAD_NONCE_LENGTH] ^= 1;
+  SLN_ERR(sln_ticket_open(s, ticket, sizeof(ticket), 110, &got, &valid,
+                          &renew));
+  assert_int_equal(0, valid);
+
+  selene_destroy(s);
+  selene_conf_destroy(conf);
+}
+
+static void tickets_rotate(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_conf_t *other = NULL;
+  selene_t *s = NULL;
+  selene_t *o = NULL;
+  selene_session_t session;
+  selene_session_t got;
+  char key[SELENE_SESSION_TICKET_KEY_LENGTH];
+  char ticket[SLN_TICKET_LENGTH];
+  int valid;
+  int renew;
+
+  memset(key, 'k', sizeof(key));
+
+  SLN_ERR(selene_conf_create(&conf));
+  SLN_ERR(selene_conf_session_ticket_key(conf, key));
+  SLN_ERR(selene_conf_session_tickets(conf, 60));
+  SLN_ERR(selene_server_create(conf, &s));
+
+  /* another server with the same key */
+  SLN_ERR(selene_conf_create(&other));
+  SLN_ERR(selene_conf_session_ticket_key(other, key));
+  SLN_ERR(selene_conf_session_tickets(other, 60));
+  SLN_ERR(selene_server_create(other, &o));
+
+  make_session(&session, 100);
+  SLN_ERR(sln_ticket_seal(s, &session, ticket));
+
+  SLN_ERR(sln_ticket_open(o, ticket, sizeof(ticket), 110, &got, &valid,
+                          &renew));
+  assert_int_equal(1, valid);
+
+  /* the previous key still opens it, and asks for a new ticket */
+  SLN_ERR(selene_conf_session_ticket_key(conf, NULL));
+  SLN_ERR(sln_ticket_open(s, ticket, sizeof(ticket), 110, &got, &valid,
+                          &renew));
+  assert_int_equal(1, valid);
+  assert_int_equal(1, renew);
+
+  SLN_ERR(selene_conf_session_ticket_key(conf, NULL));
+  SLN_ERR(sln_ticket_open(s, ticket, sizeof(ticket), 110, &got, &valid,
+                          &renew));
+  assert_int_equal(0, valid);
+
+  /* with nobody reading, the replaced generations are gone */
+  assert_true(conf->ticket_keys->older == NULL);
+  assert_int_equal(0, conf->ticket_readers);
+
+  /* one still reading keeps them, until a later rotation finds it gone */
+  conf->ticket_readers++;
+  SLN_ERR(selene_conf_session_ticket_key(conf, NULL));
+  assert_true(conf->ticket_keys->older != NULL);
+  conf->ticket_readers--;
+  SLN_ERR(selene_conf_session_ticket_key(conf, NULL));
+  assert_true(conf->ticket_keys->older == NULL);
+
+  selene_destroy(s);
+  selene_destroy(o);
+  selene_conf_destroy(conf);
+  selene_conf_destroy(other);
+}
+
+static void tickets_invalid(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_error_t *err;
+
+  SLN_ERR(selene_conf_create(&conf));
+
+  err = selene_conf_session_tickets(conf, -1);
+  assert_true(err != NULL);
+  assert_int_equal(SELENE_EINVAL, err->err);
+  selene_error_clear(err);
+
+  /* off until asked for */
+  SLN_ERR(selene_conf_session_tickets(conf, 0));
+  assert_true(conf->ticket_keys == NULL);
+
+  selene_conf_destroy(conf);
+}
+
+SLN_TESTS_START(tickets)
+SLN_TESTS_ENTRY(tickets_seal_open)
+SLN_TESTS_ENTRY(tickets_rotate)
+SLN_TESTS_ENTRY(tickets_invalid)
+SLN_TESTS_END()
@@ -18,6 +18,7 @@
 #include "selene.h"
 #include "sln_tests.h"
 #include "sln_tok.h"
+#include "sln_stitched.h"
 #include <string.h>
 #include <stdio.h>
 #include "../lib/parser/parser.h"
@@ -164,8 +165,381 @@ static void tls_v2_hello(void **state) {
   destroy_ctxt(state, s, conf);
 }
 
+static void tls_io_demux_application(void **state) {
+  sln_parser_baton_t *baton;
+  selene_conf_t *conf = NULL;
+  selene_t *s = NULL;
+  sln_bucket_t *e1;
+  const char *base;
+  char buf[16];
+  size_t len = sizeof(buf);
+  /* two application records and the start of a third in one read */
+  const char records[] = {0x17, 0x03, 0x01, 0x00, 0x03, 'a',  'b',  'c',
+                          0x17, 0x03, 0x01, 0x00, 0x02, 'd',  'e',  0x17,
+                          0x03, 0x01, 0x00, 0x02, 'f'};
+
+  init_ctxt(state, &s, &conf);
+
+  baton = (sln_parser_baton_t *)s->backend_baton;
+
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e1, records,
+                                       sizeof(records)));
+  base = e1->data;
+  SLN_BRIGADE_INSERT_TAIL(s->bb.in_enc, e1);
+  SLN_ERR(sln_io_tls_read(s, baton));
+
+  /* the payloads are slices of the bucket that was read */
+  assert_int_equal(sln_brigade_size(baton->in_application), 5);
+  assert_int_equal(sln_brigade_bucket_count(baton->in_application), 2);
+  assert_true(SLN_BRIGADE_FIRST(baton->in_application)->data == base + 5);
+  assert_int_equal(sln_brigade_size(s->bb.in_enc), 6);
+
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e1, "g", 1));
+  SLN_BRIGADE_INSERT_TAIL(s->bb.in_enc, e1);
+  SLN_ERR(sln_io_tls_read(s, baton));
+  assert_true(SLN_BRIGADE_EMPTY(s->bb.in_enc));
+
+  SLN_ERR(sln_brigade_flatten(baton->in_application, &buf[0], &len));
+  assert_int_equal(len, 7);
+  assert_memory_equal(buf, "abcdefg", 7);
+
+  destroy_ctxt(state, s, conf);
+}
+
+/* A client and a server sharing a master secret, each with suite set up in
+ * both directions, and workers record decryption threads.  Returns 0 if
+ * this OpenSSL has the cipher disabled. */
+static int init_keyed_pair_workers(void **state, selene_cipher_suite_e suite,
+                                   int explicit_iv, int workers,
+                                   selene_conf_t **conf_, selene_t **client_,
+                                   selene_t **server_) {
+  selene_t *ss[2] = {NULL, NULL};
+  sln_parser_baton_t *baton;
+  selene_conf_t *conf = NULL;
+  selene_error_t *err;
+  int i;
+
+  selene_conf_create(&conf);
+  SLN_ERR(selene_conf_use_reasonable_defaults(conf));
+  SLN_ERR(selene_conf_record_workers(conf, workers));
+  SLN_ERR(selene_client_create(conf, &ss[0]));
+  SLN_ERR(selene_server_create(conf, &ss[1]));
+
+  for (i = 0; i < 2; i++) {
+    baton = (sln_parser_baton_t *)ss[i]->backend_baton;
+    memset(baton->master_secret, 'm', sizeof(baton->master_secret));
+    memset(baton->client_random_bytes, 'c', sizeof(baton->client_random_bytes));
+    memset(baton->server_random_bytes, 's', sizeof(baton->server_random_bytes));
+    err = sln_tls_params_init(ss[i], suite);
+    if (err && err->err == SELENE_ENOTIMPL) {
+      selene_error_clear(err);
+      selene_destroy(ss[0]);
+      selene_destroy(ss[1]);
+      selene_conf_destroy(conf);
+      return 0;
+    }
+    SLN_ERR(err);
+    baton->pending_send_parameters.explicit_iv = explicit_iv;
+    baton->pending_recv_parameters.explicit_iv = explicit_iv;
+    sln_tls_params_activate_send(ss[i]);
+    sln_tls_params_activate_recv(ss[i]);
+  }
+
+  *conf_ = conf;
+  *client_ = ss[0];
+  *server_ = ss[1];
+
+  return 1;
+}
+
+static int init_keyed_pair(void **state, selene_cipher_suite_e suite,
+                           int explicit_iv, selene_conf_t **conf_,
+                           selene_t **client_, selene_t **server_) {
+  return init_keyed_pair_workers(state, suite, explicit_iv, 0, conf_, client_,
+                                 server_);
+}
+
+static void tls_record_roundtrip_suite(void **state,
+                                       selene_cipher_suite_e suite,
+                                       int explicit_iv, size_t expect_first) {
+  selene_conf_t *conf = NULL;
+  selene_t *client = NULL;
+  selene_t *server = NULL;
+  sln_parser_baton_t *sbaton;
+  sln_bucket_t *e;
+  char in[20000];
+  char out[20000];
+  size_t len;
+  size_t i;
+  int round;
+
+  if (!init_keyed_pair(state, suite, explicit_iv, &conf, &client, &server)) {
+    /* RC4 is only in OpenSSL 3's legacy provider */
+    return;
+  }
+  sbaton = (sln_parser_baton_t *)server->backend_baton;
+
+  for (i = 0; i < sizeof(in); i++) {
+    in[i] = i % 251;
+  }
+
+  /* twice, the second time on running sequence numbers and CBC state */
+  for (round = 0; round < 2; round++) {
+    SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, in, sizeof(in)));
+    SLN_BRIGADE_INSERT_TAIL(client->bb.in_cleartext, e);
+    SLN_ERR(sln_io_tls_write_appdata(client, client->backend_baton));
+
+    /* one bucket per record, encrypted where it was framed */
+    assert_int_equal(2, sln_brigade_bucket_count(client->bb.out_enc));
+    e = SLN_BRIGADE_FIRST(client->bb.out_enc);
+    assert_int_equal(expect_first, e->size);
+    assert_int_equal(0x17, e->data[0]);
+    assert_int_equal((expect_first - 5) >> 8, (unsigned char)e->data[3]);
+    assert_int_equal((expect_first - 5) & 0xFF, (unsigned char)e->data[4]);
+    assert_true(memcmp(e->data + 5, in, 64) != 0);
+
+    SLN_BRIGADE_CONCAT(server->bb.in_enc, client->bb.out_enc);
+    SLN_ERR(sln_io_tls_read(server, sbaton));
+    assert_true(SLN_BRIGADE_EMPTY(server->bb.in_enc));
+
+    len = sizeof(out);
+    SLN_ERR(sln_brigade_flatten(sbaton->in_application, out, &len));
+    assert_int_equal(sizeof(in), len);
+    assert_memory_equal(in, out, sizeof(in));
+  }
+
+  selene_destroy(client);
+  selene_destroy(server);
+  selene_conf_destroy(conf);
+}
+
+static void tls_record_roundtrip(void **state) {
+  /* header, 16384 bytes of data, a SHA1 MAC, and padding to a block */
+  tls_record_roundtrip_suite(state, SELENE_CS_RSA_WITH_RC4_128_SHA, 0,
+                             5 + 16384 + 20);
+  tls_record_roundtrip_suite(state, SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 0,
+                             5 + 16384 + 20 + 12);
+  tls_record_roundtrip_suite(state, SELENE_CS_RSA_WITH_AES_256_CBC_SHA, 0,
+                             5 + 16384 + 20 + 12);
+  tls_record_roundtrip_suite(state, SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 1,
+                             5 + 16 + 16384 + 20 + 12);
+  /* header, the explicit part of the nonce, data, and the tag */
+  tls_record_roundtrip_suite(state, SELENE_CS_RSA_WITH_AES_128_GCM_SHA256, 0,
+                             5 + 8 + 16384 + 16);
+  tls_record_roundtrip_suite(state, SELENE_CS_RSA_WITH_AES_256_GCM_SHA384, 0,
+                             5 + 8 + 16384 + 16);
+}
+
+/* Records sealed in one pass open with separate MAC and cipher contexts, and
+ * the other way around */
+static void tls_record_stitched_interop(void **state) {
+  selene_conf_t *conf = NULL;
+  selene_t *client = NULL;
+  selene_t *server = NULL;
+  sln_parser_baton_t *cbaton;
+  sln_parser_baton_t *sbaton;
+  sln_params_t *p;
+  sln_bucket_t *e;
+  char in[1000];
+  char out[1000];
+  size_t len;
+  int side;
+  int round;
+
+  memset(in, 'x', sizeof(in));
+
+  for (side = 0; side < 2; side++) {
+    assert_true(init_keyed_pair(state, SELENE_CS_RSA_WITH_AES_256_CBC_SHA, 0,
+                                &conf, &client, &server));
+    cbaton = (sln_parser_baton_t *)client->backend_baton;
+    sbaton = (sln_parser_baton_t *)server->backend_baton;
+
+    if (cbaton->active_send_parameters.stitched == NULL) {
+      /* no AES-NI */
+      selene_destroy(client);
+      selene_destroy(server);
+      selene_conf_destroy(conf);
+      return;
+    }
+
+    p = side ? &cbaton->active_send_parameters
+             : &sbaton->active_recv_parameters;
+    sln_stitched_destroy(p->stitched);
+    p->stitched = NULL;
+
+    for (round = 0; round < 3; round++) {
+      SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, in,
+                                           sizeof(in) - round));
+      SLN_BRIGADE_INSERT_TAIL(client->bb.in_cleartext, e);
+      SLN_ERR(sln_io_tls_write_appdata(client, cbaton));
+
+      SLN_BRIGADE_CONCAT(server->bb.in_enc, client->bb.out_enc);
+      SLN_ERR(sln_io_tls_read(server, sbaton));
+
+      len = sizeof(out);
+      SLN_ERR(sln_brigade_flatten(sbaton->in_application, out, &len));
+      assert_int_equal(sizeof(in) - round, len);
+      assert_memory_equal(in, out, len);
+    }
+
+    selene_destroy(client);
+    selene_destroy(server);
+    selene_conf_destroy(conf);
+  }
+}
+
+/* Records that arrive together are opened on the workers, and come out in
+ * order; nothing after a bad one does */
+static void tls_record_parallel_suite(void **state, selene_cipher_suite_e suite,
+                                      int explicit_iv) {
+  selene_error_t *err;
+  selene_conf_t *conf = NULL;
+  selene_t *client = NULL;
+  selene_t *server = NULL;
+  sln_parser_baton_t *sbaton;
+  sln_bucket_t *e;
+  char in[22 * 1000];
+  char out[22 * 1000];
+  size_t len;
+  size_t i;
+  int tamper;
+  int ntamper;
+
+  for (i = 0; i < sizeof(in); i++) {
+    in[i] = i % 251;
+  }
+
+  /* untouched, a flipped data byte, and for CBC a flipped padding length */
+  ntamper = suite == SELENE_CS_RSA_WITH_AES_128_GCM_SHA256 ? 2 : 3;
+  for (tamper = 0; tamper < ntamper; tamper++) {
+    assert_true(init_keyed_pair_workers(state, suite, explicit_iv, 3, &conf,
+                                        &client, &server));
+    sbaton = (sln_parser_baton_t *)server->backend_baton;
+
+    /* a record that goes through on its own first, then 20 together */
+    for (i = 0; i < 21; i++) {
+      SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, in + (i * 1000),
+                                           i == 0 ? 1 : 1000));
+      SLN_BRIGADE_INSERT_TAIL(client->bb.in_cleartext, e);
+      SLN_ERR(sln_io_tls_write_appdata(client, client->backend_baton));
+
+      if (tamper && i == 12) {
+        e = SLN_BRIGADE_LAST(client->bb.out_enc);
+        e->data[tamper == 1 ? 100 : e->size - 17] ^= 0x01;
+      }
+
+      if (i == 0) {
+        SLN_BRIGADE_CONCAT(server->bb.in_enc, client->bb.out_enc);
+        SLN_ERR(sln_io_tls_read(server, sbaton));
+        sln_brigade_clear(sbaton->in_application);
+      }
+    }
+
+    SLN_BRIGADE_CONCAT(server->bb.in_enc, client->bb.out_enc);
+    err = sln_io_tls_read(server, sbaton);
+
+    if (!tamper) {
+      SLN_ERR(err);
+      /* one more on its own, carrying on from the end of the batch */
+      SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, in + 21000,
+                                           1000));
+      SLN_BRIGADE_INSERT_TAIL(client->bb.in_cleartext, e);
+      SLN_ERR(sln_io_tls_write_appdata(client, client->backend_baton));
+      SLN_BRIGADE_CONCAT(server->bb.in_enc, client->bb.out_enc);
+      err = sln_io_tls_read(server, sbaton);
+    }
+
+    len = sizeof(out);
+    SLN_ERR(sln_brigade_flatten(sbaton->in_application, out, &len));
+    if (tamper) {
+      SLN_ASSERT(err != NULL);
+      assert_int_equal(SELENE_EINVAL, err->err);
+      selene_error_clear(err);
+      assert_int_equal(11 * 1000, len);
+    } else {
+      SLN_ERR(err);
+      assert_int_equal(21 * 1000, len);
+      assert_true(SLN_BRIGADE_EMPTY(server->bb.in_enc));
+      /* the lanes are only set up by the parallel path */
+      assert_true(sbaton->active_recv_parameters.lanes != NULL);
+    }
+    assert_memory_equal(in + 1000, out, len);
+
+    selene_destroy(client);
+    selene_destroy(server);
+    selene_conf_destroy(conf);
+  }
+}
+
+static void tls_record_parallel(void **state) {
+  tls_record_parallel_suite(state, SELENE_CS_RSA_WITH_AES_128_GCM_SHA256, 0);
+  /* chained on from the record before, and with explicit IVs */
+  tls_record_parallel_suite(state, SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 0);
+  tls_record_parallel_suite(state, SELENE_CS_RSA_WITH_AES_256_CBC_SHA, 1);
+}
+
+/* pad flips the padding length of a CBC record instead of a byte of its
+ * data, and two_pass opens it without the stitched context */
+static void tls_record_tampered_suite(void **state,
+                                      selene_cipher_suite_e suite, int pad,
+                                      int two_pass) {
+  selene_error_t *err;
+  selene_conf_t *conf = NULL;
+  selene_t *client = NULL;
+  selene_t *server = NULL;
+  sln_parser_baton_t *sbaton;
+  sln_bucket_t *e;
+
+  assert_true(init_keyed_pair(state, suite, 0, &conf, &client, &server));
+  sbaton = (sln_parser_baton_t *)server->backend_baton;
+
+  if (two_pass && sbaton->active_recv_parameters.stitched != NULL) {
+    sln_stitched_destroy(sbaton->active_recv_parameters.stitched);
+    sbaton->active_recv_parameters.stitched = NULL;
+  }
+
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e, "hello world", 11));
+  SLN_BRIGADE_INSERT_TAIL(client->bb.in_cleartext, e);
+  SLN_ERR(sln_io_tls_write_appdata(client, client->backend_baton));
+
+  e = SLN_BRIGADE_FIRST(client->bb.out_enc);
+  if (pad) {
+    /* CBC carries the flip over to the last byte of the next block */
+    e->data[e->size - 17] ^= 0x01;
+  } else {
+    e->data[8] ^= 0x01;
+  }
+
+  SLN_BRIGADE_CONCAT(server->bb.in_enc, client->bb.out_enc);
+  err = sln_io_tls_read(server, sbaton);
+  SLN_ASSERT(err != NULL);
+  assert_int_equal(SELENE_EINVAL, err->err);
+  selene_error_clear(err);
+
+  /* and the peer is told about it */
+  assert_int_equal(1, sln_brigade_bucket_count(server->bb.out_enc));
+
+  selene_destroy(client);
+  selene_destroy(server);
+  selene_conf_destroy(conf);
+}
+
+static void tls_record_tampered(void **state) {
+  tls_record_tampered_suite(state, SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 0, 0);
+  tls_record_tampered_suite(state, SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 0, 1);
+  tls_record_tampered_suite(state, SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 1, 0);
+  tls_record_tampered_suite(state, SELENE_CS_RSA_WITH_AES_128_CBC_SHA, 1, 1);
+  tls_record_tampered_suite(state, SELENE_CS_RSA_WITH_AES_128_GCM_SHA256, 0,
+                            0);
+}
+
 SLN_TESTS_START(tls_io)
 SLN_TESTS_ENTRY(tls_io_slowly)
 SLN_TESTS_ENTRY(tls_http_accident)
 SLN_TESTS_ENTRY(tls_v2_hello)
+SLN_TESTS_ENTRY(tls_io_demux_application)
+SLN_TESTS_ENTRY(tls_record_roundtrip)
+SLN_TESTS_ENTRY(tls_record_stitched_interop)
+SLN_TESTS_ENTRY(tls_record_parallel)
+SLN_TESTS_ENTRY(tls_record_tampered)
 SLN_TESTS_END()
@@ -105,8 +105,105 @@ static void tok_copy_brigade(void **state) {
   sln_brigade_destroy(bb);
 }
 
+static selene_error_t *tok_resume_cb(sln_tok_value_t *v, void *baton_) {
+  baton_t *baton = (baton_t *)baton_;
+  char buf[6];
+  size_t len = sizeof(buf);
+
+  switch (baton->count) {
+    case 0:
+      v->next = TOK_UINT16;
+      v->wantlen = 2;
+      break;
+    case 1:
+      assert_int_equal(6, v->v.uint16);
+      v->next = TOK_COPY_BRIGADE;
+      v->wantlen = v->v.uint16;
+      break;
+    case 2:
+      SLN_ERR(sln_brigade_flatten(v->v.bb, &buf[0], &len));
+      assert_int_equal(6, len);
+      assert_memory_equal(buf, "abcdef", 6);
+      v->next = TOK_UINT24;
+      v->wantlen = 3;
+      break;
+    case 3:
+      assert_int_equal(0x010203, v->v.uint24);
+      v->next = TOK_DONE;
+      v->wantlen = 0;
+      break;
+  }
+  baton->count++;
+  return SELENE_SUCCESS;
+}
+
+static const char tok_resume_input[] = {0x00, 0x06, 'a',  'b',  'c', 'd',
+                                        'e',  'f',  0x01, 0x02, 0x03};
+
+static void tok_resume_whole(void **state) {
+  sln_brigade_t *bb;
+  sln_bucket_t *e1;
+  sln_tok_parser_t tok;
+  baton_t baton;
+  baton.count = 0;
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e1, tok_resume_input,
+                                       sizeof(tok_resume_input)));
+  SLN_BRIGADE_INSERT_TAIL(bb, e1);
+
+  sln_tok_parser_init(&tok);
+  SLN_ERR(sln_tok_parser_resume(&tok, bb, tok_resume_cb, &baton));
+  assert_true(sln_tok_parser_done(&tok));
+  assert_int_equal(4, tok.steps);
+  assert_int_equal(4, baton.count);
+  assert_int_equal(sizeof(tok_resume_input), tok.offset);
+
+  sln_tok_parser_destroy(&tok);
+  sln_brigade_destroy(bb);
+}
+
+static void tok_resume_bytewise(void **state) {
+  size_t i;
+  sln_brigade_t *bb;
+  sln_bucket_t *e1;
+  sln_tok_parser_t tok;
+  baton_t baton;
+  baton.count = 0;
+
+  SLN_ERR(sln_brigade_create(sln_test_alloc, &bb));
+  sln_tok_parser_init(&tok);
+
+  for (i = 0; i < sizeof(tok_resume_input); i++) {
+    assert_false(sln_tok_parser_done(&tok));
+    SLN_ERR(sln_bucket_create_copy_bytes(sln_test_alloc, &e1,
+                                         tok_resume_input + i, 1));
+    SLN_BRIGADE_INSERT_TAIL(bb, e1);
+    SLN_ERR(sln_tok_parser_resume(&tok, bb, tok_resume_cb, &baton));
+  }
+
+  /* every token is handed to the callback once, no matter how the input
+   * was split up */
+  assert_true(sln_tok_parser_done(&tok));
+  assert_int_equal(4, tok.steps);
+  assert_int_equal(4, baton.count);
+
+  /* resuming a finished parser is a no-op */
+  SLN_ERR(sln_tok_parser_resume(&tok, bb, tok_resume_cb, &baton));
+  assert_int_equal(4, tok.steps);
+
+  sln_tok_parser_reset(&tok);
+  assert_int_equal(0, tok.offset);
+  assert_int_equal(0, tok.steps);
+
+  sln_tok_parser_destroy(&tok);
+  sln_brigade_destroy(bb);
+}
+
 SLN_TESTS_START(tok)
 SLN_TESTS_ENTRY(tok_nowork)
 SLN_TESTS_ENTRY(tok_bytes)
 SLN_TESTS_ENTRY(tok_copy_brigade)
+SLN_TESTS_ENTRY(tok_resume_whole)
+SLN_TESTS_ENTRY(tok_resume_bytewise)
 SLN_TESTS_END()
@@ -0,0 +1,111 @@
+/*
+ * Licensed to Selene developers ('Selene') under one or more
+ * contributor license agreements.  See the NOTICE file distributed with
+ * this work for additional information regarding copyright ownership.
+ * Selene licenses this file to You under the Apache License, Version 2.0
+ * (the "License"); you may not use this file except in compliance with
+ * the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "selene.h"
+#include "sln_tests.h"
+#include "sln_workers.h"
+#include <pthread.h>
+#include <string.h>
+
+#define JOBS 1000
+
+typedef struct {
+  int lanes;
+  int ran[JOBS];
+  int bad_lane;
+} jobs_baton_t;
+
+static void count_job(void *baton, size_t job, int lane) {
+  jobs_baton_t *jb = (jobs_baton_t *)baton;
+
+  /* each job is handed out once, so this needs no lock */
+  jb->ran[job]++;
+  if (lane < 0 || lane >= jb->lanes) {
+    jb->bad_lane = 1;
+  }
+}
+
+static void run_jobs(sln_workers_t *w, jobs_baton_t *jb, size_t njobs) {
+  size_t i;
+
+  memset(jb, 0, sizeof(*jb));
+  jb->lanes = sln_workers_lanes(w);
+
+  sln_workers_run(w, count_job, jb, njobs);
+
+  for (i = 0; i < njobs; i++) {
+    assert_int_equal(1, jb->ran[i]);
+  }
+  assert_int_equal(0, jb->bad_lane);
+}
+
+static void workers_run(void **state) {
+  sln_workers_t *w;
+  jobs_baton_t jb;
+
+  SLN_ERR(sln_workers_create(sln_test_alloc, 3, &w));
+  assert_int_equal(4, sln_workers_lanes(w));
+
+  run_jobs(w, &jb, 0);
+  run_jobs(w, &jb, 1);
+  run_jobs(w, &jb, JOBS);
+  run_jobs(w, &jb, JOBS);
+
+  sln_workers_destroy(w);
+}
+
+typedef struct {
+  sln_workers_t *w;
+  jobs_baton_t jb;
+} submitter_t;
+
+static void *submit_main(void *arg) {
+  submitter_t *sub = (submitter_t *)arg;
+  int i;
+
+  for (i = 0; i < 20; i++) {
+    run_jobs(sub->w, &sub->jb, JOBS);
+  }
+
+  return NULL;
+}
+
+static void workers_many_submitters(void **state) {
+  sln_workers_t *w;
+  submitter_t subs[4];
+  pthread_t threads[4];
+  int i;
+
+  SLN_ERR(sln_workers_create(sln_test_alloc, 2, &w));
+
+  for (i = 0; i < 4; i++) {
+    subs[i].w = w;
+    assert_int_equal(0, pthread_create(&threads[i], NULL, submit_main,
+                                       &subs[i]));
+  }
+
+  for (i = 0; i < 4; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  sln_workers_destroy(w);
+}
+
+SLN_TESTS_START(workers)
+SLN_TESTS_ENTRY(workers_run)
+SLN_TESTS_ENTRY(workers_many_submitters)
+SLN_TESTS_END()
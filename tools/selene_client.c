@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <netdb.h>
 #include <unistd.h>
@@ -104,25 +105,25 @@ static selene_error_t *have_cleartext(selene_t *s, selene_event_e event,
 
 static selene_error_t *want_pull(selene_t *s, selene_event_e event,
                                  void *baton) {
-  int rv = 0;
-  char buf[8096];
-  size_t blen = 0;
-  size_t remaining = 0;
+  int count = 0;
+  ssize_t rv = 0;
+  struct iovec vec[16];
   client_t *c = (client_t *)baton;
 
   do {
-    SELENE_ERR(
-        selene_io_out_enc_bytes(s, &buf[0], sizeof(buf), &blen, &remaining));
+    /* hand Selene's buffers to the kernel as they are */
+    SELENE_ERR(selene_io_out_enc_peek_iovec(s, vec, 16, &count));
 
-    if (blen > 0) {
+    if (count > 0) {
       setblocking(c->sock);
-      rv = write(c->sock, buf, blen);
+      rv = writev(c->sock, vec, count);
       if (rv < 0) {
         c->write_err = errno;
         break;
       }
+      SELENE_ERR(selene_io_out_enc_consume(s, rv));
     }
-  } while (remaining > 0);
+  } while (count > 0);
 
   return SELENE_SUCCESS;
 }
@@ -131,11 +132,17 @@ static int read_from_sock(client_t *c, selene_t *s) {
   int err;
   ssize_t rv = 0;
   do {
-    char buf[8096];
+    char *buf;
+    size_t blen;
 
     setnonblocking(c->sock);
 
-    rv = read(c->sock, &buf[0], sizeof(buf));
+    /* read straight into Selene's buffers */
+    SERR(selene_io_in_enc_reserve(s, 0, &buf, &blen));
+
+    rv = read(c->sock, buf, blen);
+
+    SERR(selene_io_in_enc_commit(s, rv > 0 ? rv : 0));
 
     if (rv == -1) {
       err = errno;
@@ -148,10 +155,6 @@ static int read_from_sock(client_t *c, selene_t *s) {
     if (rv == 0) {
       break;
     }
-
-    if (rv > 0) {
-      SERR(selene_io_in_enc_bytes(s, buf, rv));
-    }
   } while (rv > 0);
 
   return 0;